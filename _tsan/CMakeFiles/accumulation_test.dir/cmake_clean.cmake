@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/accumulation_test.dir/tests/accumulation_test.cpp.o"
+  "CMakeFiles/accumulation_test.dir/tests/accumulation_test.cpp.o.d"
+  "accumulation_test"
+  "accumulation_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/accumulation_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
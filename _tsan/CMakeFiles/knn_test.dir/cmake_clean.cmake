@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/knn_test.dir/tests/knn_test.cpp.o"
+  "CMakeFiles/knn_test.dir/tests/knn_test.cpp.o.d"
+  "knn_test"
+  "knn_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/knn_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/selection_test.dir/tests/selection_test.cpp.o"
+  "CMakeFiles/selection_test.dir/tests/selection_test.cpp.o.d"
+  "selection_test"
+  "selection_test.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/selection_test.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
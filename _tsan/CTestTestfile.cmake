@@ -0,0 +1,32 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo
+# Build directory: /root/repo/_tsan
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test(expression "/root/repo/_tsan/expression_test")
+set_tests_properties(expression PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;42;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(io "/root/repo/_tsan/io_test")
+set_tests_properties(io PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;42;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(hash "/root/repo/_tsan/hash_test")
+set_tests_properties(hash PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;42;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(accumulation "/root/repo/_tsan/accumulation_test")
+set_tests_properties(accumulation PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;42;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(sparse "/root/repo/_tsan/sparse_test")
+set_tests_properties(sparse PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;42;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(selection "/root/repo/_tsan/selection_test")
+set_tests_properties(selection PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;42;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(stream "/root/repo/_tsan/stream_test")
+set_tests_properties(stream PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;42;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(distributed "/root/repo/_tsan/distributed_test")
+set_tests_properties(distributed PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;42;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(gemm "/root/repo/_tsan/gemm_test")
+set_tests_properties(gemm PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;42;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(knn "/root/repo/_tsan/knn_test")
+set_tests_properties(knn PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;42;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(compact "/root/repo/_tsan/compact_test")
+set_tests_properties(compact PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;42;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(math "/root/repo/_tsan/math_test")
+set_tests_properties(math PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;42;add_test;/root/repo/CMakeLists.txt;0;")
+add_test(parallel "/root/repo/_tsan/parallel_test")
+set_tests_properties(parallel PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/CMakeLists.txt;42;add_test;/root/repo/CMakeLists.txt;0;")
@@ -0,0 +1,1196 @@
+/*
+ Benchmarks of the public Vector operations.
+
+ Every benchmark sweeps the vector size from 3 up to VECTOR_BENCH_MAX_SIZE
+ (set by CMake) for float, double and int, and reports elements/s and
+ bytes/s, where the bytes are the ones the operation has to read or write.
+
+ Run a subset with e.g. `./vector_bench --benchmark_filter='Sum<double>'`.
+*/
+#include "vector.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef VECTOR_BENCH_MAX_SIZE
+#define VECTOR_BENCH_MAX_SIZE 100000000
+#endif
+
+namespace {
+    constexpr std::int64_t max_size = VECTOR_BENCH_MAX_SIZE;
+
+    // 3: geometry, 16: inline storage, then L1, L2, L3 and main memory
+    void sizes(benchmark::internal::Benchmark* b) {
+        for (std::int64_t n : { 3, 16, 256, 4096, 65536, 1 << 20, 1 << 24, 100000000 })
+            if (n <= max_size)
+                b->Arg(n);
+    }
+
+    // sizes for the operations that are O(n) per element, like repeated inserts
+    void small_sizes(benchmark::internal::Benchmark* b) {
+        for (std::int64_t n : { 3, 16, 256, 4096, 65536 })
+            if (n <= max_size)
+                b->Arg(n);
+    }
+
+    // values in [1, 2), or in [0, 4) for integers so that sums of 10^8 elements don't overflow
+    template <typename T>
+    Vector<T> random_vector(std::size_t n, unsigned seed = 42) {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<double> dist(1.0, 2.0);
+
+        Vector<T> vec(n, uninitialized);
+        for (auto& x : vec)
+            x = std::is_integral_v<T> ? static_cast<T>(gen() % 4) : static_cast<T>(dist(gen));
+
+        return vec;
+    }
+
+    template <typename T>
+    Vector<T> ones(std::size_t n) {
+        Vector<T> vec(n, uninitialized);
+        std::fill(vec.begin(), vec.end(), T(1));
+
+        return vec;
+    }
+
+    // `streams` arrays of n elements are read or written per iteration
+    template <typename T>
+    void report(benchmark::State& state, std::size_t n, std::size_t streams = 1) {
+        state.SetItemsProcessed(state.iterations() * std::int64_t(n));
+        state.SetBytesProcessed(state.iterations() * std::int64_t(n * streams * sizeof(T)));
+    }
+}
+
+// construction
+
+template <typename T>
+void Construct(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    for (auto _ : state) {
+        Vector<T> vec(n);
+        benchmark::DoNotOptimize(vec.data());
+    }
+    report<T>(state, n);
+}
+
+template <typename T>
+void ConstructUninitialized(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    for (auto _ : state) {
+        Vector<T> vec(n, uninitialized);
+        benchmark::DoNotOptimize(vec.data());
+    }
+    report<T>(state, n);
+}
+
+template <typename T>
+void ConstructFromUniquePtr(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    auto source = std::make_unique<T[]>(n);
+    for (auto _ : state) {
+        Vector<T> vec(source, n);
+        benchmark::DoNotOptimize(vec.data());
+    }
+    report<T>(state, n, 2);
+}
+
+template <typename T>
+void ConstructFromView(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto source = random_vector<T>(n);
+    for (auto _ : state) {
+        Vector<T> vec(source.view());
+        benchmark::DoNotOptimize(vec.data());
+    }
+    report<T>(state, n, 2);
+}
+
+template <typename T>
+void Copy(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto source = random_vector<T>(n);
+    for (auto _ : state) {
+        Vector<T> vec(source);
+        benchmark::DoNotOptimize(vec.data());
+    }
+    report<T>(state, n, 2);
+}
+
+// copies of a SharedVector share the elements: O(1) whatever the size
+template <typename T>
+void CopyShared(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const SharedVector<T> source(random_vector<T>(n));
+    for (auto _ : state) {
+        SharedVector<T> vec(source);
+        benchmark::DoNotOptimize(vec.data());
+    }
+    report<T>(state, n);
+}
+
+// storage
+
+template <typename T>
+void Resize(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    for (auto _ : state) {
+        Vector<T> vec;
+        vec.resize(n / 2, T(1));
+        vec.resize(n, T(2));
+        benchmark::DoNotOptimize(vec.data());
+    }
+    report<T>(state, n);
+}
+
+template <typename T>
+void PushBack(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    for (auto _ : state) {
+        Vector<T> vec;
+        for (std::size_t i = 0; i < n; i++)
+            vec.push_back(static_cast<T>(i));
+        benchmark::DoNotOptimize(vec.data());
+    }
+    report<T>(state, n);
+}
+
+template <typename T>
+void PushBackReserved(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    for (auto _ : state) {
+        Vector<T> vec;
+        vec.reserve(n);
+        for (std::size_t i = 0; i < n; i++)
+            vec.push_back(static_cast<T>(i));
+        benchmark::DoNotOptimize(vec.data());
+    }
+    report<T>(state, n);
+}
+
+// one element inserted in and erased from the middle, the rest is shifted twice
+template <typename T>
+void InsertEraseMiddle(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    auto vec = random_vector<T>(n);
+    vec.reserve(n + 1);
+    for (auto _ : state) {
+        vec.insert(n / 2, T(7));
+        vec.erase(n / 2);
+        benchmark::DoNotOptimize(vec.data());
+    }
+    report<T>(state, n / 2, 4);
+}
+
+// building a vector of n elements by repeated inserts at the front
+template <typename T>
+void InsertFront(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    for (auto _ : state) {
+        Vector<T> vec;
+        for (std::size_t i = 0; i < n; i++)
+            vec.insert(0, static_cast<T>(i));
+        benchmark::DoNotOptimize(vec.data());
+    }
+    report<T>(state, n);
+}
+
+template <typename T>
+void InsertRange(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const std::vector<T> source(n, T(3));
+    for (auto _ : state) {
+        Vector<T> vec;
+        vec.insert(0, source.begin(), source.end());
+        benchmark::DoNotOptimize(vec.data());
+    }
+    report<T>(state, n, 2);
+}
+
+template <typename T>
+void EraseRange(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto source = random_vector<T>(n);
+    for (auto _ : state) {
+        state.PauseTiming();
+        Vector<T> vec(source.view());
+        state.ResumeTiming();
+
+        vec.erase(0, n / 2);
+        benchmark::DoNotOptimize(vec.data());
+    }
+    report<T>(state, n - n / 2, 2);
+}
+
+template <typename T>
+void Subvec(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto vec = random_vector<T>(n);
+    for (auto _ : state) {
+        auto sub = vec.subvec(0, n / 2);
+        benchmark::DoNotOptimize(sub.data());
+    }
+    report<T>(state, n / 2, 2);
+}
+
+template <typename T>
+void Concat(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto a = random_vector<T>(n / 2), b = random_vector<T>(n - n / 2, 7);
+    for (auto _ : state) {
+        auto joined = concat(a, b);
+        benchmark::DoNotOptimize(joined.data());
+    }
+    report<T>(state, n, 2);
+}
+
+#if defined(VECTOR_HAS_PMR)
+// as Subvec, with the copy drawn from an arena over a preallocated buffer, released every iteration
+template <typename T>
+void SubvecArena(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto vec = random_vector<T>(n);
+    std::vector<unsigned char> buffer(n * sizeof(T) + 2 * vector_alignment);
+    std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+    for (auto _ : state) {
+        {
+            ScopedVectorResource scope(&arena);
+            PmrVector<T> sub(vec.view(0, n / 2));
+            benchmark::DoNotOptimize(sub.data());
+        }
+        arena.release();
+    }
+    report<T>(state, n / 2, 2);
+}
+#endif
+
+template <typename T>
+void ConcatViewSum(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto a = random_vector<T>(n / 2), b = random_vector<T>(n - n / 2, 7);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(concat_view(a, b).sum());
+    report<T>(state, n);
+}
+
+// reductions
+
+#define VECTOR_BENCH_REDUCTION(Name, call)                      \
+    template <typename T>                                       \
+    void Name(benchmark::State& state) {                        \
+        const std::size_t n = state.range(0);                   \
+        const auto vec = random_vector<T>(n);                   \
+        for (auto _ : state)                                    \
+            benchmark::DoNotOptimize(vec.call);                 \
+        report<T>(state, n);                                    \
+    }
+
+VECTOR_BENCH_REDUCTION(Sum, sum())
+VECTOR_BENCH_REDUCTION(Mean, mean())
+VECTOR_BENCH_REDUCTION(Magnitude, magnitude())
+VECTOR_BENCH_REDUCTION(Median, median())
+VECTOR_BENCH_REDUCTION(Quantiles, quantiles({ 0.5, 0.9, 0.99 }))
+VECTOR_BENCH_REDUCTION(Max, max())
+VECTOR_BENCH_REDUCTION(Min, min())
+VECTOR_BENCH_REDUCTION(MinMaxIndexed, minmax())
+VECTOR_BENCH_REDUCTION(Describe, describe())
+VECTOR_BENCH_REDUCTION(Argmax, argmax())
+VECTOR_BENCH_REDUCTION(TopK, top_k(100))
+VECTOR_BENCH_REDUCTION(TopKLarge, top_k(n / 8))
+VECTOR_BENCH_REDUCTION(SumParallel, sum(execution::par))
+VECTOR_BENCH_REDUCTION(MedianParallel, median(execution::par))
+VECTOR_BENCH_REDUCTION(MinMaxParallel, minmax(execution::par))
+VECTOR_BENCH_REDUCTION(TopKParallel, top_k(execution::par, 100))
+VECTOR_BENCH_REDUCTION(SumPairwise, sum(accumulation::pairwise))
+VECTOR_BENCH_REDUCTION(SumKahan, sum(accumulation::kahan))
+VECTOR_BENCH_REDUCTION(SumWidened, sum(accumulation::widened))
+VECTOR_BENCH_REDUCTION(MagnitudeKahan, magnitude(accumulation::kahan))
+VECTOR_BENCH_REDUCTION(SumReproducible, sum(accumulation::reproducible))
+VECTOR_BENCH_REDUCTION(SumReproducibleParallel, sum(execution::par, accumulation::reproducible))
+VECTOR_BENCH_REDUCTION(MagnitudeReproducible, magnitude(accumulation::reproducible))
+
+// every statistic of RunningStats, one sample at a time
+template <typename T>
+void RunningStatsPush(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto vec = random_vector<T>(n);
+    for (auto _ : state) {
+        RunningStats<T> stats;
+        stats.push(vec);
+        benchmark::DoNotOptimize(stats.median());
+    }
+    report<T>(state, n);
+}
+
+#undef VECTOR_BENCH_REDUCTION
+
+// ones, so that the product neither overflows nor underflows
+template <typename T>
+void Product(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto vec = ones<T>(n);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(vec.product());
+    report<T>(state, n);
+}
+
+template <typename T>
+void DotProduct(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto a = random_vector<T>(n), b = random_vector<T>(n, 7);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(dot_product(a, b));
+    report<T>(state, n, 2);
+}
+
+template <typename T>
+void DotProductParallel(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto a = random_vector<T>(n), b = random_vector<T>(n, 7);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(dot_product(execution::par, a, b));
+    report<T>(state, n, 2);
+}
+
+// one pass for the dot product and both norms, vs dot_product() and two magnitude()
+template <typename T>
+void Cosine(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto a = random_vector<T>(n), b = random_vector<T>(n, 7);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(cosine(a, b));
+    report<T>(state, n, 2);
+}
+
+template <typename T>
+void CosineThreePass(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto a = random_vector<T>(n), b = random_vector<T>(n, 7);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(dot_product(a, b) / (a.magnitude() * b.magnitude()));
+    report<T>(state, n, 2);
+}
+
+template <typename T>
+void L1(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto a = random_vector<T>(n), b = random_vector<T>(n, 7);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(l1(a, b));
+    report<T>(state, n, 2);
+}
+
+template <typename T>
+void CrossProduct(benchmark::State& state) {
+    const auto a = random_vector<T>(3), b = random_vector<T>(3, 7);
+    for (auto _ : state) {
+        auto c = cross_product(a, b);
+        benchmark::DoNotOptimize(c.data());
+    }
+    report<T>(state, 3, 3);
+}
+
+// the components past the third wrap around
+template <typename T>
+void CrossProductLarge(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto a = random_vector<T>(n), b = random_vector<T>(n, 7);
+    for (auto _ : state) {
+        auto c = cross_product(a, b);
+        benchmark::DoNotOptimize(c.data());
+    }
+    report<T>(state, n, 3);
+}
+
+// operator[] in an indexed loop, unchecked in release builds
+template <typename T>
+void IndexedLoop(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto a = random_vector<T>(n), b = random_vector<T>(n, 7);
+    Vector<T> c(n);
+    for (auto _ : state) {
+        T* out = c.data();
+        for (std::size_t i = 0; i < n; i++)
+            out[i] = a[i] * b[i];
+        benchmark::DoNotOptimize(c.data());
+    }
+    report<T>(state, n, 3);
+}
+
+// fixed-size vectors, the loop over many of them is what the geometry code runs
+template <typename T>
+void FixedDotCross(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    std::vector<Vector<T, 3>> points(n);
+    for (std::size_t i = 0; i < n; i++)
+        points[i] = Vector<T, 3>(T(i % 7), T(i % 5), T(i % 3));
+
+    const Vector<T, 3> axis(T(1), T(2), T(3));
+    for (auto _ : state) {
+        T total = T();
+        for (const auto& p : points)
+            total += dot_product(cross_product(p, axis), p + axis);
+        benchmark::DoNotOptimize(total);
+    }
+    report<T>(state, n, 3);
+}
+
+// normalizes a copy, so that the values don't shrink to zero
+template <typename T>
+void Normalize(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto source = random_vector<T>(n);
+    Vector<T> vec(source.view());
+    for (auto _ : state) {
+        vec = source.view() * T(1);
+        vec.normalize();
+        benchmark::DoNotOptimize(vec.data());
+    }
+    report<T>(state, n, 4);
+}
+
+// normalizes the same vector over and over: the magnitude pass and the scaling pass only
+template <typename T>
+void NormalizeInPlace(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    auto vec = random_vector<T>(n);
+    for (auto _ : state) {
+        vec.normalize();
+        benchmark::DoNotOptimize(vec.data());
+    }
+    report<T>(state, n, 3);
+}
+
+// batches of `n` vectors of 128 elements
+
+constexpr std::size_t batch_dim = 128;
+
+template <typename T>
+VectorBatch<T> random_batch(std::size_t n, BatchLayout layout) {
+    VectorBatch<T> batch(n, batch_dim, layout);
+    const auto vec = random_vector<T>(batch_dim);
+    for (std::size_t i = 0; i < n; i++)
+        batch.assign(i, vec);
+
+    return batch;
+}
+
+template <typename T, BatchLayout Layout>
+void BatchDotProduct(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto batch = random_batch<T>(n, Layout);
+    const auto query = random_vector<T>(batch_dim, 7);
+    std::vector<T> out(n);
+    for (auto _ : state) {
+        dot_product(batch, query, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    report<T>(state, n * batch_dim);
+}
+
+template <typename T, BatchLayout Layout>
+void BatchDistances(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto batch = random_batch<T>(n, Layout);
+    const auto query = random_vector<T>(batch_dim, 7);
+    std::vector<T> out(n);
+    for (auto _ : state) {
+        distances(batch, query, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    report<T>(state, n * batch_dim);
+}
+
+template <typename T, BatchLayout Layout>
+void BatchNormalize(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    auto batch = random_batch<T>(n, Layout);
+    for (auto _ : state) {
+        batch.normalize();
+        benchmark::DoNotOptimize(batch.data());
+    }
+    report<T>(state, n * batch_dim, 3);
+}
+
+template <typename T, BatchLayout Layout>
+void BatchCosine(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto batch = random_batch<T>(n, Layout);
+    const auto query = random_vector<T>(batch_dim, 7);
+    std::vector<T> out(n);
+    for (auto _ : state) {
+        cosine(batch, query, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    report<T>(state, n * batch_dim);
+}
+
+template <typename T, BatchLayout Layout>
+void BatchCosineCached(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    auto batch = random_batch<T>(n, Layout);
+    batch.cache_norms();
+    const auto query = random_vector<T>(batch_dim, 7);
+    std::vector<T> out(n);
+    for (auto _ : state) {
+        cosine(batch, query, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    report<T>(state, n * batch_dim);
+}
+
+// the 10 nearest of n vectors
+template <typename T, BatchLayout Layout>
+void Knn(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto batch = random_batch<T>(n, Layout);
+    const auto query = random_vector<T>(batch_dim, 7);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(knn(batch, query, 10).data());
+    report<T>(state, n * batch_dim);
+}
+
+template <typename T, BatchLayout Layout>
+void KnnParallel(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto batch = random_batch<T>(n, Layout);
+    const auto query = random_vector<T>(batch_dim, 7);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(knn(execution::par, batch, query, 10).data());
+    report<T>(state, n * batch_dim);
+}
+
+// 64 queries against n vectors
+template <typename T, BatchLayout Layout>
+void PairwiseDistances(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto queries = random_batch<T>(64, BatchLayout::row_major);
+    const auto batch = random_batch<T>(n, Layout);
+    std::vector<T> out(64 * n);
+    for (auto _ : state) {
+        pairwise_distances(queries, batch, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    report<T>(state, 64 * n * batch_dim);
+}
+
+// 64 queries against n candidates as one blocked product, vs one dot_product per pair
+template <typename T>
+void DotProducts(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto queries = random_batch<T>(64, BatchLayout::row_major);
+    const auto candidates = random_batch<T>(n, BatchLayout::row_major);
+    std::vector<T> out(64 * n);
+    for (auto _ : state) {
+        dot_products(queries, candidates, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    report<T>(state, 64 * n * batch_dim);
+}
+
+template <typename T>
+void DotProductsParallel(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto queries = random_batch<T>(64, BatchLayout::row_major);
+    const auto candidates = random_batch<T>(n, BatchLayout::row_major);
+    std::vector<T> out(64 * n);
+    for (auto _ : state) {
+        dot_products(execution::par, queries, candidates, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    report<T>(state, 64 * n * batch_dim);
+}
+
+template <typename T>
+void DotProductsNaive(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto queries = random_batch<T>(64, BatchLayout::row_major);
+    const auto candidates = random_batch<T>(n, BatchLayout::row_major);
+    std::vector<T> out(64 * n);
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < 64; i++)
+            for (std::size_t j = 0; j < n; j++)
+                out[i * n + j] = dot_product(queries.row(i), candidates.row(j));
+        benchmark::DoNotOptimize(out.data());
+    }
+    report<T>(state, 64 * n * batch_dim);
+}
+
+// binary files, in the page cache after the first iteration
+
+template <typename T>
+std::string bench_file() {
+    return "vector_bench_" + std::to_string(sizeof(T)) + (std::is_integral_v<T> ? "i" : "f") + ".bin";
+}
+
+template <typename T>
+void Save(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto vec = random_vector<T>(n);
+    for (auto _ : state)
+        vec.save(bench_file<T>());
+    std::remove(bench_file<T>().c_str());
+    report<T>(state, n);
+}
+
+template <typename T>
+void Load(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    random_vector<T>(n).save(bench_file<T>());
+    for (auto _ : state) {
+        auto vec = Vector<T>::load(bench_file<T>());
+        benchmark::DoNotOptimize(vec.data());
+    }
+    std::remove(bench_file<T>().c_str());
+    report<T>(state, n);
+}
+
+#if defined(VECTOR_HAS_MMAP)
+// mapping alone is O(1), so the elements are summed to touch every page
+template <typename T>
+void MapSum(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    random_vector<T>(n).save(bench_file<T>());
+    for (auto _ : state) {
+        const auto vec = Vector<T>::map(bench_file<T>());
+        benchmark::DoNotOptimize(vec.sum());
+    }
+    std::remove(bench_file<T>().c_str());
+    report<T>(state, n);
+}
+#endif
+
+// reads overlap the sums
+template <typename T>
+void StreamSum(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    random_vector<T>(n).save(bench_file<T>());
+    const VectorStream<T> stream(bench_file<T>());
+    for (auto _ : state)
+        benchmark::DoNotOptimize(stream.sum());
+    std::remove(bench_file<T>().c_str());
+    report<T>(state, n);
+}
+
+// the same chunks read and summed one after the other
+template <typename T>
+void ReadThenSum(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    random_vector<T>(n).save(bench_file<T>());
+    const std::size_t chunk = VectorStream<T>::default_chunk_size;
+    Vector<T> buffer(std::min(n, chunk));
+    for (auto _ : state) {
+        std::ifstream is(bench_file<T>(), std::ios::binary);
+        is.seekg(sizeof(VectorFileHeader));
+        T total = T();
+        for (std::size_t first = 0; first < n; first += chunk) {
+            const std::size_t count = std::min(chunk, n - first);
+            is.read(reinterpret_cast<char*>(buffer.data()), count * sizeof(T));
+            total += buffer.view(0, count).sum();
+        }
+        benchmark::DoNotOptimize(total);
+    }
+    std::remove(bench_file<T>().c_str());
+    report<T>(state, n);
+}
+
+// distributed vectors, over 4 ranks on threads of their own; starting the threads is part of every iteration
+
+constexpr std::size_t bench_ranks = 4;
+
+template <typename F>
+void on_ranks(const std::vector<std::shared_ptr<LocalTransport>>& group, F f) {
+    std::vector<std::thread> threads;
+    for (std::size_t r = 0; r < group.size(); r++)
+        threads.emplace_back([&f, r] { f(r); });
+    for (auto& thread : threads)
+        thread.join();
+}
+
+// the shards are summed in parallel, the 4 partial sums go up and down the tree
+template <typename T>
+void DistributedSum(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto source = random_vector<T>(n);
+    const auto group = LocalTransport::group(bench_ranks);
+    std::vector<DistributedVector<T>> shards;
+    for (std::size_t r = 0; r < bench_ranks; r++) {
+        shards.emplace_back(group[r], n);
+        Vector<T>& local = shards.back().local();
+        std::copy(source.begin() + shards.back().offset(), source.begin() + shards.back().offset() + local.size(), local.begin());
+    }
+    for (auto _ : state)
+        on_ranks(group, [&](std::size_t r) { benchmark::DoNotOptimize(shards[r].sum()); });
+    report<T>(state, n);
+}
+
+// element-wise sum of 4 vectors of n elements, around the ring from 64 KiB on
+template <typename T>
+void Allreduce(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto group = LocalTransport::group(bench_ranks);
+    std::vector<Vector<T>> parts(bench_ranks, random_vector<T>(n));
+    for (auto _ : state)
+        on_ranks(group, [&](std::size_t r) { allreduce(*group[r], parts[r]); });
+    report<T>(state, n * bench_ranks);
+}
+
+// the same through the tree at every size
+template <typename T>
+void AllreduceTree(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto group = LocalTransport::group(bench_ranks);
+    std::vector<Vector<T>> parts(bench_ranks, random_vector<T>(n));
+    for (auto _ : state)
+        on_ranks(group, [&](std::size_t r) { vector_detail::tree_allreduce(*group[r], parts[r].data(), n, std::plus<>()); });
+    report<T>(state, n * bench_ranks);
+}
+
+// sizes for the allreduce benchmarks, which hold 4 vectors plus the messages in flight
+void allreduce_sizes(benchmark::internal::Benchmark* b) {
+    for (std::int64_t n : { 256, 4096, 65536, 1 << 20, 1 << 24 })
+        if (n <= max_size)
+            b->Arg(n);
+}
+
+// element-wise operations
+
+template <typename T>
+void FusedExpression(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto a = random_vector<T>(n), b = random_vector<T>(n, 7), c = random_vector<T>(n, 9);
+    Vector<T> d(n);
+    for (auto _ : state) {
+        d = (a + b - c) * T(2);
+        benchmark::DoNotOptimize(d.data());
+    }
+    report<T>(state, n, 4);
+}
+
+// adds and subtracts, so that the values stay bounded
+template <typename T>
+void AddSubtractAssign(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    auto a = random_vector<T>(n);
+    const auto b = random_vector<T>(n, 7);
+    for (auto _ : state) {
+        a += b;
+        a -= b;
+        benchmark::DoNotOptimize(a.data());
+    }
+    report<T>(state, n, 6);
+}
+
+template <typename T>
+void Scale(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    auto a = random_vector<T>(n);
+    for (auto _ : state) {
+        a *= T(1);
+        benchmark::DoNotOptimize(a.data());
+    }
+    report<T>(state, n, 2);
+}
+
+// element-wise functions, fused into the assignment
+
+template <typename T>
+void Axpy(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto x = random_vector<T>(n);
+    auto y = random_vector<T>(n, 7);
+    for (auto _ : state) {
+        y = axpy(T(1), x, y);
+        benchmark::DoNotOptimize(y.data());
+    }
+    report<T>(state, n, 3);
+}
+
+// max(x, 0) through a comparison mask
+template <typename T>
+void Where(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto x = random_vector<T>(n);
+    Vector<T> y(n);
+    for (auto _ : state) {
+        y = where(greater(x, T(1.5)), x, T(0));
+        benchmark::DoNotOptimize(y.data());
+    }
+    report<T>(state, n, 2);
+}
+
+template <typename T>
+void Exp(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto x = random_vector<T>(n);
+    Vector<T> y(n);
+    for (auto _ : state) {
+        y = exp(x);
+        benchmark::DoNotOptimize(y.data());
+    }
+    report<T>(state, n, 2);
+}
+
+// std::exp element by element, compare with Exp
+template <typename T>
+void ExpScalar(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto x = random_vector<T>(n);
+    Vector<T> y(n);
+    for (auto _ : state) {
+        std::transform(x.begin(), x.end(), y.begin(), [](T v) { return std::exp(v); });
+        benchmark::DoNotOptimize(y.data());
+    }
+    report<T>(state, n, 2);
+}
+
+template <typename T>
+void Log(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto x = random_vector<T>(n);
+    Vector<T> y(n);
+    for (auto _ : state) {
+        y = log(x);
+        benchmark::DoNotOptimize(y.data());
+    }
+    report<T>(state, n, 2);
+}
+
+// comparisons, on equal vectors so that everything is compared
+
+template <typename T>
+void Equal(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto a = random_vector<T>(n), b = random_vector<T>(n);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(a == b);
+    report<T>(state, n, 2);
+}
+
+// unequal vectors whose hashes are cached: rejected without reading the elements
+template <typename T>
+void EqualHashed(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto a = random_vector<T>(n), b = random_vector<T>(n, 7);
+    a.hash();
+    b.hash();
+    for (auto _ : state)
+        benchmark::DoNotOptimize(a == b);
+    report<T>(state, n, 2);
+}
+
+template <typename T>
+void Hash(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto vec = random_vector<T>(n);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(vec.view().hash());
+    report<T>(state, n);
+}
+
+template <typename T>
+void Less(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto a = random_vector<T>(n), b = random_vector<T>(n);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(a < b);
+    report<T>(state, n, 2);
+}
+
+template <typename T>
+void LessEqual(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto a = random_vector<T>(n), b = random_vector<T>(n);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(a <= b);
+    report<T>(state, n, 2);
+}
+
+// sorts 1024 keys of n elements that only differ in the last element, through an index
+template <typename T>
+void SortKeys(benchmark::State& state) {
+    const std::size_t n = state.range(0), count = 1024;
+    const auto prefix = random_vector<T>(n);
+    const auto last = random_vector<T>(count, 7);
+    
+    std::vector<Vector<T>> keys;
+    for (std::size_t k = 0; k < count; k++) {
+        keys.emplace_back(prefix.view());
+        keys.back()[n - 1] = last[k];
+    }
+    
+    std::vector<std::size_t> order(count);
+    for (auto _ : state) {
+        for (std::size_t k = 0; k < count; k++)
+            order[k] = k;
+        std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return keys[a] < keys[b]; });
+        benchmark::DoNotOptimize(order.data());
+    }
+    report<T>(state, n * count);
+}
+
+// sparse vectors, with 1 in `density` elements non-zero like bag-of-words features
+
+template <typename T>
+SparseVector<T> random_sparse(std::size_t n, std::size_t density, unsigned seed) {
+    std::mt19937 gen(seed);
+    const auto values = random_vector<T>(n, seed);
+    
+    SparseVector<T> vec(n);
+    for (std::size_t i = 0; i < n; i++)
+        if (gen() % density == 0)
+            vec.push_back(i, values[i] == T() ? T(1) : values[i]);
+    
+    return vec;
+}
+
+// items are the elements of the dense equivalent, compare with DotProduct
+template <typename T>
+void SparseDenseDot(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto a = random_sparse<T>(n, 20, 42);
+    const auto b = random_vector<T>(n, 7);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(dot_product(a, b));
+    state.SetItemsProcessed(state.iterations() * std::int64_t(n));
+}
+
+template <typename T>
+void SparseDot(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto a = random_sparse<T>(n, 20, 42), b = random_sparse<T>(n, 20, 7);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(dot_product(a, b));
+    state.SetItemsProcessed(state.iterations() * std::int64_t(n));
+}
+
+// 1 in 1000 against 1 in 20 non-zeros: gallops through the denser vector
+template <typename T>
+void SparseDotSkewed(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto a = random_sparse<T>(n, 1000, 42), b = random_sparse<T>(n, 20, 7);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(dot_product(a, b));
+    state.SetItemsProcessed(state.iterations() * std::int64_t(n));
+}
+
+template <typename T>
+void SparseAdd(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto a = random_sparse<T>(n, 20, 42), b = random_sparse<T>(n, 20, 7);
+    for (auto _ : state) {
+        auto c = a + b;
+        benchmark::DoNotOptimize(c.values().data());
+    }
+    state.SetItemsProcessed(state.iterations() * std::int64_t(n));
+}
+
+// Storage is float16, bfloat16 or std::int8_t, compare with DotProduct<float>
+template <typename Storage>
+void CompactDot(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const CompactVector<Storage> a(random_vector<float>(n, 42)), b(random_vector<float>(n, 7));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(dot_product(a, b));
+    state.SetItemsProcessed(state.iterations() * std::int64_t(n));
+}
+
+// a stored vector against a float query
+template <typename Storage>
+void CompactQueryDot(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const CompactVector<Storage> a(random_vector<float>(n, 42));
+    const auto query = random_vector<float>(n, 7);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(dot_product(a, VectorView<float>(query)));
+    state.SetItemsProcessed(state.iterations() * std::int64_t(n));
+}
+
+template <typename Storage>
+void Compress(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const auto source = random_vector<float>(n);
+    for (auto _ : state) {
+        CompactVector<Storage> vec{VectorView<float>(source)};
+        benchmark::DoNotOptimize(vec.data());
+    }
+    state.SetItemsProcessed(state.iterations() * std::int64_t(n));
+}
+
+template <typename Storage>
+void Decompress(benchmark::State& state) {
+    const std::size_t n = state.range(0);
+    const CompactVector<Storage> source(random_vector<float>(n));
+    for (auto _ : state) {
+        auto vec = source.to_vector();
+        benchmark::DoNotOptimize(vec.data());
+    }
+    state.SetItemsProcessed(state.iterations() * std::int64_t(n));
+}
+
+#define VECTOR_BENCH(Name, Sizes)                                       \
+    BENCHMARK_TEMPLATE(Name, float)->Apply(Sizes);                      \
+    BENCHMARK_TEMPLATE(Name, double)->Apply(Sizes);                     \
+    BENCHMARK_TEMPLATE(Name, int)->Apply(Sizes)
+
+VECTOR_BENCH(Construct, sizes);
+VECTOR_BENCH(ConstructUninitialized, sizes);
+VECTOR_BENCH(ConstructFromUniquePtr, sizes);
+VECTOR_BENCH(ConstructFromView, sizes);
+VECTOR_BENCH(Copy, sizes);
+VECTOR_BENCH(CopyShared, sizes);
+
+VECTOR_BENCH(Resize, sizes);
+VECTOR_BENCH(PushBack, sizes);
+VECTOR_BENCH(PushBackReserved, sizes);
+VECTOR_BENCH(InsertEraseMiddle, sizes);
+VECTOR_BENCH(InsertFront, small_sizes);
+VECTOR_BENCH(InsertRange, sizes);
+VECTOR_BENCH(EraseRange, sizes);
+VECTOR_BENCH(Subvec, sizes);
+#if defined(VECTOR_HAS_PMR)
+VECTOR_BENCH(SubvecArena, sizes);
+#endif
+VECTOR_BENCH(Concat, sizes);
+VECTOR_BENCH(ConcatViewSum, sizes);
+
+VECTOR_BENCH(Sum, sizes);
+VECTOR_BENCH(SumPairwise, sizes);
+VECTOR_BENCH(SumKahan, sizes);
+VECTOR_BENCH(SumWidened, sizes);
+VECTOR_BENCH(SumReproducible, sizes);
+VECTOR_BENCH(Product, sizes);
+VECTOR_BENCH(Mean, sizes);
+VECTOR_BENCH(Magnitude, sizes);
+VECTOR_BENCH(MagnitudeKahan, sizes);
+VECTOR_BENCH(MagnitudeReproducible, sizes);
+VECTOR_BENCH(Median, sizes);
+VECTOR_BENCH(Quantiles, sizes);
+VECTOR_BENCH(Max, sizes);
+VECTOR_BENCH(Min, sizes);
+VECTOR_BENCH(MinMaxIndexed, sizes);
+VECTOR_BENCH(Describe, sizes);
+VECTOR_BENCH(Argmax, sizes);
+VECTOR_BENCH(TopK, sizes);
+VECTOR_BENCH(TopKLarge, sizes);
+VECTOR_BENCH(DotProduct, sizes);
+BENCHMARK_TEMPLATE(Cosine, float)->Apply(sizes);
+BENCHMARK_TEMPLATE(Cosine, double)->Apply(sizes);
+BENCHMARK_TEMPLATE(CosineThreePass, float)->Apply(sizes);
+BENCHMARK_TEMPLATE(CosineThreePass, double)->Apply(sizes);
+VECTOR_BENCH(L1, sizes);
+
+// normalize() is defined for floating point types only
+BENCHMARK_TEMPLATE(Normalize, float)->Apply(sizes);
+BENCHMARK_TEMPLATE(Normalize, double)->Apply(sizes);
+BENCHMARK_TEMPLATE(NormalizeInPlace, float)->Apply(sizes);
+BENCHMARK_TEMPLATE(NormalizeInPlace, double)->Apply(sizes);
+
+VECTOR_BENCH(SumParallel, sizes);
+VECTOR_BENCH(SumReproducibleParallel, sizes);
+VECTOR_BENCH(MedianParallel, sizes);
+VECTOR_BENCH(MinMaxParallel, sizes);
+VECTOR_BENCH(TopKParallel, sizes);
+VECTOR_BENCH(RunningStatsPush, sizes);
+VECTOR_BENCH(DotProductParallel, sizes);
+
+BENCHMARK_TEMPLATE(CrossProduct, float);
+BENCHMARK_TEMPLATE(CrossProduct, double);
+BENCHMARK_TEMPLATE(CrossProduct, int);
+VECTOR_BENCH(CrossProductLarge, sizes);
+VECTOR_BENCH(IndexedLoop, sizes);
+
+VECTOR_BENCH(FixedDotCross, small_sizes);
+
+// up to 2^20 vectors of 128 elements, 512 MB of doubles
+void batch_sizes(benchmark::internal::Benchmark* b) {
+    for (std::int64_t n : { 16, 1024, 65536, 1 << 20 })
+        if (n * std::int64_t(batch_dim) <= max_size)
+            b->Arg(n);
+}
+
+#define VECTOR_BENCH_BATCH(Name)                                                        \
+    BENCHMARK_TEMPLATE(Name, float, BatchLayout::row_major)->Apply(batch_sizes);        \
+    BENCHMARK_TEMPLATE(Name, float, BatchLayout::soa)->Apply(batch_sizes);              \
+    BENCHMARK_TEMPLATE(Name, double, BatchLayout::row_major)->Apply(batch_sizes);       \
+    BENCHMARK_TEMPLATE(Name, double, BatchLayout::soa)->Apply(batch_sizes)
+
+VECTOR_BENCH_BATCH(BatchDotProduct);
+VECTOR_BENCH_BATCH(BatchDistances);
+VECTOR_BENCH_BATCH(BatchNormalize);
+VECTOR_BENCH_BATCH(BatchCosine);
+VECTOR_BENCH_BATCH(BatchCosineCached);
+VECTOR_BENCH_BATCH(Knn);
+VECTOR_BENCH_BATCH(KnnParallel);
+VECTOR_BENCH_BATCH(PairwiseDistances);
+
+BENCHMARK_TEMPLATE(DotProducts, float)->Apply(batch_sizes);
+BENCHMARK_TEMPLATE(DotProducts, double)->Apply(batch_sizes);
+BENCHMARK_TEMPLATE(DotProductsParallel, float)->Apply(batch_sizes);
+BENCHMARK_TEMPLATE(DotProductsParallel, double)->Apply(batch_sizes);
+BENCHMARK_TEMPLATE(DotProductsNaive, float)->Apply(batch_sizes);
+BENCHMARK_TEMPLATE(DotProductsNaive, double)->Apply(batch_sizes);
+
+VECTOR_BENCH(Save, sizes);
+VECTOR_BENCH(Load, sizes);
+#if defined(VECTOR_HAS_MMAP)
+VECTOR_BENCH(MapSum, sizes);
+#endif
+VECTOR_BENCH(StreamSum, sizes);
+VECTOR_BENCH(ReadThenSum, sizes);
+
+// the work is done by the threads of the ranks, hence real time
+BENCHMARK_TEMPLATE(DistributedSum, float)->Apply(sizes)->UseRealTime();
+BENCHMARK_TEMPLATE(DistributedSum, double)->Apply(sizes)->UseRealTime();
+BENCHMARK_TEMPLATE(DistributedSum, int)->Apply(sizes)->UseRealTime();
+// floating point only, integers would overflow since every iteration multiplies the elements by 4
+BENCHMARK_TEMPLATE(Allreduce, float)->Apply(allreduce_sizes)->UseRealTime();
+BENCHMARK_TEMPLATE(Allreduce, double)->Apply(allreduce_sizes)->UseRealTime();
+BENCHMARK_TEMPLATE(AllreduceTree, float)->Apply(allreduce_sizes)->UseRealTime();
+BENCHMARK_TEMPLATE(AllreduceTree, double)->Apply(allreduce_sizes)->UseRealTime();
+
+VECTOR_BENCH(FusedExpression, sizes);
+VECTOR_BENCH(AddSubtractAssign, sizes);
+VECTOR_BENCH(Scale, sizes);
+VECTOR_BENCH(Axpy, sizes);
+VECTOR_BENCH(Where, sizes);
+
+// exp() and log() are defined for floating point types only
+BENCHMARK_TEMPLATE(Exp, float)->Apply(sizes);
+BENCHMARK_TEMPLATE(Exp, double)->Apply(sizes);
+BENCHMARK_TEMPLATE(ExpScalar, float)->Apply(sizes);
+BENCHMARK_TEMPLATE(ExpScalar, double)->Apply(sizes);
+BENCHMARK_TEMPLATE(Log, float)->Apply(sizes);
+BENCHMARK_TEMPLATE(Log, double)->Apply(sizes);
+
+VECTOR_BENCH(Equal, sizes);
+VECTOR_BENCH(EqualHashed, sizes);
+VECTOR_BENCH(Hash, sizes);
+VECTOR_BENCH(Less, sizes);
+VECTOR_BENCH(LessEqual, sizes);
+VECTOR_BENCH(SortKeys, small_sizes);
+
+VECTOR_BENCH(SparseDenseDot, sizes);
+VECTOR_BENCH(SparseDot, sizes);
+VECTOR_BENCH(SparseDotSkewed, sizes);
+VECTOR_BENCH(SparseAdd, sizes);
+
+#define VECTOR_BENCH_COMPACT(Name)                                      \
+    BENCHMARK_TEMPLATE(Name, float16)->Apply(sizes);                    \
+    BENCHMARK_TEMPLATE(Name, bfloat16)->Apply(sizes);                   \
+    BENCHMARK_TEMPLATE(Name, std::int8_t)->Apply(sizes)
+
+VECTOR_BENCH_COMPACT(CompactDot);
+VECTOR_BENCH_COMPACT(CompactQueryDot);
+VECTOR_BENCH_COMPACT(Compress);
+VECTOR_BENCH_COMPACT(Decompress);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,37 @@
+// accumulation::reproducible gives the same bits for any thread count, grain and threshold (user-016)
+#include "vector.hpp"
+#include "test.hpp"
+
+#include <random>
+
+int main() {
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> dist(-1000.f, 1000.f);
+    
+    Vector<float> v(1000003);
+    for (auto& x : v)
+        x = dist(gen);
+    
+    const float serial = v.sum(execution::seq, accumulation::reproducible);
+    
+    const std::size_t threads = VectorThreadPool::instance().size();
+    for (std::size_t count : { 1, 2, 3, 8 }) {
+        VectorThreadPool::instance().resize(count);
+        
+        for (std::size_t grain : { 1000, 4096, 65536 }) {
+            const auto policy = execution::par.with_grain(grain).with_threshold(0);
+            const float parallel = v.sum(policy, accumulation::reproducible);
+            
+            CHECK(std::memcmp(&parallel, &serial, sizeof(float)) == 0);
+        }
+    }
+    VectorThreadPool::instance().resize(threads);
+    
+    // and close to the exact sum
+    double exact = 0;
+    for (float x : v)
+        exact += x;
+    CHECK_NEAR(serial, exact, 1e-4);
+    
+    return vector_test::result();
+}
@@ -0,0 +1,213 @@
+// float16/bfloat16 rounding and the int8 quantization of CompactVector, against naive references (user-024)
+#include "vector.hpp"
+#include "test.hpp"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+    float from_bits(std::uint32_t bits) {
+        float x;
+        std::memcpy(&x, &bits, sizeof x);
+        return x;
+    }
+    
+    std::uint32_t to_bits(float x) {
+        std::uint32_t bits;
+        std::memcpy(&bits, &x, sizeof bits);
+        return bits;
+    }
+    
+    /*
+     Every positive finite value of the format, then the float values just
+     below, at and above the midpoint of each consecutive pair: the midpoint
+     rounds to the even one. Negative values are checked by symmetry.
+    */
+    template <typename Half>
+    void rounding(std::uint16_t infinity) {
+        std::vector<float> inputs;
+        std::vector<std::uint16_t> expected;
+        const auto add = [&](float x, std::uint16_t bits) {
+            inputs.push_back(x);
+            expected.push_back(bits);
+            inputs.push_back(-x);
+            expected.push_back(static_cast<std::uint16_t>(bits | 0x8000));
+        };
+        
+        for (std::uint16_t h = 0; h < infinity; h++) {
+            const float x = Half::from_bits(h);
+            add(x, h);
+            
+            // past the largest finite float16 comes 2^16; the midpoint below 2^128 isn't a float
+            const float next = h + 1 < infinity ? static_cast<float>(Half::from_bits(static_cast<std::uint16_t>(h + 1)))
+                                                : x + (x - Half::from_bits(static_cast<std::uint16_t>(h - 1)));
+            if (std::isinf(next))
+                continue;
+            
+            const float middle = x + (next - x) / 2;
+            const std::uint16_t even = (h & 1) ? static_cast<std::uint16_t>(h + 1) : h;
+            add(middle, even);
+            add(std::nextafter(middle, 0.f), h);
+            add(std::nextafter(middle, INFINITY), static_cast<std::uint16_t>(h + 1));
+        }
+        add(INFINITY, infinity);
+        
+        for (std::size_t i = 0; i < inputs.size(); i++)
+            CHECK(Half(inputs[i]).bits == expected[i]);
+        
+        // the vectorized conversion of CompactVector agrees with the scalar one
+        const Vector<float> all(VectorView<float>(inputs.data(), inputs.size()));
+        const CompactVector<Half> compact(all);
+        std::size_t mismatches = 0;
+        for (std::size_t i = 0; i < inputs.size(); i++)
+            mismatches += compact.data()[i].bits != expected[i];
+        CHECK(mismatches == 0);
+        
+        // NaN stays NaN
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        CHECK(std::isnan(static_cast<float>(Half(nan))));
+        CHECK(std::isnan(static_cast<float>(Half(from_bits(0x7f800001)))));
+    }
+    
+    void float16_range() {
+        CHECK(float16(65504.f).bits == 0x7bff);
+        CHECK(float16(65519.f).bits == 0x7bff);
+        CHECK(float16(65520.f).bits == 0x7c00);
+        CHECK(float16(1e10f).bits == 0x7c00);
+        CHECK(float16(0x1p-24f).bits == 0x0001);
+        CHECK(float16(0x1p-25f).bits == 0x0000);
+        CHECK(float16(0x1.000002p-25f).bits == 0x0001);
+        CHECK(float16(-0.f).bits == 0x8000);
+        
+        // bfloat16 keeps the range of float
+        CHECK(static_cast<float>(bfloat16(3e38f)) > 2.9e38f);
+        CHECK(to_bits(static_cast<float>(bfloat16(1.f))) == 0x3f800000);
+    }
+    
+    std::vector<float> random_floats(std::size_t n, float range, std::mt19937& gen) {
+        std::uniform_real_distribution<float> dist(-range, range);
+        std::vector<float> v(n);
+        for (float& x : v)
+            x = dist(gen);
+        
+        return v;
+    }
+    
+    // largest error of a stored element: half a unit in the last place, or half a quantization step
+    template <typename Storage>
+    double tolerance(double x, float scale) {
+        if constexpr (std::is_same_v<Storage, float16>)
+            return std::abs(x) * 0x1p-11 + 0x1p-25;
+        else if constexpr (std::is_same_v<Storage, bfloat16>)
+            return std::abs(x) * 0x1p-8;
+        else
+            return scale / 2 * (1 + 1e-6);
+    }
+    
+    template <typename Storage>
+    void compact_vectors() {
+        std::mt19937 gen(3);
+        
+        // around the SIMD widths and the 2^16 elements after which int8 dot products widen
+        for (std::size_t n : { 0, 1, 3, 7, 8, 9, 15, 16, 17, 31, 33, 1000, 65537 }) {
+            const std::vector<float> a = random_floats(n, 4.f, gen), b = random_floats(n, 4.f, gen);
+            const CompactVector<Storage> u(VectorView<float>(a.data(), n)), v(VectorView<float>(b.data(), n));
+            CHECK(u.size() == n);
+            
+            const Vector<float> restored = u.to_vector();
+            double dot_uv = 0, dot_ub = 0, sum = 0, squares = 0;
+            for (std::size_t i = 0; i < n; i++) {
+                CHECK(std::abs(u[i] - a[i]) <= tolerance<Storage>(a[i], u.scale()));
+                CHECK(restored[i] == u[i]);
+                
+                dot_uv += double(u[i]) * v[i];
+                dot_ub += double(u[i]) * b[i];
+                sum += u[i];
+                squares += double(u[i]) * u[i];
+            }
+            
+            if constexpr (std::is_same_v<Storage, std::int8_t>) {
+                // the largest magnitude maps to 127
+                if (n) {
+                    const auto largest = std::max_element(a.begin(), a.end(), [](float x, float y) { return std::abs(x) < std::abs(y); });
+                    CHECK(std::abs(u.data()[largest - a.begin()]) == 127);
+                }
+            } else {
+                CHECK(u.scale() == 1);
+            }
+            
+            // float accumulation of n terms of magnitude up to 16
+            const double slack = 1e-6 * 16 * static_cast<double>(n) + 1e-6;
+            CHECK(std::abs(dot_product(u, v) - dot_uv) <= slack);
+            CHECK(std::abs(dot_product(u, VectorView<float>(b.data(), n)) - dot_ub) <= slack);
+            CHECK(std::abs(dot_product(VectorView<float>(b.data(), n), u) - dot_ub) <= slack);
+            CHECK(std::abs(u.sum() - sum) <= slack);
+            CHECK(std::abs(u.magnitude() - std::sqrt(squares)) <= slack);
+        }
+        
+        CHECK_THROWS(dot_product(CompactVector<Storage>(Vector<float>(3)), CompactVector<Storage>(Vector<float>(4))),
+                     std::invalid_argument);
+        CHECK_THROWS(CompactVector<Storage>(Vector<float>(3)).at(3), std::out_of_range);
+    }
+    
+    void int8_edges() {
+        // all zeros: nothing to scale
+        const Int8Vector zeros(Vector<float>(100));
+        CHECK(zeros.scale() == 1 && zeros.sum() == 0 && zeros[99] == 0);
+        
+        // products of 127 * 127 that overflow 32 bits when summed
+        const std::size_t n = 140000;
+        Vector<float> ones(n);
+        for (auto& x : ones)
+            x = 1.f;
+        const Int8Vector u(ones);
+        CHECK(u.data()[0] == 127 && u.data()[n - 1] == 127);
+        CHECK_NEAR(dot_product(u, u), double(n), 1e-6);
+        
+        // negative extremes
+        Vector<float> signs(5);
+        signs[0] = -2.f;
+        signs[1] = 1.f;
+        signs[2] = 2.f;
+        const Int8Vector s(signs);
+        CHECK(s.data()[0] == -127 && s.data()[2] == 127 && s.data()[3] == 0);
+    }
+    
+    // Vector<float16> and Vector<bfloat16> accumulate in float and round once
+    template <typename Half>
+    void half_vectors() {
+        std::mt19937 gen(9);
+        for (std::size_t n : { 0, 1, 9, 17, 4099 }) {
+            const std::vector<float> a = random_floats(n, 1.f, gen), b = random_floats(n, 1.f, gen);
+            Vector<Half> u(n), v(n);
+            double sum = 0, dot = 0;
+            for (std::size_t i = 0; i < n; i++) {
+                u[i] = Half(a[i]);
+                v[i] = Half(b[i]);
+                sum += static_cast<float>(u[i]);
+                dot += double(static_cast<float>(u[i])) * static_cast<float>(v[i]);
+            }
+            
+            // one rounding of the result, plus the float accumulation
+            CHECK(std::abs(static_cast<float>(u.sum()) - sum) <= tolerance<Half>(sum, 1) + 1e-4);
+            CHECK(std::abs(static_cast<float>(dot_product(u, v)) - dot) <= tolerance<Half>(dot, 1) + 1e-4);
+        }
+    }
+}
+
+int main() {
+    rounding<float16>(0x7c00);
+    rounding<bfloat16>(0x7f80);
+    float16_range();
+    
+    compact_vectors<float16>();
+    compact_vectors<bfloat16>();
+    compact_vectors<std::int8_t>();
+    int8_edges();
+    
+    half_vectors<float16>();
+    half_vectors<bfloat16>();
+    
+    return vector_test::result();
+}
@@ -0,0 +1,92 @@
+// DistributedVector and allreduce() on LocalTransport against serial results (user-030)
+#include "vector.hpp"
+#include "test.hpp"
+
+#include <random>
+#include <thread>
+
+namespace {
+    // runs f(transport) on a thread per rank
+    template <typename F>
+    void on_ranks(std::size_t ranks, F f) {
+        const auto group = LocalTransport::group(ranks);
+        std::vector<std::thread> threads;
+        for (const auto& transport : group)
+            threads.emplace_back([&f, transport] { f(transport); });
+        for (auto& thread : threads)
+            thread.join();
+    }
+    
+    // the tree for small vectors, the ring for large ones
+    void allreduce_sums(std::size_t ranks, std::size_t n) {
+        std::vector<Vector<double>> parts;
+        Vector<double> expected(n);
+        for (std::size_t r = 0; r < ranks; r++) {
+            parts.emplace_back(n);
+            for (std::size_t i = 0; i < n; i++) {
+                parts[r][i] = static_cast<double>(i * (r + 1));
+                expected[i] += parts[r][i];
+            }
+        }
+        
+        on_ranks(ranks, [&](const std::shared_ptr<LocalTransport>& transport) {
+            allreduce(*transport, parts[transport->rank()]);
+        });
+        
+        for (std::size_t r = 0; r < ranks; r++)
+            CHECK(parts[r] == expected);
+    }
+    
+    void reductions(std::size_t ranks, std::size_t n) {
+        std::mt19937 gen(static_cast<unsigned>(n + ranks));
+        std::uniform_real_distribution<double> dist(-1, 1);
+        
+        Vector<double> whole(n);
+        for (auto& x : whole)
+            x = dist(gen);
+        
+        on_ranks(ranks, [&](const std::shared_ptr<LocalTransport>& transport) {
+            DistributedVector<double> v(transport, n), ones(transport, n);
+            for (std::size_t i = 0; i < v.local().size(); i++) {
+                v.local()[i] = whole[v.offset() + i];
+                ones.local()[i] = 1;
+            }
+            
+            CHECK_NEAR(v.sum(), whole.sum(), 1e-9);
+            CHECK_NEAR(v.magnitude(), whole.magnitude(), 1e-9);
+            CHECK_NEAR(dot_product(v, ones), whole.sum(), 1e-9);
+            
+            const MinMax<double> expected = whole.minmax(), extrema = v.minmax();
+            CHECK(extrema.min.index == expected.min.index && extrema.max.index == expected.max.index);
+            
+            // exact while no shard has more than distributed_quantile_samples elements
+            if (n / ranks < vector_detail::distributed_quantile_samples) {
+                CHECK(v.median() == whole.median());
+                CHECK(v.quantile(0.9) == whole.quantile(0.9));
+            }
+            
+            // everything on rank 0, which doesn't match the even split of v on the other ranks
+            Vector<double> shard(transport->rank() == 0 ? n : 0);
+            for (std::size_t i = 0; i < shard.size(); i++)
+                shard[i] = whole[i];
+            const DistributedVector<double> uneven(transport, std::move(shard));
+            CHECK(uneven.size() == n);
+            CHECK_NEAR(uneven.sum(), whole.sum(), 1e-9);
+            if (ranks > 1)
+                CHECK_THROWS(dot_product(v, uneven), std::invalid_argument);
+        });
+    }
+}
+
+int main() {
+    for (std::size_t ranks : { 1, 2, 3, 4, 7 }) {
+        allreduce_sums(ranks, 10);
+        allreduce_sums(ranks, 100000);
+        reductions(ranks, 1000);
+        reductions(ranks, 100003);
+    }
+    
+    CHECK_THROWS(LocalTransport::group(0), std::invalid_argument);
+    
+    return vector_test::result();
+}
@@ -0,0 +1,128 @@
+// expression templates and their assignment (user-001), views and concat_view (user-005)
+#include "vector.hpp"
+#include "test.hpp"
+
+namespace {
+    Vector<double> iota(std::size_t n, double first = 0) {
+        Vector<double> v(n);
+        for (std::size_t i = 0; i < n; i++)
+            v[i] = first + static_cast<double>(i);
+        
+        return v;
+    }
+    
+    void construct_from_expression() {
+        const Vector<double> a = iota(100), b = iota(100, 1);
+        const Vector<double> c = a + b * 2.0 - a;
+        
+        CHECK(c.size() == 100);
+        for (std::size_t i = 0; i < c.size(); i++)
+            CHECK(c[i] == 2 * b[i]);
+    }
+    
+    void assign_expression() {
+        const Vector<double> a = iota(100), b = iota(100, 1);
+        
+        Vector<double> same(100), smaller(3), larger(1000);
+        same = a + b;
+        smaller = a + b;
+        larger = a + b;
+        
+        for (const Vector<double>* v : { &same, &smaller, &larger }) {
+            CHECK(v->size() == 100);
+            for (std::size_t i = 0; i < 100; i++)
+                CHECK((*v)[i] == a[i] + b[i]);
+        }
+        
+        CHECK_THROWS(same = a + iota(99), std::invalid_argument);
+    }
+    
+    // every element only depends on the elements at the same position
+    void assign_aliased_expression() {
+        Vector<double> a = iota(100);
+        const Vector<double> b = iota(100, 1);
+        
+        a = a + b;
+        for (std::size_t i = 0; i < a.size(); i++)
+            CHECK(a[i] == 2 * static_cast<double>(i) + 1);
+        
+        a.assign(execution::par.with_threshold(0).with_grain(16), a - b);
+        for (std::size_t i = 0; i < a.size(); i++)
+            CHECK(a[i] == static_cast<double>(i));
+    }
+    
+    // the expression reads the storage that a size change replaces
+    void assign_aliased_resizing_expression() {
+        const Vector<double> b = iota(50, 100);
+        
+        Vector<double> a = iota(100);
+        a = concat_view(a, b);
+        CHECK(a.size() == 150);
+        for (std::size_t i = 0; i < a.size(); i++)
+            CHECK(a[i] == static_cast<double>(i));
+        
+        Vector<double> c = iota(100);
+        c.assign(execution::par.with_threshold(0).with_grain(16), concat_view(c, b));
+        CHECK(c.size() == 150);
+        for (std::size_t i = 0; i < c.size(); i++)
+            CHECK(c[i] == static_cast<double>(i));
+        
+        // inline storage on both sides
+        Vector<double> small = iota(4);
+        small = concat_view(small, small);
+        CHECK(small.size() == 8 && small[3] == 3 && small[4] == 0 && small[7] == 3);
+    }
+    
+    // the vector is read at other positions than the ones written
+    void assign_shifted_expression() {
+        const Vector<double> zero = iota(1);
+        
+        Vector<double> a = iota(5, 1);
+        a = concat_view(zero.view(), a.view(0, 4));
+        CHECK(a == iota(5));
+        
+        Vector<double> b = iota(5, 1);
+        b += concat_view(zero.view(), b.view(0, 4));
+        CHECK(b == Vector<double>(iota(5, 1) + iota(5)));
+        
+        Vector<double> c = iota(5, 1);
+        c -= concat_view(c.view(1, 5), zero.view()) * 2.0;
+        CHECK(c == Vector<double>(iota(5, 1) - concat_view(iota(4, 2), zero) * 2.0));
+        
+        // the shift is found inside larger expressions
+        Vector<double> d = iota(5);
+        d = d + concat_view(zero.view(), d.view(0, 4));
+        CHECK(d == Vector<double>(iota(5) + concat_view(zero, iota(4))));
+        
+        // every task would read elements already written by another one
+        const std::size_t n = 100000;
+        Vector<double> e = iota(n, 1);
+        e.assign(execution::par.with_threshold(0).with_grain(1024), concat_view(zero.view(), e.view(0, n - 1)));
+        CHECK(e == iota(n));
+    }
+    
+    void views() {
+        const Vector<double> a = iota(100), b = iota(50, 100);
+        
+        const VectorView<double> middle = a.view(10, 20);
+        CHECK(middle.size() == 10);
+        CHECK(middle[0] == 10 && middle[9] == 19);
+        CHECK(middle.sum() == 145);
+        
+        const Vector<double> joined = concat_view(a, b) * 2.0;
+        CHECK(joined.size() == 150);
+        for (std::size_t i = 0; i < joined.size(); i++)
+            CHECK(joined[i] == 2 * static_cast<double>(i));
+    }
+}
+
+int main() {
+    construct_from_expression();
+    assign_expression();
+    assign_aliased_expression();
+    assign_aliased_resizing_expression();
+    assign_shifted_expression();
+    views();
+    
+    return vector_test::result();
+}
@@ -0,0 +1,120 @@
+// fixed-size Vector<T, N> against the dynamic Vector for every operation, and at compile time (user-010)
+#include "vector.hpp"
+#include "test.hpp"
+
+#include <array>
+
+namespace {
+    // everything the header promises to be constexpr
+    constexpr Vector<double, 3> x(1.0, 0.0, 0.0), y(0.0, 1.0, 0.0);
+    static_assert(cross_product(x, y) == Vector<double, 3>(0.0, 0.0, 1.0));
+    static_assert(dot_product(x, y) == 0 && dot_product(x + y, x + y) == 2);
+    static_assert((x - y)[1] == -1 && (x * 2.0)[0] == 2 && (2.0 * x)[0] == 2 && (x / 2.0)[0] == 0.5);
+    static_assert(Vector<int, 4>(1, 2, 3, 4).sum() == 10 && Vector<int, 4>(1, 2, 3, 4).product() == 24);
+    static_assert(Vector<int, 4>(1, 2, 3, 4).mean() == 2);
+    static_assert(Vector<int, 2>(1, 2) < Vector<int, 2>(1, 3) && Vector<int, 2>(2, 0) > Vector<int, 2>(1, 3));
+    static_assert(Vector<int, 3>().sum() == 0 && Vector<int, 3>::size() == 3);
+    static_assert([] {
+        Vector<int, 3> v(1, 2, 3);
+        v += Vector<int, 3>(1, 1, 1);
+        v -= Vector<int, 3>(0, 1, 0);
+        v *= 2;
+        v /= 2;
+        return v == Vector<int, 3>(2, 2, 4) && v.at(2) == 4;
+    }());
+    
+    // no size stored
+    static_assert(sizeof(Vector<float, 4>) == sizeof(std::array<float, 4>));
+    
+    template <typename T, std::size_t N>
+    Vector<T, N> pattern(int salt) {
+        Vector<T, N> v;
+        for (std::size_t i = 0; i < N; i++)
+            v[i] = static_cast<T>(static_cast<int>((i * 7 + static_cast<std::size_t>(salt)) % 13) - 6);
+        
+        return v;
+    }
+    
+    template <typename T, std::size_t N>
+    bool same(const Vector<T, N>& fixed, const Vector<T>& dynamic) {
+        return dynamic.size() == N && std::equal(fixed.begin(), fixed.end(), dynamic.begin());
+    }
+    
+    template <typename T, std::size_t N>
+    void against_dynamic() {
+        using Fixed = Vector<T, N>;
+        const Fixed u = pattern<T, N>(1), v = pattern<T, N>(2);
+        const Vector<T> du(u), dv(v);
+        CHECK(same(u, du));
+        
+        CHECK(same(u + v, Vector<T>(du + dv)));
+        CHECK(same(u - v, Vector<T>(du - dv)));
+        CHECK(same(u * T(3), Vector<T>(du * T(3))));
+        CHECK(same(T(3) * u, Vector<T>(T(3) * du)));
+        CHECK(same(u / T(2), Vector<T>(du / T(2))));
+        
+        Vector<T, N> w = u;
+        Vector<T> dw = du;
+        w += v;
+        dw += dv;
+        w -= u * T(2);
+        dw -= du * T(2);
+        w *= T(5);
+        dw *= T(5);
+        CHECK(same(w, dw));
+        
+        CHECK(dot_product(u, v) == dot_product(du, dv));
+        CHECK(u.sum() == du.sum());
+        CHECK(u.product() == du.product());
+        CHECK_NEAR(u.magnitude(), du.magnitude(), 1e-6);
+        CHECK((u == v) == (du == dv) && u == u && !(u != u));
+        CHECK((u < v) == (du < dv) && (v < u) == (dv < du) && (u <= v) == (du <= dv) && (u >= v) == (du >= dv));
+        
+        if constexpr (N >= 3) {
+            const Vector<T> dynamic = cross_product(du, dv);
+            CHECK(same(cross_product(u, v), dynamic));
+        }
+        
+        if constexpr (std::is_floating_point_v<T>) {
+            CHECK_NEAR(u.mean(), du.mean(), 1e-6);
+            
+            Vector<T, N> n = u;
+            Vector<T> dn = du;
+            n.normalize();
+            dn.normalize();
+            for (std::size_t i = 0; i < N; i++)
+                CHECK_NEAR(n[i], dn[i], 1e-6);
+            
+            // a zero vector is left as it is
+            Fixed zero;
+            zero.normalize();
+            CHECK(zero == Fixed());
+        }
+        
+        // views in both directions
+        const Vector<T, N> back(du.view());
+        CHECK(back == u);
+        CHECK(u.view().size() == N && u.view().data() == u.data());
+        CHECK_THROWS(Fixed(Vector<T>(N + 1).view()), std::length_error);
+        CHECK_THROWS(u.at(N), std::out_of_range);
+    }
+    
+    template <typename T>
+    void sizes() {
+        against_dynamic<T, 1>();
+        against_dynamic<T, 2>();
+        against_dynamic<T, 3>();
+        against_dynamic<T, 4>();
+        against_dynamic<T, 5>();
+        against_dynamic<T, 8>();
+        against_dynamic<T, 17>();
+    }
+}
+
+int main() {
+    sizes<float>();
+    sizes<double>();
+    sizes<int>();
+    
+    return vector_test::result();
+}
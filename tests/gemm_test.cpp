@@ -0,0 +1,112 @@
+// dot_products() against one naive dot product per pair, with tiles cut by the edges (user-012)
+#include "vector.hpp"
+#include "test.hpp"
+
+#include <vector>
+
+namespace {
+    // small integers, so that float sums of any order are exact
+    template <typename T>
+    T element(std::size_t i, std::size_t k, std::size_t salt) {
+        return static_cast<T>(static_cast<int>((i * 7 + k * 3 + salt) % 11) - 5);
+    }
+    
+    template <typename T>
+    VectorBatch<T> batch(std::size_t count, std::size_t dim, BatchLayout layout, std::size_t salt) {
+        VectorBatch<T> b(count, dim, layout);
+        for (std::size_t i = 0; i < count; i++)
+            for (std::size_t k = 0; k < dim; k++)
+                b(i, k) = element<T>(i, k, salt);
+        
+        return b;
+    }
+    
+    template <typename T>
+    std::vector<T> naive(std::size_t m, std::size_t n, std::size_t dim) {
+        std::vector<T> out(m * n);
+        for (std::size_t i = 0; i < m; i++)
+            for (std::size_t j = 0; j < n; j++) {
+                T sum = 0;
+                for (std::size_t k = 0; k < dim; k++)
+                    sum += element<T>(i, k, 1) * element<T>(j, k, 2);
+                out[i * n + j] = sum;
+            }
+        
+        return out;
+    }
+    
+    template <typename T>
+    void batches(std::size_t m, std::size_t n, std::size_t dim) {
+        const std::vector<T> expected = naive<T>(m, n, dim);
+        
+        for (BatchLayout qlayout : { BatchLayout::row_major, BatchLayout::soa })
+            for (BatchLayout clayout : { BatchLayout::row_major, BatchLayout::soa }) {
+                const VectorBatch<T> queries = batch<T>(m, dim, qlayout, 1);
+                const VectorBatch<T> candidates = batch<T>(n, dim, clayout, 2);
+                
+                std::vector<T> out(m * n, T(-1));
+                dot_products(queries, candidates, out.data());
+                CHECK(out == expected);
+                
+                std::fill(out.begin(), out.end(), T(-1));
+                dot_products(execution::par.with_threshold(0), queries, candidates, out.data());
+                CHECK(out == expected);
+            }
+    }
+    
+    template <typename T>
+    void separate_vectors(std::size_t m, std::size_t n, std::size_t dim) {
+        std::vector<Vector<T>> queries(m, Vector<T>(dim)), candidates(n, Vector<T>(dim));
+        for (std::size_t k = 0; k < dim; k++) {
+            for (std::size_t i = 0; i < m; i++)
+                queries[i][k] = element<T>(i, k, 1);
+            for (std::size_t j = 0; j < n; j++)
+                candidates[j][k] = element<T>(j, k, 2);
+        }
+        
+        std::vector<T> out(m * n, T(-1));
+        dot_products(queries, candidates, out.data());
+        CHECK(out == naive<T>(m, n, dim));
+    }
+    
+    template <typename T>
+    void sizes() {
+        // below, at and past the register tile (4 x 2 registers) and the blocks (64 x 512 x 256)
+        const std::size_t shapes[][3] = {
+            { 1, 1, 1 }, { 3, 5, 7 }, { 4, 16, 8 }, { 5, 17, 3 }, { 1, 33, 256 },
+            { 65, 9, 257 }, { 7, 515, 5 }, { 130, 40, 600 }, { 3, 4, 0 },
+        };
+        
+        for (const auto& shape : shapes) {
+            batches<T>(shape[0], shape[1], shape[2]);
+            separate_vectors<T>(shape[0], shape[1], shape[2]);
+        }
+    }
+    
+    void empty_and_mismatched() {
+        // nothing to write
+        std::vector<float> out(4, -1.f);
+        dot_products(batch<float>(0, 8, BatchLayout::row_major, 1), batch<float>(4, 8, BatchLayout::row_major, 2), out.data());
+        dot_products(batch<float>(4, 8, BatchLayout::row_major, 1), batch<float>(0, 8, BatchLayout::row_major, 2), out.data());
+        CHECK(out == std::vector<float>(4, -1.f));
+        
+        CHECK_THROWS(dot_products(batch<float>(2, 8, BatchLayout::row_major, 1), batch<float>(2, 9, BatchLayout::row_major, 2),
+                                  out.data()), std::invalid_argument);
+        
+        std::vector<Vector<float>> ragged = { Vector<float>(3), Vector<float>(4) };
+        CHECK_THROWS(dot_products(ragged, ragged, out.data()), std::invalid_argument);
+    }
+}
+
+int main() {
+    const std::size_t threads = VectorThreadPool::instance().size();
+    VectorThreadPool::instance().resize(4);
+    
+    sizes<float>();
+    sizes<double>();
+    sizes<int>();
+    empty_and_mismatched();
+    
+    VectorThreadPool::instance().resize(threads);
+    return vector_test::result();
+}
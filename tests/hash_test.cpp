@@ -0,0 +1,129 @@
+// Vector::hash() is cached until the next write, and operator== uses it (user-017)
+#include "vector.hpp"
+#include "test.hpp"
+
+#include <thread>
+#include <unordered_set>
+
+namespace {
+    Vector<float> ramp(std::size_t n) {
+        Vector<float> v(n);
+        for (std::size_t i = 0; i < n; i++)
+            v[i] = static_cast<float>(i);
+        
+        return v;
+    }
+    
+    void writes_drop_the_cache() {
+        Vector<float> a = ramp(1000);
+        const Vector<float> b = ramp(1000);
+        const std::uint64_t h = a.hash();
+        CHECK(h == b.hash());
+        
+        a[10] = -1.f;
+        CHECK(a.hash() != h);
+        CHECK(a != b);
+        
+        a[10] = 10.f;
+        CHECK(a.hash() == h);
+        CHECK(a == b);
+        
+        a.data()[0] = 5.f;
+        CHECK(a.hash() != h);
+        
+        *a.begin() = 0.f;
+        CHECK(a.hash() == h);
+        
+        a *= 2.f;
+        CHECK(a.hash() != h);
+        
+        a = b;
+        CHECK(a.hash() == h);
+        
+        a.push_back(1.f);
+        CHECK(a.hash() != h);
+    }
+    
+    void copies_and_swaps() {
+        Vector<float> a = ramp(1000), b = ramp(2000);
+        const std::uint64_t ha = a.hash(), hb = b.hash();
+        
+        Vector<float> copy(a);
+        CHECK(copy.hash() == ha);
+        
+        a.swap(b);
+        CHECK(a.hash() == hb && b.hash() == ha);
+        
+        Vector<float> moved(std::move(a));
+        CHECK(moved.hash() == hb);
+        CHECK(a.hash() == Vector<float>().hash());
+        
+        // inline storage is swapped by moves
+        Vector<float> small = ramp(3), other = ramp(5);
+        const std::uint64_t hs = small.hash(), ho = other.hash();
+        small.swap(other);
+        CHECK(small.hash() == ho && other.hash() == hs);
+    }
+    
+    // concurrent hash() calls on a const vector agree
+    void concurrent_hash() {
+        const Vector<float> v = ramp(100000);
+        const std::uint64_t expected = Vector<float>(v.view()).hash();
+        
+        std::vector<std::thread> threads;
+        std::vector<std::uint64_t> results(4);
+        for (std::size_t t = 0; t < results.size(); t++)
+            threads.emplace_back([&, t] { results[t] = v.hash(); });
+        for (auto& thread : threads)
+            thread.join();
+        
+        for (std::uint64_t h : results)
+            CHECK(h == expected);
+    }
+    
+    /*
+     Tasks of a parallel assign and threads writing disjoint elements through
+     operator[] share the vector: build with VECTOR_TEST_SANITIZER=thread to
+     check that they don't race on the cached hash.
+    */
+    void concurrent_writes() {
+        VectorThreadPool::instance().resize(4);
+        
+        const Vector<float> a = ramp(100000), b = ramp(100000);
+        Vector<float> v(100000);
+        v.hash();
+        v.assign(execution::par.with_grain(4096), a + b);
+        CHECK(v == Vector<float>(a + b));
+        
+        std::vector<std::thread> threads;
+        const std::size_t count = 4, chunk = v.size() / count;
+        for (std::size_t t = 0; t < count; t++)
+            threads.emplace_back([&, t] {
+                for (std::size_t i = t * chunk; i < (t + 1) * chunk; i++)
+                    v[i] = a[i];
+            });
+        for (auto& thread : threads)
+            thread.join();
+        
+        CHECK(v.hash() == a.hash());
+        CHECK(v == a);
+    }
+    
+    void hash_sets() {
+        std::unordered_set<Vector<float>> set;
+        set.insert(ramp(10));
+        set.insert(ramp(10));
+        set.insert(ramp(11));
+        CHECK(set.size() == 2);
+    }
+}
+
+int main() {
+    writes_drop_the_cache();
+    copies_and_swaps();
+    concurrent_hash();
+    concurrent_writes();
+    hash_sets();
+    
+    return vector_test::result();
+}
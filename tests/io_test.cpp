@@ -0,0 +1,77 @@
+// save(), load() and map() round-trips and damaged files (user-013)
+#include "vector.hpp"
+#include "test.hpp"
+
+#include <cstdio>
+#include <sstream>
+
+namespace {
+    const std::string path = "io_test.bin";
+    
+    template <typename T>
+    Vector<T> ramp(std::size_t n) {
+        Vector<T> v(n);
+        for (std::size_t i = 0; i < n; i++)
+            v[i] = static_cast<T>(i * 3 + 1);
+        
+        return v;
+    }
+    
+    template <typename T>
+    void round_trip(std::size_t n) {
+        const Vector<T> original = ramp<T>(n);
+        
+        original.save(path);
+        CHECK(Vector<T>::load(path) == original);
+        
+        std::stringstream stream;
+        original.save(stream);
+        CHECK(Vector<T>::load(stream) == original);
+        
+#if defined(VECTOR_HAS_MMAP)
+        const MappedVector<T> mapped = Vector<T>::map(path);
+        CHECK(mapped.size() == n);
+        CHECK(Vector<T>(mapped) == original);
+#endif
+    }
+    
+    void damaged_files() {
+        ramp<float>(1000).save(path);
+        
+        // another element type
+        CHECK_THROWS(Vector<double>::load(path), std::runtime_error);
+        
+        std::string bytes;
+        {
+            std::ifstream is(path, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+        }
+        {
+            std::ofstream os(path, std::ios::binary | std::ios::trunc);
+            os.write(bytes.data(), static_cast<std::streamsize>(bytes.size() - 4));
+        }
+        CHECK_THROWS(Vector<float>::load(path), std::runtime_error);
+#if defined(VECTOR_HAS_MMAP)
+        CHECK_THROWS(Vector<float>::map(path), std::runtime_error);
+#endif
+        
+        {
+            std::ofstream os(path, std::ios::binary | std::ios::trunc);
+            os.write(bytes.data(), 10);
+        }
+        CHECK_THROWS(Vector<float>::load(path), std::runtime_error);
+        
+        CHECK_THROWS(Vector<float>::load("io_test_missing.bin"), std::runtime_error);
+    }
+}
+
+int main() {
+    round_trip<float>(0);
+    round_trip<float>(5);
+    round_trip<double>(100000);
+    round_trip<int>(4097);
+    damaged_files();
+    
+    std::remove(path.c_str());
+    return vector_test::result();
+}
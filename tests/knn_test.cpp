@@ -0,0 +1,190 @@
+// knn() and batch cosine() against naive scores, with and without cached norms (user-028)
+#include "vector.hpp"
+#include "test.hpp"
+
+#include <random>
+#include <vector>
+
+namespace {
+    template <typename T>
+    Vector<T> filled(std::size_t n, T value) {
+        Vector<T> v(n);
+        for (auto& x : v)
+            x = value;
+        
+        return v;
+    }
+    
+    template <typename T>
+    VectorBatch<T> random_batch(std::size_t count, std::size_t dim, BatchLayout layout, std::mt19937& gen) {
+        std::uniform_int_distribution<int> dist(-20, 20);
+        VectorBatch<T> batch(count, dim, layout);
+        for (std::size_t i = 0; i < count; i++)
+            for (std::size_t j = 0; j < dim; j++)
+                batch(i, j) = static_cast<T>(dist(gen)) / T(4);
+        
+        return batch;
+    }
+    
+    template <typename T>
+    double naive_score(const VectorBatch<T>& batch, std::size_t i, const Vector<T>& q, Metric metric) {
+        double l2 = 0, l1 = 0, dot = 0, nb = 0, nq = 0;
+        for (std::size_t j = 0; j < batch.dim(); j++) {
+            const double a = batch(i, j), b = q[j];
+            l2 += (a - b) * (a - b);
+            l1 += std::abs(a - b);
+            dot += a * b;
+            nb += a * a;
+            nq += b * b;
+        }
+        
+        switch (metric) {
+            case Metric::l2: return std::sqrt(l2);
+            case Metric::l1: return l1;
+            case Metric::inner_product: return dot;
+            case Metric::cosine: return nb == 0 || nq == 0 ? 0 : dot / std::sqrt(nb * nq);
+        }
+        return 0;
+    }
+    
+    /*
+     The neighbours must have the k best scores of the naive ranking. Near
+     ties may be ordered differently by rounding, so the returned values are
+     compared by rank and every index is checked against its own score.
+    */
+    template <typename T, typename Policy>
+    void check_knn(const Policy& policy, const VectorBatch<T>& batch, const Vector<T>& q, std::size_t k, Metric metric) {
+        const bool largest_first = metric == Metric::cosine || metric == Metric::inner_product;
+        std::vector<double> scores(batch.size());
+        for (std::size_t i = 0; i < batch.size(); i++)
+            scores[i] = naive_score(batch, i, q, metric);
+        
+        std::vector<double> ranked = scores;
+        if (largest_first)
+            std::sort(ranked.rbegin(), ranked.rend());
+        else
+            std::sort(ranked.begin(), ranked.end());
+        
+        const auto neighbours = knn(policy, batch, q.view(), k, metric);
+        CHECK(neighbours.size() == std::min(k, batch.size()));
+        
+        std::vector<bool> seen(batch.size());
+        for (std::size_t r = 0; r < neighbours.size(); r++) {
+            const auto& [value, index] = neighbours[r];
+            CHECK(index < batch.size() && !seen[index]);
+            if (index >= batch.size())
+                continue;
+            seen[index] = true;
+            
+            CHECK_NEAR(value, ranked[r], 1e-4);
+            CHECK_NEAR(value, scores[index], 1e-4);
+        }
+    }
+    
+    template <typename T>
+    void neighbours() {
+        std::mt19937 gen(11);
+        const Metric metrics[] = { Metric::l2, Metric::l1, Metric::cosine, Metric::inner_product };
+        
+        // empty, partial and full blocks of 256 vectors, k from 0 to past the size
+        for (std::size_t count : { 0, 1, 7, 255, 256, 257, 1000 })
+            for (std::size_t dim : { 1, 3, 17, 128 })
+                for (BatchLayout layout : { BatchLayout::row_major, BatchLayout::soa }) {
+                    VectorBatch<T> batch = random_batch<T>(count, dim, layout, gen);
+                    const Vector<T> q(random_batch<T>(1, dim, BatchLayout::row_major, gen).row(0));
+                    
+                    for (Metric metric : metrics)
+                        for (std::size_t k : { std::size_t(0), std::size_t(1), std::size_t(5), count, count + 10 }) {
+                            check_knn(execution::seq, batch, q, k, metric);
+                            check_knn(execution::par.with_threshold(0), batch, q, k, metric);
+                        }
+                    
+                    batch.cache_norms();
+                    check_knn(execution::seq, batch, q, 10, Metric::cosine);
+                    check_knn(execution::par.with_threshold(0), batch, q, 10, Metric::cosine);
+                }
+    }
+    
+    template <typename T>
+    void cosines() {
+        std::mt19937 gen(5);
+        VectorBatch<T> batch = random_batch<T>(600, 33, BatchLayout::row_major, gen);
+        const Vector<T> q(random_batch<T>(1, 33, BatchLayout::row_major, gen).row(0));
+        for (std::size_t j = 0; j < 33; j++)
+            batch(3, j) = 0;
+        
+        const auto check = [&] {
+            std::vector<T> out(batch.size());
+            cosine(batch, q.view(), out.data());
+            for (std::size_t i = 0; i < batch.size(); i++)
+                CHECK_NEAR(out[i], naive_score(batch, i, q, Metric::cosine), 1e-5);
+            
+            std::fill(out.begin(), out.end(), T(-2));
+            cosine(execution::par.with_threshold(0), batch, q.view(), out.data());
+            for (std::size_t i = 0; i < batch.size(); i++)
+                CHECK_NEAR(out[i], naive_score(batch, i, q, Metric::cosine), 1e-5);
+            CHECK(out[3] == 0);
+        };
+        
+        check();
+        batch.cache_norms();
+        CHECK(batch.cached_norms() != nullptr);
+        check();
+        
+        // a write drops the cached norms, which would be stale
+        batch(10, 0) += 100;
+        CHECK(batch.cached_norms() == nullptr);
+        check();
+        
+        // a zero query has similarity 0 with everything
+        std::vector<T> out(batch.size(), T(-2));
+        cosine(batch, Vector<T>(33).view(), out.data());
+        CHECK(std::all_of(out.begin(), out.end(), [](T x) { return x == 0; }));
+    }
+    
+    void ties_and_errors() {
+        // equal scores rank by index
+        VectorBatch<float> same(300, 4);
+        for (std::size_t i = 0; i < same.size(); i++)
+            same.assign(i, filled(4, 1.f).view());
+        const Vector<float> q = filled(4, 2.f);
+        
+        for (Metric metric : { Metric::l2, Metric::cosine }) {
+            const auto neighbours = knn(execution::par.with_threshold(0), same, q.view(), 20, metric);
+            CHECK(neighbours.size() == 20);
+            for (std::size_t r = 0; r < neighbours.size(); r++)
+                CHECK(neighbours[r].index == r);
+        }
+        
+        // integer batches, cosine needs floating point
+        VectorBatch<int> ints(50, 8);
+        for (std::size_t i = 0; i < ints.size(); i++)
+            for (std::size_t j = 0; j < ints.dim(); j++)
+                ints(i, j) = static_cast<int>((i * 5 + j) % 9) - 4;
+        const Vector<int> qi = filled(8, 1);
+        
+        const auto nearest = knn(ints, qi.view(), 3, Metric::l1);
+        CHECK(nearest.size() == 3);
+        for (std::size_t r = 1; r < nearest.size(); r++)
+            CHECK(nearest[r - 1].value <= nearest[r].value);
+        CHECK_THROWS(knn(ints, qi.view(), 3, Metric::cosine), std::invalid_argument);
+        
+        CHECK_THROWS(knn(same, Vector<float>(5).view(), 3), std::invalid_argument);
+        std::vector<float> out(same.size());
+        CHECK_THROWS(cosine(same, Vector<float>(5).view(), out.data()), std::invalid_argument);
+    }
+}
+
+int main() {
+    const std::size_t threads = VectorThreadPool::instance().size();
+    VectorThreadPool::instance().resize(4);
+    
+    neighbours<float>();
+    neighbours<double>();
+    cosines<float>();
+    cosines<double>();
+    ties_and_errors();
+    
+    VectorThreadPool::instance().resize(threads);
+    return vector_test::result();
+}
@@ -0,0 +1,111 @@
+// exp() and log() stay within 1 and 3 ulp of std::exp and std::log, special values included (user-026)
+#include "vector.hpp"
+#include "test.hpp"
+
+#include <random>
+#include <vector>
+
+namespace {
+    // distance in representable values, 0 for two NaNs
+    template <typename T>
+    std::uint64_t ulps(T a, T b) {
+        if (std::isnan(a) || std::isnan(b))
+            return std::isnan(a) && std::isnan(b) ? 0 : ~std::uint64_t(0);
+        if (a == b)
+            return 0;
+        
+        // map the bit patterns to a monotonic integer scale
+        using Bits = std::conditional_t<sizeof(T) == 4, std::int32_t, std::int64_t>;
+        const auto ordered = [](T x) {
+            Bits bits;
+            std::memcpy(&bits, &x, sizeof bits);
+            return bits < 0 ? static_cast<std::int64_t>(std::numeric_limits<Bits>::min() - bits) : static_cast<std::int64_t>(bits);
+        };
+        
+        const std::int64_t d = ordered(a) - ordered(b);
+        return static_cast<std::uint64_t>(d < 0 ? -d : d);
+    }
+    
+    // largest distance of exp(x) and log(x) from the standard library over the inputs
+    template <typename T>
+    std::pair<std::uint64_t, std::uint64_t> worst(const Vector<T>& x) {
+        const Vector<T> e = exp(x), l = log(x);
+        
+        std::uint64_t worst_exp = 0, worst_log = 0;
+        for (std::size_t i = 0; i < x.size(); i++) {
+            worst_exp = std::max(worst_exp, ulps(e[i], std::exp(x[i])));
+            worst_log = std::max(worst_log, ulps(l[i], std::log(x[i])));
+        }
+        
+        return { worst_exp, worst_log };
+    }
+    
+    // every 61st float, both signs, all exponents including subnormals, infinities and NaNs
+    void floats() {
+        const std::size_t chunk = 1 << 20;
+        Vector<float> x(chunk);
+        
+        std::uint64_t worst_exp = 0, worst_log = 0;
+        std::size_t n = 0;
+        for (std::uint64_t bits = 0; bits <= 0xffffffff; bits += 61) {
+            x.data()[n++] = vector_detail::bits_as<float>(static_cast<std::uint32_t>(bits));
+            if (n == chunk || bits + 61 > 0xffffffff) {
+                x.resize(n, 0.f);
+                const auto [e, l] = worst(x);
+                worst_exp = std::max(worst_exp, e);
+                worst_log = std::max(worst_log, l);
+                n = 0;
+            }
+        }
+        
+        CHECK(worst_exp <= 1);
+        CHECK(worst_log <= 3);
+    }
+    
+    void doubles() {
+        std::mt19937_64 gen(17);
+        std::uniform_real_distribution<double> range(-750, 712);
+        std::uniform_int_distribution<std::uint64_t> positive(0, 0x7ff0000000000000);
+        
+        Vector<double> x(1 << 20), y(1 << 20);
+        for (std::size_t i = 0; i < x.size(); i++) {
+            x[i] = range(gen);
+            y[i] = vector_detail::bits_as<double>(positive(gen));
+        }
+        
+        CHECK(worst(x).first <= 1);
+        CHECK(worst(y).second <= 3);
+    }
+    
+    template <typename T>
+    void special_values() {
+        constexpr T inf = std::numeric_limits<T>::infinity(), nan = std::numeric_limits<T>::quiet_NaN();
+        const T values[] = { 0, -T(0), 1, -1, inf, -inf, nan, std::numeric_limits<T>::min(), std::numeric_limits<T>::denorm_min(),
+                             std::numeric_limits<T>::max(), T(1e-3), T(700), T(-700), T(88.7), T(-103.9) };
+        
+        // lengths that leave a remainder after any SIMD width
+        Vector<T> x(std::size(values) * 3);
+        for (std::size_t i = 0; i < x.size(); i++)
+            x[i] = values[i % std::size(values)];
+        
+        const Vector<T> e = exp(x), l = log(x);
+        for (std::size_t i = 0; i < x.size(); i++) {
+            CHECK(ulps(e[i], std::exp(x[i])) <= 1);
+            CHECK(ulps(l[i], std::log(x[i])) <= 3);
+        }
+        
+        CHECK(Vector<T>(exp(Vector<T>())).size() == 0);
+        CHECK(log(x)[0] == -inf && exp(x)[0] == 1 && log(x)[2] == 0);
+        CHECK(exp(x)[5] == 0 && exp(x)[4] == inf && log(x)[4] == inf);
+        CHECK(std::isnan(log(x)[3]) && std::isnan(exp(x)[6]) && std::isnan(log(x)[6]));
+    }
+}
+
+int main() {
+    floats();
+    doubles();
+    special_values<float>();
+    special_values<double>();
+    
+    return vector_test::result();
+}
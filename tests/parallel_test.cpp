@@ -0,0 +1,117 @@
+// parallel element-wise operations give the serial results for any thread count, grain and threshold (user-006)
+#include "vector.hpp"
+#include "test.hpp"
+
+#include <vector>
+
+namespace {
+    // small integers, so that the results are exact whatever the evaluation order or contraction
+    template <typename T>
+    Vector<T> pattern(std::size_t n, std::size_t salt) {
+        Vector<T> v(n);
+        for (std::size_t i = 0; i < n; i++)
+            v[i] = static_cast<T>(static_cast<int>((i * 13 + salt) % 101) - 50);
+        
+        return v;
+    }
+    
+    template <typename T, typename Policy>
+    void element_wise(const Policy& policy, std::size_t n) {
+        const Vector<T> a = pattern<T>(n, 1), b = pattern<T>(n, 2), c = pattern<T>(n, 3);
+        
+        std::vector<T> expected(n);
+        for (std::size_t i = 0; i < n; i++)
+            expected[i] = a[i] * T(2) + b[i] - c[i];
+        
+        const auto equal = [&](const Vector<T>& v, const std::vector<T>& reference) {
+            return v.size() == reference.size() && std::equal(v.begin(), v.end(), reference.begin());
+        };
+        
+        // same size, grown from empty, and shrunk
+        Vector<T> same = pattern<T>(n, 4), grown, shrunk = pattern<T>(n + 100, 5);
+        same.assign(policy, a * T(2) + b - c);
+        grown.assign(policy, a * T(2) + b - c);
+        shrunk.assign(policy, a * T(2) + b - c);
+        CHECK(equal(same, expected));
+        CHECK(equal(grown, expected));
+        CHECK(equal(shrunk, expected));
+        
+        // in place, v += w
+        Vector<T> v = a;
+        v.assign(policy, v + b);
+        for (std::size_t i = 0; i < n; i++)
+            expected[i] = a[i] + b[i];
+        CHECK(equal(v, expected));
+        
+        v.scale(policy, T(3));
+        for (std::size_t i = 0; i < n; i++)
+            expected[i] *= T(3);
+        CHECK(equal(v, expected));
+        
+        // reductions over the same chunks
+        T sum = 0;
+        for (std::size_t i = 0; i < n; i++)
+            sum += a[i];
+        CHECK(a.sum(policy) == sum);
+        if (n) {
+            const auto extrema = a.minmax(policy);
+            CHECK(extrema.min.value == *std::min_element(a.begin(), a.end()));
+            CHECK(extrema.max.value == *std::max_element(a.begin(), a.end()));
+            CHECK(extrema.max.index == static_cast<std::size_t>(std::max_element(a.begin(), a.end()) - a.begin()));
+        }
+    }
+    
+    template <typename Policy>
+    void normalized(const Policy& policy, std::size_t n) {
+        Vector<double> v = pattern<double>(n, 6);
+        double squares = 0;
+        for (double x : v)
+            squares += x * x;
+        const double norm = std::sqrt(squares);
+        
+        const Vector<double> original = v;
+        v.normalize(policy);
+        for (std::size_t i = 0; i < n; i++)
+            CHECK_NEAR(v[i], original[i] / norm, 1e-12);
+    }
+    
+    template <typename Policy>
+    void all(const Policy& policy) {
+        // around the default threshold (32768), the minimum grain (4096) and a prime
+        for (std::size_t n : { 0, 1, 4095, 4096, 4097, 32767, 32768, 32769, 100003 }) {
+            element_wise<double>(policy, n);
+            element_wise<float>(policy, n);
+            element_wise<int>(policy, n);
+            if (n)
+                normalized(policy, n);
+        }
+    }
+}
+
+int main() {
+    const std::size_t threads = VectorThreadPool::instance().size();
+    
+    for (std::size_t count : { 1, 2, 3, 8 }) {
+        VectorThreadPool::instance().resize(count);
+        
+        all(execution::seq);
+        all(execution::par);
+        all(execution::par.with_threshold(0));
+        all(execution::par.with_threshold(0).with_grain(1));
+        all(execution::par.with_threshold(0).with_grain(1000));
+        all(execution::par.with_threshold(0).with_grain(1 << 20));
+    }
+    
+    // from inside a task the work runs serially on the calling thread
+    VectorThreadPool::instance().resize(4);
+    std::vector<Vector<double>> outputs(8);
+    VectorThreadPool::instance().run(outputs.size(), [&](std::size_t task) {
+        const Vector<double> a = pattern<double>(50000, task);
+        outputs[task].assign(execution::par.with_threshold(0), a + a);
+    });
+    for (std::size_t task = 0; task < outputs.size(); task++)
+        CHECK(outputs[task] == Vector<double>(pattern<double>(50000, task) * 2.0));
+    
+    VectorThreadPool::instance().resize(threads);
+    return vector_test::result();
+}
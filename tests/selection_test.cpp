@@ -0,0 +1,43 @@
+// top_k() and argtop_k(), ties go to the lower index (user-025)
+#include "vector.hpp"
+#include "test.hpp"
+
+namespace {
+    void ties(std::size_t n, std::size_t k) {
+        // values 0..9 repeated, so every value has many ties
+        Vector<int> v(n);
+        for (std::size_t i = 0; i < n; i++)
+            v[i] = static_cast<int>(i % 10);
+        
+        const std::vector<IndexedValue<int>> best = v.top_k(k);
+        CHECK(best.size() == std::min(k, n));
+        
+        // the 9s by index, then the 8s, and so on
+        for (std::size_t j = 0; j < best.size(); j++) {
+            const std::size_t per_value = n / 10;
+            const int expected_value = 9 - static_cast<int>(j / per_value);
+            CHECK(best[j].value == expected_value);
+            if (j > 0 && best[j].value == best[j - 1].value)
+                CHECK(best[j - 1].index < best[j].index);
+        }
+        
+        const auto parallel = v.top_k(execution::par.with_threshold(0).with_grain(1000), k);
+        CHECK(parallel.size() == best.size());
+        for (std::size_t j = 0; j < best.size() && j < parallel.size(); j++)
+            CHECK(parallel[j].index == best[j].index);
+        
+        const std::vector<std::size_t> indexes = v.argtop_k(k);
+        CHECK(indexes.size() == best.size());
+        for (std::size_t j = 0; j < best.size() && j < indexes.size(); j++)
+            CHECK(indexes[j] == best[j].index);
+    }
+}
+
+int main() {
+    ties(100, 5);
+    ties(100000, 30);      // heap
+    ties(100000, 50000);   // selection
+    ties(10, 20);
+    
+    return vector_test::result();
+}
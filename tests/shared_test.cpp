@@ -0,0 +1,145 @@
+// copies, moves and swaps of Vector, and the copy-on-write of SharedVector (user-020)
+#include "vector.hpp"
+#include "test.hpp"
+
+#include <thread>
+#include <vector>
+
+namespace {
+    Vector<float> ramp(std::size_t n, float first = 0) {
+        Vector<float> v(n);
+        for (std::size_t i = 0; i < n; i++)
+            v[i] = first + static_cast<float>(i);
+        
+        return v;
+    }
+    
+    bool is_ramp(VectorView<float> v, std::size_t n, float first = 0) {
+        if (v.size() != n)
+            return false;
+        for (std::size_t i = 0; i < n; i++)
+            if (v[i] != first + static_cast<float>(i))
+                return false;
+        
+        return true;
+    }
+    
+    // inline (small) and heap storage on either side
+    void vector_copies() {
+        for (std::size_t n : { 0, 1, 3, 1000 })
+            for (std::size_t m : { 0, 2, 5000 }) {
+                const Vector<float> a = ramp(n), b = ramp(m, 7);
+                
+                Vector<float> copy(a);
+                CHECK(copy == a && (n == 0 || copy.data() != a.data()));
+                
+                copy = b;
+                CHECK(copy == b);
+                
+                Vector<float> moved(std::move(copy));
+                CHECK(moved == b && copy.size() == 0);
+                
+                moved = a;
+                Vector<float> target = ramp(m);
+                target = std::move(moved);
+                CHECK(target == a && moved.size() == 0);
+                
+                Vector<float> x = ramp(n), y = ramp(m, 7);
+                x.swap(y);
+                CHECK(is_ramp(x.view(), m, 7) && is_ramp(y.view(), n));
+                std::swap(x, y);
+                CHECK(is_ramp(x.view(), n) && is_ramp(y.view(), m, 7));
+            }
+        
+        // self-assignment keeps the elements
+        Vector<float> self = ramp(100);
+        const Vector<float>& alias = self;
+        self = alias;
+        CHECK(is_ramp(self.view(), 100));
+        self = std::move(self);
+        CHECK(is_ramp(self.view(), 100));
+    }
+    
+    void copy_on_write() {
+        const Vector<float> source = ramp(10000);
+        SharedVector<float> shared{ Vector<float>(source) };
+        CHECK(shared.use_count() == 1 && is_ramp(shared, 10000));
+        
+        // copies share the elements
+        SharedVector<float> copy = shared;
+        CHECK(shared.use_count() == 2 && copy.data() == shared.data());
+        CHECK(copy.hash() == shared.hash() && shared.hash() == source.hash());
+        
+        // the first write through a shared copy copies the elements, the others don't
+        float* written = copy.mutable_data();
+        CHECK(written != shared.data() && copy.data() == written);
+        CHECK(shared.use_count() == 1 && copy.use_count() == 1);
+        written[0] = -1.f;
+        CHECK(shared[0] == 0.f && copy[0] == -1.f);
+        CHECK(copy.mutable_data() == written);
+        CHECK(copy.hash() != shared.hash());
+        
+        // modify() may resize, the view follows
+        SharedVector<float> grown = shared;
+        grown.modify([](Vector<float>& v) { v.push_back(10000.f); });
+        CHECK(is_ramp(grown, 10001) && is_ramp(shared, 10000) && grown.use_count() == 1);
+        const std::size_t size = grown.modify([](Vector<float>& v) { return v.size(); });
+        CHECK(size == 10001);
+        
+        // release() moves the elements out when they aren't shared, and copies them otherwise
+        const float* unique = grown.data();
+        Vector<float> owned = grown.release();
+        CHECK(owned.data() == unique && is_ramp(owned.view(), 10001));
+        CHECK(grown.size() == 0 && grown.use_count() == 0);
+        
+        SharedVector<float> other = shared;
+        Vector<float> copied = other.release();
+        CHECK(copied.data() != shared.data() && copied == source && shared.use_count() == 1);
+        
+        // moves leave an empty SharedVector that can be written again
+        SharedVector<float> moved = std::move(shared);
+        CHECK(shared.size() == 0 && shared.use_count() == 0 && is_ramp(moved, 10000));
+        shared.modify([](Vector<float>& v) { v.push_back(1.f); });
+        CHECK(shared.size() == 1 && shared[0] == 1.f);
+        
+        // from a view, and assignment
+        SharedVector<float> viewed(source.view(0, 5));
+        viewed = moved;
+        CHECK(viewed.use_count() == 2 && viewed.data() == moved.data());
+        viewed = SharedVector<float>();
+        CHECK(moved.use_count() == 1 && viewed.size() == 0);
+    }
+    
+    // readers of the original and writers of their own copies on other threads
+    void threads() {
+        const SharedVector<float> shared(ramp(100000));
+        std::vector<int> ok(8);
+        
+        std::vector<std::thread> pool;
+        for (std::size_t t = 0; t < ok.size(); t++)
+            pool.emplace_back([&, t] {
+                SharedVector<float> copy = shared;
+                if (t % 2) {
+                    float* out = copy.mutable_data();
+                    for (std::size_t i = 0; i < copy.size(); i++)
+                        out[i] += 1.f;
+                    ok[t] = is_ramp(copy, 100000, 1);
+                } else {
+                    ok[t] = is_ramp(copy, 100000) && copy.hash() == shared.hash();
+                }
+            });
+        for (auto& thread : pool)
+            thread.join();
+        
+        CHECK(std::all_of(ok.begin(), ok.end(), [](int x) { return x == 1; }));
+        CHECK(is_ramp(shared, 100000) && shared.use_count() == 1);
+    }
+}
+
+int main() {
+    vector_copies();
+    copy_on_write();
+    threads();
+    
+    return vector_test::result();
+}
@@ -0,0 +1,59 @@
+// SparseVector set(), erasing by setting 0, and combinations with other vectors (user-023)
+#include "vector.hpp"
+#include "test.hpp"
+
+namespace {
+    void set_and_erase() {
+        SparseVector<double> v(100);
+        v.set(50, 2.0);
+        v.set(10, 1.0);
+        v.set(90, 3.0);
+        
+        CHECK(v.nnz() == 3);
+        CHECK(v.indices()[0] == 10 && v.indices()[1] == 50 && v.indices()[2] == 90);
+        CHECK(v[50] == 2.0 && v[11] == 0.0);
+        
+        v.set(50, 5.0);
+        CHECK(v.nnz() == 3 && v[50] == 5.0);
+        
+        v.set(50, 0.0);
+        CHECK(v.nnz() == 2 && v[50] == 0.0);
+        
+        v.set(20, 0.0);
+        CHECK(v.nnz() == 2);
+        
+        CHECK_THROWS(v.set(100, 1.0), std::out_of_range);
+    }
+    
+    void combine() {
+        SparseVector<double> u(10), v(10);
+        u.set(1, 1.0);
+        u.set(4, 2.0);
+        v.set(4, -2.0);
+        v.set(7, 3.0);
+        
+        const SparseVector<double> sum = u + v;
+        CHECK(sum.nnz() == 2);
+        CHECK(sum[1] == 1.0 && sum[4] == 0.0 && sum[7] == 3.0);
+        
+        const SparseVector<double> difference = u - v;
+        CHECK(difference[4] == 4.0 && difference[7] == -3.0);
+        
+        CHECK(dot_product(u, v) == -4.0);
+        
+        Vector<double> dense(10);
+        for (std::size_t i = 0; i < dense.size(); i++)
+            dense[i] = static_cast<double>(i);
+        CHECK(dot_product(u, dense) == 9.0);
+        
+        CHECK(SparseVector<double>(u.to_dense()) == u);
+        CHECK_THROWS(u + SparseVector<double>(11), std::invalid_argument);
+    }
+}
+
+int main() {
+    set_and_erase();
+    combine();
+    
+    return vector_test::result();
+}
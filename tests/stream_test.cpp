@@ -0,0 +1,73 @@
+// VectorStream reductions against the same vector in memory (user-027)
+#include "vector.hpp"
+#include "test.hpp"
+
+#include <cstdio>
+#include <random>
+
+namespace {
+    const std::string path = "stream_test.bin";
+    const std::string other_path = "stream_test_other.bin";
+    
+    void reductions(std::size_t n, std::size_t chunk) {
+        std::mt19937 gen(static_cast<unsigned>(n));
+        std::uniform_real_distribution<double> dist(-1, 1);
+        
+        Vector<double> v(n), w(n);
+        for (std::size_t i = 0; i < n; i++) {
+            v[i] = dist(gen);
+            w[i] = dist(gen);
+        }
+        v.save(path);
+        w.save(other_path);
+        
+        const VectorStream<double> stream(path, chunk), other(other_path, chunk);
+        CHECK(stream.size() == n);
+        
+        CHECK_NEAR(stream.sum(), v.sum(), 1e-9);
+        CHECK_NEAR(stream.mean(), v.mean(), 1e-9);
+        CHECK_NEAR(dot_product(stream, other), dot_product(v, w), 1e-9);
+        CHECK_NEAR(dot_product(stream, w), dot_product(v, w), 1e-9);
+        
+        const MinMax<double> expected = v.minmax(), streamed = stream.minmax();
+        CHECK(streamed.min.index == expected.min.index && streamed.min.value == expected.min.value);
+        CHECK(streamed.max.index == expected.max.index && streamed.max.value == expected.max.value);
+        
+        std::size_t seen = 0;
+        stream.for_each_chunk([&](VectorView<double> part, std::size_t offset) {
+            CHECK(offset == seen);
+            CHECK(part.size() <= chunk);
+            seen += part.size();
+        });
+        CHECK(seen == n);
+    }
+    
+    // samples spread over every chunk, including a partial last one
+    void median(std::size_t chunk) {
+        Vector<double> ramp(60000);
+        for (std::size_t i = 0; i < ramp.size(); i++)
+            ramp[i] = static_cast<double>(i);
+        ramp.save(path);
+        
+        // a fraction of a percent of the ranks
+        CHECK(std::abs(VectorStream<double>(path, chunk).median() - 29999.5) < 60);
+    }
+}
+
+int main() {
+    reductions(1, 1);
+    reductions(10000, 1000);
+    reductions(100003, VectorStream<double>::default_chunk_size);
+    reductions(300000, 65536);
+    
+    for (std::size_t chunk : { 1000, 4096, 6000, 8191, 65536 })
+        median(chunk);
+    
+    CHECK_THROWS(VectorStream<double>("stream_test_missing.bin"), std::runtime_error);
+    CHECK_THROWS(VectorStream<double>(path, 0), std::invalid_argument);
+    CHECK_THROWS(VectorStream<float>(path), std::runtime_error);
+    
+    std::remove(path.c_str());
+    std::remove(other_path.c_str());
+    return vector_test::result();
+}
@@ -0,0 +1,60 @@
+/*
+ Minimal checks for the tests, which have no dependency but the library.
+ 
+ Every test is a main() that runs CHECK()s; a failed check prints the file,
+ line and expression, and the test fails at the end with the number of
+ failed checks, so that one run reports all of them.
+*/
+#ifndef vector_test_hpp
+#define vector_test_hpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+namespace vector_test {
+    inline int& failures() {
+        static int count = 0;
+        return count;
+    }
+    
+    inline void fail(const char* file, int line, const char* what) {
+        std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+        failures()++;
+    }
+    
+    inline bool near(double a, double b, double tolerance) {
+        return std::abs(a - b) <= tolerance * std::max(1.0, std::abs(b));
+    }
+    
+    inline int result() {
+        if (failures() > 0)
+            std::fprintf(stderr, "%d check(s) failed\n", failures());
+        
+        return failures() > 0 ? 1 : 0;
+    }
+}
+
+#define CHECK(condition)                                                        \
+    do {                                                                        \
+        if (!(condition))                                                       \
+            ::vector_test::fail(__FILE__, __LINE__, #condition);                \
+    } while (false)
+
+// relative tolerance, absolute below 1
+#define CHECK_NEAR(a, b, tolerance) CHECK(::vector_test::near(double(a), double(b), tolerance))
+
+#define CHECK_THROWS(expression, exception)                                     \
+    do {                                                                        \
+        bool thrown_ = false;                                                   \
+        try {                                                                   \
+            (void)(expression);                                                 \
+        } catch (const exception&) {                                            \
+            thrown_ = true;                                                     \
+        }                                                                       \
+        if (!thrown_)                                                           \
+            ::vector_test::fail(__FILE__, __LINE__, #expression " throws " #exception); \
+    } while (false)
+
+#endif /* vector_test_hpp */
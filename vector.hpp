@@ -9,506 +9,10904 @@
 #define vector_hpp
 
 #include <algorithm>
+#include <array>
 #include <vector>
 #include <numeric>
 #include <variant>
 #include <memory>
+#include <cmath>
+#include <functional>
+#include <initializer_list>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <new>
+#include <limits>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include <cerrno>
+#include <string>
+#include <istream>
+#include <fstream>
+#include <system_error>
+#include <cassert>
+#include <deque>
 
+// memory-mapped files (Vector::map) need POSIX; define VECTOR_NO_MMAP to leave them out
+#if !defined(VECTOR_NO_MMAP) && (defined(__unix__) || defined(__APPLE__))
+    #define VECTOR_HAS_MMAP 1
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/uio.h>
+    #include <unistd.h>
+#endif
+
+// std::pmr memory resources (ResourceAllocator), missing from older standard libraries
+#if defined(__has_include)
+    #if __has_include(<memory_resource>)
+        #define VECTOR_HAS_PMR 1
+        #include <memory_resource>
+    #endif
+#endif
+
+// MPI transport of DistributedVector (MpiTransport), if VECTOR_MPI is defined; link the program against MPI
+#if defined(VECTOR_MPI)
+    #define VECTOR_HAS_MPI 1
+    #include <mpi.h>
+#endif
+
+// instrumentation counters (VECTOR_INSTRUMENT), with timings if VECTOR_INSTRUMENT_TIMING is defined too
+#if defined(VECTOR_INSTRUMENT) && defined(VECTOR_INSTRUMENT_TIMING)
+    #if defined(__x86_64__) || defined(__i386__)
+        #include <x86intrin.h>
+    #else
+        #include <chrono>
+    #endif
+#endif
+
+// bounds checks of operator[]: assert()ed, so compiled out with NDEBUG, unless VECTOR_CHECKED_ACCESS makes them
+// throw std::out_of_range like at() does
+#if defined(VECTOR_CHECKED_ACCESS)
+    #define VECTOR_CHECK_INDEX(i, n) do { if (!((i) < (n))) throw std::out_of_range("Index out of range"); } while (false)
+#else
+    #define VECTOR_CHECK_INDEX(i, n) assert((i) < (n) && "Index out of range")
+#endif
+
+#if !defined(VECTOR_NO_SIMD)
+    #if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE2__)
+        #include <immintrin.h>
+    #elif defined(__ARM_NEON)
+        #include <arm_neon.h>
+    #endif
+#endif
+
+/*
+ SIMD reduction kernels.
+ 
+ The widest instruction set enabled at compile time is used: AVX-512, AVX2,
+ SSE2 or NEON (e.g. build with -mavx2 -mfma or -march=native to get more
+ than the x86-64 baseline). Define VECTOR_NO_SIMD to force the portable code.
+ 
+ Every kernel keeps four independent accumulators, so consecutive additions
+ don't wait for each other. Floating point results may therefore differ
+ from a strictly serial loop in the last bits.
+*/
+namespace vector_detail {
+    // primary template: no SIMD support for the lane type
+    template <typename Lane>
+    struct simd {
+        static constexpr bool enabled = false;
+        static constexpr bool has_mul = false;
+        static constexpr bool has_minmax = false;
+        static constexpr bool has_compare = false;
+    };
+
+#if !defined(VECTOR_NO_SIMD) && defined(__AVX512F__)
+    template <>
+    struct simd<float> {
+        using reg = __m512;
+        static constexpr bool enabled = true;
+        static constexpr bool has_mul = true;
+        static constexpr bool has_minmax = true;
+        static constexpr bool has_compare = true;
+        static constexpr std::size_t width = 16;
+        
+        static reg zero() { return _mm512_setzero_ps(); }
+        static reg one() { return _mm512_set1_ps(1.0f); }
+        static reg set1(float x) { return _mm512_set1_ps(x); }
+        static reg load(const void* p) { return _mm512_loadu_ps(p); }
+        static void store(void* p, reg a) { _mm512_storeu_ps(p, a); }
+        static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+        static reg sub(reg a, reg b) { return _mm512_sub_ps(a, b); }
+        static reg min(reg a, reg b) { return _mm512_min_ps(a, b); }
+        static reg max(reg a, reg b) { return _mm512_max_ps(a, b); }
+        static reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+        static reg fma(reg a, reg b, reg c) { return _mm512_fmadd_ps(a, b, c); }
+        static unsigned eq_mask(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+    };
+    
+    template <>
+    struct simd<double> {
+        using reg = __m512d;
+        static constexpr bool enabled = true;
+        static constexpr bool has_mul = true;
+        static constexpr bool has_minmax = true;
+        static constexpr bool has_compare = true;
+        static constexpr std::size_t width = 8;
+        
+        static reg zero() { return _mm512_setzero_pd(); }
+        static reg one() { return _mm512_set1_pd(1.0); }
+        static reg set1(double x) { return _mm512_set1_pd(x); }
+        static reg load(const void* p) { return _mm512_loadu_pd(p); }
+        static void store(void* p, reg a) { _mm512_storeu_pd(p, a); }
+        static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+        static reg sub(reg a, reg b) { return _mm512_sub_pd(a, b); }
+        static reg min(reg a, reg b) { return _mm512_min_pd(a, b); }
+        static reg max(reg a, reg b) { return _mm512_max_pd(a, b); }
+        static reg mul(reg a, reg b) { return _mm512_mul_pd(a, b); }
+        static reg fma(reg a, reg b, reg c) { return _mm512_fmadd_pd(a, b, c); }
+        static unsigned eq_mask(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+    };
+    
+    template <>
+    struct simd<std::int32_t> {
+        using reg = __m512i;
+        static constexpr bool enabled = true;
+        static constexpr bool has_mul = true;
+        static constexpr bool has_minmax = true;
+        static constexpr bool has_compare = true;
+        static constexpr std::size_t width = 16;
+        
+        static reg zero() { return _mm512_setzero_si512(); }
+        static reg one() { return _mm512_set1_epi32(1); }
+        static reg set1(std::int32_t x) { return _mm512_set1_epi32(x); }
+        static reg load(const void* p) { return _mm512_loadu_si512(p); }
+        static void store(void* p, reg a) { _mm512_storeu_si512(p, a); }
+        static reg add(reg a, reg b) { return _mm512_add_epi32(a, b); }
+        static reg sub(reg a, reg b) { return _mm512_sub_epi32(a, b); }
+        static reg min(reg a, reg b) { return _mm512_min_epi32(a, b); }
+        static reg max(reg a, reg b) { return _mm512_max_epi32(a, b); }
+        static reg mul(reg a, reg b) { return _mm512_mullo_epi32(a, b); }
+        static reg fma(reg a, reg b, reg c) { return add(mul(a, b), c); }
+        static unsigned eq_mask(reg a, reg b) { return _mm512_cmpeq_epi32_mask(a, b); }
+    };
+    
+    template <>
+    struct simd<std::int64_t> {
+        using reg = __m512i;
+        static constexpr bool enabled = true;
+    #if defined(__AVX512DQ__)
+        static constexpr bool has_mul = true;
+    #else
+        static constexpr bool has_mul = false;
+    #endif
+        static constexpr bool has_minmax = true;
+        static constexpr bool has_compare = true;
+        static constexpr std::size_t width = 8;
+        
+        static reg zero() { return _mm512_setzero_si512(); }
+        static reg one() { return _mm512_set1_epi64(1); }
+        static reg set1(std::int64_t x) { return _mm512_set1_epi64(x); }
+        static reg load(const void* p) { return _mm512_loadu_si512(p); }
+        static void store(void* p, reg a) { _mm512_storeu_si512(p, a); }
+        static reg add(reg a, reg b) { return _mm512_add_epi64(a, b); }
+        static reg sub(reg a, reg b) { return _mm512_sub_epi64(a, b); }
+        static reg min(reg a, reg b) { return _mm512_min_epi64(a, b); }
+        static reg max(reg a, reg b) { return _mm512_max_epi64(a, b); }
+    #if defined(__AVX512DQ__)
+        static reg mul(reg a, reg b) { return _mm512_mullo_epi64(a, b); }
+        static reg fma(reg a, reg b, reg c) { return add(mul(a, b), c); }
+    #endif
+        static unsigned eq_mask(reg a, reg b) { return _mm512_cmpeq_epi64_mask(a, b); }
+    };
+#elif !defined(VECTOR_NO_SIMD) && defined(__AVX2__)
+    template <>
+    struct simd<float> {
+        using reg = __m256;
+        static constexpr bool enabled = true;
+        static constexpr bool has_mul = true;
+        static constexpr bool has_minmax = true;
+        static constexpr bool has_compare = true;
+        static constexpr std::size_t width = 8;
+        
+        static reg zero() { return _mm256_setzero_ps(); }
+        static reg one() { return _mm256_set1_ps(1.0f); }
+        static reg set1(float x) { return _mm256_set1_ps(x); }
+        static reg load(const void* p) { return _mm256_loadu_ps(static_cast<const float*>(p)); }
+        static void store(void* p, reg a) { _mm256_storeu_ps(static_cast<float*>(p), a); }
+        static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+        static reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+        static reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+        static reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+        static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+    #if defined(__FMA__)
+        static reg fma(reg a, reg b, reg c) { return _mm256_fmadd_ps(a, b, c); }
+    #else
+        static reg fma(reg a, reg b, reg c) { return add(mul(a, b), c); }
+    #endif
+        static unsigned eq_mask(reg a, reg b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ)); }
+    };
+    
+    template <>
+    struct simd<double> {
+        using reg = __m256d;
+        static constexpr bool enabled = true;
+        static constexpr bool has_mul = true;
+        static constexpr bool has_minmax = true;
+        static constexpr bool has_compare = true;
+        static constexpr std::size_t width = 4;
+        
+        static reg zero() { return _mm256_setzero_pd(); }
+        static reg one() { return _mm256_set1_pd(1.0); }
+        static reg set1(double x) { return _mm256_set1_pd(x); }
+        static reg load(const void* p) { return _mm256_loadu_pd(static_cast<const double*>(p)); }
+        static void store(void* p, reg a) { _mm256_storeu_pd(static_cast<double*>(p), a); }
+        static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+        static reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+        static reg min(reg a, reg b) { return _mm256_min_pd(a, b); }
+        static reg max(reg a, reg b) { return _mm256_max_pd(a, b); }
+        static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+    #if defined(__FMA__)
+        static reg fma(reg a, reg b, reg c) { return _mm256_fmadd_pd(a, b, c); }
+    #else
+        static reg fma(reg a, reg b, reg c) { return add(mul(a, b), c); }
+    #endif
+        static unsigned eq_mask(reg a, reg b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ)); }
+    };
+    
+    template <>
+    struct simd<std::int32_t> {
+        using reg = __m256i;
+        static constexpr bool enabled = true;
+        static constexpr bool has_mul = true;
+        static constexpr bool has_minmax = true;
+        static constexpr bool has_compare = true;
+        static constexpr std::size_t width = 8;
+        
+        static reg zero() { return _mm256_setzero_si256(); }
+        static reg one() { return _mm256_set1_epi32(1); }
+        static reg set1(std::int32_t x) { return _mm256_set1_epi32(x); }
+        static reg load(const void* p) { return _mm256_loadu_si256(static_cast<const __m256i*>(p)); }
+        static void store(void* p, reg a) { _mm256_storeu_si256(static_cast<__m256i*>(p), a); }
+        static reg add(reg a, reg b) { return _mm256_add_epi32(a, b); }
+        static reg sub(reg a, reg b) { return _mm256_sub_epi32(a, b); }
+        static reg min(reg a, reg b) { return _mm256_min_epi32(a, b); }
+        static reg max(reg a, reg b) { return _mm256_max_epi32(a, b); }
+        static reg mul(reg a, reg b) { return _mm256_mullo_epi32(a, b); }
+        static reg fma(reg a, reg b, reg c) { return add(mul(a, b), c); }
+        static unsigned eq_mask(reg a, reg b) { return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b))); }
+    };
+    
+    template <>
+    struct simd<std::int64_t> {
+        using reg = __m256i;
+        static constexpr bool enabled = true;
+        static constexpr bool has_mul = false;
+        static constexpr bool has_minmax = false;
+        static constexpr bool has_compare = true;
+        static constexpr std::size_t width = 4;
+        
+        static reg zero() { return _mm256_setzero_si256(); }
+        static reg set1(std::int64_t x) { return _mm256_set1_epi64x(x); }
+        static reg load(const void* p) { return _mm256_loadu_si256(static_cast<const __m256i*>(p)); }
+        static void store(void* p, reg a) { _mm256_storeu_si256(static_cast<__m256i*>(p), a); }
+        static reg add(reg a, reg b) { return _mm256_add_epi64(a, b); }
+        static reg sub(reg a, reg b) { return _mm256_sub_epi64(a, b); }
+        static unsigned eq_mask(reg a, reg b) { return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(a, b))); }
+    };
+#elif !defined(VECTOR_NO_SIMD) && defined(__SSE2__)
+    template <>
+    struct simd<float> {
+        using reg = __m128;
+        static constexpr bool enabled = true;
+        static constexpr bool has_mul = true;
+        static constexpr bool has_minmax = true;
+        static constexpr bool has_compare = true;
+        static constexpr std::size_t width = 4;
+        
+        static reg zero() { return _mm_setzero_ps(); }
+        static reg one() { return _mm_set1_ps(1.0f); }
+        static reg set1(float x) { return _mm_set1_ps(x); }
+        static reg load(const void* p) { return _mm_loadu_ps(static_cast<const float*>(p)); }
+        static void store(void* p, reg a) { _mm_storeu_ps(static_cast<float*>(p), a); }
+        static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+        static reg sub(reg a, reg b) { return _mm_sub_ps(a, b); }
+        static reg min(reg a, reg b) { return _mm_min_ps(a, b); }
+        static reg max(reg a, reg b) { return _mm_max_ps(a, b); }
+        static reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+        static reg fma(reg a, reg b, reg c) { return add(mul(a, b), c); }
+        static unsigned eq_mask(reg a, reg b) { return _mm_movemask_ps(_mm_cmpeq_ps(a, b)); }
+    };
+    
+    template <>
+    struct simd<double> {
+        using reg = __m128d;
+        static constexpr bool enabled = true;
+        static constexpr bool has_mul = true;
+        static constexpr bool has_minmax = true;
+        static constexpr bool has_compare = true;
+        static constexpr std::size_t width = 2;
+        
+        static reg zero() { return _mm_setzero_pd(); }
+        static reg one() { return _mm_set1_pd(1.0); }
+        static reg set1(double x) { return _mm_set1_pd(x); }
+        static reg load(const void* p) { return _mm_loadu_pd(static_cast<const double*>(p)); }
+        static void store(void* p, reg a) { _mm_storeu_pd(static_cast<double*>(p), a); }
+        static reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+        static reg sub(reg a, reg b) { return _mm_sub_pd(a, b); }
+        static reg min(reg a, reg b) { return _mm_min_pd(a, b); }
+        static reg max(reg a, reg b) { return _mm_max_pd(a, b); }
+        static reg mul(reg a, reg b) { return _mm_mul_pd(a, b); }
+        static reg fma(reg a, reg b, reg c) { return add(mul(a, b), c); }
+        static unsigned eq_mask(reg a, reg b) { return _mm_movemask_pd(_mm_cmpeq_pd(a, b)); }
+    };
+    
+    template <>
+    struct simd<std::int32_t> {
+        using reg = __m128i;
+        static constexpr bool enabled = true;
+    #if defined(__SSE4_1__)
+        static constexpr bool has_mul = true;
+    #else
+        static constexpr bool has_mul = false;
+    #endif
+    #if defined(__SSE4_1__)
+        static constexpr bool has_minmax = true;
+    #else
+        static constexpr bool has_minmax = false;
+    #endif
+        static constexpr bool has_compare = true;
+        static constexpr std::size_t width = 4;
+        
+        static reg zero() { return _mm_setzero_si128(); }
+        static reg one() { return _mm_set1_epi32(1); }
+        static reg set1(std::int32_t x) { return _mm_set1_epi32(x); }
+        static reg load(const void* p) { return _mm_loadu_si128(static_cast<const __m128i*>(p)); }
+        static void store(void* p, reg a) { _mm_storeu_si128(static_cast<__m128i*>(p), a); }
+        static reg add(reg a, reg b) { return _mm_add_epi32(a, b); }
+        static reg sub(reg a, reg b) { return _mm_sub_epi32(a, b); }
+    #if defined(__SSE4_1__)
+        static reg min(reg a, reg b) { return _mm_min_epi32(a, b); }
+        static reg max(reg a, reg b) { return _mm_max_epi32(a, b); }
+        static reg mul(reg a, reg b) { return _mm_mullo_epi32(a, b); }
+        static reg fma(reg a, reg b, reg c) { return add(mul(a, b), c); }
+    #endif
+        static unsigned eq_mask(reg a, reg b) { return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, b))); }
+    };
+    
+    template <>
+    struct simd<std::int64_t> {
+        using reg = __m128i;
+        static constexpr bool enabled = true;
+        static constexpr bool has_mul = false;
+        static constexpr bool has_minmax = false;
+        static constexpr bool has_compare = true;
+        static constexpr std::size_t width = 2;
+        
+        static reg zero() { return _mm_setzero_si128(); }
+        static reg set1(std::int64_t x) { return _mm_set1_epi64x(x); }
+        static reg load(const void* p) { return _mm_loadu_si128(static_cast<const __m128i*>(p)); }
+        static void store(void* p, reg a) { _mm_storeu_si128(static_cast<__m128i*>(p), a); }
+        static reg add(reg a, reg b) { return _mm_add_epi64(a, b); }
+        static reg sub(reg a, reg b) { return _mm_sub_epi64(a, b); }
+        // SSE2 has no 64-bit compare: both 32-bit halves have to be equal
+        static unsigned eq_mask(reg a, reg b) {
+            reg c = _mm_cmpeq_epi32(a, b);
+            c = _mm_and_si128(c, _mm_shuffle_epi32(c, _MM_SHUFFLE(2, 3, 0, 1)));
+            return _mm_movemask_pd(_mm_castsi128_pd(c));
+        }
+    };
+#elif !defined(VECTOR_NO_SIMD) && defined(__ARM_NEON)
+    template <>
+    struct simd<float> {
+        using reg = float32x4_t;
+        static constexpr bool enabled = true;
+        static constexpr bool has_mul = true;
+        static constexpr bool has_minmax = true;
+        static constexpr bool has_compare = true;
+        static constexpr std::size_t width = 4;
+        
+        static reg zero() { return vdupq_n_f32(0.0f); }
+        static reg one() { return vdupq_n_f32(1.0f); }
+        static reg set1(float x) { return vdupq_n_f32(x); }
+        static reg load(const void* p) { return vld1q_f32(static_cast<const float*>(p)); }
+        static void store(void* p, reg a) { vst1q_f32(static_cast<float*>(p), a); }
+        static reg add(reg a, reg b) { return vaddq_f32(a, b); }
+        static reg sub(reg a, reg b) { return vsubq_f32(a, b); }
+        static reg min(reg a, reg b) { return vminq_f32(a, b); }
+        static reg max(reg a, reg b) { return vmaxq_f32(a, b); }
+        static reg mul(reg a, reg b) { return vmulq_f32(a, b); }
+    #if defined(__aarch64__)
+        static reg fma(reg a, reg b, reg c) { return vfmaq_f32(c, a, b); }
+    #else
+        static reg fma(reg a, reg b, reg c) { return vmlaq_f32(c, a, b); }
+    #endif
+        static unsigned eq_mask(reg a, reg b) {
+            const uint32x4_t bits = { 1, 2, 4, 8 };
+            uint32x4_t m = vandq_u32(vceqq_f32(a, b), bits);
+            uint32x2_t s = vadd_u32(vget_low_u32(m), vget_high_u32(m));
+            return vget_lane_u32(vpadd_u32(s, s), 0);
+        }
+    };
+    
+    #if defined(__aarch64__)
+    template <>
+    struct simd<double> {
+        using reg = float64x2_t;
+        static constexpr bool enabled = true;
+        static constexpr bool has_mul = true;
+        static constexpr bool has_minmax = true;
+        static constexpr bool has_compare = true;
+        static constexpr std::size_t width = 2;
+        
+        static reg zero() { return vdupq_n_f64(0.0); }
+        static reg one() { return vdupq_n_f64(1.0); }
+        static reg set1(double x) { return vdupq_n_f64(x); }
+        static reg load(const void* p) { return vld1q_f64(static_cast<const double*>(p)); }
+        static void store(void* p, reg a) { vst1q_f64(static_cast<double*>(p), a); }
+        static reg add(reg a, reg b) { return vaddq_f64(a, b); }
+        static reg sub(reg a, reg b) { return vsubq_f64(a, b); }
+        static reg min(reg a, reg b) { return vminq_f64(a, b); }
+        static reg max(reg a, reg b) { return vmaxq_f64(a, b); }
+        static reg mul(reg a, reg b) { return vmulq_f64(a, b); }
+        static reg fma(reg a, reg b, reg c) { return vfmaq_f64(c, a, b); }
+        static unsigned eq_mask(reg a, reg b) {
+            uint64x2_t m = vceqq_f64(a, b);
+            return unsigned(vgetq_lane_u64(m, 0) & 1) | unsigned(vgetq_lane_u64(m, 1) & 2);
+        }
+    };
+    #endif
+    
+    template <>
+    struct simd<std::int32_t> {
+        using reg = int32x4_t;
+        static constexpr bool enabled = true;
+        static constexpr bool has_mul = true;
+        static constexpr bool has_minmax = true;
+        static constexpr bool has_compare = true;
+        static constexpr std::size_t width = 4;
+        
+        static reg zero() { return vdupq_n_s32(0); }
+        static reg one() { return vdupq_n_s32(1); }
+        static reg set1(std::int32_t x) { return vdupq_n_s32(x); }
+        static reg load(const void* p) { return vld1q_s32(static_cast<const std::int32_t*>(p)); }
+        static void store(void* p, reg a) { vst1q_s32(static_cast<std::int32_t*>(p), a); }
+        static reg add(reg a, reg b) { return vaddq_s32(a, b); }
+        static reg sub(reg a, reg b) { return vsubq_s32(a, b); }
+        static reg min(reg a, reg b) { return vminq_s32(a, b); }
+        static reg max(reg a, reg b) { return vmaxq_s32(a, b); }
+        static reg mul(reg a, reg b) { return vmulq_s32(a, b); }
+        static reg fma(reg a, reg b, reg c) { return vmlaq_s32(c, a, b); }
+        static unsigned eq_mask(reg a, reg b) {
+            const uint32x4_t bits = { 1, 2, 4, 8 };
+            uint32x4_t m = vandq_u32(vceqq_s32(a, b), bits);
+            uint32x2_t s = vadd_u32(vget_low_u32(m), vget_high_u32(m));
+            return vget_lane_u32(vpadd_u32(s, s), 0);
+        }
+    };
+    
+    template <>
+    struct simd<std::int64_t> {
+        using reg = int64x2_t;
+        static constexpr bool enabled = true;
+        static constexpr bool has_mul = false;
+        static constexpr bool has_minmax = false;
+        static constexpr bool has_compare = true;
+        static constexpr std::size_t width = 2;
+        
+        static reg zero() { return vdupq_n_s64(0); }
+        static reg set1(std::int64_t x) { return vdupq_n_s64(x); }
+        static reg load(const void* p) { return vld1q_s64(static_cast<const std::int64_t*>(p)); }
+        static void store(void* p, reg a) { vst1q_s64(static_cast<std::int64_t*>(p), a); }
+        static reg add(reg a, reg b) { return vaddq_s64(a, b); }
+        static reg sub(reg a, reg b) { return vsubq_s64(a, b); }
+        // 32-bit compares: vceqq_s64 is AArch64 only
+        static unsigned eq_mask(reg a, reg b) {
+            uint32x4_t c = vceqq_s32(vreinterpretq_s32_s64(a), vreinterpretq_s32_s64(b));
+            uint64x2_t m = vreinterpretq_u64_u32(vandq_u32(c, vrev64q_u32(c)));
+            return unsigned(vgetq_lane_u64(m, 0) & 1) | unsigned(vgetq_lane_u64(m, 1) & 2);
+        }
+    };
+#endif
+
+    // SIMD lane type used for T: integers of any signedness share 32/64-bit lanes
+    template <typename T>
+    using simd_lane_t = std::conditional_t<std::is_same_v<T, float> || std::is_same_v<T, double>, T,
+                        std::conditional_t<!std::is_integral_v<T> || std::is_same_v<T, bool>, void,
+                        std::conditional_t<sizeof(T) == 4, std::int32_t,
+                        std::conditional_t<sizeof(T) == 8, std::int64_t, void>>>>;
+    
+    template <typename T>
+    using simd_for = simd<simd_lane_t<T>>;
+    
+    template <typename T, typename S>
+    T horizontal_sum(typename S::reg r) {
+        simd_lane_t<T> lanes[S::width];
+        S::store(lanes, r);
+        
+        T total = T();
+        for (std::size_t i = 0; i < S::width; i++)
+            total += static_cast<T>(lanes[i]);
+        
+        return total;
+    }
+    
+    template <typename T, typename S>
+    T horizontal_product(typename S::reg r) {
+        simd_lane_t<T> lanes[S::width];
+        S::store(lanes, r);
+        
+        T total = T(1);
+        for (std::size_t i = 0; i < S::width; i++)
+            total *= static_cast<T>(lanes[i]);
+        
+        return total;
+    }
+    
+    template <typename T>
+    T reduce_sum(const T* data, std::size_t n) {
+        std::size_t i = 0;
+        T total = T();
+        
+        if constexpr (simd_for<T>::enabled) {
+            using S = simd_for<T>;
+            constexpr std::size_t w = S::width;
+            
+            auto acc0 = S::zero(), acc1 = S::zero(), acc2 = S::zero(), acc3 = S::zero();
+            for (; i + 4 * w <= n; i += 4 * w) {
+                acc0 = S::add(acc0, S::load(data + i));
+                acc1 = S::add(acc1, S::load(data + i + w));
+                acc2 = S::add(acc2, S::load(data + i + 2 * w));
+                acc3 = S::add(acc3, S::load(data + i + 3 * w));
+            }
+            for (; i + w <= n; i += w)
+                acc0 = S::add(acc0, S::load(data + i));
+            
+            total = horizontal_sum<T, S>(S::add(S::add(acc0, acc1), S::add(acc2, acc3)));
+        }
+        else {
+            T acc0 = T(), acc1 = T(), acc2 = T(), acc3 = T();
+            for (; i + 4 <= n; i += 4) {
+                acc0 += data[i];
+                acc1 += data[i + 1];
+                acc2 += data[i + 2];
+                acc3 += data[i + 3];
+            }
+            
+            total = (acc0 + acc1) + (acc2 + acc3);
+        }
+        
+        for (; i < n; i++)
+            total += data[i];
+        
+        return total;
+    }
+    
+    template <typename T>
+    T reduce_product(const T* data, std::size_t n) {
+        std::size_t i = 0;
+        T total = T(1);
+        
+        if constexpr (simd_for<T>::has_mul) {
+            using S = simd_for<T>;
+            constexpr std::size_t w = S::width;
+            
+            auto acc0 = S::one(), acc1 = S::one(), acc2 = S::one(), acc3 = S::one();
+            for (; i + 4 * w <= n; i += 4 * w) {
+                acc0 = S::mul(acc0, S::load(data + i));
+                acc1 = S::mul(acc1, S::load(data + i + w));
+                acc2 = S::mul(acc2, S::load(data + i + 2 * w));
+                acc3 = S::mul(acc3, S::load(data + i + 3 * w));
+            }
+            for (; i + w <= n; i += w)
+                acc0 = S::mul(acc0, S::load(data + i));
+            
+            total = horizontal_product<T, S>(S::mul(S::mul(acc0, acc1), S::mul(acc2, acc3)));
+        }
+        else {
+            T acc0 = T(1), acc1 = T(1), acc2 = T(1), acc3 = T(1);
+            for (; i + 4 <= n; i += 4) {
+                acc0 *= data[i];
+                acc1 *= data[i + 1];
+                acc2 *= data[i + 2];
+                acc3 *= data[i + 3];
+            }
+            
+            total = (acc0 * acc1) * (acc2 * acc3);
+        }
+        
+        for (; i < n; i++)
+            total *= data[i];
+        
+        return total;
+    }
+    
+    template <typename T>
+    T reduce_dot(const T* u, const T* v, std::size_t n) {
+        std::size_t i = 0;
+        T total = T();
+        
+        if constexpr (simd_for<T>::has_mul) {
+            using S = simd_for<T>;
+            constexpr std::size_t w = S::width;
+            
+            auto acc0 = S::zero(), acc1 = S::zero(), acc2 = S::zero(), acc3 = S::zero();
+            for (; i + 4 * w <= n; i += 4 * w) {
+                acc0 = S::fma(S::load(u + i), S::load(v + i), acc0);
+                acc1 = S::fma(S::load(u + i + w), S::load(v + i + w), acc1);
+                acc2 = S::fma(S::load(u + i + 2 * w), S::load(v + i + 2 * w), acc2);
+                acc3 = S::fma(S::load(u + i + 3 * w), S::load(v + i + 3 * w), acc3);
+            }
+            for (; i + w <= n; i += w)
+                acc0 = S::fma(S::load(u + i), S::load(v + i), acc0);
+            
+            total = horizontal_sum<T, S>(S::add(S::add(acc0, acc1), S::add(acc2, acc3)));
+        }
+        else {
+            T acc0 = T(), acc1 = T(), acc2 = T(), acc3 = T();
+            for (; i + 4 <= n; i += 4) {
+                acc0 += u[i] * v[i];
+                acc1 += u[i + 1] * v[i + 1];
+                acc2 += u[i + 2] * v[i + 2];
+                acc3 += u[i + 3] * v[i + 3];
+            }
+            
+            total = (acc0 + acc1) + (acc2 + acc3);
+        }
+        
+        for (; i < n; i++)
+            total += u[i] * v[i];
+        
+        return total;
+    }
+    template <typename T>
+    T reduce_sum_strided(const T* data, std::size_t stride, std::size_t n) {
+        if (stride == 1)
+            return reduce_sum(data, n);
+        
+        T acc0 = T(), acc1 = T();
+        std::size_t i = 0;
+        for (; i + 2 <= n; i += 2) {
+            acc0 += data[i * stride];
+            acc1 += data[(i + 1) * stride];
+        }
+        if (i < n)
+            acc0 += data[i * stride];
+        
+        return acc0 + acc1;
+    }
+    
+    template <typename T>
+    T reduce_product_strided(const T* data, std::size_t stride, std::size_t n) {
+        if (stride == 1)
+            return reduce_product(data, n);
+        
+        T acc0 = T(1), acc1 = T(1);
+        std::size_t i = 0;
+        for (; i + 2 <= n; i += 2) {
+            acc0 *= data[i * stride];
+            acc1 *= data[(i + 1) * stride];
+        }
+        if (i < n)
+            acc0 *= data[i * stride];
+        
+        return acc0 * acc1;
+    }
+    
+    // sum of (u[i] - v[i])^2
+    template <typename T>
+    T reduce_squared_distance(const T* u, const T* v, std::size_t n) {
+        std::size_t i = 0;
+        T total = T();
+        
+        if constexpr (simd_for<T>::has_mul) {
+            using S = simd_for<T>;
+            constexpr std::size_t w = S::width;
+            
+            auto acc0 = S::zero(), acc1 = S::zero(), acc2 = S::zero(), acc3 = S::zero();
+            for (; i + 4 * w <= n; i += 4 * w) {
+                const auto d0 = S::sub(S::load(u + i), S::load(v + i));
+                const auto d1 = S::sub(S::load(u + i + w), S::load(v + i + w));
+                const auto d2 = S::sub(S::load(u + i + 2 * w), S::load(v + i + 2 * w));
+                const auto d3 = S::sub(S::load(u + i + 3 * w), S::load(v + i + 3 * w));
+                acc0 = S::fma(d0, d0, acc0);
+                acc1 = S::fma(d1, d1, acc1);
+                acc2 = S::fma(d2, d2, acc2);
+                acc3 = S::fma(d3, d3, acc3);
+            }
+            for (; i + w <= n; i += w) {
+                const auto d = S::sub(S::load(u + i), S::load(v + i));
+                acc0 = S::fma(d, d, acc0);
+            }
+            
+            total = horizontal_sum<T, S>(S::add(S::add(acc0, acc1), S::add(acc2, acc3)));
+        }
+        
+        for (; i < n; i++)
+            total += (u[i] - v[i]) * (u[i] - v[i]);
+        
+        return total;
+    }
+    
+    template <typename T>
+    T reduce_dot_strided(const T* u, std::size_t u_stride, const T* v, std::size_t v_stride, std::size_t n) {
+        if (u_stride == 1 && v_stride == 1)
+            return reduce_dot(u, v, n);
+        
+        T acc0 = T(), acc1 = T();
+        std::size_t i = 0;
+        for (; i + 2 <= n; i += 2) {
+            acc0 += u[i * u_stride] * v[i * v_stride];
+            acc1 += u[(i + 1) * u_stride] * v[(i + 1) * v_stride];
+        }
+        if (i < n)
+            acc0 += u[i * u_stride] * v[i * v_stride];
+        
+        return acc0 + acc1;
+    }
+}
+
+/*
+ Reduced-precision element types.
+ 
+ float16 (IEEE 754 binary16) and bfloat16 (the upper half of a float) are
+ storage types: they convert to float implicitly, so arithmetic on them is
+ done in float, and from float explicitly, rounding to nearest even.
+ float16 keeps 11 significant bits up to 65504, bfloat16 keeps the range
+ of float with 8 significant bits. The reductions of a Vector of them
+ accumulate in float and round the result once, see CompactVector for
+ results in float and for int8 quantization.
+*/
+namespace vector_detail {
+    inline std::uint32_t float_bits(float x) {
+        std::uint32_t bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+        return bits;
+    }
+    
+    inline float bits_float(std::uint32_t bits) {
+        float x;
+        std::memcpy(&x, &bits, sizeof(x));
+        return x;
+    }
+    
+    inline float half_to_float(std::uint16_t h) {
+        const std::uint32_t sign = std::uint32_t(h & 0x8000) << 16;
+        const std::uint32_t exponent = (h >> 10) & 0x1f;
+        const std::uint32_t mantissa = h & 0x3ff;
+        
+        if (exponent == 0x1f)
+            return bits_float(sign | 0x7f800000 | (mantissa << 13));
+        if (exponent == 0) {
+            // zero or subnormal, mantissa * 2^-24 is exact in float
+            const float magnitude = static_cast<float>(mantissa) * 0x1p-24f;
+            return sign ? -magnitude : magnitude;
+        }
+        
+        return bits_float(sign | ((exponent + 112) << 23) | (mantissa << 13));
+    }
+    
+    // rounds to nearest even; NaN stays a (quiet) NaN, too large values become infinity
+    inline std::uint16_t float_to_half(float x) {
+        std::uint32_t bits = float_bits(x);
+        const std::uint32_t sign = bits & 0x80000000;
+        bits ^= sign;
+        
+        std::uint32_t h;
+        if (bits >= 0x47800000) {
+            h = bits > 0x7f800000 ? 0x7e00 : 0x7c00;
+        }
+        else if (bits < 0x38800000) {
+            // subnormal or zero: the float addition rounds the mantissa
+            const std::uint32_t magic = 126u << 23;
+            h = float_bits(bits_float(bits) + bits_float(magic)) - magic;
+        }
+        else {
+            const std::uint32_t odd = (bits >> 13) & 1;
+            bits += 0xc8000fff + odd;
+            h = bits >> 13;
+        }
+        
+        return static_cast<std::uint16_t>(h | (sign >> 16));
+    }
+    
+    inline float bfloat_to_float(std::uint16_t b) {
+        return bits_float(std::uint32_t(b) << 16);
+    }
+    
+    inline std::uint16_t float_to_bfloat(float x) {
+        const std::uint32_t bits = float_bits(x);
+        if ((bits & 0x7fffffff) > 0x7f800000)
+            return static_cast<std::uint16_t>((bits >> 16) | 0x40);
+        
+        return static_cast<std::uint16_t>((bits + 0x7fff + ((bits >> 16) & 1)) >> 16);
+    }
+}
+
+struct float16 {
+    std::uint16_t bits;
+    
+    float16() = default;
+    explicit float16(float x) : bits(vector_detail::float_to_half(x)) {}
+    
+    operator float() const { return vector_detail::half_to_float(bits); }
+    
+    static float16 from_bits(std::uint16_t bits) {
+        float16 h;
+        h.bits = bits;
+        return h;
+    }
+};
+
+struct bfloat16 {
+    std::uint16_t bits;
+    
+    bfloat16() = default;
+    explicit bfloat16(float x) : bits(vector_detail::float_to_bfloat(x)) {}
+    
+    operator float() const { return vector_detail::bfloat_to_float(bits); }
+    
+    static bfloat16 from_bits(std::uint16_t bits) {
+        bfloat16 b;
+        b.bits = bits;
+        return b;
+    }
+};
+
+/*
+ Widening kernels.
+ 
+ widen<Storage>::load() converts simd<float>::width elements of float16,
+ bfloat16, int8 or float to a register of floats, so the kernels below read
+ 2-4 times fewer bytes than on float and still accumulate in float. On x86
+ without F16C float16 is converted with integer operations and a
+ multiplication; without SIMD (or float16 on 32-bit ARM) the elements are
+ converted one by one.
+*/
+namespace vector_detail {
+    template <typename Storage>
+    struct widen {
+        static constexpr bool enabled = false;
+    };
+    
+    // simd<float>, looked up only when widen<A> is enabled
+    template <typename A>
+    using widening_simd = simd<std::conditional_t<widen<A>::enabled, float, void>>;
+    
+    template <typename Storage>
+    float to_float(Storage x) {
+        return static_cast<float>(x);
+    }
+    
+#if !defined(VECTOR_NO_SIMD) && (defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE2__) || defined(__ARM_NEON))
+    template <>
+    struct widen<float> {
+        static constexpr bool enabled = true;
+        static simd<float>::reg load(const float* p) { return simd<float>::load(p); }
+    };
+#endif
+
+#if !defined(VECTOR_NO_SIMD) && defined(__AVX512F__)
+    template <>
+    struct widen<float16> {
+        static constexpr bool enabled = true;
+        static __m512 load(const float16* p) { return _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))); }
+    };
+    
+    template <>
+    struct widen<bfloat16> {
+        static constexpr bool enabled = true;
+        static __m512 load(const bfloat16* p) {
+            const __m512i x = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+            return _mm512_castsi512_ps(_mm512_slli_epi32(x, 16));
+        }
+    };
+    
+    template <>
+    struct widen<std::int8_t> {
+        static constexpr bool enabled = true;
+        static __m512 load(const std::int8_t* p) { return _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)))); }
+    };
+#elif !defined(VECTOR_NO_SIMD) && defined(__AVX2__)
+    #if defined(__F16C__)
+    template <>
+    struct widen<float16> {
+        static constexpr bool enabled = true;
+        static __m256 load(const float16* p) { return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))); }
+    };
+    #else
+    // see the SSE2 version below
+    template <>
+    struct widen<float16> {
+        static constexpr bool enabled = true;
+        static __m256 load(const float16* p) {
+            const __m256i h = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+            const __m256i x = _mm256_and_si256(h, _mm256_set1_epi32(0x7fff));
+            const __m256i sign = _mm256_slli_epi32(_mm256_xor_si256(h, x), 16);
+            const __m256i special = _mm256_and_si256(_mm256_cmpgt_epi32(x, _mm256_set1_epi32(0x7bff)), _mm256_set1_epi32(0x7f800000));
+            
+            const __m256 f = _mm256_mul_ps(_mm256_castsi256_ps(_mm256_slli_epi32(x, 13)), _mm256_castsi256_ps(_mm256_set1_epi32(0x77800000)));
+            return _mm256_or_ps(f, _mm256_castsi256_ps(_mm256_or_si256(special, sign)));
+        }
+    };
+    #endif
+    
+    template <>
+    struct widen<bfloat16> {
+        static constexpr bool enabled = true;
+        static __m256 load(const bfloat16* p) {
+            const __m256i x = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+            return _mm256_castsi256_ps(_mm256_slli_epi32(x, 16));
+        }
+    };
+    
+    template <>
+    struct widen<std::int8_t> {
+        static constexpr bool enabled = true;
+        static __m256 load(const std::int8_t* p) { return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)))); }
+    };
+#elif !defined(VECTOR_NO_SIMD) && defined(__SSE2__)
+    #if defined(__F16C__)
+    template <>
+    struct widen<float16> {
+        static constexpr bool enabled = true;
+        static __m128 load(const float16* p) { return _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))); }
+    };
+    #else
+    template <>
+    struct widen<float16> {
+        static constexpr bool enabled = true;
+        static __m128 load(const float16* p) {
+            const __m128i h = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), _mm_setzero_si128());
+            const __m128i x = _mm_and_si128(h, _mm_set1_epi32(0x7fff));
+            const __m128i sign = _mm_slli_epi32(_mm_xor_si128(h, x), 16);
+            
+            // exponent and mantissa shifted into place are the float 2^-112 times too small,
+            // the multiplication is exact (subnormals included, unless denormals are flushed to zero)
+            const __m128 f = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(x, 13)), _mm_castsi128_ps(_mm_set1_epi32(0x77800000)));
+            
+            // infinity and NaN keep the mantissa and take the largest exponent
+            const __m128i special = _mm_and_si128(_mm_cmpgt_epi32(x, _mm_set1_epi32(0x7bff)), _mm_set1_epi32(0x7f800000));
+            return _mm_or_ps(f, _mm_castsi128_ps(_mm_or_si128(special, sign)));
+        }
+    };
+    #endif
+    
+    template <>
+    struct widen<bfloat16> {
+        static constexpr bool enabled = true;
+        static __m128 load(const bfloat16* p) {
+            return _mm_castsi128_ps(_mm_unpacklo_epi16(_mm_setzero_si128(), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))));
+        }
+    };
+    
+    template <>
+    struct widen<std::int8_t> {
+        static constexpr bool enabled = true;
+        static __m128 load(const std::int8_t* p) {
+            std::int32_t bytes;
+            std::memcpy(&bytes, p, sizeof(bytes));
+            
+            // every byte ends up in the top of a 32-bit lane, the arithmetic shift extends its sign
+            __m128i x = _mm_cvtsi32_si128(bytes);
+            x = _mm_unpacklo_epi8(x, x);
+            x = _mm_unpacklo_epi16(x, x);
+            return _mm_cvtepi32_ps(_mm_srai_epi32(x, 24));
+        }
+    };
+#elif !defined(VECTOR_NO_SIMD) && defined(__ARM_NEON)
+    #if defined(__aarch64__)
+    template <>
+    struct widen<float16> {
+        static constexpr bool enabled = true;
+        static float32x4_t load(const float16* p) { return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(reinterpret_cast<const std::uint16_t*>(p)))); }
+    };
+    #endif
+    
+    template <>
+    struct widen<bfloat16> {
+        static constexpr bool enabled = true;
+        static float32x4_t load(const bfloat16* p) { return vreinterpretq_f32_u32(vshll_n_u16(vld1_u16(reinterpret_cast<const std::uint16_t*>(p)), 16)); }
+    };
+#endif
+    
+    // sum of a[i] * b[i], accumulated in float
+    template <typename A, typename B>
+    float widening_dot(const A* a, const B* b, std::size_t n) {
+        std::size_t i = 0;
+        float total = 0;
+        
+        if constexpr (widen<A>::enabled && widen<B>::enabled) {
+            using S = widening_simd<A>;
+            constexpr std::size_t w = S::width;
+            
+            auto acc0 = S::zero(), acc1 = S::zero(), acc2 = S::zero(), acc3 = S::zero();
+            for (; i + 4 * w <= n; i += 4 * w) {
+                acc0 = S::fma(widen<A>::load(a + i), widen<B>::load(b + i), acc0);
+                acc1 = S::fma(widen<A>::load(a + i + w), widen<B>::load(b + i + w), acc1);
+                acc2 = S::fma(widen<A>::load(a + i + 2 * w), widen<B>::load(b + i + 2 * w), acc2);
+                acc3 = S::fma(widen<A>::load(a + i + 3 * w), widen<B>::load(b + i + 3 * w), acc3);
+            }
+            for (; i + w <= n; i += w)
+                acc0 = S::fma(widen<A>::load(a + i), widen<B>::load(b + i), acc0);
+            
+            total = horizontal_sum<float, S>(S::add(S::add(acc0, acc1), S::add(acc2, acc3)));
+        }
+        else {
+            float acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+            for (; i + 4 <= n; i += 4) {
+                acc0 += to_float(a[i]) * to_float(b[i]);
+                acc1 += to_float(a[i + 1]) * to_float(b[i + 1]);
+                acc2 += to_float(a[i + 2]) * to_float(b[i + 2]);
+                acc3 += to_float(a[i + 3]) * to_float(b[i + 3]);
+            }
+            
+            total = (acc0 + acc1) + (acc2 + acc3);
+        }
+        
+        for (; i < n; i++)
+            total += to_float(a[i]) * to_float(b[i]);
+        
+        return total;
+    }
+    
+    // sum of a[i], accumulated in float
+    template <typename A>
+    float widening_sum(const A* a, std::size_t n) {
+        std::size_t i = 0;
+        float total = 0;
+        
+        if constexpr (widen<A>::enabled) {
+            using S = widening_simd<A>;
+            constexpr std::size_t w = S::width;
+            
+            auto acc0 = S::zero(), acc1 = S::zero(), acc2 = S::zero(), acc3 = S::zero();
+            for (; i + 4 * w <= n; i += 4 * w) {
+                acc0 = S::add(acc0, widen<A>::load(a + i));
+                acc1 = S::add(acc1, widen<A>::load(a + i + w));
+                acc2 = S::add(acc2, widen<A>::load(a + i + 2 * w));
+                acc3 = S::add(acc3, widen<A>::load(a + i + 3 * w));
+            }
+            for (; i + w <= n; i += w)
+                acc0 = S::add(acc0, widen<A>::load(a + i));
+            
+            total = horizontal_sum<float, S>(S::add(S::add(acc0, acc1), S::add(acc2, acc3)));
+        }
+        else {
+            float acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+            for (; i + 4 <= n; i += 4) {
+                acc0 += to_float(a[i]);
+                acc1 += to_float(a[i + 1]);
+                acc2 += to_float(a[i + 2]);
+                acc3 += to_float(a[i + 3]);
+            }
+            
+            total = (acc0 + acc1) + (acc2 + acc3);
+        }
+        
+        for (; i < n; i++)
+            total += to_float(a[i]);
+        
+        return total;
+    }
+    
+    // writes a[i] * scale to out[i]
+    template <typename A>
+    void widen_into(const A* a, std::size_t n, float scale, float* out) {
+        std::size_t i = 0;
+        
+        if constexpr (widen<A>::enabled) {
+            using S = widening_simd<A>;
+            constexpr std::size_t w = S::width;
+            
+            const auto s = S::set1(scale);
+            for (; i + w <= n; i += w)
+                S::store(out + i, S::mul(widen<A>::load(a + i), s));
+        }
+        
+        for (; i < n; i++)
+            out[i] = to_float(a[i]) * scale;
+    }
+    
+    template <>
+    inline float16 reduce_sum(const float16* data, std::size_t n) {
+        return float16(widening_sum(data, n));
+    }
+    
+    template <>
+    inline float16 reduce_dot(const float16* u, const float16* v, std::size_t n) {
+        return float16(widening_dot(u, v, n));
+    }
+    
+    template <>
+    inline bfloat16 reduce_sum(const bfloat16* data, std::size_t n) {
+        return bfloat16(widening_sum(data, n));
+    }
+    
+    template <>
+    inline bfloat16 reduce_dot(const bfloat16* u, const bfloat16* v, std::size_t n) {
+        return bfloat16(widening_dot(u, v, n));
+    }
+    
+    /*
+     Exact dot product of int8 arrays. Products are summed in pairs into
+     32-bit lanes (pmaddwd), which are widened to 64 bits every int8_block
+     elements so that they never overflow.
+    */
+    inline constexpr std::size_t int8_block = 1 << 16;
+    
+    // b == nullptr sums a instead
+    template <bool Dot>
+    std::int64_t int8_reduce(const std::int8_t* a, const std::int8_t* b, std::size_t n) {
+        std::int64_t total = 0;
+        std::size_t i = 0;
+        
+#if !defined(VECTOR_NO_SIMD) && (defined(__AVX512BW__) || defined(__AVX2__) || defined(__SSE2__))
+    #if defined(__AVX512BW__)
+        constexpr std::size_t w = 32;
+        using reg = __m512i;
+        auto widen16 = [](const std::int8_t* p) { return _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))); };
+        auto madd = [](reg x, reg y) { return _mm512_madd_epi16(x, y); };
+        auto add = [](reg x, reg y) { return _mm512_add_epi32(x, y); };
+        const reg ones = _mm512_set1_epi16(1);
+        const reg zero = _mm512_setzero_si512();
+    #elif defined(__AVX2__)
+        constexpr std::size_t w = 16;
+        using reg = __m256i;
+        auto widen16 = [](const std::int8_t* p) { return _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))); };
+        auto madd = [](reg x, reg y) { return _mm256_madd_epi16(x, y); };
+        auto add = [](reg x, reg y) { return _mm256_add_epi32(x, y); };
+        const reg ones = _mm256_set1_epi16(1);
+        const reg zero = _mm256_setzero_si256();
+    #else
+        // 8 elements, sign-extended by unpacking every byte into the top of a 16-bit lane
+        constexpr std::size_t w = 8;
+        using reg = __m128i;
+        auto widen16 = [](const std::int8_t* p) {
+            const __m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+            return _mm_srai_epi16(_mm_unpacklo_epi8(x, x), 8);
+        };
+        auto madd = [](reg x, reg y) { return _mm_madd_epi16(x, y); };
+        auto add = [](reg x, reg y) { return _mm_add_epi32(x, y); };
+        const reg ones = _mm_set1_epi16(1);
+        const reg zero = _mm_setzero_si128();
+    #endif
+        
+        const std::size_t full = n - n % w;
+        while (i < full) {
+            const std::size_t end = std::min(full, i + int8_block);
+            
+            reg acc0 = zero, acc1 = zero;
+            for (; i + 2 * w <= end; i += 2 * w) {
+                acc0 = add(acc0, madd(widen16(a + i), Dot ? widen16(b + i) : ones));
+                acc1 = add(acc1, madd(widen16(a + i + w), Dot ? widen16(b + i + w) : ones));
+            }
+            for (; i < end; i += w)
+                acc0 = add(acc0, madd(widen16(a + i), Dot ? widen16(b + i) : ones));
+            
+            alignas(64) std::int32_t lanes[sizeof(reg) / sizeof(std::int32_t)];
+            std::memcpy(lanes, &acc0, sizeof(reg));
+            for (std::int32_t lane : lanes)
+                total += lane;
+            std::memcpy(lanes, &acc1, sizeof(reg));
+            for (std::int32_t lane : lanes)
+                total += lane;
+        }
+#elif !defined(VECTOR_NO_SIMD) && defined(__ARM_NEON)
+        constexpr std::size_t w = 16;
+        const int8x8_t ones = vdup_n_s8(1);
+        
+        const std::size_t full = n - n % w;
+        while (i < full) {
+            const std::size_t end = std::min(full, i + int8_block);
+            
+            // vmull_s8 products fit in 16 bits, vpadalq_s16 adds them in pairs into 32-bit lanes
+            int32x4_t acc = vdupq_n_s32(0);
+            for (; i < end; i += w) {
+                const int8x16_t x = vld1q_s8(a + i);
+                const int8x16_t y = Dot ? vld1q_s8(b + i) : vcombine_s8(ones, ones);
+                acc = vpadalq_s16(acc, vmull_s8(vget_low_s8(x), vget_low_s8(y)));
+                acc = vpadalq_s16(acc, vmull_s8(vget_high_s8(x), vget_high_s8(y)));
+            }
+            
+            total += std::int64_t(vgetq_lane_s32(acc, 0)) + vgetq_lane_s32(acc, 1) + vgetq_lane_s32(acc, 2) + vgetq_lane_s32(acc, 3);
+        }
+#endif
+        
+        for (; i < n; i++)
+            total += Dot ? std::int32_t(a[i]) * b[i] : a[i];
+        
+        return total;
+    }
+    
+    // out[i] = float16(in[i])
+    inline void narrow(const float* in, std::size_t n, float16* out) {
+        std::size_t i = 0;
+        
+#if !defined(VECTOR_NO_SIMD) && defined(__AVX512F__)
+        for (; i + 16 <= n; i += 16) {
+            const __m256i h = _mm512_cvtps_ph(_mm512_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), h);
+        }
+#elif !defined(VECTOR_NO_SIMD) && defined(__F16C__)
+        for (; i + 8 <= n; i += 8)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+#elif !defined(VECTOR_NO_SIMD) && defined(__ARM_NEON) && defined(__aarch64__)
+        for (; i + 4 <= n; i += 4)
+            vst1_u16(reinterpret_cast<std::uint16_t*>(out + i), vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(in + i))));
+#endif
+        
+        for (; i < n; i++)
+            out[i] = float16(in[i]);
+    }
+    
+    // out[i] = bfloat16(in[i]): adds 0x7fff plus the lowest kept bit, so that ties round to even, and keeps NaN quiet
+    inline void narrow(const float* in, std::size_t n, bfloat16* out) {
+        std::size_t i = 0;
+        
+#if !defined(VECTOR_NO_SIMD) && defined(__AVX512F__)
+        const __m512i bias = _mm512_set1_epi32(0x7fff), one = _mm512_set1_epi32(1);
+        const __m512i abs_mask = _mm512_set1_epi32(0x7fffffff), inf = _mm512_set1_epi32(0x7f800000), quiet = _mm512_set1_epi32(0x400000);
+        
+        for (; i + 16 <= n; i += 16) {
+            const __m512i x = _mm512_castps_si512(_mm512_loadu_ps(in + i));
+            const __m512i lsb = _mm512_and_si512(_mm512_srli_epi32(x, 16), one);
+            const __mmask16 nan = _mm512_cmpgt_epi32_mask(_mm512_and_si512(x, abs_mask), inf);
+            
+            __m512i r = _mm512_add_epi32(x, _mm512_add_epi32(bias, lsb));
+            r = _mm512_mask_blend_epi32(nan, r, _mm512_or_si512(x, quiet));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm512_cvtepi32_epi16(_mm512_srli_epi32(r, 16)));
+        }
+#elif !defined(VECTOR_NO_SIMD) && defined(__AVX2__)
+        const __m256i bias = _mm256_set1_epi32(0x7fff), one = _mm256_set1_epi32(1);
+        const __m256i abs_mask = _mm256_set1_epi32(0x7fffffff), inf = _mm256_set1_epi32(0x7f800000), quiet = _mm256_set1_epi32(0x400000);
+        
+        auto round = [&](const float* p) {
+            const __m256i x = _mm256_castps_si256(_mm256_loadu_ps(p));
+            const __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(x, 16), one);
+            const __m256i nan = _mm256_cmpgt_epi32(_mm256_and_si256(x, abs_mask), inf);
+            
+            const __m256i r = _mm256_add_epi32(x, _mm256_add_epi32(bias, lsb));
+            return _mm256_srli_epi32(_mm256_blendv_epi8(r, _mm256_or_si256(x, quiet), nan), 16);
+        };
+        
+        // packus interleaves the 128-bit lanes of its operands, the permutation puts them back in order
+        for (; i + 16 <= n; i += 16) {
+            const __m256i packed = _mm256_packus_epi32(round(in + i), round(in + i + 8));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permute4x64_epi64(packed, 0xd8));
+        }
+#endif
+        
+        for (; i < n; i++)
+            out[i] = bfloat16(in[i]);
+    }
+    
+    // out[i] = in[i] * inverse_scale rounded to nearest even, which must fit in [-127, 127]
+    inline void quantize(const float* in, std::size_t n, float inverse_scale, std::int8_t* out) {
+        std::size_t i = 0;
+        
+#if !defined(VECTOR_NO_SIMD) && defined(__AVX512F__)
+        const __m512 s = _mm512_set1_ps(inverse_scale);
+        for (; i + 16 <= n; i += 16) {
+            const __m512i q = _mm512_cvtps_epi32(_mm512_mul_ps(_mm512_loadu_ps(in + i), s));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm512_cvtsepi32_epi8(q));
+        }
+#elif !defined(VECTOR_NO_SIMD) && defined(__AVX2__)
+        const __m256 s = _mm256_set1_ps(inverse_scale);
+        auto round = [&](const float* p) { return _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(p), s)); };
+        
+        // the packs interleave the 128-bit lanes, the permutation puts the 32-bit groups back in order
+        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        for (; i + 32 <= n; i += 32) {
+            const __m256i ab = _mm256_packs_epi32(round(in + i), round(in + i + 8));
+            const __m256i cd = _mm256_packs_epi32(round(in + i + 16), round(in + i + 24));
+            const __m256i q = _mm256_permutevar8x32_epi32(_mm256_packs_epi16(ab, cd), order);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), q);
+        }
+#elif !defined(VECTOR_NO_SIMD) && defined(__SSE2__)
+        const __m128 s = _mm_set1_ps(inverse_scale);
+        auto round = [&](const float* p) { return _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(p), s)); };
+        
+        for (; i + 16 <= n; i += 16) {
+            const __m128i ab = _mm_packs_epi32(round(in + i), round(in + i + 4));
+            const __m128i cd = _mm_packs_epi32(round(in + i + 8), round(in + i + 12));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi16(ab, cd));
+        }
+#endif
+        
+        for (; i < n; i++)
+            out[i] = static_cast<std::int8_t>(std::lrint(in[i] * inverse_scale));
+    }
+}
+
+/*
+ Algorithms shared by Vector and the views, written against iterators.
+*/
+namespace vector_detail {
+    /*
+     Element-wise equality of two arrays. Types whose equal values have
+     equal bytes are compared with memcmp; floating point numbers with ==
+     (so NaN != NaN and -0.0 == 0.0), a SIMD register at a time when the
+     lane type supports comparisons.
+    */
+    template <typename T>
+    bool equal_elements(const T* a, const T* b, std::size_t n) {
+        if (n == 0 || a == b) {
+            if constexpr (std::is_floating_point_v<T>)
+                return std::equal(a, a + n, b);
+            return true;
+        }
+        
+        if constexpr (std::has_unique_object_representations_v<T>) {
+            return std::memcmp(a, b, n * sizeof(T)) == 0;
+        } else if constexpr (std::is_floating_point_v<T> && simd_for<T>::has_compare) {
+            using S = simd_for<T>;
+            constexpr unsigned all = (1u << S::width) - 1;
+            std::size_t i = 0;
+            for (; i + 4 * S::width <= n; i += 4 * S::width) {
+                unsigned m0 = S::eq_mask(S::load(a + i), S::load(b + i));
+                unsigned m1 = S::eq_mask(S::load(a + i + S::width), S::load(b + i + S::width));
+                unsigned m2 = S::eq_mask(S::load(a + i + 2 * S::width), S::load(b + i + 2 * S::width));
+                unsigned m3 = S::eq_mask(S::load(a + i + 3 * S::width), S::load(b + i + 3 * S::width));
+                if ((m0 & m1 & m2 & m3) != all)
+                    return false;
+            }
+            for (; i + S::width <= n; i += S::width) {
+                if (S::eq_mask(S::load(a + i), S::load(b + i)) != all)
+                    return false;
+            }
+            
+            return std::equal(a + i, a + n, b + i);
+        } else {
+            return std::equal(a, a + n, b);
+        }
+    }
+    
+    // index of the lowest clear bit of an eq_mask() result that isn't all ones
+    inline std::size_t first_unequal_lane(unsigned mask) {
+        std::size_t lane = 0;
+        for (; mask & 1; mask >>= 1)
+            lane++;
+        
+        return lane;
+    }
+    
+    /*
+     Index of the first element in [from, n) where !(a[i] == b[i]), or n.
+     Compares a SIMD register at a time when the lane type supports it.
+    */
+    template <typename T>
+    std::size_t mismatch_index(const T* a, const T* b, std::size_t n, std::size_t from = 0) {
+        std::size_t i = from;
+        if constexpr (simd_for<T>::has_compare) {
+            using S = simd_for<T>;
+            constexpr unsigned all = (1u << S::width) - 1;
+            for (; i + 4 * S::width <= n; i += 4 * S::width) {
+                unsigned m[4];
+                for (std::size_t k = 0; k < 4; k++)
+                    m[k] = S::eq_mask(S::load(a + i + k * S::width), S::load(b + i + k * S::width));
+                if ((m[0] & m[1] & m[2] & m[3]) != all) {
+                    std::size_t k = 0;
+                    while (m[k] == all)
+                        k++;
+                    return i + k * S::width + first_unequal_lane(m[k]);
+                }
+            }
+            for (; i + S::width <= n; i += S::width) {
+                unsigned m = S::eq_mask(S::load(a + i), S::load(b + i));
+                if (m != all)
+                    return i + first_unequal_lane(m);
+            }
+        }
+        
+        for (; i < n; i++) {
+            if (!(a[i] == b[i]))
+                return i;
+        }
+        
+        return n;
+    }
+    
+    /*
+     Three-way lexicographical comparison: negative if a < b, positive if
+     a > b, 0 otherwise, with the same result as std::lexicographical_compare
+     in both directions (elements that are neither less nor greater, like
+     NaN, are skipped). Unsigned bytes are compared with memcmp; other types
+     jump from one mismatch to the next with mismatch_index().
+    */
+    template <typename T>
+    int compare_elements(const T* a, std::size_t na, const T* b, std::size_t nb) {
+        const std::size_t n = std::min(na, nb);
+        if constexpr (std::is_integral_v<T> && std::is_unsigned_v<T> && sizeof(T) == 1) {
+            int c = n == 0 ? 0 : std::memcmp(a, b, n);
+            if (c != 0)
+                return c < 0 ? -1 : 1;
+        } else {
+            for (std::size_t i = mismatch_index(a, b, n); i < n; i = mismatch_index(a, b, n, i + 1)) {
+                if (a[i] < b[i])
+                    return -1;
+                if (b[i] < a[i])
+                    return 1;
+            }
+        }
+        
+        return na < nb ? -1 : (nb < na ? 1 : 0);
+    }
+    
+    // XXH64 (github.com/Cyan4973/xxHash), over the bytes of the elements
+    inline constexpr std::uint64_t xxh_prime1 = 11400714785074694791ULL;
+    inline constexpr std::uint64_t xxh_prime2 = 14029467366897019727ULL;
+    inline constexpr std::uint64_t xxh_prime3 = 1609587929392839161ULL;
+    inline constexpr std::uint64_t xxh_prime4 = 9650029242287828579ULL;
+    inline constexpr std::uint64_t xxh_prime5 = 2870177450012600261ULL;
+    
+    inline std::uint64_t rotl64(std::uint64_t x, int r) {
+        return (x << r) | (x >> (64 - r));
+    }
+    
+    inline std::uint64_t xxh_round(std::uint64_t acc, std::uint64_t input) {
+        return rotl64(acc + input * xxh_prime2, 31) * xxh_prime1;
+    }
+    
+    inline std::uint64_t xxh_merge(std::uint64_t acc, std::uint64_t value) {
+        return (acc ^ xxh_round(0, value)) * xxh_prime1 + xxh_prime4;
+    }
+    
+    inline std::uint64_t xxh_avalanche(std::uint64_t h) {
+        h ^= h >> 33;
+        h *= xxh_prime2;
+        h ^= h >> 29;
+        h *= xxh_prime3;
+        
+        return h ^ (h >> 32);
+    }
+    
+    // -0.0 is hashed as 0.0, since they compare equal
+    template <typename T>
+    std::uint64_t canonical_word(std::uint64_t word) {
+        if constexpr (std::is_same_v<T, float>) {
+            const auto lo = static_cast<std::uint32_t>(word), hi = static_cast<std::uint32_t>(word >> 32);
+            return (lo == 0x80000000u ? 0 : lo) | (std::uint64_t(hi == 0x80000000u ? 0 : hi) << 32);
+        } else if constexpr (std::is_same_v<T, double>) {
+            return word == 0x8000000000000000ULL ? 0 : word;
+        } else {
+            return word;
+        }
+    }
+    
+    /*
+     64-bit hash of the elements, consistent with equal_elements(): equal
+     arrays have equal hashes. Integers, float and double are hashed as
+     bytes with XXH64, other types combine std::hash of each element.
+     The result is never 0, and depends on the byte order of the machine.
+    */
+    template <typename T>
+    std::uint64_t hash_elements(const T* data, std::size_t n) {
+        std::uint64_t h;
+        
+        if constexpr (std::is_integral_v<T> || std::is_same_v<T, float> || std::is_same_v<T, double>) {
+            const auto* p = reinterpret_cast<const unsigned char*>(data);
+            const std::size_t length = n * sizeof(T);
+            const auto word = [&p]() {
+                std::uint64_t w;
+                std::memcpy(&w, p, 8);
+                p += 8;
+                return canonical_word<T>(w);
+            };
+            
+            std::size_t left = length;
+            if (left >= 32) {
+                std::uint64_t v1 = xxh_prime1 + xxh_prime2, v2 = xxh_prime2, v3 = 0, v4 = 0 - xxh_prime1;
+                for (; left >= 32; left -= 32) {
+                    v1 = xxh_round(v1, word());
+                    v2 = xxh_round(v2, word());
+                    v3 = xxh_round(v3, word());
+                    v4 = xxh_round(v4, word());
+                }
+                
+                h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+                h = xxh_merge(xxh_merge(xxh_merge(xxh_merge(h, v1), v2), v3), v4);
+            } else {
+                h = xxh_prime5;
+            }
+            h += length;
+            
+            for (; left >= 8; left -= 8)
+                h = rotl64(h ^ xxh_round(0, word()), 27) * xxh_prime1 + xxh_prime4;
+            
+            if (left >= 4) {
+                std::uint32_t w;
+                std::memcpy(&w, p, 4);
+                if constexpr (std::is_same_v<T, float>)
+                    w = w == 0x80000000u ? 0 : w;
+                
+                h = rotl64(h ^ (std::uint64_t(w) * xxh_prime1), 23) * xxh_prime2 + xxh_prime3;
+                p += 4;
+                left -= 4;
+            }
+            
+            for (; left > 0; left--, p++)
+                h = rotl64(h ^ (*p * xxh_prime5), 11) * xxh_prime1;
+        } else {
+            h = xxh_prime5 + n;
+            for (std::size_t i = 0; i < n; i++)
+                h = rotl64(h ^ xxh_round(0, std::hash<T>()(data[i])), 27) * xxh_prime1 + xxh_prime4;
+        }
+        
+        h = xxh_avalanche(h);
+        return h ? h : 1;
+    }
+
+    template <typename It>
+    std::ostream& print(std::ostream& os, It first, It last) {
+        os << "[";
+        for (It it = first; it != last; ++it) {
+            if (it != first)
+                os << ", ";
+            os << *it;
+        }
+        os << "]";
+        
+        return os;
+    }
+    
+    // see Vector::max()
+    template <typename It, typename Compare>
+    auto extremum(It first, It last, Compare comp)
+        -> std::variant<typename std::iterator_traits<It>::value_type, std::vector<std::size_t>>
+    {
+        if (first == last)
+            return {};
+        
+        auto best = std::min_element(first, last, comp);
+        
+        if (std::count(first, last, *best) == 1)
+            return static_cast<typename std::iterator_traits<It>::value_type>(std::distance(first, best));
+        else {
+            std::vector<std::size_t> indexes;
+            for (auto it = first; it != last; ++it)
+                if (*it == *best)
+                    indexes.push_back(std::distance(first, it));
+            
+            return indexes;
+        }
+    }
+}
+
+/*
+ Execution policies.
+ 
+ Every reduction and element-wise operation has an overload taking a policy
+ as its first argument, e.g. `v.sum(execution::par)` or
+ `dot_product(execution::par, u, v)`. The parallel policy splits the work
+ into tasks of `grain` elements, run by VectorThreadPool::instance().
+ Vectors smaller than `threshold` elements are processed serially, since
+ waking up the pool costs more than the work itself.
+*/
+namespace execution {
+    struct sequenced_policy {};
+    
+    struct parallel_policy {
+        // elements per task, 0 splits the data into 4 tasks per thread
+        std::size_t grain = 0;
+        // vectors with fewer elements are processed serially
+        std::size_t threshold = std::size_t(1) << 15;
+        
+        constexpr parallel_policy with_grain(std::size_t elements) const {
+            parallel_policy policy = *this;
+            policy.grain = elements;
+            return policy;
+        }
+        
+        constexpr parallel_policy with_threshold(std::size_t elements) const {
+            parallel_policy policy = *this;
+            policy.threshold = elements;
+            return policy;
+        }
+    };
+    
+    inline constexpr sequenced_policy seq{};
+    inline constexpr parallel_policy par{};
+    
+    template <typename T>
+    inline constexpr bool is_execution_policy_v =
+        std::is_same_v<std::decay_t<T>, sequenced_policy> || std::is_same_v<std::decay_t<T>, parallel_policy>;
+}
+
+/*
+ Accumulation policies.
+ 
+ sum(), mean(), magnitude() and dot_product() take one to choose how the
+ elements are added up, e.g. `v.sum(accumulation::kahan)` or
+ `dot_product(execution::par, accumulation::pairwise, u, v)`:
+ 
+ - naive: the default, four SIMD accumulators. The error grows linearly
+   with the number of elements.
+ - pairwise: blocks of 256 elements are summed with the SIMD kernel and
+   the block sums are added pairwise, so the error grows with log(n) at
+   nearly the speed of naive.
+ - kahan: compensated summation in every SIMD lane, the error doesn't
+   grow with n; up to 4 times slower than naive on data in cache.
+ - widened: float is accumulated in double, integers in 64 bits. double
+   has no faster wider type, so it uses kahan.
+ - reproducible: bitwise identical results for any number of threads,
+   grain and threshold, see reproducible_reduce(). Sums are also the same
+   with every SIMD instruction set; dot products only when the compiler
+   doesn't fuse multiplications and additions (-ffp-contract=off), since
+   GCC turns them into FMAs on machines that have them. As accurate as
+   pairwise, and as fast as naive in cache, 10-15% slower from memory.
+ 
+ The policies only change the order and precision of floating point
+ additions; for integers, all but widened are the same as naive.
+*/
+namespace accumulation {
+    struct naive_policy {};
+    struct pairwise_policy {};
+    struct kahan_policy {};
+    struct widened_policy {};
+    struct reproducible_policy {};
+    
+    inline constexpr naive_policy naive{};
+    inline constexpr pairwise_policy pairwise{};
+    inline constexpr kahan_policy kahan{};
+    inline constexpr widened_policy widened{};
+    inline constexpr reproducible_policy reproducible{};
+    
+    template <typename T>
+    inline constexpr bool is_accumulation_policy_v =
+        std::is_same_v<std::decay_t<T>, naive_policy> || std::is_same_v<std::decay_t<T>, pairwise_policy> ||
+        std::is_same_v<std::decay_t<T>, kahan_policy> || std::is_same_v<std::decay_t<T>, widened_policy> ||
+        std::is_same_v<std::decay_t<T>, reproducible_policy>;
+}
+
+namespace vector_detail {
+    template <typename Policy>
+    using if_accumulation = std::enable_if_t<accumulation::is_accumulation_policy_v<Policy>, int>;
+    
+    inline constexpr std::size_t pairwise_block = 256;
+    
+    // block(begin, end) reduces a block of at most pairwise_block elements
+    template <typename T, typename Block>
+    T pairwise(std::size_t begin, std::size_t end, Block block) {
+        const std::size_t n = end - begin;
+        if (n <= pairwise_block)
+            return block(begin, end);
+        
+        // split on a block boundary, so that every block starts at the same alignment
+        const std::size_t half = (n / 2 + pairwise_block - 1) / pairwise_block * pairwise_block;
+        
+        return pairwise<T>(begin, begin + half, block) + pairwise<T>(begin + half, end, block);
+    }
+    
+    // Neumaier's variant of Kahan summation, which is also exact when x is larger than the sum
+    template <typename T>
+    void compensated_add(T& sum, T& compensation, T x) {
+        const T t = sum + x;
+        compensation += std::abs(sum) >= std::abs(x) ? (sum - t) + x : (x - t) + sum;
+        sum = t;
+    }
+    
+    /*
+     Kahan summation of term(i) for i in [0, n). Every SIMD lane keeps its
+     own sum and compensation, the lanes are added up with Neumaier's
+     algorithm at the end. lanes(S(), i) returns the terms i to i + width.
+    */
+    template <typename T, typename Lanes, typename Term>
+    T kahan_reduce(std::size_t n, Lanes lanes, Term term) {
+        std::size_t i = 0;
+        T sum = T(), compensation = T();
+        
+        if constexpr (simd_for<T>::enabled) {
+            using S = simd_for<T>;
+            constexpr std::size_t w = S::width;
+            
+            typename S::reg sums[4] = { S::zero(), S::zero(), S::zero(), S::zero() };
+            typename S::reg errors[4] = { S::zero(), S::zero(), S::zero(), S::zero() };
+            const auto step = [](typename S::reg& s, typename S::reg& c, typename S::reg x) {
+                const auto y = S::sub(x, c);
+                const auto t = S::add(s, y);
+                c = S::sub(S::sub(t, s), y);
+                s = t;
+            };
+            
+            for (; i + 4 * w <= n; i += 4 * w)
+                for (std::size_t k = 0; k < 4; k++)
+                    step(sums[k], errors[k], lanes(S(), i + k * w));
+            for (; i + w <= n; i += w)
+                step(sums[0], errors[0], lanes(S(), i));
+            
+            T sum_lanes[w], error_lanes[w];
+            for (std::size_t k = 0; k < 4; k++) {
+                S::store(sum_lanes, sums[k]);
+                S::store(error_lanes, errors[k]);
+                for (std::size_t j = 0; j < w; j++) {
+                    compensated_add(sum, compensation, sum_lanes[j]);
+                    compensated_add(sum, compensation, -error_lanes[j]);
+                }
+            }
+        }
+        
+        for (; i < n; i++)
+            compensated_add(sum, compensation, term(i));
+        
+        return sum + compensation;
+    }
+    
+    // float is widened to double and integers to 64 bits
+    template <typename T>
+    using widened_t = std::conditional_t<std::is_same_v<T, float>, double,
+                      std::conditional_t<!std::is_integral_v<T>, T,
+                      std::conditional_t<std::is_signed_v<T>, std::int64_t, std::uint64_t>>>;
+    
+    template <typename T, typename Term>
+    T widened_reduce(std::size_t n, Term term) {
+        using W = widened_t<T>;
+        
+        W acc[8] = {};
+        std::size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+            for (std::size_t k = 0; k < 8; k++)
+                acc[k] += term(i + k);
+        for (; i < n; i++)
+            acc[0] += term(i);
+        
+        return static_cast<T>(((acc[0] + acc[1]) + (acc[2] + acc[3])) + ((acc[4] + acc[5]) + (acc[6] + acc[7])));
+    }
+    
+    template <typename Accumulation, typename T>
+    T accumulate_sum(const T* data, std::size_t n) {
+        static_assert(accumulation::is_accumulation_policy_v<Accumulation>, "Accumulation should be one of the accumulation:: policies");
+        constexpr bool compensated = std::is_same_v<Accumulation, accumulation::kahan_policy> ||
+            (std::is_same_v<Accumulation, accumulation::widened_policy> && std::is_same_v<widened_t<T>, T>);
+        
+        if constexpr (!std::is_floating_point_v<T> && !std::is_same_v<Accumulation, accumulation::widened_policy>) {
+            return reduce_sum(data, n);
+        } else if constexpr (std::is_same_v<Accumulation, accumulation::naive_policy>) {
+            return reduce_sum(data, n);
+        } else if constexpr (std::is_same_v<Accumulation, accumulation::pairwise_policy>) {
+            return pairwise<T>(0, n, [data](std::size_t begin, std::size_t end) { return reduce_sum(data + begin, end - begin); });
+        } else if constexpr (compensated) {
+            return kahan_reduce<T>(n, [data](auto s, std::size_t i) { return decltype(s)::load(data + i); },
+                                   [data](std::size_t i) { return data[i]; });
+        } else {
+            static_assert(std::is_same_v<Accumulation, accumulation::widened_policy>, "Reproducible reductions go through sum_of() and dot_of()");
+            return widened_reduce<T>(n, [data](std::size_t i) { return static_cast<widened_t<T>>(data[i]); });
+        }
+    }
+    
+    template <typename Accumulation, typename T>
+    T accumulate_dot(const T* u, const T* v, std::size_t n) {
+        static_assert(accumulation::is_accumulation_policy_v<Accumulation>, "Accumulation should be one of the accumulation:: policies");
+        constexpr bool compensated = std::is_same_v<Accumulation, accumulation::kahan_policy> ||
+            (std::is_same_v<Accumulation, accumulation::widened_policy> && std::is_same_v<widened_t<T>, T>);
+        
+        if constexpr (!std::is_floating_point_v<T> && !std::is_same_v<Accumulation, accumulation::widened_policy>) {
+            return reduce_dot(u, v, n);
+        } else if constexpr (std::is_same_v<Accumulation, accumulation::naive_policy>) {
+            return reduce_dot(u, v, n);
+        } else if constexpr (std::is_same_v<Accumulation, accumulation::pairwise_policy>) {
+            return pairwise<T>(0, n, [u, v](std::size_t begin, std::size_t end) { return reduce_dot(u + begin, v + begin, end - begin); });
+        } else if constexpr (compensated) {
+            return kahan_reduce<T>(n, [u, v](auto s, std::size_t i) { return decltype(s)::mul(decltype(s)::load(u + i), decltype(s)::load(v + i)); },
+                                   [u, v](std::size_t i) { return u[i] * v[i]; });
+        } else {
+            static_assert(std::is_same_v<Accumulation, accumulation::widened_policy>, "Reproducible reductions go through sum_of() and dot_of()");
+            return widened_reduce<T>(n, [u, v](std::size_t i) { return static_cast<widened_t<T>>(u[i]) * static_cast<widened_t<T>>(v[i]); });
+        }
+    }
+}
+
+/*
+ @brief     Fixed set of worker threads shared by all parallel operations.
+ 
+ The pool starts std::thread::hardware_concurrency() threads, or the number
+ given by the VECTOR_NUM_THREADS environment variable. The thread calling
+ run() takes part in the work, so size() counts it as well.
+ 
+ Only one job runs at a time: run() called while the pool is busy, or from
+ inside a task, executes its tasks serially on the calling thread instead
+ of waiting.
+*/
+class VectorThreadPool {
+public:
+    explicit VectorThreadPool(std::size_t threads);
+    ~VectorThreadPool();
+    
+    VectorThreadPool(const VectorThreadPool&) = delete;
+    VectorThreadPool& operator=(const VectorThreadPool&) = delete;
+    
+    static VectorThreadPool& instance();
+    
+    std::size_t size() const;
+    void resize(std::size_t);
+    
+    template <typename F>
+    void run(std::size_t, F&&);
+
+private:
+    void start(std::size_t);
+    void stop();
+    void worker();
+    void execute();
+    
+    static bool& inside_task();
+    
+    std::vector<std::thread> workers_;
+    std::atomic<std::size_t> size_{1};
+    
+    std::mutex run_mutex_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable finished_;
+    
+    // the current job, published under mutex_ together with generation_
+    void (*invoke_)(void*, std::size_t) = nullptr;
+    void* context_ = nullptr;
+    std::size_t tasks_ = 0;
+    std::atomic<std::size_t> next_{0};
+    std::atomic<std::size_t> done_{0};
+    std::size_t active_ = 0;
+    std::uint64_t generation_ = 0;
+    std::exception_ptr error_;
+    bool stopping_ = false;
+};
+
+inline VectorThreadPool::VectorThreadPool(std::size_t threads) {
+    start(threads);
+}
+
+inline VectorThreadPool::~VectorThreadPool() {
+    stop();
+}
+
+inline VectorThreadPool& VectorThreadPool::instance() {
+    static VectorThreadPool pool([] {
+        if (const char* env = std::getenv("VECTOR_NUM_THREADS")) {
+            const long threads = std::strtol(env, nullptr, 10);
+            if (threads > 0)
+                return static_cast<std::size_t>(threads);
+        }
+        
+        return static_cast<std::size_t>(std::max(1u, std::thread::hardware_concurrency()));
+    }());
+    
+    return pool;
+}
+
+inline std::size_t VectorThreadPool::size() const {
+    return size_.load(std::memory_order_relaxed);
+}
+
+// waits for the running job, if any, and restarts the pool with `threads` threads
+inline void VectorThreadPool::resize(std::size_t threads) {
+    std::lock_guard<std::mutex> run_lock(run_mutex_);
+    stop();
+    start(threads);
+}
+
+/*
+ @brief         Calls f(i) for every i in [0, tasks) and waits for all of them.
+ 
+ The first exception thrown by a task is rethrown here, once every task
+ has finished.
+*/
+template <typename F>
+void VectorThreadPool::run(std::size_t tasks, F&& f) {
+    std::unique_lock<std::mutex> run_lock(run_mutex_, std::defer_lock);
+    if (tasks < 2 || inside_task() || !run_lock.try_lock() || workers_.empty()) {
+        for (std::size_t i = 0; i < tasks; i++)
+            f(i);
+        return;
+    }
+    
+    using Fn = std::remove_reference_t<F>;
+    {
+        // workers still leaving the previous job may read its fields
+        std::unique_lock<std::mutex> lock(mutex_);
+        finished_.wait(lock, [this] { return active_ == 0; });
+        
+        invoke_ = [](void* context, std::size_t i) { (*static_cast<Fn*>(context))(i); };
+        context_ = const_cast<void*>(static_cast<const void*>(std::addressof(f)));
+        tasks_ = tasks;
+        next_.store(0, std::memory_order_relaxed);
+        done_.store(0, std::memory_order_relaxed);
+        error_ = nullptr;
+        generation_++;
+    }
+    wake_.notify_all();
+    
+    inside_task() = true;
+    execute();
+    inside_task() = false;
+    
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_.wait(lock, [this] { return done_.load() == tasks_ && active_ == 0; });
+    
+    if (error_)
+        std::rethrow_exception(error_);
+}
+
+inline void VectorThreadPool::start(std::size_t threads) {
+    threads = std::max<std::size_t>(threads, 1);
+    stopping_ = false;
+    
+    for (std::size_t i = 1; i < threads; i++)
+        workers_.emplace_back([this] { worker(); });
+    
+    size_.store(threads, std::memory_order_relaxed);
+}
+
+inline void VectorThreadPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    
+    for (auto& thread : workers_)
+        thread.join();
+    
+    workers_.clear();
+    size_.store(1, std::memory_order_relaxed);
+}
+
+inline void VectorThreadPool::worker() {
+    inside_task() = true;
+    
+    std::uint64_t seen;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        seen = generation_;
+    }
+    
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+            if (stopping_)
+                return;
+            
+            seen = generation_;
+            active_++;
+        }
+        
+        execute();
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            active_--;
+        }
+        finished_.notify_all();
+    }
+}
+
+inline void VectorThreadPool::execute() {
+    for (;;) {
+        const std::size_t i = next_.fetch_add(1);
+        if (i >= tasks_)
+            return;
+        
+        try {
+            invoke_(context_, i);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_)
+                error_ = std::current_exception();
+        }
+        
+        if (done_.fetch_add(1) + 1 == tasks_) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            finished_.notify_all();
+        }
+    }
+}
+
+inline bool& VectorThreadPool::inside_task() {
+    thread_local bool inside = false;
+    return inside;
+}
+
+/*
+ Building blocks of the parallel operations. Work is split into tasks
+ of `grain` consecutive elements; per-task results are combined in task
+ order.
+*/
+namespace vector_detail {
+    // number of elements per task for `n` elements, or 0 to run serially
+    inline std::size_t parallel_grain(const execution::parallel_policy& policy, std::size_t n) {
+        const std::size_t threads = VectorThreadPool::instance().size();
+        if (n == 0 || n < policy.threshold || threads < 2)
+            return 0;
+        
+        if (policy.grain)
+            return policy.grain;
+        
+        constexpr std::size_t min_grain = 4096;
+        return std::max(min_grain, (n + 4 * threads - 1) / (4 * threads));
+    }
+    
+    /*
+     Calls chunk(begin, end) on consecutive ranges covering [0, n).
+    */
+    template <typename Policy, typename Chunk>
+    void for_each_chunk(const Policy& policy, std::size_t n, Chunk chunk) {
+        static_assert(execution::is_execution_policy_v<Policy>, "Policy should be execution::seq or execution::par");
+        
+        std::size_t grain = 0;
+        if constexpr (std::is_same_v<Policy, execution::parallel_policy>)
+            grain = parallel_grain(policy, n);
+        
+        if (grain == 0) {
+            chunk(std::size_t(0), n);
+            return;
+        }
+        
+        const std::size_t tasks = (n + grain - 1) / grain;
+        VectorThreadPool::instance().run(tasks, [&](std::size_t task) {
+            const std::size_t begin = task * grain;
+            chunk(begin, std::min(n, begin + grain));
+        });
+    }
+    
+    /*
+     Calls chunk(begin, end) on consecutive ranges of rows covering
+     [0, rows), sized so that every task gets about `grain` elements.
+    */
+    template <typename Policy, typename Chunk>
+    void for_each_row_chunk(const Policy& policy, std::size_t rows, std::size_t dim, Chunk chunk) {
+        static_assert(execution::is_execution_policy_v<Policy>, "Policy should be execution::seq or execution::par");
+        
+        std::size_t grain = 0;
+        if constexpr (std::is_same_v<Policy, execution::parallel_policy>)
+            grain = parallel_grain(policy, rows * std::max<std::size_t>(dim, 1));
+        
+        if (grain == 0) {
+            chunk(std::size_t(0), rows);
+            return;
+        }
+        
+        const std::size_t per_task = std::max<std::size_t>(1, grain / std::max<std::size_t>(dim, 1));
+        const std::size_t tasks = (rows + per_task - 1) / per_task;
+        VectorThreadPool::instance().run(tasks, [&](std::size_t task) {
+            const std::size_t begin = task * per_task;
+            chunk(begin, std::min(rows, begin + per_task));
+        });
+    }
+    
+    /*
+     Reduces [0, n) with chunk(begin, end) -> R on every range, and combines
+     the partial results left to right.
+    */
+    template <typename Policy, typename Chunk, typename Combine>
+    auto reduce_chunks(const Policy& policy, std::size_t n, Chunk chunk, Combine combine) {
+        static_assert(execution::is_execution_policy_v<Policy>, "Policy should be execution::seq or execution::par");
+        using R = decltype(chunk(std::size_t(0), n));
+        
+        std::size_t grain = 0;
+        if constexpr (std::is_same_v<Policy, execution::parallel_policy>)
+            grain = parallel_grain(policy, n);
+        
+        if (grain == 0)
+            return chunk(std::size_t(0), n);
+        
+        const std::size_t tasks = (n + grain - 1) / grain;
+        std::vector<std::optional<R>> partials(tasks);
+        
+        VectorThreadPool::instance().run(tasks, [&](std::size_t task) {
+            const std::size_t begin = task * grain;
+            partials[task].emplace(chunk(begin, std::min(n, begin + grain)));
+        });
+        
+        R total = std::move(*partials[0]);
+        for (std::size_t i = 1; i < tasks; i++)
+            total = combine(std::move(total), std::move(*partials[i]));
+        
+        return total;
+    }
+    
+    /*
+     Reproducible reductions: the data is cut into blocks of
+     reproducible_block elements, whatever the number of threads, and every
+     block is reduced into 16 lanes, whatever the SIMD width. The block
+     results are added in a fixed tree, so the tasks only decide who
+     computes a block, never the order of the additions.
+    */
+    inline constexpr std::size_t reproducible_block = 1 << 12;
+    inline constexpr std::size_t reproducible_lanes = 16;
+    
+    // adds values[0, n) in a tree that only depends on n
+    template <typename T>
+    T tree_sum(const T* values, std::size_t n) {
+        if (n == 1)
+            return values[0];
+        
+        const std::size_t half = (n + 1) / 2;
+        return tree_sum(values, half) + tree_sum(values + half, n - half);
+    }
+    
+    // lane(S(), i) returns the terms i to i + S::width, term(i) the scalar term i
+    template <typename T, typename Lanes, typename Term>
+    T reproducible_block_sum(std::size_t n, Lanes lanes, Term term) {
+        T acc[reproducible_lanes] = {};
+        std::size_t i = 0;
+        
+        if constexpr (simd_for<T>::enabled) {
+            using S = simd_for<T>;
+            static_assert(reproducible_lanes % S::width == 0, "The SIMD width must divide the number of lanes");
+            constexpr std::size_t regs = reproducible_lanes / S::width;
+            
+            typename S::reg sums[regs];
+            for (std::size_t r = 0; r < regs; r++)
+                sums[r] = S::zero();
+            
+            for (; i + reproducible_lanes <= n; i += reproducible_lanes)
+                for (std::size_t r = 0; r < regs; r++)
+                    sums[r] = S::add(sums[r], lanes(S(), i + r * S::width));
+            
+            for (std::size_t r = 0; r < regs; r++)
+                S::store(acc + r * S::width, sums[r]);
+        }
+        
+        // the same lanes as the SIMD loop: element i always goes to lane i % 16
+        for (; i < n; i++)
+            acc[i % reproducible_lanes] += term(i);
+        
+        return tree_sum(acc, reproducible_lanes);
+    }
+    
+    // block(begin, end) reduces one block
+    template <typename T, typename Policy, typename Block>
+    T reproducible_reduce(const Policy& policy, std::size_t n, Block block) {
+        const std::size_t blocks = (n + reproducible_block - 1) / reproducible_block;
+        if (blocks <= 1)
+            return block(std::size_t(0), n);
+        
+        std::vector<T> partials(blocks);
+        for_each_row_chunk(policy, blocks, reproducible_block, [&](std::size_t first, std::size_t last) {
+            for (std::size_t b = first; b < last; b++)
+                partials[b] = block(b * reproducible_block, std::min(n, (b + 1) * reproducible_block));
+        });
+        
+        return tree_sum(partials.data(), blocks);
+    }
+    
+    // sum of data[0, n) with the given execution and accumulation policies
+    template <typename Accumulation, typename Policy, typename T>
+    T sum_of(const Policy& policy, const T* data, std::size_t n) {
+        if constexpr (std::is_same_v<Accumulation, accumulation::reproducible_policy> && std::is_floating_point_v<T>) {
+            return reproducible_reduce<T>(policy, n, [data](std::size_t begin, std::size_t end) {
+                return reproducible_block_sum<T>(end - begin, [p = data + begin](auto s, std::size_t i) { return decltype(s)::load(p + i); },
+                                                 [p = data + begin](std::size_t i) { return p[i]; });
+            });
+        } else {
+            return reduce_chunks(policy, n, [data](std::size_t begin, std::size_t end) {
+                return accumulate_sum<Accumulation>(data + begin, end - begin);
+            }, std::plus<>());
+        }
+    }
+    
+    // the products are never fused into the additions, so that every SIMD width rounds them the same way
+    template <typename Accumulation, typename Policy, typename T>
+    T dot_of(const Policy& policy, const T* u, const T* v, std::size_t n) {
+        if constexpr (std::is_same_v<Accumulation, accumulation::reproducible_policy> && std::is_floating_point_v<T>) {
+            return reproducible_reduce<T>(policy, n, [u, v](std::size_t begin, std::size_t end) {
+                const T* a = u + begin;
+                const T* b = v + begin;
+                return reproducible_block_sum<T>(end - begin, [a, b](auto s, std::size_t i) {
+                    using S = decltype(s);
+                    return S::mul(S::load(a + i), S::load(b + i));
+                }, [a, b](std::size_t i) { return a[i] * b[i]; });
+            });
+        } else {
+            return reduce_chunks(policy, n, [u, v](std::size_t begin, std::size_t end) {
+                return accumulate_dot<Accumulation>(u + begin, v + begin, end - begin);
+            }, std::plus<>());
+        }
+    }
+    
+    /*
+     Scratch storage for algorithms that must not reorder the data they
+     select from. Every thread has one buffer per element type, which keeps
+     its capacity between calls, so repeated medians or quantiles of windows
+     of similar size don't allocate after the first one.
+    */
+    template <typename T>
+    std::vector<T>& scratch_arena() {
+        thread_local std::vector<T> arena;
+        return arena;
+    }
+    
+    /*
+     Multi-select: places the elements of the given ranks (sorted, unique)
+     where they would be if [begin, end) was sorted. Every nth_element
+     (introselect) only partitions the part between the neighbouring
+     ranks already in place, so k ranks cost about log(k) passes, not k.
+    */
+    template <typename T>
+    void select_in_place(T* data, std::size_t begin, std::size_t end, const std::size_t* first, const std::size_t* last) {
+        while (first != last) {
+            const std::size_t* middle = first + (last - first) / 2;
+            std::nth_element(data + begin, data + *middle, data + end);
+            
+            select_in_place(data, begin, *middle, first, middle);
+            begin = *middle + 1;
+            first = middle + 1;
+        }
+    }
+    
+    // ranks are sorted and unique, see the parallel version below
+    template <typename T>
+    void select_ranks(const execution::sequenced_policy&, const T* data, std::size_t n,
+                      const std::size_t* ranks, std::size_t count, T* out)
+    {
+        auto& scratch = scratch_arena<T>();
+        scratch.assign(data, data + n);
+        
+        select_in_place(scratch.data(), 0, n, ranks, ranks + count);
+        for (std::size_t r = 0; r < count; r++)
+            out[r] = scratch[ranks[r]];
+    }
+    
+    /*
+     Finds the elements of the given ranks (0-based, ascending) without
+     reordering the data, as if it was sorted.
+     
+     Parallel sample select: sorted samples split the value range into
+     buckets, one parallel pass counts the elements of every bucket, another
+     one gathers the buckets holding the requested ranks, and each of those
+     (about n / buckets elements) is finished off with nth_element.
+    */
+    template <typename T>
+    void select_ranks(const execution::parallel_policy& policy, const T* data, std::size_t n,
+                      const std::size_t* ranks, std::size_t count, T* out)
+    {
+        const std::size_t grain = parallel_grain(policy, n);
+        if (grain == 0)
+            return select_ranks(execution::seq, data, n, ranks, count, out);
+        
+        const std::size_t tasks = (n + grain - 1) / grain;
+        
+        // evenly spaced samples, so the result doesn't depend on randomness
+        const std::size_t sample_count = std::min(n, 64 * tasks);
+        std::vector<T> splitters(sample_count);
+        for (std::size_t i = 0; i < sample_count; i++)
+            splitters[i] = data[i * (n / sample_count)];
+        
+        std::sort(splitters.begin(), splitters.end());
+        splitters.erase(std::unique(splitters.begin(), splitters.end()), splitters.end());
+        
+        const std::size_t max_buckets = 4 * tasks;
+        if (splitters.size() > max_buckets) {
+            std::vector<T> picked(max_buckets - 1);
+            for (std::size_t i = 0; i + 1 < max_buckets; i++)
+                picked[i] = splitters[(i + 1) * splitters.size() / max_buckets];
+            splitters = std::move(picked);
+        }
+        
+        const std::size_t buckets = splitters.size() + 1;
+        auto bucket_of = [&](const T& x) {
+            return std::size_t(std::upper_bound(splitters.begin(), splitters.end(), x) - splitters.begin());
+        };
+        
+        std::vector<std::size_t> histograms(tasks * buckets, 0);
+        VectorThreadPool::instance().run(tasks, [&](std::size_t task) {
+            std::size_t* histogram = histograms.data() + task * buckets;
+            for (std::size_t i = task * grain; i < std::min(n, (task + 1) * grain); i++)
+                histogram[bucket_of(data[i])]++;
+        });
+        
+        // bucket holding every rank, and the rank inside of that bucket
+        std::vector<std::size_t> bucket_start(buckets + 1, 0);
+        for (std::size_t b = 0; b < buckets; b++) {
+            std::size_t total = 0;
+            for (std::size_t t = 0; t < tasks; t++)
+                total += histograms[t * buckets + b];
+            bucket_start[b + 1] = bucket_start[b] + total;
+        }
+        
+        std::vector<std::size_t> wanted;
+        for (std::size_t r = 0; r < count; r++) {
+            const std::size_t b = std::upper_bound(bucket_start.begin(), bucket_start.end(), ranks[r]) - bucket_start.begin() - 1;
+            if (wanted.empty() || wanted.back() != b)
+                wanted.push_back(b);
+        }
+        
+        // every task writes its elements of the wanted buckets at precomputed offsets
+        std::vector<std::vector<T>> gathered(wanted.size());
+        std::vector<std::size_t> offsets(tasks * wanted.size());
+        for (std::size_t w = 0; w < wanted.size(); w++) {
+            gathered[w].resize(bucket_start[wanted[w] + 1] - bucket_start[wanted[w]]);
+            
+            std::size_t offset = 0;
+            for (std::size_t t = 0; t < tasks; t++) {
+                offsets[t * wanted.size() + w] = offset;
+                offset += histograms[t * buckets + wanted[w]];
+            }
+        }
+        
+        VectorThreadPool::instance().run(tasks, [&](std::size_t task) {
+            std::size_t* offset = offsets.data() + task * wanted.size();
+            for (std::size_t i = task * grain; i < std::min(n, (task + 1) * grain); i++) {
+                const std::size_t b = bucket_of(data[i]);
+                const auto it = std::lower_bound(wanted.begin(), wanted.end(), b);
+                if (it != wanted.end() && *it == b) {
+                    const std::size_t w = it - wanted.begin();
+                    gathered[w][offset[w]++] = data[i];
+                }
+            }
+        });
+        
+        for (std::size_t r = 0; r < count; r++) {
+            const std::size_t b = std::upper_bound(bucket_start.begin(), bucket_start.end(), ranks[r]) - bucket_start.begin() - 1;
+            auto& bucket = gathered[std::lower_bound(wanted.begin(), wanted.end(), b) - wanted.begin()];
+            
+            const std::size_t local = ranks[r] - bucket_start[b];
+            std::nth_element(bucket.begin(), bucket.begin() + local, bucket.end());
+            out[r] = bucket[local];
+        }
+    }
+    
+    template <typename Policy, typename T>
+    T median_of(const Policy& policy, const T* data, std::size_t n) {
+        if (n == 0)
+            throw std::length_error("Cannot calculate median of an empty vector");
+        
+        const std::size_t ranks[] = { (n - 1) / 2, n / 2 };
+        T middles[2];
+        
+        select_ranks(policy, data, n, ranks, (n & 1) ? 1 : 2, middles);
+        
+        if (n & 1)
+            return middles[0];
+        
+        return (middles[0] + middles[1]) / 2;
+    }
+    
+    // median of a range that isn't contiguous, selected in the scratch arena
+    template <typename It>
+    auto median_of(It first, It last) -> typename std::iterator_traits<It>::value_type {
+        using T = typename std::iterator_traits<It>::value_type;
+        
+        auto& scratch = scratch_arena<T>();
+        scratch.assign(first, last);
+        
+        const std::size_t n = scratch.size();
+        if (n == 0)
+            throw std::length_error("Cannot calculate median of an empty vector");
+        
+        const std::size_t ranks[] = { (n - 1) / 2, n / 2 };
+        select_in_place(scratch.data(), 0, n, ranks, ranks + ((n & 1) ? 1 : 2));
+        
+        return (n & 1) ? scratch[ranks[0]] : (scratch[ranks[0]] + scratch[ranks[1]]) / 2;
+    }
+    
+    // position of a quantile between two ranks of the sorted data
+    struct quantile_rank {
+        std::size_t lower;
+        std::size_t upper;
+        double weight;
+    };
+    
+    // linear interpolation between the closest ranks, as numpy's default method
+    inline quantile_rank rank_of(double p, std::size_t n) {
+        if (!(p >= 0 && p <= 1))
+            throw std::invalid_argument("Quantile must be in [0, 1]");
+        
+        const double h = p * (n - 1);
+        const std::size_t lower = std::min(static_cast<std::size_t>(h), n - 1);
+        
+        return { lower, std::min(lower + 1, n - 1), h - lower };
+    }
+    
+    template <typename T>
+    T interpolate(const T& lower, const T& upper, double weight) {
+        if (weight == 0)
+            return lower;
+        
+        if constexpr (std::is_floating_point_v<T>)
+            return lower + static_cast<T>(weight) * (upper - lower);
+        else
+            return static_cast<T>(lower + weight * (static_cast<double>(upper) - static_cast<double>(lower)));
+    }
+    
+    template <typename Policy, typename T>
+    T quantile_of(const Policy& policy, const T* data, std::size_t n, double p) {
+        if (n == 0)
+            throw std::length_error("Cannot calculate quantile of an empty vector");
+        
+        const quantile_rank position = rank_of(p, n);
+        const std::size_t ranks[] = { position.lower, position.upper };
+        T values[2];
+        
+        select_ranks(policy, data, n, ranks, position.weight == 0 ? 1 : 2, values);
+        
+        return position.weight == 0 ? values[0] : interpolate(values[0], values[1], position.weight);
+    }
+    
+    /*
+     Quantiles of the probabilities in [pfirst, plast), written to out in
+     the same order. All the ranks they need are selected together.
+    */
+    template <typename Policy, typename T, typename InputIt, typename OutputIt>
+    OutputIt quantiles_of(const Policy& policy, const T* data, std::size_t n, InputIt pfirst, InputIt plast, OutputIt out) {
+        if (n == 0)
+            throw std::length_error("Cannot calculate quantile of an empty vector");
+        
+        std::vector<quantile_rank> positions;
+        std::vector<std::size_t> ranks;
+        for (; pfirst != plast; ++pfirst) {
+            positions.push_back(rank_of(*pfirst, n));
+            ranks.push_back(positions.back().lower);
+            if (positions.back().weight != 0)
+                ranks.push_back(positions.back().upper);
+        }
+        
+        std::sort(ranks.begin(), ranks.end());
+        ranks.erase(std::unique(ranks.begin(), ranks.end()), ranks.end());
+        
+        std::vector<T> values(ranks.size());
+        select_ranks(policy, data, n, ranks.data(), ranks.size(), values.data());
+        
+        auto value_of = [&](std::size_t rank) -> const T& {
+            return values[std::lower_bound(ranks.begin(), ranks.end(), rank) - ranks.begin()];
+        };
+        
+        for (const auto& position : positions)
+            *out++ = position.weight == 0 ? value_of(position.lower)
+                                          : interpolate(value_of(position.lower), value_of(position.upper), position.weight);
+        
+        return out;
+    }
+}
+
+/*
+ Index-tracking extrema.
+ 
+ The data is scanned in blocks small enough to stay in L1: the extreme
+ values of a block are found with SIMD min/max, and the block is searched
+ for the index only when it improves on the best value so far, which is
+ rare past the first few blocks. The index is always the first one among
+ equal values. The result is unspecified when the data contains NaNs.
+*/
+template <typename T>
+struct IndexedValue {
+    T value;
+    std::size_t index;
+};
+
+template <typename T>
+struct MinMax {
+    IndexedValue<T> min;
+    IndexedValue<T> max;
+};
+
+/*
+ @brief     Statistics of a vector computed in a single pass, see Vector::describe().
+ 
+ variance() is derived from the two sums and loses precision when the mean
+ is large compared with the spread; RunningStats computes it robustly.
+*/
+template <typename T>
+struct Summary {
+    std::size_t count;
+    T sum;
+    T sum_of_squares;
+    IndexedValue<T> min;
+    IndexedValue<T> max;
+    
+    T mean() const { return sum / static_cast<T>(count); }
+    T variance() const { return std::max(T(), sum_of_squares / static_cast<T>(count) - mean() * mean()); }
+    T magnitude() const { return static_cast<T>(std::sqrt(sum_of_squares)); }
+};
+
+namespace vector_detail {
+    // signed integer lanes would compare unsigned elements wrongly
+    template <typename T>
+    inline constexpr bool simd_minmax_v = simd_for<T>::has_minmax && (std::is_floating_point_v<T> || std::is_signed_v<T>);
+    
+    // smallest and largest value of the n > 0 elements
+    template <typename T, bool WantMin, bool WantMax>
+    void block_extrema(const T* data, std::size_t n, T& lo, T& hi) {
+        std::size_t i = 0;
+        lo = hi = data[0];
+        
+        if constexpr (simd_minmax_v<T>) {
+            using S = simd_for<T>;
+            constexpr std::size_t w = S::width;
+            
+            if (n >= 2 * w) {
+                auto lo0 = S::load(data), lo1 = S::load(data + w);
+                auto hi0 = lo0, hi1 = lo1;
+                
+                for (i = 2 * w; i + 2 * w <= n; i += 2 * w) {
+                    const auto x0 = S::load(data + i), x1 = S::load(data + i + w);
+                    if constexpr (WantMin) {
+                        lo0 = S::min(lo0, x0);
+                        lo1 = S::min(lo1, x1);
+                    }
+                    if constexpr (WantMax) {
+                        hi0 = S::max(hi0, x0);
+                        hi1 = S::max(hi1, x1);
+                    }
+                }
+                
+                simd_lane_t<T> lanes[w];
+                if constexpr (WantMin) {
+                    S::store(lanes, S::min(lo0, lo1));
+                    lo = static_cast<T>(*std::min_element(lanes, lanes + w));
+                }
+                if constexpr (WantMax) {
+                    S::store(lanes, S::max(hi0, hi1));
+                    hi = static_cast<T>(*std::max_element(lanes, lanes + w));
+                }
+            }
+        }
+        
+        for (; i < n; i++) {
+            if constexpr (WantMin)
+                lo = data[i] < lo ? data[i] : lo;
+            if constexpr (WantMax)
+                hi = hi < data[i] ? data[i] : hi;
+        }
+    }
+    
+    inline constexpr std::size_t extrema_block = 512;
+    
+    // bytes at the end of a vector that Vector::normalize() expects to find in cache
+    inline constexpr std::size_t normalize_tail = 1 << 20;
+    
+    template <typename T, bool WantMin, bool WantMax>
+    MinMax<T> scan_extrema(const T* data, std::size_t n, std::size_t offset = 0) {
+        MinMax<T> best = { { data[0], offset }, { data[0], offset } };
+        
+        for (std::size_t start = 0; start < n; start += extrema_block) {
+            const std::size_t len = std::min(extrema_block, n - start);
+            const T* block = data + start;
+            
+            T lo, hi;
+            block_extrema<T, WantMin, WantMax>(block, len, lo, hi);
+            
+            if (WantMin && lo < best.min.value)
+                best.min = { lo, offset + start + std::size_t(std::find(block, block + len, lo) - block) };
+            if (WantMax && best.max.value < hi)
+                best.max = { hi, offset + start + std::size_t(std::find(block, block + len, hi) - block) };
+        }
+        
+        return best;
+    }
+    
+    template <typename Policy, typename T, bool WantMin, bool WantMax>
+    MinMax<T> extrema(const Policy& policy, const T* data, std::size_t n) {
+        if (n == 0)
+            throw std::length_error("Cannot find extrema of an empty vector");
+        
+        // partial results are combined left to right, so ties keep the first index
+        return reduce_chunks(policy, n, [data](std::size_t begin, std::size_t end) {
+            return scan_extrema<T, WantMin, WantMax>(data + begin, end - begin, begin);
+        }, [](MinMax<T> a, const MinMax<T>& b) {
+            if (b.min.value < a.min.value)
+                a.min = b.min;
+            if (a.max.value < b.max.value)
+                a.max = b.max;
+            return a;
+        });
+    }
+    
+    // sum, sum of squares, smallest and largest value of the n > 0 elements
+    template <typename T>
+    void block_summary(const T* data, std::size_t n, T& sum, T& squares, T& lo, T& hi) {
+        std::size_t i = 0;
+        sum = squares = T();
+        lo = hi = data[0];
+        
+        if constexpr (simd_minmax_v<T> && simd_for<T>::has_mul) {
+            using S = simd_for<T>;
+            constexpr std::size_t w = S::width;
+            
+            if (n >= 2 * w) {
+                auto x0 = S::load(data), x1 = S::load(data + w);
+                auto sum0 = x0, sum1 = x1;
+                auto sq0 = S::mul(x0, x0), sq1 = S::mul(x1, x1);
+                auto lo0 = x0, lo1 = x1, hi0 = x0, hi1 = x1;
+                
+                for (i = 2 * w; i + 2 * w <= n; i += 2 * w) {
+                    x0 = S::load(data + i);
+                    x1 = S::load(data + i + w);
+                    sum0 = S::add(sum0, x0);
+                    sum1 = S::add(sum1, x1);
+                    sq0 = S::fma(x0, x0, sq0);
+                    sq1 = S::fma(x1, x1, sq1);
+                    lo0 = S::min(lo0, x0);
+                    lo1 = S::min(lo1, x1);
+                    hi0 = S::max(hi0, x0);
+                    hi1 = S::max(hi1, x1);
+                }
+                
+                simd_lane_t<T> lanes[w];
+                S::store(lanes, S::add(sum0, sum1));
+                sum = static_cast<T>(std::accumulate(lanes, lanes + w, simd_lane_t<T>()));
+                S::store(lanes, S::add(sq0, sq1));
+                squares = static_cast<T>(std::accumulate(lanes, lanes + w, simd_lane_t<T>()));
+                S::store(lanes, S::min(lo0, lo1));
+                lo = static_cast<T>(*std::min_element(lanes, lanes + w));
+                S::store(lanes, S::max(hi0, hi1));
+                hi = static_cast<T>(*std::max_element(lanes, lanes + w));
+            }
+        }
+        
+        for (; i < n; i++) {
+            sum += data[i];
+            squares += data[i] * data[i];
+            lo = data[i] < lo ? data[i] : lo;
+            hi = hi < data[i] ? data[i] : hi;
+        }
+    }
+    
+    // scan_extrema() that also sums the elements and their squares
+    template <typename T>
+    Summary<T> scan_summary(const T* data, std::size_t n, std::size_t offset = 0) {
+        Summary<T> total = { n, T(), T(), { data[0], offset }, { data[0], offset } };
+        
+        for (std::size_t start = 0; start < n; start += extrema_block) {
+            const std::size_t len = std::min(extrema_block, n - start);
+            const T* block = data + start;
+            
+            T sum, squares, lo, hi;
+            block_summary(block, len, sum, squares, lo, hi);
+            total.sum += sum;
+            total.sum_of_squares += squares;
+            
+            if (lo < total.min.value)
+                total.min = { lo, offset + start + std::size_t(std::find(block, block + len, lo) - block) };
+            if (total.max.value < hi)
+                total.max = { hi, offset + start + std::size_t(std::find(block, block + len, hi) - block) };
+        }
+        
+        return total;
+    }
+    
+    template <typename Policy, typename T>
+    Summary<T> summary(const Policy& policy, const T* data, std::size_t n) {
+        if (n == 0)
+            throw std::length_error("Cannot describe an empty vector");
+        
+        return reduce_chunks(policy, n, [data](std::size_t begin, std::size_t end) {
+            return scan_summary(data + begin, end - begin, begin);
+        }, [](Summary<T> a, const Summary<T>& b) {
+            a.count += b.count;
+            a.sum += b.sum;
+            a.sum_of_squares += b.sum_of_squares;
+            if (b.min.value < a.min.value)
+                a.min = b.min;
+            if (a.max.value < b.max.value)
+                a.max = b.max;
+            return a;
+        });
+    }
+    
+    // writes the indexes of all elements equal to value
+    template <typename T, typename OutputIt>
+    OutputIt indexes_of(const T* data, std::size_t begin, std::size_t end, const T& value, OutputIt out) {
+        for (std::size_t i = begin; i < end; i++)
+            if (data[i] == value)
+                *out++ = i;
+        
+        return out;
+    }
+    
+    /*
+     Parallel form of indexes_of(): counts the matches of every task, then
+     every task writes its own matches at their final position. At most
+     `capacity` indexes are written, the total count is returned.
+    */
+    template <typename Policy, typename T>
+    std::size_t indexes_of(const Policy& policy, const T* data, std::size_t n, const T& value,
+                           std::size_t* buffer, std::size_t capacity)
+    {
+        std::size_t grain = 0;
+        if constexpr (std::is_same_v<Policy, execution::parallel_policy>)
+            grain = parallel_grain(policy, n);
+        
+        if (grain == 0) {
+            std::size_t count = 0;
+            for (std::size_t i = 0; i < n; i++)
+                if (data[i] == value) {
+                    if (count < capacity)
+                        buffer[count] = i;
+                    count++;
+                }
+            return count;
+        }
+        
+        const std::size_t tasks = (n + grain - 1) / grain;
+        std::vector<std::size_t> offsets(tasks + 1, 0);
+        
+        VectorThreadPool::instance().run(tasks, [&](std::size_t task) {
+            offsets[task + 1] = std::count(data + task * grain, data + std::min(n, (task + 1) * grain), value);
+        });
+        
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        
+        VectorThreadPool::instance().run(tasks, [&](std::size_t task) {
+            std::size_t pos = offsets[task];
+            for (std::size_t i = task * grain; i < std::min(n, (task + 1) * grain) && pos < capacity; i++)
+                if (data[i] == value)
+                    buffer[pos++] = i;
+        });
+        
+        return offsets[tasks];
+    }
+    
+    // result of Vector::max() and Vector::min() once the extremum is known
+    template <typename Policy, typename T>
+    std::variant<T, std::vector<std::size_t>> extremum(const Policy& policy, const T* data, std::size_t n, const IndexedValue<T>& best) {
+        const T* rest = data + best.index;
+        const std::size_t ties = indexes_of(policy, rest, n - best.index, best.value, nullptr, 0);
+        
+        if (ties == 1)
+            return static_cast<T>(best.index);
+        
+        std::vector<std::size_t> indexes(ties);
+        indexes_of(policy, rest, n - best.index, best.value, indexes.data(), ties);
+        for (auto& index : indexes)
+            index += best.index;
+        
+        return indexes;
+    }
+}
+
+/*
+ Top-k selection.
+ 
+ The k largest elements, largest first and equal ones in index order. For
+ a small k the best elements seen so far are kept in a heap, and a block
+ is only looked at element by element when its maximum (found with SIMD)
+ beats the worst of them, which is rare past the first blocks. When k is a
+ large part of the data, or too many elements make it into the heap (on
+ ascending data), the k-th largest value is selected as for quantile() and
+ a second pass collects the elements above it. The data is never
+ reordered; the result is unspecified when it contains NaNs.
+*/
+namespace vector_detail {
+    inline constexpr std::size_t top_k_block = 256;
+    
+    // the heap is used when k is smaller than n / top_k_ratio
+    inline constexpr std::size_t top_k_ratio = 64;
+    
+    template <typename T>
+    bool ranks_before(const IndexedValue<T>& a, const IndexedValue<T>& b) {
+        return b.value < a.value || (!(a.value < b.value) && a.index < b.index);
+    }
+    
+    /*
+     The k best of [begin, end), best first, or nothing once more elements
+     entered the heap than random data would need, about k * ln(n / k).
+    */
+    template <typename T>
+    std::optional<std::vector<IndexedValue<T>>> heap_top_k(const T* data, std::size_t begin, std::size_t end, std::size_t k) {
+        std::vector<IndexedValue<T>> heap;
+        heap.reserve(std::min(k, end - begin));
+        
+        std::size_t i = begin;
+        for (; i < end && heap.size() < k; i++)
+            heap.push_back({ data[i], i });
+        
+        // worst candidate at the front
+        std::make_heap(heap.begin(), heap.end(), ranks_before<T>);
+        
+        const double ratio = std::max(1.0, double(end - begin) / double(k));
+        const std::size_t budget = static_cast<std::size_t>(double(k) * (2 + std::log2(ratio)));
+        std::size_t pushed = 0;
+        
+        while (i < end) {
+            const std::size_t len = std::min(top_k_block, end - i);
+            
+            T lo, hi;
+            block_extrema<T, false, true>(data + i, len, lo, hi);
+            
+            // elements equal to the worst candidate come after it, so only greater ones enter
+            if (heap.front().value < hi) {
+                for (std::size_t j = i; j < i + len; j++)
+                    if (heap.front().value < data[j]) {
+                        std::pop_heap(heap.begin(), heap.end(), ranks_before<T>);
+                        heap.back() = { data[j], j };
+                        std::push_heap(heap.begin(), heap.end(), ranks_before<T>);
+                        pushed++;
+                    }
+                
+                if (pushed > budget)
+                    return std::nullopt;
+            }
+            
+            i += len;
+        }
+        
+        std::sort_heap(heap.begin(), heap.end(), ranks_before<T>);
+        return heap;
+    }
+    
+    template <typename Policy, typename T>
+    std::vector<IndexedValue<T>> select_top_k(const Policy& policy, const T* data, std::size_t n, std::size_t k) {
+        const std::size_t rank = n - k;
+        T threshold;
+        select_ranks(policy, data, n, &rank, 1, &threshold);
+        
+        // fewer than k elements are above the threshold, the first ones equal to it make up the rest
+        struct Candidates {
+            std::vector<IndexedValue<T>> above;
+            std::vector<IndexedValue<T>> ties;
+        };
+        
+        auto found = reduce_chunks(policy, n, [&](std::size_t begin, std::size_t end) {
+            Candidates candidates;
+            for (std::size_t i = begin; i < end; i++) {
+                if (threshold < data[i])
+                    candidates.above.push_back({ data[i], i });
+                else if (!(data[i] < threshold) && candidates.ties.size() < k)
+                    candidates.ties.push_back({ data[i], i });
+            }
+            return candidates;
+        }, [k](Candidates a, Candidates b) {
+            a.above.insert(a.above.end(), b.above.begin(), b.above.end());
+            
+            const std::size_t room = std::min(b.ties.size(), k - std::min(k, a.ties.size()));
+            a.ties.insert(a.ties.end(), b.ties.begin(), b.ties.begin() + room);
+            return a;
+        });
+        
+        auto& best = found.above;
+        for (std::size_t i = 0; best.size() < k; i++)
+            best.push_back(found.ties[i]);
+        
+        std::sort(best.begin(), best.end(), ranks_before<T>);
+        return std::move(best);
+    }
+    
+    // k is clamped to n
+    template <typename Policy, typename T>
+    std::vector<IndexedValue<T>> top_k_of(const Policy& policy, const T* data, std::size_t n, std::size_t k) {
+        k = std::min(k, n);
+        if (k == 0)
+            return {};
+        
+        if (k < n / top_k_ratio) {
+            // per-chunk heaps merged in chunk order, so ties keep the first indexes
+            using Best = std::optional<std::vector<IndexedValue<T>>>;
+            Best best = reduce_chunks(policy, n, [data, k](std::size_t begin, std::size_t end) {
+                return heap_top_k(data, begin, end, k);
+            }, [k](Best a, Best b) -> Best {
+                if (!a || !b)
+                    return std::nullopt;
+                
+                std::vector<IndexedValue<T>> merged(a->size() + b->size());
+                std::merge(a->begin(), a->end(), b->begin(), b->end(), merged.begin(), ranks_before<T>);
+                merged.resize(std::min(k, merged.size()));
+                return merged;
+            });
+            
+            if (best)
+                return std::move(*best);
+        }
+        
+        return select_top_k(policy, data, n, k);
+    }
+    
+    template <typename T>
+    std::vector<std::size_t> top_k_indexes(const std::vector<IndexedValue<T>>& best) {
+        std::vector<std::size_t> indexes(best.size());
+        for (std::size_t i = 0; i < best.size(); i++)
+            indexes[i] = best[i].index;
+        
+        return indexes;
+    }
+}
+
+/*
+ Distance kernels.
+ 
+ Every kernel is a single pass over both vectors with the four
+ accumulators of reduce_dot(). The L1 distance adds |u - v| as
+ max(u - v, v - u), the cosine similarity accumulates u.v, |u|^2 and |v|^2
+ side by side so that both vectors are read once, and the Hamming distance
+ counts the differing bits of integer elements 64 at a time.
+*/
+namespace vector_detail {
+    template <typename T>
+    T absolute_difference(T a, T b) {
+        return a < b ? b - a : a - b;
+    }
+    
+    // sum of |u[i] - v[i]|
+    template <typename T>
+    T reduce_l1(const T* u, const T* v, std::size_t n) {
+        std::size_t i = 0;
+        T total = T();
+        
+        if constexpr (simd_minmax_v<T>) {
+            using S = simd_for<T>;
+            constexpr std::size_t w = S::width;
+            
+            auto acc0 = S::zero(), acc1 = S::zero(), acc2 = S::zero(), acc3 = S::zero();
+            for (; i + 4 * w <= n; i += 4 * w) {
+                const auto a0 = S::load(u + i), b0 = S::load(v + i);
+                const auto a1 = S::load(u + i + w), b1 = S::load(v + i + w);
+                const auto a2 = S::load(u + i + 2 * w), b2 = S::load(v + i + 2 * w);
+                const auto a3 = S::load(u + i + 3 * w), b3 = S::load(v + i + 3 * w);
+                acc0 = S::add(acc0, S::max(S::sub(a0, b0), S::sub(b0, a0)));
+                acc1 = S::add(acc1, S::max(S::sub(a1, b1), S::sub(b1, a1)));
+                acc2 = S::add(acc2, S::max(S::sub(a2, b2), S::sub(b2, a2)));
+                acc3 = S::add(acc3, S::max(S::sub(a3, b3), S::sub(b3, a3)));
+            }
+            for (; i + w <= n; i += w) {
+                const auto a = S::load(u + i), b = S::load(v + i);
+                acc0 = S::add(acc0, S::max(S::sub(a, b), S::sub(b, a)));
+            }
+            
+            total = horizontal_sum<T, S>(S::add(S::add(acc0, acc1), S::add(acc2, acc3)));
+        }
+        
+        for (; i < n; i++)
+            total += absolute_difference(u[i], v[i]);
+        
+        return total;
+    }
+    
+    template <typename T>
+    struct cosine_terms {
+        T uv, uu, vv;
+    };
+    
+    // u.v, u.u and v.v in one pass
+    template <typename T>
+    cosine_terms<T> reduce_cosine_terms(const T* u, const T* v, std::size_t n) {
+        std::size_t i = 0;
+        cosine_terms<T> total{ T(), T(), T() };
+        
+        if constexpr (simd_for<T>::has_mul) {
+            using S = simd_for<T>;
+            constexpr std::size_t w = S::width;
+            
+            auto uv0 = S::zero(), uu0 = S::zero(), vv0 = S::zero();
+            auto uv1 = S::zero(), uu1 = S::zero(), vv1 = S::zero();
+            for (; i + 2 * w <= n; i += 2 * w) {
+                const auto a0 = S::load(u + i), b0 = S::load(v + i);
+                const auto a1 = S::load(u + i + w), b1 = S::load(v + i + w);
+                uv0 = S::fma(a0, b0, uv0);
+                uu0 = S::fma(a0, a0, uu0);
+                vv0 = S::fma(b0, b0, vv0);
+                uv1 = S::fma(a1, b1, uv1);
+                uu1 = S::fma(a1, a1, uu1);
+                vv1 = S::fma(b1, b1, vv1);
+            }
+            for (; i + w <= n; i += w) {
+                const auto a = S::load(u + i), b = S::load(v + i);
+                uv0 = S::fma(a, b, uv0);
+                uu0 = S::fma(a, a, uu0);
+                vv0 = S::fma(b, b, vv0);
+            }
+            
+            total.uv = horizontal_sum<T, S>(S::add(uv0, uv1));
+            total.uu = horizontal_sum<T, S>(S::add(uu0, uu1));
+            total.vv = horizontal_sum<T, S>(S::add(vv0, vv1));
+        }
+        
+        for (; i < n; i++) {
+            total.uv += u[i] * v[i];
+            total.uu += u[i] * u[i];
+            total.vv += v[i] * v[i];
+        }
+        
+        return total;
+    }
+    
+    // u.v / (|u| |v|) from the dot product and the magnitudes, 0 if either vector is 0
+    template <typename T>
+    T cosine_of(T uv, T norm_u, T norm_v) {
+        const T norms = norm_u * norm_v;
+        return norms == 0 ? T() : uv / norms;
+    }
+    
+    // bit count without compiler builtins; compilers turn it into popcnt where available
+    inline std::uint64_t popcount(std::uint64_t x) {
+        x -= (x >> 1) & 0x5555555555555555u;
+        x = (x & 0x3333333333333333u) + ((x >> 2) & 0x3333333333333333u);
+        x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fu;
+        
+        return (x * 0x0101010101010101u) >> 56;
+    }
+    
+    // bits that differ between the n elements of u and v
+    template <typename T>
+    std::size_t count_differing_bits(const T* u, const T* v, std::size_t n) {
+        const auto* a = reinterpret_cast<const unsigned char*>(u);
+        const auto* b = reinterpret_cast<const unsigned char*>(v);
+        const std::size_t bytes = n * sizeof(T);
+        
+        std::uint64_t total = 0;
+        std::size_t i = 0;
+        for (; i + 8 <= bytes; i += 8) {
+            std::uint64_t x, y;
+            std::memcpy(&x, a + i, 8);
+            std::memcpy(&y, b + i, 8);
+            total += popcount(x ^ y);
+        }
+        for (; i < bytes; i++)
+            total += popcount(static_cast<std::uint64_t>(a[i] ^ b[i]));
+        
+        return static_cast<std::size_t>(total);
+    }
+}
+
+/*
+ Instrumentation.
+ 
+ Compiled out unless VECTOR_INSTRUMENT is defined: the hooks are empty
+ macros then and instrumentation::snapshot() returns zeros. When enabled,
+ every instrumented operation counts its calls, and the allocations and
+ copies it does, including those of the operations it calls, e.g. the
+ reallocations of insert(); calls made by the library itself don't count.
+ With VECTOR_INSTRUMENT_TIMING it also adds up
+ the time spent in it, in TSC ticks on x86 and nanoseconds elsewhere.
+ 
+ Every thread counts into its own block, so the counters cost a few plain
+ stores and are never contended; snapshot() adds up the blocks.
+*/
+namespace instrumentation {
+    enum class Operation : unsigned {
+        construct,      // constructors from a size, a view or an array, and load()
+        copy,           // copy construction and assignment
+        assign,         // evaluation of expressions
+        resize,
+        reserve,        // reserve() and shrink_to_fit()
+        push_back,      // push_back() and emplace_back()
+        insert,
+        erase,
+        subvec,
+        concat,
+        reduce,         // sum(), product(), mean(), magnitude(), dot_product(), normalize()
+        extrema,        // minmax(), argmax(), argmin(), describe(), top_k()
+        other           // allocations outside of the operations above
+    };
+    
+    inline constexpr std::size_t operation_count = static_cast<std::size_t>(Operation::other) + 1;
+    
+    // true when the library is built with VECTOR_INSTRUMENT
+#if defined(VECTOR_INSTRUMENT)
+    inline constexpr bool enabled = true;
+#else
+    inline constexpr bool enabled = false;
+#endif
+    
+    inline const char* name(Operation op) {
+        static const char* const names[operation_count] = {
+            "construct", "copy", "assign", "resize", "reserve", "push_back", "insert",
+            "erase", "subvec", "concat", "reduce", "extrema", "other"
+        };
+        return names[static_cast<std::size_t>(op)];
+    }
+    
+    struct Counters {
+        std::uint64_t calls = 0;
+        std::uint64_t allocations = 0;      // heap allocations, inline storage excluded
+        std::uint64_t reallocations = 0;    // allocations that moved existing elements
+        std::uint64_t bytes_allocated = 0;
+        std::uint64_t bytes_copied = 0;     // elements copied, moved to new storage or shifted
+        std::uint64_t ticks = 0;            // VECTOR_INSTRUMENT_TIMING only
+        
+        Counters& operator+=(const Counters& other) {
+            calls += other.calls;
+            allocations += other.allocations;
+            reallocations += other.reallocations;
+            bytes_allocated += other.bytes_allocated;
+            bytes_copied += other.bytes_copied;
+            ticks += other.ticks;
+            return *this;
+        }
+        
+        Counters& operator-=(const Counters& other) {
+            calls -= other.calls;
+            allocations -= other.allocations;
+            reallocations -= other.reallocations;
+            bytes_allocated -= other.bytes_allocated;
+            bytes_copied -= other.bytes_copied;
+            ticks -= other.ticks;
+            return *this;
+        }
+    };
+    
+    struct Snapshot {
+        std::array<Counters, operation_count> operations{};
+        
+        const Counters& operator[](Operation op) const { return operations[static_cast<std::size_t>(op)]; }
+        
+        Counters total() const {
+            Counters sum;
+            for (const Counters& c : operations)
+                sum += c;
+            return sum;
+        }
+    };
+    
+    Snapshot snapshot();
+    void reset();
+}
+
+#if defined(VECTOR_INSTRUMENT)
+namespace vector_detail {
+    enum class counter : unsigned { calls, allocations, reallocations, bytes_allocated, bytes_copied, ticks };
+    inline constexpr std::size_t counter_count = 6;
+    
+    // written by its thread only, read by snapshot()
+    struct thread_counters {
+        std::atomic<std::uint64_t> values[instrumentation::operation_count][counter_count] = {};
+        
+        thread_counters();
+        ~thread_counters();
+        
+        instrumentation::Snapshot read() const {
+            instrumentation::Snapshot s;
+            for (std::size_t op = 0; op < instrumentation::operation_count; op++) {
+                auto& c = s.operations[op];
+                c.calls = values[op][0].load(std::memory_order_relaxed);
+                c.allocations = values[op][1].load(std::memory_order_relaxed);
+                c.reallocations = values[op][2].load(std::memory_order_relaxed);
+                c.bytes_allocated = values[op][3].load(std::memory_order_relaxed);
+                c.bytes_copied = values[op][4].load(std::memory_order_relaxed);
+                c.ticks = values[op][5].load(std::memory_order_relaxed);
+            }
+            return s;
+        }
+    };
+    
+    // blocks of the running threads, plus the totals of the threads that exited
+    struct instrument_registry {
+        std::mutex mutex;
+        std::vector<const thread_counters*> threads;
+        instrumentation::Snapshot exited;
+        instrumentation::Snapshot baseline;
+        
+        // never destroyed, thread_counters of late threads unregister from it
+        static instrument_registry& instance() {
+            static instrument_registry* registry = new instrument_registry();
+            return *registry;
+        }
+        
+        instrumentation::Snapshot total() {
+            instrumentation::Snapshot s = exited;
+            for (const thread_counters* t : threads) {
+                instrumentation::Snapshot ts = t->read();
+                for (std::size_t op = 0; op < instrumentation::operation_count; op++)
+                    s.operations[op] += ts.operations[op];
+            }
+            return s;
+        }
+    };
+    
+    inline thread_counters::thread_counters() {
+        auto& registry = instrument_registry::instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.threads.push_back(this);
+    }
+    
+    inline thread_counters::~thread_counters() {
+        auto& registry = instrument_registry::instance();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        
+        instrumentation::Snapshot mine = read();
+        for (std::size_t op = 0; op < instrumentation::operation_count; op++)
+            registry.exited.operations[op] += mine.operations[op];
+        registry.threads.erase(std::find(registry.threads.begin(), registry.threads.end(), this));
+    }
+    
+    struct thread_instrumentation {
+        thread_counters counters;
+        instrumentation::Operation current = instrumentation::Operation::other;
+        bool inside = false;
+    };
+    
+    inline thread_instrumentation& local_instrumentation() {
+        thread_local thread_instrumentation local;
+        return local;
+    }
+    
+    inline void count(thread_instrumentation& local, instrumentation::Operation op, counter c, std::uint64_t value) {
+        auto& slot = local.counters.values[static_cast<std::size_t>(op)][static_cast<std::size_t>(c)];
+        slot.store(slot.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+    
+    inline void count(instrumentation::Operation op, counter c, std::uint64_t value) {
+        count(local_instrumentation(), op, c, value);
+    }
+    
+    // counts into the outermost operation running on this thread
+    inline void count(counter c, std::uint64_t value) {
+        auto& local = local_instrumentation();
+        count(local, local.current, c, value);
+    }
+    
+    inline std::uint64_t instrument_ticks() {
+    #if !defined(VECTOR_INSTRUMENT_TIMING)
+        return 0;
+    #elif defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+    #else
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    #endif
+    }
+    
+    /*
+     Counts a call of the outermost operation running on the thread and
+     attributes what happens until the end of the scope to it; operations
+     called by other operations, like reserve() by insert(), don't count.
+    */
+    class operation_scope {
+    public:
+        explicit operation_scope(instrumentation::Operation op) : local_(local_instrumentation()) {
+            if (!local_.inside) {
+                outermost_ = true;
+                local_.inside = true;
+                local_.current = op;
+                count(local_, op, counter::calls, 1);
+                start_ = instrument_ticks();
+            }
+        }
+        
+        operation_scope(const operation_scope&) = delete;
+        operation_scope& operator=(const operation_scope&) = delete;
+        
+        ~operation_scope() {
+            if (outermost_) {
+            #if defined(VECTOR_INSTRUMENT_TIMING)
+                count(local_, local_.current, counter::ticks, instrument_ticks() - start_);
+            #endif
+                local_.inside = false;
+                local_.current = instrumentation::Operation::other;
+            }
+        }
+        
+    private:
+        thread_instrumentation& local_;
+        bool outermost_ = false;
+        std::uint64_t start_ = 0;
+    };
+}
+
+#define VECTOR_OPERATION(op) ::vector_detail::operation_scope vector_operation_scope_(::instrumentation::Operation::op)
+#define VECTOR_COUNT(which, value) ::vector_detail::count(::vector_detail::counter::which, static_cast<std::uint64_t>(value))
+#else
+#define VECTOR_OPERATION(op) ((void)0)
+#define VECTOR_COUNT(which, value) ((void)0)
+#endif
+
+/*
+ @brief     Counters of all threads since the start of the program or the last reset().
+ 
+ Threads that exited still count. Zeros unless VECTOR_INSTRUMENT is defined.
+*/
+inline instrumentation::Snapshot instrumentation::snapshot() {
+#if defined(VECTOR_INSTRUMENT)
+    auto& registry = vector_detail::instrument_registry::instance();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    
+    Snapshot s = registry.total();
+    for (std::size_t op = 0; op < operation_count; op++)
+        s.operations[op] -= registry.baseline.operations[op];
+    return s;
+#else
+    return {};
+#endif
+}
+
+// restarts the counters of snapshot() from zero
+inline void instrumentation::reset() {
+#if defined(VECTOR_INSTRUMENT)
+    auto& registry = vector_detail::instrument_registry::instance();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.baseline = registry.total();
+#endif
+}
+
+// alignment of the vector storage, enough for aligned AVX-512 loads
+inline constexpr std::size_t vector_alignment = 64;
+
+/*
+ @brief             Allocator that returns storage aligned to a given boundary.
+ @tparam T          the type of elements to allocate.
+ @tparam Alignment  the alignment in bytes, a power of two not less than alignof(T).
+ 
+ This is the default allocator of Vector, so that the SIMD kernels can use
+ aligned loads on the beginning of the data.
+*/
+template <typename T, std::size_t Alignment = vector_alignment>
+class AlignedAllocator {
+public:
+    static_assert((Alignment & (Alignment - 1)) == 0 && Alignment >= alignof(T), "Alignment should be a power of two not less than alignof(T)");
+    
+    using value_type = T;
+    
+    template <typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+    
+    AlignedAllocator() = default;
+    
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+    
+    T* allocate(std::size_t);
+    void deallocate(T*, std::size_t) noexcept;
+};
+
+template <typename T, std::size_t Alignment>
+T* AlignedAllocator<T, Alignment>::allocate(std::size_t n) {
+    if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+        throw std::bad_array_new_length();
+    
+    return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+}
+
+template <typename T, std::size_t Alignment>
+void AlignedAllocator<T, Alignment>::deallocate(T* p, std::size_t) noexcept {
+    ::operator delete(p, std::align_val_t(Alignment));
+}
+
+template <typename T, typename U, std::size_t Alignment>
+bool operator==(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&) {
+    return true;
+}
+
+template <typename T, typename U, std::size_t Alignment>
+bool operator!=(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&) {
+    return false;
+}
+
+#if defined(VECTOR_HAS_PMR)
+namespace vector_detail {
+    inline std::pmr::memory_resource*& thread_resource() {
+        thread_local std::pmr::memory_resource* resource = nullptr;
+        return resource;
+    }
+}
+
+/*
+ @brief     The memory resource of default-constructed ResourceAllocators on
+            the calling thread: the one installed by the innermost
+            ScopedVectorResource, or std::pmr::get_default_resource().
+*/
+inline std::pmr::memory_resource* vector_resource() noexcept {
+    std::pmr::memory_resource* resource = vector_detail::thread_resource();
+    return resource ? resource : std::pmr::get_default_resource();
+}
+
+/*
+ @brief     Installs a memory resource for the vectors created on the calling
+            thread without an explicit allocator, until destroyed.
+ 
+ Vectors built from expressions and the results of subvec(), concat() and
+ cross_product() of such vectors draw from it too, so a request handler
+ can route all of its temporaries to an arena and release them at once:
+ 
+     std::pmr::monotonic_buffer_resource arena;
+     ScopedVectorResource scope(&arena);
+     PmrVector<float> tmp = a + b;          // allocated in the arena
+ 
+ Scopes nest and must be destroyed on the thread that created them, in
+ reverse order. The vectors must not outlive the resource.
+*/
+class ScopedVectorResource {
+public:
+    explicit ScopedVectorResource(std::pmr::memory_resource* resource) noexcept
+        : previous_(std::exchange(vector_detail::thread_resource(), resource)) {}
+    
+    ScopedVectorResource(const ScopedVectorResource&) = delete;
+    ScopedVectorResource& operator=(const ScopedVectorResource&) = delete;
+    
+    ~ScopedVectorResource() { vector_detail::thread_resource() = previous_; }
+    
+private:
+    std::pmr::memory_resource* previous_;
+};
+
+/*
+ @brief             Allocator that draws aligned storage from a std::pmr::memory_resource.
+ @tparam T          the type of elements to allocate.
+ @tparam Alignment  the alignment in bytes, a power of two not less than alignof(T).
+ 
+ Unlike std::pmr::polymorphic_allocator it keeps the alignment of
+ AlignedAllocator. A default-constructed allocator uses vector_resource(),
+ i.e. the resource of the innermost ScopedVectorResource of the thread;
+ the resource is fixed at construction and shared by copies. The resource
+ decides the threading and release policy, e.g. a
+ std::pmr::monotonic_buffer_resource per thread for bulk release, or a
+ std::pmr::unsynchronized_pool_resource for size-class pooling.
+*/
+template <typename T, std::size_t Alignment = vector_alignment>
+class ResourceAllocator {
+public:
+    static_assert((Alignment & (Alignment - 1)) == 0 && Alignment >= alignof(T), "Alignment should be a power of two not less than alignof(T)");
+    
+    using value_type = T;
+    
+    template <typename U>
+    struct rebind {
+        using other = ResourceAllocator<U, Alignment>;
+    };
+    
+    ResourceAllocator() noexcept : resource_(vector_resource()) {}
+    ResourceAllocator(std::pmr::memory_resource* resource) noexcept : resource_(resource) {}
+    
+    template <typename U>
+    ResourceAllocator(const ResourceAllocator<U, Alignment>& other) noexcept : resource_(other.resource()) {}
+    
+    T* allocate(std::size_t);
+    void deallocate(T*, std::size_t) noexcept;
+    
+    std::pmr::memory_resource* resource() const noexcept { return resource_; }
+    
+private:
+    std::pmr::memory_resource* resource_;
+};
+
+template <typename T, std::size_t Alignment>
+T* ResourceAllocator<T, Alignment>::allocate(std::size_t n) {
+    if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+        throw std::bad_array_new_length();
+    
+    return static_cast<T*>(resource_->allocate(n * sizeof(T), Alignment));
+}
+
+template <typename T, std::size_t Alignment>
+void ResourceAllocator<T, Alignment>::deallocate(T* p, std::size_t n) noexcept {
+    resource_->deallocate(p, n * sizeof(T), Alignment);
+}
+
+template <typename T, typename U, std::size_t Alignment>
+bool operator==(const ResourceAllocator<T, Alignment>& a, const ResourceAllocator<U, Alignment>& b) {
+    return a.resource() == b.resource() || a.resource()->is_equal(*b.resource());
+}
+
+template <typename T, typename U, std::size_t Alignment>
+bool operator!=(const ResourceAllocator<T, Alignment>& a, const ResourceAllocator<U, Alignment>& b) {
+    return !(a == b);
+}
+#endif
+
+// tag for the constructors that leave elements default-initialized,
+// i.e. uninitialized for trivial types
+struct uninitialized_t {
+    explicit uninitialized_t() = default;
+};
+
+inline constexpr uninitialized_t uninitialized{};
+
+// size of a Vector whose number of elements is only known at runtime
+inline constexpr std::size_t Dynamic = std::numeric_limits<std::size_t>::max();
+
+/*
+ Vector<T> (N = Dynamic) owns its elements through the allocator and
+ grows at runtime. Vector<T, N> stores exactly N elements inline, see the
+ fixed-size specialization below; its Allocator is unused.
+*/
+template <typename T, std::size_t N = Dynamic, typename Allocator = AlignedAllocator<T>>
+class Vector;
+
+#if defined(VECTOR_HAS_PMR)
+// dynamic vector whose storage comes from a memory resource, see ResourceAllocator
+template <typename T>
+using PmrVector = Vector<T, Dynamic, ResourceAllocator<T>>;
+#endif
+
+template <typename T>
+class VectorView;
+
+template <typename T>
+class StridedVectorView;
+
+#if defined(VECTOR_HAS_MMAP)
+template <typename T>
+class MappedVector;
+#endif
+
+/*
+ @brief         Base class of all lazy vector expressions.
+ @tparam E      the concrete expression type (CRTP).
+ 
+ Arithmetic on vectors does not compute anything by itself: `a + b - c * 2`
+ builds a tree of lightweight nodes that only remember their operands.
+ The whole tree is evaluated in a single fused loop when it is assigned into
+ a Vector, so no temporaries are allocated and every operand is read once.
+ 
+ Expressions refer to the vectors they were built from, so they must be
+ evaluated before those vectors are destroyed or resized. Prefer assigning
+ an expression to a Vector right away instead of keeping it in an `auto`.
+*/
+template <typename E>
+class VectorExpression {
+public:
+    const E& self() const { return static_cast<const E&>(*this); }
+    
+    std::size_t size() const { return self().size(); }
+    decltype(auto) operator[](std::size_t i) const { return self()[i]; }
+};
+
+namespace vector_detail {
+    /*
+     Whether an operand reading data[0, size) at positions offset, offset + 1, ...
+     of an expression reads any element of out[0, n) at another position than
+     its own, so that writing the results into out in place would change
+     elements that are still to be read.
+    */
+    template <typename U, typename T>
+    bool shifted_alias(const U* data, std::size_t size, const T* out, std::size_t n, std::size_t offset) {
+        const auto first = reinterpret_cast<std::uintptr_t>(data), last = reinterpret_cast<std::uintptr_t>(data + size);
+        const auto out_first = reinterpret_cast<std::uintptr_t>(out), out_last = reinterpret_cast<std::uintptr_t>(out + n);
+        if (size == 0 || n == 0 || last <= out_first || out_last <= first)
+            return false;
+        
+        if constexpr (std::is_same_v<std::remove_cv_t<U>, std::remove_cv_t<T>>)
+            return data != out + offset;
+        else
+            return true;
+    }
+}
+
+/*
+ @brief         Leaf of an expression tree, refers to the elements of a Vector or a view.
+ 
+ Access is unchecked: the sizes are validated once, when the node using
+ the leaf is created.
+*/
+template <typename T>
+class VectorTerminal : public VectorExpression<VectorTerminal<T>> {
+public:
+    using value_type = T;
+    
+    VectorTerminal(const T* data, std::size_t size) : data_(data), size_(size) {}
+    
+    std::size_t size() const { return size_; }
+    const T& operator[](std::size_t i) const { return data_[i]; }
+    
+    // whether evaluating into out[0, n) in place would read overwritten elements, see Vector::operator=
+    template <typename U>
+    bool aliases(const U* out, std::size_t n, std::size_t offset) const {
+        return vector_detail::shifted_alias(data_, size_, out, n, offset);
+    }
+
+private:
+    const T* data_;
+    std::size_t size_;
+};
+
+template <typename L, typename R, typename Op>
+class VectorBinaryExpression : public VectorExpression<VectorBinaryExpression<L, R, Op>> {
+public:
+    using value_type = std::decay_t<std::invoke_result_t<Op, typename L::value_type, typename R::value_type>>;
+    
+    VectorBinaryExpression(const L&, const R&, Op = Op());
+    
+    std::size_t size() const { return lhs_.size(); }
+    value_type operator[](std::size_t i) const { return op_(lhs_[i], rhs_[i]); }
+    
+    template <typename U>
+    bool aliases(const U* out, std::size_t n, std::size_t offset) const {
+        return lhs_.aliases(out, n, offset) || rhs_.aliases(out, n, offset);
+    }
+
+private:
+    L lhs_;
+    R rhs_;
+    Op op_;
+};
+
+template <typename E, typename Op>
+class VectorScalarExpression : public VectorExpression<VectorScalarExpression<E, Op>> {
+public:
+    using value_type = typename E::value_type;
+    
+    VectorScalarExpression(const E& expr, const value_type& scalar, Op op = Op())
+        : expr_(expr), scalar_(scalar), op_(op) {}
+    
+    std::size_t size() const { return expr_.size(); }
+    value_type operator[](std::size_t i) const { return op_(expr_[i], scalar_); }
+    
+    template <typename U>
+    bool aliases(const U* out, std::size_t n, std::size_t offset) const { return expr_.aliases(out, n, offset); }
+
+private:
+    E expr_;
+    value_type scalar_;
+    Op op_;
+};
+
+// op(expr[i]), see map()
+template <typename E, typename Op>
+class VectorUnaryExpression : public VectorExpression<VectorUnaryExpression<E, Op>> {
+public:
+    using value_type = std::decay_t<std::invoke_result_t<Op, typename E::value_type>>;
+    
+    VectorUnaryExpression(const E& expr, Op op = Op()) : expr_(expr), op_(op) {}
+    
+    std::size_t size() const { return expr_.size(); }
+    value_type operator[](std::size_t i) const { return op_(expr_[i]); }
+    
+    template <typename U>
+    bool aliases(const U* out, std::size_t n, std::size_t offset) const { return expr_.aliases(out, n, offset); }
+
+private:
+    E expr_;
+    Op op_;
+};
+
+// op(a[i], b[i], c[i]), see fma() and where()
+template <typename A, typename B, typename C, typename Op>
+class VectorTernaryExpression : public VectorExpression<VectorTernaryExpression<A, B, C, Op>> {
+public:
+    using value_type = std::decay_t<std::invoke_result_t<Op, typename A::value_type, typename B::value_type, typename C::value_type>>;
+    
+    VectorTernaryExpression(const A&, const B&, const C&, Op = Op());
+    
+    std::size_t size() const { return a_.size(); }
+    value_type operator[](std::size_t i) const { return op_(a_[i], b_[i], c_[i]); }
+    
+    template <typename U>
+    bool aliases(const U* out, std::size_t n, std::size_t offset) const {
+        return a_.aliases(out, n, offset) || b_.aliases(out, n, offset) || c_.aliases(out, n, offset);
+    }
+
+private:
+    A a_;
+    B b_;
+    C c_;
+    Op op_;
+};
+
+// a scalar repeated `size` times, the scalar operand of where() and of the comparisons
+template <typename T>
+class VectorBroadcast : public VectorExpression<VectorBroadcast<T>> {
+public:
+    using value_type = T;
+    
+    VectorBroadcast(const T& value, std::size_t size) : value_(value), size_(size) {}
+    
+    std::size_t size() const { return size_; }
+    const T& operator[](std::size_t) const { return value_; }
+    
+    template <typename U>
+    bool aliases(const U*, std::size_t, std::size_t) const { return false; }
+
+private:
+    T value_;
+    std::size_t size_;
+};
+
+namespace vector_detail {
+    template <typename T>
+    struct is_expression : std::is_base_of<VectorExpression<T>, T> {};
+    
+    template <typename T>
+    struct is_vector : std::false_type {};
+    
+    template <typename T, typename Allocator>
+    struct is_vector<Vector<T, Dynamic, Allocator>> : std::true_type {};
+    
+    template <typename T>
+    struct is_view : std::false_type {};
+    
+    template <typename T>
+    struct is_view<VectorView<T>> : std::true_type {};
+    
+    // anything that can appear as an operand of a vector expression
+    template <typename T>
+    inline constexpr bool is_operand_v =
+        is_expression<std::decay_t<T>>::value || is_vector<std::decay_t<T>>::value || is_view<std::decay_t<T>>::value;
+    
+    template <typename T>
+    const T& as_expression(const T& expr) {
+        return expr;
+    }
+    
+    template <typename T, typename Allocator>
+    VectorTerminal<T> as_expression(const Vector<T, Dynamic, Allocator>& vec) {
+        return VectorTerminal<T>(vec.begin(), vec.size());
+    }
+    
+    template <typename T>
+    VectorTerminal<T> as_expression(const VectorView<T>& view) {
+        return VectorTerminal<T>(view.data(), view.size());
+    }
+    
+    template <typename T>
+    using expression_t = std::decay_t<decltype(as_expression(std::declval<const T&>()))>;
+    
+    // applies the wrapped operation with the scalar on the left: `s * v`
+    template <typename Op>
+    struct scalar_first {
+        template <typename A, typename B>
+        constexpr auto operator()(const A& element, const B& scalar) const {
+            return Op()(scalar, element);
+        }
+    };
+}
+
+template <typename T, typename Allocator>
+class Vector<T, Dynamic, Allocator> {
+public:
+    using value_type = T;
+    using allocator_type = Allocator;
+    
+    // vectors of up to this many elements are stored inline, without allocations
+    static constexpr std::size_t small_capacity = sizeof(T) <= 8 ? 16 : 0;
+
+private:
+    using alloc_traits = std::allocator_traits<Allocator>;
+    
+    // storage can be moved or swapped between any two vectors without copying the elements
+    static constexpr bool can_steal_on_move = alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::is_always_equal::value;
+    static constexpr bool can_steal_on_swap = alloc_traits::propagate_on_container_swap::value || alloc_traits::is_always_equal::value;
+    static constexpr bool nothrow_move_assignable = can_steal_on_move && std::is_nothrow_move_constructible_v<T>;
+    static constexpr bool nothrow_swappable = can_steal_on_swap && std::is_nothrow_move_constructible_v<T>;
+
+public:
+    
+    Vector() = default;
+    explicit Vector(const Allocator&);
+    explicit Vector(VectorView<T>, const Allocator& = Allocator());
+    Vector(std::size_t, const Allocator& = Allocator());
+    Vector(std::size_t, uninitialized_t, const Allocator& = Allocator());
+    Vector(const std::unique_ptr<T[]>&, std::size_t, const Allocator& = Allocator());
+    Vector(const Vector&);
+    Vector(Vector&&) noexcept(std::is_nothrow_move_constructible_v<T>);
+    ~Vector();
+    
+    Vector& operator=(const Vector&);
+    Vector& operator=(Vector&&) noexcept(nothrow_move_assignable);
+    
+    void swap(Vector&) noexcept(nothrow_swappable);
+    
+    template <typename E>
+    Vector(const VectorExpression<E>&);
+    
+    template <typename E>
+    Vector& operator=(const VectorExpression<E>&);
+    
+    std::size_t size() const;
+    Allocator get_allocator() const;
+    
+    T magnitude() const;
+    
+    T mean() const;
+    T median() const;
+    
+    T quantile(double) const;
+    std::vector<T> quantiles(std::initializer_list<double>) const;
+    
+    template <typename InputIt, typename OutputIt>
+    OutputIt quantiles(InputIt, InputIt, OutputIt) const;
+    
+    std::variant<T, std::vector<std::size_t>> max() const;
+    std::variant<T, std::vector<std::size_t>> min() const;
+    
+    MinMax<T> minmax() const;
+    IndexedValue<T> argmax() const;
+    IndexedValue<T> argmin() const;
+    
+    Summary<T> describe() const;
+    
+    template <typename OutputIt>
+    OutputIt argmax_all(OutputIt) const;
+    
+    template <typename OutputIt>
+    OutputIt argmin_all(OutputIt) const;
+    
+    std::vector<IndexedValue<T>> top_k(std::size_t) const;
+    std::vector<std::size_t> argtop_k(std::size_t) const;
+    
+    T sum() const;
+    T product() const;
+    
+    void normalize();
+    
+    // overloads taking an execution policy, e.g. v.sum(execution::par)
+    template <typename Policy>
+    T magnitude(const Policy&) const;
+    
+    template <typename Policy>
+    T mean(const Policy&) const;
+    
+    template <typename Policy>
+    T median(const Policy&) const;
+    
+    template <typename Policy>
+    T quantile(const Policy&, double) const;
+    
+    template <typename Policy>
+    std::vector<T> quantiles(const Policy&, std::initializer_list<double>) const;
+    
+    template <typename Policy, typename InputIt, typename OutputIt>
+    OutputIt quantiles(const Policy&, InputIt, InputIt, OutputIt) const;
+    
+    template <typename Policy>
+    std::variant<T, std::vector<std::size_t>> max(const Policy&) const;
+    
+    template <typename Policy>
+    std::variant<T, std::vector<std::size_t>> min(const Policy&) const;
+    
+    template <typename Policy>
+    MinMax<T> minmax(const Policy&) const;
+    
+    template <typename Policy>
+    Summary<T> describe(const Policy&) const;
+    
+    template <typename Policy>
+    IndexedValue<T> argmax(const Policy&) const;
+    
+    template <typename Policy>
+    IndexedValue<T> argmin(const Policy&) const;
+    
+    template <typename Policy>
+    std::size_t argmax_all(const Policy&, std::size_t*, std::size_t) const;
+    
+    template <typename Policy>
+    std::size_t argmin_all(const Policy&, std::size_t*, std::size_t) const;
+    
+    template <typename Policy>
+    std::vector<IndexedValue<T>> top_k(const Policy&, std::size_t) const;
+    
+    template <typename Policy>
+    std::vector<std::size_t> argtop_k(const Policy&, std::size_t) const;
+    
+    template <typename Policy>
+    T sum(const Policy&) const;
+    
+    template <typename Policy>
+    T product(const Policy&) const;
+    
+    template <typename Policy>
+    void normalize(const Policy&);
+    
+    // `policy` may also be an accumulation policy, e.g. v.sum(accumulation::kahan), or both
+    template <typename Policy, typename Accumulation>
+    T magnitude(const Policy&, const Accumulation&) const;
+    
+    template <typename Policy, typename Accumulation>
+    T mean(const Policy&, const Accumulation&) const;
+    
+    template <typename Policy, typename Accumulation>
+    T sum(const Policy&, const Accumulation&) const;
+    
+    template <typename Policy, typename E>
+    Vector& assign(const Policy&, const VectorExpression<E>&);
+    
+    template <typename Policy>
+    Vector& scale(const Policy&, T);
+    
+    void clear();
+    void resize(std::size_t, const T&);
+    
+    std::size_t capacity() const;
+    void reserve(std::size_t);
+    void shrink_to_fit();
+    
+    void push_back(const T&);
+    void push_back(T&&);
+    
+    template <typename... Args>
+    T& emplace_back(Args&&...);
+    
+    void pop_back();
+    
+    Vector subvec(std::size_t, std::size_t) const;
+    
+    VectorView<T> view() const;
+    VectorView<T> view(std::size_t, std::size_t) const;
+    StridedVectorView<T> strided_view(std::size_t, std::size_t, std::size_t) const;
+    
+    // binary files, see VectorFileHeader
+    void save(std::ostream&) const;
+    void save(const std::string&) const;
+    
+    static Vector load(std::istream&, const Allocator& = Allocator());
+    static Vector load(const std::string&, const Allocator& = Allocator());
+    
+#if defined(VECTOR_HAS_MMAP)
+    static MappedVector<T> map(const std::string&);
+#endif
+    
+    template <typename A, typename Alloc>
+    friend Vector<A, Dynamic, Alloc> concat(const Vector<A, Dynamic, Alloc>&, const Vector<A, Dynamic, Alloc>&);
+    
+    void insert(std::size_t, const T&); // insert
+    void insert(std::size_t, std::size_t, const T&); // insert specific amount of values
+    
+    template <typename InputIt, typename = std::enable_if_t<!std::is_integral_v<InputIt>>>
+    void insert(std::size_t, InputIt, InputIt);
+    
+    void insert(std::size_t, std::initializer_list<T>);
+    
+    void erase(std::size_t);
+    void erase(std::size_t first, std::size_t last);
+    
+    // operator[] is checked by VECTOR_CHECK_INDEX, at() always throws std::out_of_range
+    T& operator[](std::size_t);
+    const T& operator[](std::size_t) const;
+    T& at(std::size_t);
+    const T& at(std::size_t) const;
+    
+    bool operator==(const Vector&) const;
+    bool operator!=(const Vector&) const;
+    
+    std::uint64_t hash() const;
+    
+    template <typename A, typename Alloc>
+    friend int three_way_compare(const Vector<A, Dynamic, Alloc>&, const Vector<A, Dynamic, Alloc>&);
+    
+    template <typename A, typename Alloc>
+    friend bool operator<(const Vector<A, Dynamic, Alloc>&, const Vector<A, Dynamic, Alloc>&);
+    
+    template <typename A, typename Alloc>
+    friend bool operator>(const Vector<A, Dynamic, Alloc>&, const Vector<A, Dynamic, Alloc>&);
+    
+    template <typename A, typename Alloc>
+    friend bool operator<=(const Vector<A, Dynamic, Alloc>&, const Vector<A, Dynamic, Alloc>&);
+    
+    template <typename A, typename Alloc>
+    friend bool operator>=(const Vector<A, Dynamic, Alloc>&, const Vector<A, Dynamic, Alloc>&);
+    
+    Vector& operator*=(T);
+    
+    template <typename E>
+    Vector& operator+=(const E&);
+    
+    template <typename E>
+    Vector& operator-=(const E&);
+    
+    template <typename A, typename Alloc>
+    friend A dot_product(const Vector<A, Dynamic, Alloc>&, const Vector<A, Dynamic, Alloc>&);
+    
+    template <typename A, typename Alloc>
+    friend Vector<A, Dynamic, Alloc> cross_product(const Vector<A, Dynamic, Alloc>&, const Vector<A, Dynamic, Alloc>&);
+    
+    template <typename A, typename Alloc>
+    friend std::ostream& operator<<(std::ostream&, Vector<A, Dynamic, Alloc> const&);
+    
+    T* data();
+    const T* data() const;
+    
+    // iterators
+    T* begin();
+    const T* begin() const;
+    
+    T* end();
+    const T* end() const;
+
+private:
+    static constexpr std::size_t small_bytes = small_capacity ? small_capacity * sizeof(T) : 1;
+    static constexpr std::size_t small_alignment = std::max(alignof(T), std::min(vector_alignment, small_bytes));
+    
+    template <typename E, typename Op>
+    void apply(const E&, Op, std::size_t, std::size_t);
+    
+    T* small_data();
+    T* allocate_storage(std::size_t);
+    void deallocate_storage(T*, std::size_t);
+    
+    template <typename... Args>
+    void construct_back(std::size_t, const Args&...);
+    void construct_back_default(std::size_t);
+    void copy_back(const T*, std::size_t);
+    void take_storage(Vector&);
+    void destroy_all();
+    void destroy_back(std::size_t);
+    
+    void grow(std::size_t);
+    void reallocate(std::size_t);
+    void open_gap(std::size_t, std::size_t);
+    
+    std::uint64_t cached_hash() const;
+    void cache_hash(std::uint64_t) const;
+    void invalidate_hash();
+    
+    alignas(small_alignment) unsigned char small_[small_bytes];
+    
+    // points to small_ when the elements are stored inline
+    T* entries = reinterpret_cast<T*>(small_);
+    std::size_t size_ = 0;
+    std::size_t capacity_ = small_capacity;
+    Allocator allocator_;
+    
+    // cached hash() of the elements, 0 until computed and after every change
+    mutable std::atomic<std::uint64_t> hash_{ 0 };
+};
+
+namespace vector_detail {
+    /*
+     Random access iterator over every `stride`-th element of an array.
+    */
+    template <typename T>
+    class strided_iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+        
+        strided_iterator() = default;
+        strided_iterator(const T* ptr, std::ptrdiff_t stride) : ptr_(ptr), stride_(stride) {}
+        
+        reference operator*() const { return *ptr_; }
+        pointer operator->() const { return ptr_; }
+        reference operator[](difference_type n) const { return ptr_[n * stride_]; }
+        
+        strided_iterator& operator++() { ptr_ += stride_; return *this; }
+        strided_iterator& operator--() { ptr_ -= stride_; return *this; }
+        strided_iterator operator++(int) { auto it = *this; ++*this; return it; }
+        strided_iterator operator--(int) { auto it = *this; --*this; return it; }
+        
+        strided_iterator& operator+=(difference_type n) { ptr_ += n * stride_; return *this; }
+        strided_iterator& operator-=(difference_type n) { ptr_ -= n * stride_; return *this; }
+        
+        friend strided_iterator operator+(strided_iterator it, difference_type n) { return it += n; }
+        friend strided_iterator operator+(difference_type n, strided_iterator it) { return it += n; }
+        friend strided_iterator operator-(strided_iterator it, difference_type n) { return it -= n; }
+        friend difference_type operator-(const strided_iterator& a, const strided_iterator& b) { return (a.ptr_ - b.ptr_) / a.stride_; }
+        
+        friend bool operator==(const strided_iterator& a, const strided_iterator& b) { return a.ptr_ == b.ptr_; }
+        friend bool operator!=(const strided_iterator& a, const strided_iterator& b) { return a.ptr_ != b.ptr_; }
+        friend bool operator<(const strided_iterator& a, const strided_iterator& b) { return a - b < 0; }
+        friend bool operator>(const strided_iterator& a, const strided_iterator& b) { return b < a; }
+        friend bool operator<=(const strided_iterator& a, const strided_iterator& b) { return !(b < a); }
+        friend bool operator>=(const strided_iterator& a, const strided_iterator& b) { return !(a < b); }
+    
+    private:
+        const T* ptr_ = nullptr;
+        std::ptrdiff_t stride_ = 1;
+    };
+}
+
+/*
+ @brief         Non-owning, read-only view of contiguous elements.
+ @tparam T      the type of the elements.
+ 
+ A view is just a pointer and a size, meant to be passed by value. It
+ doesn't own the elements: the Vector (or array) it refers to must outlive
+ it and must not be resized while the view is in use.
+ 
+ Vector converts to VectorView implicitly, so everything taking a view
+ accepts a vector as well. Taking a view of a part of a vector costs
+ nothing, unlike subvec() which copies:
+ 
+     for (std::size_t i = 0; i + window <= signal.size(); i++)
+         means[i] = signal.view(i, i + window).mean();
+*/
+template <typename T>
+class VectorView {
+public:
+    using value_type = T;
+    
+    VectorView() = default;
+    VectorView(const T*, std::size_t);
+    
+    template <std::size_t N, typename Allocator>
+    VectorView(const Vector<T, N, Allocator>&);
+    
+    std::size_t size() const;
+    const T* data() const;
+    
+    T magnitude() const;
+    
+    T mean() const;
+    T median() const;
+    
+    T quantile(double) const;
+    std::vector<T> quantiles(std::initializer_list<double>) const;
+    
+    std::variant<T, std::vector<std::size_t>> max() const;
+    std::variant<T, std::vector<std::size_t>> min() const;
+    
+    MinMax<T> minmax() const;
+    IndexedValue<T> argmax() const;
+    IndexedValue<T> argmin() const;
+    
+    Summary<T> describe() const;
+    
+    std::vector<IndexedValue<T>> top_k(std::size_t) const;
+    std::vector<std::size_t> argtop_k(std::size_t) const;
+    
+    T sum() const;
+    T product() const;
+    
+    // not cached, unlike Vector::hash()
+    std::uint64_t hash() const;
+    
+    // with an accumulation policy, e.g. view.sum(accumulation::pairwise)
+    template <typename Accumulation>
+    T magnitude(const Accumulation&) const;
+    
+    template <typename Accumulation>
+    T mean(const Accumulation&) const;
+    
+    template <typename Accumulation>
+    T sum(const Accumulation&) const;
+    
+    VectorView view(std::size_t, std::size_t) const;
+    StridedVectorView<T> strided_view(std::size_t, std::size_t, std::size_t) const;
+    
+    const T& operator[](std::size_t) const;
+    const T& at(std::size_t) const;
+    
+    // defined inline so that vectors are converted to views implicitly
+    friend bool operator==(VectorView u, VectorView v) {
+        return u.size() == v.size() && vector_detail::equal_elements(u.data(), v.data(), u.size());
+    }
+    
+    friend bool operator!=(VectorView u, VectorView v) {
+        return !(u == v);
+    }
+    
+    friend int three_way_compare(VectorView u, VectorView v) {
+        return vector_detail::compare_elements(u.data(), u.size(), v.data(), v.size());
+    }
+    
+    friend bool operator<(VectorView u, VectorView v) {
+        return three_way_compare(u, v) < 0;
+    }
+    
+    friend bool operator>(VectorView u, VectorView v) {
+        return three_way_compare(u, v) > 0;
+    }
+    
+    friend bool operator<=(VectorView u, VectorView v) {
+        return three_way_compare(u, v) <= 0;
+    }
+    
+    friend bool operator>=(VectorView u, VectorView v) {
+        return three_way_compare(u, v) >= 0;
+    }
+    
+    friend T dot_product(VectorView u, VectorView v) {
+        if (u.size() != v.size())
+            throw std::invalid_argument("Vectors must have the same size");
+        
+        return vector_detail::reduce_dot(u.data(), v.data(), u.size());
+    }
+    
+    // distances of two vectors in one pass each, see the Distance kernels
+    friend T l2_squared(VectorView u, VectorView v) {
+        if (u.size() != v.size())
+            throw std::invalid_argument("Vectors must have the same size");
+        
+        return vector_detail::reduce_squared_distance(u.data(), v.data(), u.size());
+    }
+    
+    friend T l1(VectorView u, VectorView v) {
+        if (u.size() != v.size())
+            throw std::invalid_argument("Vectors must have the same size");
+        
+        return vector_detail::reduce_l1(u.data(), v.data(), u.size());
+    }
+    
+    // cosine similarity, 0 if either vector is 0
+    friend T cosine(VectorView u, VectorView v) {
+        static_assert(std::is_floating_point_v<T>, "Cosine similarity needs floating point elements");
+        if (u.size() != v.size())
+            throw std::invalid_argument("Vectors must have the same size");
+        
+        const auto terms = vector_detail::reduce_cosine_terms(u.data(), v.data(), u.size());
+        return vector_detail::cosine_of(terms.uv, std::sqrt(terms.uu), std::sqrt(terms.vv));
+    }
+    
+    // number of differing bits, for integer elements holding packed binary codes
+    friend std::size_t hamming(VectorView u, VectorView v) {
+        static_assert(std::is_integral_v<T>, "Hamming distance needs integer elements");
+        if (u.size() != v.size())
+            throw std::invalid_argument("Vectors must have the same size");
+        
+        return vector_detail::count_differing_bits(u.data(), v.data(), u.size());
+    }
+    
+    friend std::ostream& operator<<(std::ostream& os, VectorView v) {
+        return vector_detail::print(os, v.begin(), v.end());
+    }
+    
+    // iterators
+    const T* begin() const;
+    const T* end() const;
+
+private:
+    const T* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+/*
+ @brief         Non-owning, read-only view of every `stride`-th element.
+ @tparam T      the type of the elements.
+ 
+ Same as VectorView, but the elements are `stride` positions apart,
+ e.g. a column of a row-major matrix. A VectorView or a Vector converts
+ to a strided view with a stride of 1.
+*/
+template <typename T>
+class StridedVectorView {
+public:
+    using value_type = T;
+    using iterator = vector_detail::strided_iterator<T>;
+    
+    StridedVectorView() = default;
+    StridedVectorView(const T*, std::size_t, std::size_t);
+    StridedVectorView(VectorView<T>);
+    
+    template <std::size_t N, typename Allocator>
+    StridedVectorView(const Vector<T, N, Allocator>&);
+    
+    std::size_t size() const;
+    std::size_t stride() const;
+    const T* data() const;
+    
+    T magnitude() const;
+    
+    T mean() const;
+    T median() const;
+    
+    std::variant<T, std::vector<std::size_t>> max() const;
+    std::variant<T, std::vector<std::size_t>> min() const;
+    
+    T sum() const;
+    T product() const;
+    
+    const T& operator[](std::size_t) const;
+    const T& at(std::size_t) const;
+    
+    friend bool operator==(StridedVectorView u, StridedVectorView v) {
+        return u.size() == v.size() && std::equal(u.begin(), u.end(), v.begin());
+    }
+    
+    friend bool operator!=(StridedVectorView u, StridedVectorView v) {
+        return !(u == v);
+    }
+    
+    friend bool operator<(StridedVectorView u, StridedVectorView v) {
+        return std::lexicographical_compare(u.begin(), u.end(), v.begin(), v.end());
+    }
+    
+    friend bool operator>(StridedVectorView u, StridedVectorView v) {
+        return v < u;
+    }
+    
+    friend bool operator<=(StridedVectorView u, StridedVectorView v) {
+        return !(v < u);
+    }
+    
+    friend bool operator>=(StridedVectorView u, StridedVectorView v) {
+        return !(u < v);
+    }
+    
+    friend T dot_product(StridedVectorView u, StridedVectorView v) {
+        if (u.size() != v.size())
+            throw std::invalid_argument("Vectors must have the same size");
+        
+        return vector_detail::reduce_dot_strided(u.data(), u.stride(), v.data(), v.stride(), u.size());
+    }
+    
+    friend std::ostream& operator<<(std::ostream& os, StridedVectorView v) {
+        return vector_detail::print(os, v.begin(), v.end());
+    }
+    
+    // iterators
+    iterator begin() const;
+    iterator end() const;
+
+private:
+    const T* data_ = nullptr;
+    std::size_t size_ = 0;
+    std::size_t stride_ = 1;
+};
+
+/*
+ @brief         Lazy concatenation of two views.
+ @tparam T      the type of the elements.
+ 
+ Reads the elements of both parts in place: nothing is allocated or copied
+ until the concatenation is assigned into a Vector. It is also a vector
+ expression, so it can appear in arithmetic:
+ 
+     Vector<double> scaled = concat_view(head, tail) * 2.0;
+*/
+template <typename T>
+class ConcatView : public VectorExpression<ConcatView<T>> {
+public:
+    using value_type = T;
+    
+    class iterator;
+    
+    ConcatView(VectorView<T>, VectorView<T>);
+    
+    std::size_t size() const;
+    const T& operator[](std::size_t) const;
+    
+    template <typename U>
+    bool aliases(const U*, std::size_t, std::size_t) const;
+    
+    VectorView<T> first() const;
+    VectorView<T> second() const;
+    
+    T mean() const;
+    T sum() const;
+    T product() const;
+    
+    friend std::ostream& operator<<(std::ostream& os, const ConcatView& v) {
+        return vector_detail::print(os, v.begin(), v.end());
+    }
+    
+    // iterators
+    iterator begin() const;
+    iterator end() const;
+
+private:
+    VectorView<T> first_;
+    VectorView<T> second_;
+};
+
+template <typename T>
+class ConcatView<T>::iterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T*;
+    using reference = const T&;
+    
+    iterator() = default;
+    iterator(const ConcatView* view, std::size_t pos) : view_(view), pos_(pos) {}
+    
+    reference operator*() const { return (*view_)[pos_]; }
+    pointer operator->() const { return &(*view_)[pos_]; }
+    
+    iterator& operator++() { ++pos_; return *this; }
+    iterator operator++(int) { auto it = *this; ++pos_; return it; }
+    
+    friend bool operator==(const iterator& a, const iterator& b) { return a.pos_ == b.pos_; }
+    friend bool operator!=(const iterator& a, const iterator& b) { return a.pos_ != b.pos_; }
+
+private:
+    const ConcatView* view_ = nullptr;
+    std::size_t pos_ = 0;
+};
+
+/*
+ @brief     Vector of exactly N elements, stored inline in a std::array.
+ 
+ The size is part of the type, so operands never need to be checked at
+ runtime and every loop is unrolled at compile time. Construction, element
+ access and the arithmetic operators are constexpr:
+ 
+     constexpr Vector<double, 3> x(1.0, 0.0, 0.0), y(0.0, 1.0, 0.0);
+     constexpr auto z = cross_product(x, y);    // (0, 0, 1)
+ 
+ Element-wise operators return a new vector instead of an expression:
+ with a few elements kept in registers there are no temporaries to save.
+ A fixed-size vector converts to a VectorView, and hence to Vector<T>.
+*/
+template <typename T, std::size_t N, typename Allocator>
+class Vector {
+    static_assert(N > 0, "Fixed-size vector should have at least one element");
+    
+public:
+    using value_type = T;
+    
+    constexpr Vector();
+    
+    // one value per element, e.g. Vector<float, 3>(x, y, z)
+    template <typename... Args, typename = std::enable_if_t<sizeof...(Args) == N && (std::is_convertible_v<Args, T> && ...)>>
+    constexpr Vector(Args...);
+    
+    constexpr explicit Vector(const std::array<T, N>&);
+    explicit Vector(VectorView<T>);
+    
+    static constexpr std::size_t size();
+    
+    T magnitude() const;
+    constexpr T mean() const;
+    constexpr T sum() const;
+    constexpr T product() const;
+    
+    void normalize();
+    
+    VectorView<T> view() const;
+    
+    // operator[] is checked by VECTOR_CHECK_INDEX, at() always throws std::out_of_range
+    constexpr T& operator[](std::size_t);
+    constexpr const T& operator[](std::size_t) const;
+    constexpr T& at(std::size_t);
+    constexpr const T& at(std::size_t) const;
+    
+    constexpr Vector& operator+=(const Vector&);
+    constexpr Vector& operator-=(const Vector&);
+    constexpr Vector& operator*=(T);
+    constexpr Vector& operator/=(T);
+    
+    constexpr T* data();
+    constexpr const T* data() const;
+    
+    // iterators
+    constexpr T* begin();
+    constexpr const T* begin() const;
+    constexpr T* end();
+    constexpr const T* end() const;
+    
+private:
+    std::array<T, N> entries;
+};
+
+// overload std::swap
+namespace std {
+    template <typename T, typename Allocator>
+    void swap(Vector<T, Dynamic, Allocator>& v1, Vector<T, Dynamic, Allocator>& v2) noexcept(noexcept(v1.swap(v2))) {
+        v1.swap(v2);
+    }
+    
+    // hash by content, e.g. std::unordered_set<Vector<float>>
+    template <typename T, typename Allocator>
+    struct hash<Vector<T, Dynamic, Allocator>> {
+        std::size_t operator()(const Vector<T, Dynamic, Allocator>& vec) const {
+            return static_cast<std::size_t>(vec.hash());
+        }
+    };
+    
+    template <typename T>
+    struct hash<VectorView<T>> {
+        std::size_t operator()(VectorView<T> view) const {
+            return static_cast<std::size_t>(view.hash());
+        }
+    };
+}
+
+// print vector elements
+template <typename T, typename Allocator>
+std::ostream& operator<<(std::ostream& os, Vector<T, Dynamic, Allocator> const& vec) {
+    return vector_detail::print(os, vec.begin(), vec.end());
+}
+
+inline std::ostream& operator<<(std::ostream& os, const std::vector<std::size_t>& indexes) {
+    os << "[";
+    for (std::size_t i = 0; i < indexes.size(); i++) {
+        os << indexes[i];
+        if (i < indexes.size() - 1)
+            os << ", ";
+    }
+    os << "]";
+    
+    return os;
+}
+
+template <typename T>
+std::ostream& operator<<(std::ostream& os, const std::variant<T, std::vector<std::size_t>>& value) {
+    std::visit([&](auto&& arg) {
+        os << arg;
+    }, value);
+    
+    return os;
+}
+
+template <typename T, typename Allocator>
+Vector<T, Dynamic, Allocator>::Vector(const Allocator& allocator)
+    : allocator_(allocator)
+{}
+
+template <typename T, typename Allocator>
+Vector<T, Dynamic, Allocator>::Vector(std::size_t size, const Allocator& allocator)
+    : allocator_(allocator)
+{
+    VECTOR_OPERATION(construct);
+    reserve(size);
+    
+    try {
+        construct_back(size);
+    }
+    catch (...) {
+        clear();
+        throw;
+    }
+}
+
+/*
+ @brief         Constructs a vector holding a copy of the elements of a view.
+*/
+template <typename T, typename Allocator>
+Vector<T, Dynamic, Allocator>::Vector(VectorView<T> view, const Allocator& allocator)
+    : allocator_(allocator)
+{
+    VECTOR_OPERATION(construct);
+    reserve(view.size());
+    
+    try {
+        copy_back(view.data(), view.size());
+    }
+    catch (...) {
+        clear();
+        throw;
+    }
+}
+
+/*
+ @brief         Constructs a vector without initializing its elements.
+ @param size    the number of elements.
+ 
+ Elements are default-initialized: for trivial types such as float or int
+ their values are indeterminate and should be written before being read.
+ This avoids touching the memory twice when the vector is going to be
+ overwritten right away.
+*/
+template <typename T, typename Allocator>
+Vector<T, Dynamic, Allocator>::Vector(std::size_t size, uninitialized_t, const Allocator& allocator)
+    : allocator_(allocator)
+{
+    VECTOR_OPERATION(construct);
+    reserve(size);
+    
+    try {
+        construct_back_default(size);
+    }
+    catch (...) {
+        clear();
+        throw;
+    }
+}
+
+/*
+ @brief         Constructs a Vector object from a unique_ptr to an array.
+ @tparam T      the type of elements in the array.
+ @param vec     the unique_ptr to the array to construct the vector from.
+ @param size    the number of elements in the array.
+ 
+ The elements of the array are copied into the storage of the vector,
+ the array stays owned by the unique_ptr. If the unique_ptr is null,
+ the size of the vector is 0.
+*/
+template <typename T, typename Allocator>
+Vector<T, Dynamic, Allocator>::Vector(const std::unique_ptr<T[]>& vec, std::size_t size, const Allocator& allocator)
+    : allocator_(allocator)
+{
+    VECTOR_OPERATION(construct);
+    if (!vec)
+        return;
+    
+    reserve(size);
+    
+    try {
+        copy_back(vec.get(), size);
+    }
+    catch (...) {
+        clear();
+        throw;
+    }
+}
+
+/*
+ @brief         Copy constructor.
+ 
+ The copy has its own storage, with the allocator given by
+ select_on_container_copy_construction(), and keeps the cached hash.
+ See SharedVector for copies that share the elements until written.
+*/
+template <typename T, typename Allocator>
+Vector<T, Dynamic, Allocator>::Vector(const Vector& other)
+    : allocator_(alloc_traits::select_on_container_copy_construction(other.allocator_))
+{
+    VECTOR_OPERATION(copy);
+    reserve(other.size_);
+    
+    try {
+        copy_back(other.entries, other.size_);
+    }
+    catch (...) {
+        clear();
+        throw;
+    }
+    
+    cache_hash(other.cached_hash());
+}
+
+/*
+ @brief         Move constructor.
+ 
+ Heap storage is taken over without copying. Inline storage can't be taken
+ over, so small vectors move their elements one by one.
+ The moved-from vector is left empty.
+*/
+template <typename T, typename Allocator>
+Vector<T, Dynamic, Allocator>::Vector(Vector&& other) noexcept(std::is_nothrow_move_constructible_v<T>)
+    : allocator_(std::move(other.allocator_))
+{
+    take_storage(other);
+}
+
+/*
+ @brief         Copy assignment.
+ 
+ The existing storage is reused when it is large enough. The allocator is
+ replaced only if it propagates on copy assignment.
+*/
+template <typename T, typename Allocator>
+Vector<T, Dynamic, Allocator>& Vector<T, Dynamic, Allocator>::operator=(const Vector& other) {
+    VECTOR_OPERATION(copy);
+    if (this == &other)
+        return *this;
+    
+    if constexpr (alloc_traits::propagate_on_container_copy_assignment::value) {
+        if (allocator_ != other.allocator_)
+            clear();
+        allocator_ = other.allocator_;
+    }
+    
+    destroy_all();
+    reserve(other.size_);
+    copy_back(other.entries, other.size_);
+    
+    cache_hash(other.cached_hash());
+    return *this;
+}
+
+/*
+ @brief         Move assignment.
+ 
+ Takes over the storage of `other` like the move constructor, unless the
+ allocators differ and don't propagate: the elements are moved one by one
+ into storage of this allocator then. The moved-from vector is left empty.
+*/
+template <typename T, typename Allocator>
+Vector<T, Dynamic, Allocator>& Vector<T, Dynamic, Allocator>::operator=(Vector&& other) noexcept(nothrow_move_assignable) {
+    if (this == &other)
+        return *this;
+    
+    if (can_steal_on_move || allocator_ == other.allocator_) {
+        clear();
+        if constexpr (alloc_traits::propagate_on_container_move_assignment::value)
+            allocator_ = std::move(other.allocator_);
+        take_storage(other);
+    }
+    else {
+        destroy_all();
+        reserve(other.size_);
+        for (; size_ < other.size_; size_++)
+            alloc_traits::construct(allocator_, entries + size_, std::move(other.entries[size_]));
+        other.clear();
+    }
+    
+    return *this;
+}
+
+/*
+ @brief         Exchanges the elements of two vectors.
+ 
+ Heap storage is exchanged in O(1); if either vector stores its elements
+ inline, or the allocators differ and don't propagate, the vectors are
+ swapped with three moves instead.
+*/
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::swap(Vector& other) noexcept(nothrow_swappable) {
+    if (this == &other)
+        return;
+    
+    const bool on_heap = entries != small_data() && other.entries != other.small_data();
+    if (on_heap && (can_steal_on_swap || allocator_ == other.allocator_)) {
+        using std::swap;
+        if constexpr (alloc_traits::propagate_on_container_swap::value)
+            swap(allocator_, other.allocator_);
+        
+        swap(entries, other.entries);
+        swap(size_, other.size_);
+        swap(capacity_, other.capacity_);
+        
+        const std::uint64_t h = cached_hash();
+        cache_hash(other.cached_hash());
+        other.cache_hash(h);
+    }
+    else {
+        Vector tmp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(tmp);
+    }
+}
+
+template <typename T, typename Allocator>
+Vector<T, Dynamic, Allocator>::~Vector() {
+    clear();
+}
+
+template <typename T, typename Allocator>
+T* Vector<T, Dynamic, Allocator>::small_data() {
+    return reinterpret_cast<T*>(small_);
+}
+
+template <typename T, typename Allocator>
+T* Vector<T, Dynamic, Allocator>::allocate_storage(std::size_t count) {
+    if (count <= small_capacity)
+        return small_data();
+    
+    VECTOR_COUNT(allocations, 1);
+    VECTOR_COUNT(bytes_allocated, count * sizeof(T));
+    return alloc_traits::allocate(allocator_, count);
+}
+
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::deallocate_storage(T* storage, std::size_t count) {
+    if (storage != small_data())
+        alloc_traits::deallocate(allocator_, storage, count);
+}
+
+/*
+ Constructs `count` elements past the end from `args`, value-initializing
+ them when `args` is empty. size_ always counts the constructed elements,
+ so a throwing constructor leaves the vector consistent.
+*/
+template <typename T, typename Allocator>
+template <typename... Args>
+void Vector<T, Dynamic, Allocator>::construct_back(std::size_t count, const Args&... args) {
+    invalidate_hash();
+    
+    const std::size_t new_size = size_ + count;
+    for (; size_ < new_size; size_++)
+        alloc_traits::construct(allocator_, entries + size_, args...);
+}
+
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::construct_back_default(std::size_t count) {
+    if constexpr (std::is_trivially_default_constructible_v<T>) {
+        size_ += count;
+    }
+    else {
+        const std::size_t new_size = size_ + count;
+        for (; size_ < new_size; size_++)
+            ::new (static_cast<void*>(entries + size_)) T;
+    }
+}
+
+// copies `count` elements past the end, see construct_back()
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::copy_back(const T* source, std::size_t count) {
+    invalidate_hash();
+    VECTOR_COUNT(bytes_copied, count * sizeof(T));
+    
+    if constexpr (std::is_trivially_copyable_v<T>) {
+        if (count)
+            std::memcpy(static_cast<void*>(entries + size_), source, count * sizeof(T));
+        size_ += count;
+    }
+    else {
+        for (std::size_t i = 0; i < count; i++, size_++)
+            alloc_traits::construct(allocator_, entries + size_, source[i]);
+    }
+}
+
+/*
+ Takes over the elements of `other`, which is left empty; this vector must
+ be empty, with inline storage, and its allocator must be able to release
+ the storage of `other`.
+*/
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::take_storage(Vector& other) {
+    if (other.entries != other.small_data()) {
+        entries = other.entries;
+        size_ = other.size_;
+        capacity_ = other.capacity_;
+    }
+    else {
+        for (; size_ < other.size_; size_++)
+            alloc_traits::construct(allocator_, entries + size_, std::move(other.entries[size_]));
+        
+        other.destroy_all();
+    }
+    
+    other.entries = other.small_data();
+    other.size_ = 0;
+    other.capacity_ = small_capacity;
+    
+    cache_hash(other.cached_hash());
+    other.invalidate_hash();
+}
+
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::destroy_all() {
+    invalidate_hash();
+    
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+        for (std::size_t i = 0; i < size_; i++)
+            alloc_traits::destroy(allocator_, entries + i);
+    }
+    
+    size_ = 0;
+}
+
+/*
+ @brief         Evaluates a vector expression into a new vector.
+ @param expr    the expression to evaluate, e.g. `a + b * 2`.
+ 
+ All operations of the expression are fused into a single loop, so the only
+ allocation is the one for the result. The elements are not initialized
+ first: trivial ones are written once by that loop, others are constructed
+ from the values of the expression.
+*/
+template <typename T, typename Allocator>
+template <typename E>
+Vector<T, Dynamic, Allocator>::Vector(const VectorExpression<E>& expr) {
+    VECTOR_OPERATION(construct);
+    const E& e = expr.self();
+    reserve(e.size());
+    
+    if constexpr (std::is_trivially_default_constructible_v<T>) {
+        construct_back_default(e.size());
+        apply(e, [](T&, const auto& value) { return T(value); }, 0, size_);
+    }
+    else {
+        try {
+            for (const std::size_t n = e.size(); size_ < n; size_++)
+                alloc_traits::construct(allocator_, entries + size_, T(e[size_]));
+        }
+        catch (...) {
+            clear();
+            throw;
+        }
+    }
+}
+
+/*
+ @brief         Evaluates a vector expression into this vector.
+ @param expr    the expression to evaluate.
+ 
+ The vector may appear in the expression itself. When the sizes match and
+ every element is computed only from the elements at the same position,
+ e.g. for `a = a + b`, the elements are overwritten in place. Otherwise the
+ expression is evaluated into new storage that replaces the old one
+ afterwards, as it still reads elements that would already be overwritten:
+ when the size changes, e.g. for `a = concat_view(a, b)`, or when the vector
+ is read at other positions, e.g. for `a = concat_view(x, a.view(0, 4))`.
+*/
+template <typename T, typename Allocator>
+template <typename E>
+Vector<T, Dynamic, Allocator>& Vector<T, Dynamic, Allocator>::operator=(const VectorExpression<E>& expr) {
+    VECTOR_OPERATION(assign);
+    if (size_ != expr.size() || expr.self().aliases(entries, size_, 0)) {
+        Vector result(expr.size(), uninitialized, allocator_);
+        result.apply(expr.self(), [](T&, const auto& value) { return T(value); }, 0, result.size_);
+        swap(result);
+        
+        return *this;
+    }
+    
+    invalidate_hash();
+    apply(expr.self(), [](T&, const auto& value) { return T(value); }, 0, size_);
+    return *this;
+}
+
+// out[i] = op(out[i], expr[i]) for i in [first, last); callers drop the cached hash first, once for all the tasks
+template <typename T, typename Allocator>
+template <typename E, typename Op>
+void Vector<T, Dynamic, Allocator>::apply(const E& expr, Op op, std::size_t first, std::size_t last) {
+    T* out = entries;
+    for (std::size_t i = first; i < last; i++)
+        out[i] = op(out[i], expr[i]);
+}
+
+template <typename T, typename Allocator>
+std::size_t Vector<T, Dynamic, Allocator>::size() const {
+    return size_;
+}
+
+template <typename T, typename Allocator>
+Allocator Vector<T, Dynamic, Allocator>::get_allocator() const {
+    return allocator_;
+}
+
+template <typename T, typename Allocator>
+T Vector<T, Dynamic, Allocator>::magnitude() const {
+    VECTOR_OPERATION(reduce);
+    return std::sqrt(dot_product(*this, *this));
+}
+
+template <typename T, typename Allocator>
+T Vector<T, Dynamic, Allocator>::mean() const {
+    VECTOR_OPERATION(reduce);
+    if (size_ == 0)
+        throw std::logic_error("Vector is empty");
+    
+    return sum() / size_;
+}
+
+/*
+ @brief     Calculates the median of the vector without reordering it.
+ @return    The middle element, or the mean of the two middle elements for an even size.
+ 
+ The elements are selected in a per-thread scratch buffer, see vector_detail::scratch_arena.
+ Throws std::length_error if the vector is empty.
+*/
+template <typename T, typename Allocator>
+T Vector<T, Dynamic, Allocator>::median() const {
+    return median(execution::seq);
+}
+
+/*
+ @brief     Calculates a quantile of the vector without reordering it.
+ @param p   the probability, in [0, 1].
+ @return    The value interpolated linearly between the two closest ranks.
+ 
+ Throws std::invalid_argument if p is out of range, std::length_error if the vector is empty.
+*/
+template <typename T, typename Allocator>
+T Vector<T, Dynamic, Allocator>::quantile(double p) const {
+    return quantile(execution::seq, p);
+}
+
+/*
+ @brief     Calculates several quantiles at once, e.g. `v.quantiles({ 0.5, 0.9, 0.99 })`.
+ @return    The quantiles in the order of the probabilities.
+ 
+ One selection pass places all the needed ranks, which is cheaper than
+ calling quantile() for every probability.
+*/
+template <typename T, typename Allocator>
+std::vector<T> Vector<T, Dynamic, Allocator>::quantiles(std::initializer_list<double> ps) const {
+    return quantiles(execution::seq, ps);
+}
+
+/*
+ @brief         Calculates the quantiles of the probabilities in [first, last).
+ @param out     the output iterator to write the quantiles to.
+ @return        The output iterator past the last written quantile.
+*/
+template <typename T, typename Allocator>
+template <typename InputIt, typename OutputIt>
+OutputIt Vector<T, Dynamic, Allocator>::quantiles(InputIt first, InputIt last, OutputIt out) const {
+    return quantiles(execution::seq, first, last, out);
+}
+
+/*
+ @brief     Finds the maximum element(s) in the vector.
+ @return    A std::variant object containing either the maximum element or a vector of indexes of the maximum elements.
+ 
+ This function finds the maximum element(s) in the vector and returns them in a std::variant object.
+ If there is only one maximum element, the function returns the element itself.
+ If there are multiple maximum elements, the function returns a vector of indexes of those elements.
+ 
+ The function uses the std::max_element function to find the maximum element(s) in the vector.
+ 
+ If there is only one maximum element, the function counts the number of occurrences of that element in the vector.
+ If there is only one occurrence, the function returns the index of that element.
+ If there are multiple occurrences, the function creates a vector of indexes of those occurrences and returns it.
+ 
+ Note that if the vector is empty, the function returns the default-constructed std::variant object,
+ which contains the value of the first alternative (i.e., a default-constructed T object).
+*/
+template <typename T, typename Allocator>
+std::variant<T, std::vector<std::size_t>> Vector<T, Dynamic, Allocator>::max() const {
+    return max(execution::seq);
+}
+
+template <typename T, typename Allocator>
+std::variant<T, std::vector<std::size_t>> Vector<T, Dynamic, Allocator>::min() const {
+    return min(execution::seq);
+}
+
+/*
+ @brief     Finds the smallest and the largest element in a single pass.
+ @return    Both values with the index of their first occurrence.
+ 
+ Throws std::length_error if the vector is empty.
+*/
+template <typename T, typename Allocator>
+MinMax<T> Vector<T, Dynamic, Allocator>::minmax() const {
+    VECTOR_OPERATION(extrema);
+    return minmax(execution::seq);
+}
+
+/*
+ @brief     Computes the sum, the sum of squares, and the smallest and largest
+            elements with their indexes, in a single pass.
+ 
+ Asking for these separately costs a pass over the vector each; here every
+ element is read once, and the blocks that improve on an extremum are
+ searched for its index while they are still in L1. The mean, variance and
+ magnitude follow from the sums, see Summary. Throws std::length_error if
+ the vector is empty.
+*/
+template <typename T, typename Allocator>
+Summary<T> Vector<T, Dynamic, Allocator>::describe() const {
+    VECTOR_OPERATION(extrema);
+    return describe(execution::seq);
+}
+
+// the largest element and the index of its first occurrence
+template <typename T, typename Allocator>
+IndexedValue<T> Vector<T, Dynamic, Allocator>::argmax() const {
+    VECTOR_OPERATION(extrema);
+    return argmax(execution::seq);
+}
+
+// the smallest element and the index of its first occurrence
+template <typename T, typename Allocator>
+IndexedValue<T> Vector<T, Dynamic, Allocator>::argmin() const {
+    VECTOR_OPERATION(extrema);
+    return argmin(execution::seq);
+}
+
+/*
+ @brief         Writes the indexes of all the largest elements, in increasing order.
+ @param out     the output iterator to write the indexes to.
+ @return        The output iterator past the last written index.
+ 
+ Nothing is allocated, e.g. `v.argmax_all(std::back_inserter(ties))` or
+ a pointer into a buffer known to be large enough. Nothing is written if
+ the vector is empty.
+*/
+template <typename T, typename Allocator>
+template <typename OutputIt>
+OutputIt Vector<T, Dynamic, Allocator>::argmax_all(OutputIt out) const {
+    if (size_ == 0)
+        return out;
+    
+    const auto best = argmax();
+    return vector_detail::indexes_of(entries, best.index, size_, best.value, out);
+}
+
+template <typename T, typename Allocator>
+template <typename OutputIt>
+OutputIt Vector<T, Dynamic, Allocator>::argmin_all(OutputIt out) const {
+    if (size_ == 0)
+        return out;
+    
+    const auto best = argmin();
+    return vector_detail::indexes_of(entries, best.index, size_, best.value, out);
+}
+
+/*
+ @brief     Finds the k largest elements without reordering the vector.
+ @return    The elements and their indexes, largest first; equal elements
+            are in index order. All the elements if k exceeds the size.
+ 
+ Small k cost about as much as max(), see "Top-k selection".
+*/
+template <typename T, typename Allocator>
+std::vector<IndexedValue<T>> Vector<T, Dynamic, Allocator>::top_k(std::size_t k) const {
+    VECTOR_OPERATION(extrema);
+    return top_k(execution::seq, k);
+}
+
+// the indexes of top_k(k), in the same order
+template <typename T, typename Allocator>
+std::vector<std::size_t> Vector<T, Dynamic, Allocator>::argtop_k(std::size_t k) const {
+    VECTOR_OPERATION(extrema);
+    return argtop_k(execution::seq, k);
+}
+
+template <typename T, typename Allocator>
+T Vector<T, Dynamic, Allocator>::sum() const {
+    VECTOR_OPERATION(reduce);
+    return vector_detail::reduce_sum(entries, size_);
+}
+
+template <typename T, typename Allocator>
+T Vector<T, Dynamic, Allocator>::product() const {
+    VECTOR_OPERATION(reduce);
+    return vector_detail::reduce_product(entries, size_);
+}
+
+/*
+ @brief     Divides the vector by its magnitude, unless the magnitude is 0.
+ 
+ The magnitude has to be known before the first element is scaled, so
+ this takes two passes. The first one leaves the end of the vector in
+ cache, hence the second one scales the last MiB first, then the rest from
+ the start: for vectors a few times larger than the cache, that part is not
+ read from memory again.
+*/
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::normalize() {
+    VECTOR_OPERATION(reduce);
+    static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>, "Vector should consist of double or float types");
+    
+    T mag = magnitude();
+    if (mag == 0)
+        return;
+    
+    invalidate_hash();
+    
+    const T scalar = 1 / mag;
+    const std::size_t tail = size_ - std::min(size_, vector_detail::normalize_tail / sizeof(T));
+    for (std::size_t i = tail; i < size_; i++)
+        entries[i] *= scalar;
+    for (std::size_t i = 0; i < tail; i++)
+        entries[i] *= scalar;
+}
+
+/*
+ @brief         Parallel versions of the reductions.
+ @param policy  execution::seq, or execution::par to split the work between
+                the threads of VectorThreadPool::instance().
+ 
+ Floating point results may differ from the serial versions in the last
+ bits, and may depend on the number of threads, since the partial sums are
+ grouped differently.
+*/
+template <typename T, typename Allocator>
+template <typename Policy>
+T Vector<T, Dynamic, Allocator>::sum(const Policy& policy) const {
+    VECTOR_OPERATION(reduce);
+    if constexpr (accumulation::is_accumulation_policy_v<Policy>)
+        return sum(execution::seq, policy);
+    else
+        return sum(policy, accumulation::naive);
+}
+
+template <typename T, typename Allocator>
+template <typename Policy>
+T Vector<T, Dynamic, Allocator>::product(const Policy& policy) const {
+    VECTOR_OPERATION(reduce);
+    return vector_detail::reduce_chunks(policy, size_, [this](std::size_t begin, std::size_t end) {
+        return vector_detail::reduce_product(entries + begin, end - begin);
+    }, std::multiplies<>());
+}
+
+template <typename T, typename Allocator>
+template <typename Policy>
+T Vector<T, Dynamic, Allocator>::magnitude(const Policy& policy) const {
+    VECTOR_OPERATION(reduce);
+    return std::sqrt(dot_product(policy, *this, *this));
+}
+
+template <typename T, typename Allocator>
+template <typename Policy>
+T Vector<T, Dynamic, Allocator>::mean(const Policy& policy) const {
+    VECTOR_OPERATION(reduce);
+    if (size_ == 0)
+        throw std::logic_error("Vector is empty");
+    
+    return sum(policy) / size_;
+}
+
+/*
+ @brief                 Reductions with a chosen accumulation policy.
+ @param policy          execution::seq or execution::par.
+ @param accumulation    accumulation::naive, pairwise, kahan or widened.
+ 
+ In parallel, every task accumulates its chunk with the policy and the
+ partial results are added in T.
+*/
+template <typename T, typename Allocator>
+template <typename Policy, typename Accumulation>
+T Vector<T, Dynamic, Allocator>::sum(const Policy& policy, const Accumulation&) const {
+    VECTOR_OPERATION(reduce);
+    return vector_detail::sum_of<Accumulation>(policy, entries, size_);
+}
+
+template <typename T, typename Allocator>
+template <typename Policy, typename Accumulation>
+T Vector<T, Dynamic, Allocator>::mean(const Policy& policy, const Accumulation& accumulation) const {
+    VECTOR_OPERATION(reduce);
+    if (size_ == 0)
+        throw std::logic_error("Vector is empty");
+    
+    return sum(policy, accumulation) / size_;
+}
+
+template <typename T, typename Allocator>
+template <typename Policy, typename Accumulation>
+T Vector<T, Dynamic, Allocator>::magnitude(const Policy& policy, const Accumulation& accumulation) const {
+    VECTOR_OPERATION(reduce);
+    return std::sqrt(dot_product(policy, accumulation, *this, *this));
+}
+
+/*
+ @brief         Median computed without reordering the vector.
+ 
+ With execution::par the element is found by a parallel sample select,
+ see vector_detail::select_ranks.
+*/
+template <typename T, typename Allocator>
+template <typename Policy>
+T Vector<T, Dynamic, Allocator>::median(const Policy& policy) const {
+    return vector_detail::median_of(policy, entries, size_);
+}
+
+template <typename T, typename Allocator>
+template <typename Policy>
+T Vector<T, Dynamic, Allocator>::quantile(const Policy& policy, double p) const {
+    return vector_detail::quantile_of(policy, entries, size_, p);
+}
+
+template <typename T, typename Allocator>
+template <typename Policy>
+std::vector<T> Vector<T, Dynamic, Allocator>::quantiles(const Policy& policy, std::initializer_list<double> ps) const {
+    std::vector<T> values;
+    values.reserve(ps.size());
+    quantiles(policy, ps.begin(), ps.end(), std::back_inserter(values));
+    
+    return values;
+}
+
+template <typename T, typename Allocator>
+template <typename Policy, typename InputIt, typename OutputIt>
+OutputIt Vector<T, Dynamic, Allocator>::quantiles(const Policy& policy, InputIt first, InputIt last, OutputIt out) const {
+    return vector_detail::quantiles_of(policy, entries, size_, first, last, out);
+}
+
+template <typename T, typename Allocator>
+template <typename Policy>
+std::variant<T, std::vector<std::size_t>> Vector<T, Dynamic, Allocator>::max(const Policy& policy) const {
+    if (size_ == 0)
+        return {};
+    
+    return vector_detail::extremum(policy, entries, size_, argmax(policy));
+}
+
+template <typename T, typename Allocator>
+template <typename Policy>
+std::variant<T, std::vector<std::size_t>> Vector<T, Dynamic, Allocator>::min(const Policy& policy) const {
+    if (size_ == 0)
+        return {};
+    
+    return vector_detail::extremum(policy, entries, size_, argmin(policy));
+}
+
+template <typename T, typename Allocator>
+template <typename Policy>
+MinMax<T> Vector<T, Dynamic, Allocator>::minmax(const Policy& policy) const {
+    VECTOR_OPERATION(extrema);
+    return vector_detail::extrema<Policy, T, true, true>(policy, entries, size_);
+}
+
+template <typename T, typename Allocator>
+template <typename Policy>
+Summary<T> Vector<T, Dynamic, Allocator>::describe(const Policy& policy) const {
+    VECTOR_OPERATION(extrema);
+    return vector_detail::summary(policy, entries, size_);
+}
+
+template <typename T, typename Allocator>
+template <typename Policy>
+IndexedValue<T> Vector<T, Dynamic, Allocator>::argmax(const Policy& policy) const {
+    VECTOR_OPERATION(extrema);
+    return vector_detail::extrema<Policy, T, false, true>(policy, entries, size_).max;
+}
+
+template <typename T, typename Allocator>
+template <typename Policy>
+IndexedValue<T> Vector<T, Dynamic, Allocator>::argmin(const Policy& policy) const {
+    VECTOR_OPERATION(extrema);
+    return vector_detail::extrema<Policy, T, true, false>(policy, entries, size_).min;
+}
+
+/*
+ @brief             Writes the indexes of all the largest elements into a buffer.
+ @param policy      the execution policy.
+ @param buffer      the buffer to write the indexes to, in increasing order.
+ @param capacity    the size of the buffer.
+ @return            The number of largest elements, which may exceed capacity:
+                    only the first `capacity` indexes are written then.
+*/
+template <typename T, typename Allocator>
+template <typename Policy>
+std::size_t Vector<T, Dynamic, Allocator>::argmax_all(const Policy& policy, std::size_t* buffer, std::size_t capacity) const {
+    if (size_ == 0)
+        return 0;
+    
+    return vector_detail::indexes_of(policy, entries, size_, argmax(policy).value, buffer, capacity);
+}
+
+template <typename T, typename Allocator>
+template <typename Policy>
+std::size_t Vector<T, Dynamic, Allocator>::argmin_all(const Policy& policy, std::size_t* buffer, std::size_t capacity) const {
+    if (size_ == 0)
+        return 0;
+    
+    return vector_detail::indexes_of(policy, entries, size_, argmin(policy).value, buffer, capacity);
+}
+
+template <typename T, typename Allocator>
+template <typename Policy>
+std::vector<IndexedValue<T>> Vector<T, Dynamic, Allocator>::top_k(const Policy& policy, std::size_t k) const {
+    VECTOR_OPERATION(extrema);
+    return vector_detail::top_k_of(policy, entries, size_, k);
+}
+
+template <typename T, typename Allocator>
+template <typename Policy>
+std::vector<std::size_t> Vector<T, Dynamic, Allocator>::argtop_k(const Policy& policy, std::size_t k) const {
+    VECTOR_OPERATION(extrema);
+    return vector_detail::top_k_indexes(vector_detail::top_k_of(policy, entries, size_, k));
+}
+
+template <typename T, typename Allocator>
+template <typename Policy>
+void Vector<T, Dynamic, Allocator>::normalize(const Policy& policy) {
+    VECTOR_OPERATION(reduce);
+    static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>, "Vector should consist of double or float types");
+    
+    T mag = magnitude(policy);
+    if (mag == 0)
+        return;
+    
+    scale(policy, 1 / mag);
+}
+
+/*
+ @brief         Evaluates a vector expression into this vector, in parallel.
+ @param policy  the execution policy.
+ @param expr    the expression to evaluate.
+ 
+ Parallel version of operator=, e.g. `d.assign(execution::par, a + b - c)`.
+ Use `v.assign(execution::par, v + w)` for a parallel `v += w`. As with
+ operator=, the vector may appear in the expression.
+*/
+template <typename T, typename Allocator>
+template <typename Policy, typename E>
+Vector<T, Dynamic, Allocator>& Vector<T, Dynamic, Allocator>::assign(const Policy& policy, const VectorExpression<E>& expr) {
+    VECTOR_OPERATION(assign);
+    if (size_ != expr.size() || expr.self().aliases(entries, size_, 0)) {
+        // the vector may be part of the expression, see operator=
+        Vector result(expr.size(), uninitialized, allocator_);
+        result.assign(policy, expr);
+        swap(result);
+        
+        return *this;
+    }
+    
+    invalidate_hash();
+    vector_detail::for_each_chunk(policy, size_, [&](std::size_t begin, std::size_t end) {
+        apply(expr.self(), [](T&, const auto& value) { return T(value); }, begin, end);
+    });
+    
+    return *this;
+}
+
+// parallel version of operator*=
+template <typename T, typename Allocator>
+template <typename Policy>
+Vector<T, Dynamic, Allocator>& Vector<T, Dynamic, Allocator>::scale(const Policy& policy, T scalar) {
+    invalidate_hash();
+    
+    vector_detail::for_each_chunk(policy, size_, [&](std::size_t begin, std::size_t end) {
+        std::transform(entries + begin, entries + end, entries + begin, [scalar](T x) {
+            return x * scalar;
+        });
+    });
+    
+    return *this;
+}
+
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::clear() {
+    destroy_all();
+    deallocate_storage(entries, capacity_);
+    
+    entries = small_data();
+    capacity_ = small_capacity;
+}
+
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::resize(std::size_t size, const T& default_value) {
+    VECTOR_OPERATION(resize);
+    if (size > size_) {
+        if (size > capacity_)
+            grow(size);
+        
+        construct_back(size - size_, default_value);
+    }
+    else {
+        destroy_back(size_ - size);
+    }
+}
+
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::reserve(std::size_t count) {
+    VECTOR_OPERATION(reserve);
+    if (count > capacity_)
+        reallocate(count);
+}
+
+/*
+ @brief     Releases the unused capacity.
+ 
+ Vectors small enough to be stored inline move back into the inline buffer.
+*/
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::shrink_to_fit() {
+    VECTOR_OPERATION(reserve);
+    if (entries != small_data() && capacity_ > size_)
+        reallocate(size_);
+}
+
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::push_back(const T& value) {
+    VECTOR_OPERATION(push_back);
+    emplace_back(value);
+}
+
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::push_back(T&& value) {
+    VECTOR_OPERATION(push_back);
+    emplace_back(std::move(value));
+}
+
+/*
+ @brief         Constructs an element in place at the end of the vector.
+ @param args    the arguments to forward to the constructor of the element.
+ @return        A reference to the new element.
+ 
+ Amortized O(1): the capacity grows geometrically, so appending n elements
+ one by one does O(log n) reallocations.
+*/
+template <typename T, typename Allocator>
+template <typename... Args>
+T& Vector<T, Dynamic, Allocator>::emplace_back(Args&&... args) {
+    VECTOR_OPERATION(push_back);
+    invalidate_hash();
+    
+    if (size_ == capacity_) {
+        // the arguments may refer to an element of this vector,
+        // so build the value before the storage is moved
+        T value(std::forward<Args>(args)...);
+        grow(size_ + 1);
+        alloc_traits::construct(allocator_, entries + size_, std::move(value));
+    }
+    else {
+        alloc_traits::construct(allocator_, entries + size_, std::forward<Args>(args)...);
+    }
+    
+    return entries[size_++];
+}
+
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::pop_back() {
+    if (size_ == 0)
+        throw std::out_of_range("Vector is empty");
+    
+    destroy_back(1);
+}
+
+template <typename T, typename Allocator>
+std::size_t Vector<T, Dynamic, Allocator>::capacity() const {
+    return capacity_;
+}
+
+// grows the capacity geometrically to hold at least `count` elements
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::grow(std::size_t count) {
+    reallocate(std::max(count, 2 * capacity_));
+}
+
+/*
+ Moves the elements into new storage for `count` elements, count >= size_.
+ Elements are moved (or copied in bulk when trivially copyable), unless
+ their move constructor may throw and a copy is possible.
+*/
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::reallocate(std::size_t count) {
+    T* new_entries = allocate_storage(count);
+    if (new_entries == entries)
+        return;
+    
+    if (size_) {
+        VECTOR_COUNT(reallocations, 1);
+        VECTOR_COUNT(bytes_copied, size_ * sizeof(T));
+    }
+    
+    if constexpr (std::is_trivially_copyable_v<T>) {
+        if (size_)
+            std::memcpy(static_cast<void*>(new_entries), entries, size_ * sizeof(T));
+    }
+    else {
+        std::size_t constructed = 0;
+        try {
+            for (; constructed < size_; constructed++)
+                alloc_traits::construct(allocator_, new_entries + constructed, std::move_if_noexcept(entries[constructed]));
+        }
+        catch (...) {
+            for (std::size_t i = 0; i < constructed; i++)
+                alloc_traits::destroy(allocator_, new_entries + i);
+            
+            deallocate_storage(new_entries, count);
+            throw;
+        }
+    }
+    
+    const std::size_t size = size_;
+    clear();
+    
+    entries = new_entries;
+    size_ = size;
+    capacity_ = std::max(count, small_capacity);
+}
+
+/*
+ Shifts the elements from `pos` on `count` places to the right, growing the
+ capacity if needed. The slots [pos, pos + count) are left holding
+ moved-from or default-initialized elements, to be assigned by the caller.
+*/
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::open_gap(std::size_t pos, std::size_t count) {
+    invalidate_hash();
+    
+    if (size_ + count > capacity_)
+        grow(size_ + count);
+    
+    VECTOR_COUNT(bytes_copied, (size_ - pos) * sizeof(T));
+    
+    if constexpr (std::is_trivially_copyable_v<T>) {
+        std::memmove(static_cast<void*>(entries + pos + count), entries + pos, (size_ - pos) * sizeof(T));
+        size_ += count;
+    }
+    else {
+        const std::size_t old_size = size_;
+        
+        // the slots past the old end are constructed from the tail, or are part of the gap
+        for (std::size_t i = old_size; i < old_size + count; i++, size_++) {
+            if (i >= pos + count)
+                alloc_traits::construct(allocator_, entries + i, std::move(entries[i - count]));
+            else
+                ::new (static_cast<void*>(entries + i)) T;
+        }
+        
+        if (old_size > pos + count)
+            std::move_backward(entries + pos, entries + old_size - count, entries + old_size);
+    }
+}
+
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::destroy_back(std::size_t count) {
+    invalidate_hash();
+    
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+        for (std::size_t i = size_ - count; i < size_; i++)
+            alloc_traits::destroy(allocator_, entries + i);
+    }
+    
+    size_ -= count;
+}
+
+template <typename T, typename Allocator>
+Vector<T, Dynamic, Allocator> Vector<T, Dynamic, Allocator>::subvec(std::size_t start, std::size_t end) const {
+    VECTOR_OPERATION(subvec);
+    if (start >= end || end > size())
+        throw std::out_of_range("Invalid range for subvector");
+    
+    Vector<T, Dynamic, Allocator> sub(end - start, uninitialized, allocator_);
+    std::copy(entries + start, entries + end, sub.entries);
+    VECTOR_COUNT(bytes_copied, (end - start) * sizeof(T));
+    
+    return sub;
+}
+
+template <typename T, typename Allocator>
+VectorView<T> Vector<T, Dynamic, Allocator>::view() const {
+    return VectorView<T>(entries, size_);
+}
+
+/*
+ @brief         Returns a view of the elements in [start, end), without copying.
+ 
+ The view is invalidated when the vector is reallocated or destroyed.
+ Use subvec() to get an independent copy instead.
+*/
+template <typename T, typename Allocator>
+VectorView<T> Vector<T, Dynamic, Allocator>::view(std::size_t start, std::size_t end) const {
+    return view().view(start, end);
+}
+
+template <typename T, typename Allocator>
+StridedVectorView<T> Vector<T, Dynamic, Allocator>::strided_view(std::size_t start, std::size_t count, std::size_t stride) const {
+    return view().strided_view(start, count, stride);
+}
+
+template <typename T, typename Allocator>
+Vector<T, Dynamic, Allocator> concat(const Vector<T, Dynamic, Allocator>& v1, const Vector<T, Dynamic, Allocator>& v2) {
+    VECTOR_OPERATION(concat);
+    Vector<T, Dynamic, Allocator> result(v1.size() + v2.size(), uninitialized, v1.get_allocator());
+    
+    std::copy(v1.begin(), v1.end(), result.begin());
+    std::copy(v2.begin(), v2.end(), result.begin() + v1.size());
+    VECTOR_COUNT(bytes_copied, result.size() * sizeof(T));
+    
+    return result;
+}
+
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::insert(std::size_t pos, const T& value) {
+    VECTOR_OPERATION(insert);
+    if (pos > size())
+        throw std::out_of_range("Index out of range");
+    
+    if (pos == size_) {
+        emplace_back(value);
+        return;
+    }
+    
+    // value may refer to an element that is about to be shifted
+    T copy(value);
+    open_gap(pos, 1);
+    entries[pos] = std::move(copy);
+}
+
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::insert(std::size_t pos, std::size_t count, const T& value) {
+    VECTOR_OPERATION(insert);
+    if (pos > size())
+        throw std::out_of_range("Index out of range");
+    
+    T copy(value);
+    open_gap(pos, count);
+    std::fill_n(entries + pos, count, copy);
+}
+
+template <typename T, typename Allocator>
+template <typename InputIt, typename>
+void Vector<T, Dynamic, Allocator>::insert(std::size_t pos, InputIt first, InputIt last) {
+    VECTOR_OPERATION(insert);
+    if (pos > size())
+        throw std::out_of_range("Index out of range");
+    
+    const std::size_t count = std::distance(first, last);
+    open_gap(pos, count);
+    std::copy(first, last, entries + pos);
+}
+
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::insert(std::size_t pos, std::initializer_list<T> ilist) {
+    VECTOR_OPERATION(insert);
+    insert(pos, ilist.begin(), ilist.end());
+}
+
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::erase(std::size_t pos) {
+    VECTOR_OPERATION(erase);
+    if (pos >= size())
+        throw std::out_of_range("Index out of range");
+    
+    VECTOR_COUNT(bytes_copied, (size_ - pos - 1) * sizeof(T));
+    std::move(begin() + pos + 1, end(), begin() + pos);
+    destroy_back(1);
+}
+
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::erase(std::size_t first, std::size_t last) {
+    VECTOR_OPERATION(erase);
+    if (first >= size() || last > size() || first >= last)
+        throw std::out_of_range("Invalid range");
+    
+    VECTOR_COUNT(bytes_copied, (size_ - last) * sizeof(T));
+    std::move(entries + last, entries + size(), entries + first);
+    destroy_back(last - first);
+}
+
+/*
+ @brief     Element i, checked by VECTOR_CHECK_INDEX.
+ 
+ In release builds the index isn't checked at all, so loops reading the
+ elements through the const overload can be vectorized; debug builds
+ assert() it and VECTOR_CHECKED_ACCESS makes it throw like at(). Every
+ call also drops the cached hash with an atomic store, which keeps loops
+ writing through it scalar: write through data() or an expression in hot
+ loops.
+*/
+template <typename T, typename Allocator>
+T& Vector<T, Dynamic, Allocator>::operator[](std::size_t i) {
+    VECTOR_CHECK_INDEX(i, size_);
+    invalidate_hash();
+    return entries[i];
+}
+
+template <typename T, typename Allocator>
+const T& Vector<T, Dynamic, Allocator>::operator[](std::size_t i) const {
+    VECTOR_CHECK_INDEX(i, size_);
+    return entries[i];
+}
+
+// element i, throws std::out_of_range if i is not less than size()
+template <typename T, typename Allocator>
+T& Vector<T, Dynamic, Allocator>::at(std::size_t i) {
+    if (i >= size_)
+        throw std::out_of_range("Index out of range");
+    
+    invalidate_hash();
+    return entries[i];
+}
+
+template <typename T, typename Allocator>
+const T& Vector<T, Dynamic, Allocator>::at(std::size_t i) const {
+    if (i >= size_)
+        throw std::out_of_range("Index out of range");
+    
+    return entries[i];
+}
+
+/*
+ @brief     Compares the elements, see vector_detail::equal_elements().
+ 
+ Vectors of different sizes, or whose cached hashes differ, are rejected
+ without reading the elements.
+*/
+template <typename T, typename Allocator>
+bool Vector<T, Dynamic, Allocator>::operator==(const Vector& other) const {
+    if (size_ != other.size_)
+        return false;
+    
+    const std::uint64_t h1 = cached_hash(), h2 = other.cached_hash();
+    if (h1 && h2 && h1 != h2)
+        return false;
+    
+    return vector_detail::equal_elements(entries, other.entries, size_);
+}
+
+template <typename T, typename Allocator>
+bool Vector<T, Dynamic, Allocator>::operator!=(const Vector& other) const {
+    return !(*this == other);
+}
+
+/*
+ @brief     64-bit hash of the elements, computed once and cached.
+ 
+ Equal vectors have equal hashes, so the hash can key hash sets, and
+ operator== compares the cached hashes first. Every non-const member
+ function, including operator[], data() and begin(), drops the cached
+ value; a vector must not be written through pointers obtained before
+ calling hash().
+*/
+template <typename T, typename Allocator>
+std::uint64_t Vector<T, Dynamic, Allocator>::hash() const {
+    std::uint64_t h = cached_hash();
+    if (h == 0) {
+        h = vector_detail::hash_elements(entries, size_);
+        cache_hash(h);
+    }
+    
+    return h;
+}
+
+// the hash computed since the last write, 0 if there is none
+template <typename T, typename Allocator>
+std::uint64_t Vector<T, Dynamic, Allocator>::cached_hash() const {
+    return hash_.load(std::memory_order_relaxed);
+}
+
+// threads calling hash() at once may all store it, they compute the same value
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::cache_hash(std::uint64_t h) const {
+    hash_.store(h, std::memory_order_relaxed);
+}
+
+/*
+ A relaxed atomic store, so that threads writing different elements of the
+ same vector through operator[], data() or begin() don't race. It is
+ never moved out of a loop, hence the bulk operations drop the hash once
+ and then write through entries.
+*/
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::invalidate_hash() {
+    hash_.store(0, std::memory_order_relaxed);
+}
+
+/*
+ @brief     Lexicographical comparison in a single pass over the elements.
+ @return    A negative value if v1 < v2, a positive one if v1 > v2, 0 if
+            neither is less than the other.
+ 
+ The relational operators are defined with it, so they stop at the first
+ element that differs, found a SIMD register at a time for arithmetic types
+ (see vector_detail::compare_elements()).
+*/
+template <typename T, typename Allocator>
+int three_way_compare(const Vector<T, Dynamic, Allocator>& v1, const Vector<T, Dynamic, Allocator>& v2) {
+    return vector_detail::compare_elements(v1.entries, v1.size(), v2.entries, v2.size());
+}
+
+template <typename T, typename Allocator>
+bool operator<(const Vector<T, Dynamic, Allocator>& v1, const Vector<T, Dynamic, Allocator>& v2) {
+    return three_way_compare(v1, v2) < 0;
+}
+
+template <typename T, typename Allocator>
+bool operator>(const Vector<T, Dynamic, Allocator>& v1, const Vector<T, Dynamic, Allocator>& v2) {
+    return three_way_compare(v1, v2) > 0;
+}
+
+template <typename T, typename Allocator>
+bool operator<=(const Vector<T, Dynamic, Allocator>& v1, const Vector<T, Dynamic, Allocator>& v2) {
+    return three_way_compare(v1, v2) <= 0;
+}
+
+template <typename T, typename Allocator>
+bool operator>=(const Vector<T, Dynamic, Allocator>& v1, const Vector<T, Dynamic, Allocator>& v2) {
+    return three_way_compare(v1, v2) >= 0;
+}
+
+template <typename T, typename Allocator>
+Vector<T, Dynamic, Allocator>& Vector<T, Dynamic, Allocator>::operator*=(T scalar) {
+    invalidate_hash();
+    
+    std::transform(entries,
+        entries + size_,
+        entries, [scalar](T x)
+    {
+        return x * scalar;
+    });
+    
+    return *this;
+}
+
+/*
+ @brief         Adds a vector, a view or an expression of the same size element-wise.
+ @param other   the operand, std::invalid_argument is thrown if its size differs.
+ 
+ The vector may appear in the operand, with the same rules as operator=:
+ `a += a * 2.0` is evaluated in place, while an operand that reads the vector
+ at other positions, e.g. `a += concat_view(x, a.view(0, 4))`, is evaluated
+ into a temporary vector first.
+*/
+template <typename T, typename Allocator>
+template <typename E>
+Vector<T, Dynamic, Allocator>& Vector<T, Dynamic, Allocator>::operator+=(const E& other) {
+    static_assert(vector_detail::is_operand_v<E>, "Right-hand side should be a vector or a vector expression");
+    
+    const auto& expr = vector_detail::as_expression(other);
+    if (size() != expr.size())
+        throw std::invalid_argument("Vectors must have the same size");
+    
+    // the vector is read at other positions, see operator=
+    if (expr.aliases(entries, size_, 0))
+        return *this += Vector(expr);
+    
+    invalidate_hash();
+    apply(expr, [](const T& lhs, const auto& rhs) { return T(lhs + rhs); }, 0, size_);
+    return *this;
+}
+
+// subtracts element-wise, the vector may appear in the operand as for operator+=
+template <typename T, typename Allocator>
+template <typename E>
+Vector<T, Dynamic, Allocator>& Vector<T, Dynamic, Allocator>::operator-=(const E& other) {
+    static_assert(vector_detail::is_operand_v<E>, "Right-hand side should be a vector or a vector expression");
+    
+    const auto& expr = vector_detail::as_expression(other);
+    if (size() != expr.size())
+        throw std::invalid_argument("Vectors must have the same size");
+    
+    // the vector is read at other positions, see operator=
+    if (expr.aliases(entries, size_, 0))
+        return *this -= Vector(expr);
+    
+    invalidate_hash();
+    apply(expr, [](const T& lhs, const auto& rhs) { return T(lhs - rhs); }, 0, size_);
+    return *this;
+}
+
+template <typename L, typename R, typename Op>
+VectorBinaryExpression<L, R, Op>::VectorBinaryExpression(const L& lhs, const R& rhs, Op op)
+    : lhs_(lhs),
+      rhs_(rhs),
+      op_(op)
+{
+    if (lhs_.size() != rhs_.size())
+        throw std::invalid_argument("Vectors must have the same size");
+}
+
+/*
+ @brief     Lazy element-wise addition and subtraction.
+ @return    An expression node, evaluated when assigned into a Vector.
+ 
+ Unlike the old in-place operators, neither operand is modified:
+ `Vector<double> d = a + b - c;` leaves `a`, `b` and `c` untouched and
+ computes `d` in one pass.
+*/
+template <typename L, typename R, typename = std::enable_if_t<vector_detail::is_operand_v<L> && vector_detail::is_operand_v<R>>>
+auto operator+(const L& lhs, const R& rhs) {
+    using Node = VectorBinaryExpression<vector_detail::expression_t<L>, vector_detail::expression_t<R>, std::plus<>>;
+    return Node(vector_detail::as_expression(lhs), vector_detail::as_expression(rhs));
+}
+
+template <typename L, typename R, typename = std::enable_if_t<vector_detail::is_operand_v<L> && vector_detail::is_operand_v<R>>>
+auto operator-(const L& lhs, const R& rhs) {
+    using Node = VectorBinaryExpression<vector_detail::expression_t<L>, vector_detail::expression_t<R>, std::minus<>>;
+    return Node(vector_detail::as_expression(lhs), vector_detail::as_expression(rhs));
+}
+
+/*
+ @brief     Lazy multiplication and division by a scalar.
+ @return    An expression node, evaluated when assigned into a Vector.
+*/
+template <typename E, typename = std::enable_if_t<vector_detail::is_operand_v<E>>>
+auto operator*(const E& expr, const typename vector_detail::expression_t<E>::value_type& scalar) {
+    using Node = VectorScalarExpression<vector_detail::expression_t<E>, std::multiplies<>>;
+    return Node(vector_detail::as_expression(expr), scalar);
+}
+
+template <typename E, typename = std::enable_if_t<vector_detail::is_operand_v<E>>>
+auto operator*(const typename vector_detail::expression_t<E>::value_type& scalar, const E& expr) {
+    using Node = VectorScalarExpression<vector_detail::expression_t<E>, vector_detail::scalar_first<std::multiplies<>>>;
+    return Node(vector_detail::as_expression(expr), scalar);
+}
+
+template <typename E, typename = std::enable_if_t<vector_detail::is_operand_v<E>>>
+auto operator/(const E& expr, const typename vector_detail::expression_t<E>::value_type& scalar) {
+    using Node = VectorScalarExpression<vector_detail::expression_t<E>, std::divides<>>;
+    return Node(vector_detail::as_expression(expr), scalar);
+}
+
+template <typename A, typename B, typename C, typename Op>
+VectorTernaryExpression<A, B, C, Op>::VectorTernaryExpression(const A& a, const B& b, const C& c, Op op)
+    : a_(a),
+      b_(b),
+      c_(c),
+      op_(op)
+{
+    if (a_.size() != b_.size() || a_.size() != c_.size())
+        throw std::invalid_argument("Vectors must have the same size");
+}
+
+/*
+ Element-wise functions.
+ 
+ Every function below returns an expression node, so chains like
+ `where(greater(x, 0.f), exp(x * 2.f), 0.f)` are evaluated in the single
+ fused loop of the assignment, which the compiler vectorizes. For that
+ the elements are computed without branches: exp() and log() are
+ polynomial approximations on top of exponent bit manipulation, within
+ 1 and 3 ulp of std::exp and std::log, and selections mask the bits of
+ both alternatives, since GCC doesn't turn a floating point `?:` into a
+ vector select under the default -ftrapping-math. double needs AVX2 to
+ be vectorized; sqrt() is std::sqrt, which vectorizes only with
+ -fno-math-errno.
+*/
+namespace vector_detail {
+    template <typename T>
+    using float_bits_t = std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+    
+    template <typename To, typename From>
+    To bits_as(const From& x) {
+        static_assert(sizeof(To) == sizeof(From), "bits_as converts between types of the same size");
+        
+        To y;
+        std::memcpy(&y, &x, sizeof(y));
+        return y;
+    }
+    
+    // condition ? a : b, without a branch
+    template <typename T>
+    T blend(bool condition, const T& a, const T& b) {
+        if constexpr (std::is_floating_point_v<T> && (sizeof(T) == 4 || sizeof(T) == 8)) {
+            using Bits = float_bits_t<T>;
+            const Bits mask = Bits(0) - Bits(condition);
+            return bits_as<T>(Bits((mask & bits_as<Bits>(a)) | (~mask & bits_as<Bits>(b))));
+        }
+        else {
+            return condition ? a : b;
+        }
+    }
+    
+    // 2^n for a normal result
+    template <typename T>
+    T exp2_int(std::int32_t n) {
+        constexpr int mantissa = std::numeric_limits<T>::digits - 1;
+        constexpr int bias = std::numeric_limits<T>::max_exponent - 1;
+        
+        return bits_as<T>(float_bits_t<T>(n + bias) << mantissa);
+    }
+    
+    // c0 + x * (c1 + x * (c2 + ...)), unrolled so that the callers stay straight-line code
+    template <typename T>
+    T horner(T, T c0) {
+        return c0;
+    }
+    
+    template <typename T, typename... C>
+    T horner(T x, T c0, C... rest) {
+        return c0 + x * horner(x, T(rest)...);
+    }
+    
+    // ln(2) in two parts, the first one exact when multiplied by an exponent
+    template <typename T>
+    inline constexpr T ln2_high = sizeof(T) == 4 ? T(0.693359375) : T(6.93145751953125e-1);
+    
+    template <typename T>
+    inline constexpr T ln2_low = sizeof(T) == 4 ? T(-2.12194440e-4) : T(1.42860682030941723212e-6);
+    
+    /*
+     exp(x) = 2^n * exp(r) with n = round(x / ln(2)) and |r| <= ln(2) / 2,
+     where exp(r) is its Taylor polynomial (degree 7 for float, 13 for
+     double). 2^n is applied in two halves, so that results close to the
+     largest value and subnormal ones are still right.
+    */
+    template <typename T>
+    inline T exp_approx(T x) {
+        static_assert(std::is_floating_point_v<T> && (sizeof(T) == 4 || sizeof(T) == 8), "exp() is defined for float and double");
+        constexpr bool single = sizeof(T) == 4;
+        
+        // below lo the result rounds to 0, above hi it overflows
+        const T lo = single ? T(-104) : T(-746);
+        const T hi = single ? T(88.72283935546875) : T(709.782712893384);
+        
+        // NaN becomes lo here, it is put back at the end; std::min and std::max would turn into branches
+        T y = blend(!(x >= lo), lo, x);
+        y = blend(hi < y, hi, y);
+        
+        const std::int32_t n = static_cast<std::int32_t>(y * T(1.44269504088896340736) + blend(y < 0, T(-0.5), T(0.5)));
+        const T k = static_cast<T>(n);
+        const T r = (y - k * ln2_high<T>) - k * ln2_low<T>;
+        
+        T p;
+        if constexpr (single)
+            p = horner(r, T(1), T(1), T(1.0 / 2), T(1.0 / 6), T(1.0 / 24), T(1.0 / 120), T(1.0 / 720), T(1.0 / 5040));
+        else
+            p = horner(r, 1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040, 1.0 / 40320, 1.0 / 362880,
+                       1.0 / 3628800, 1.0 / 39916800, 1.0 / 479001600, 1.0 / 6227020800);
+        
+        const std::int32_t half = n / 2;
+        p = p * exp2_int<T>(half) * exp2_int<T>(n - half);
+        
+        p = blend(x < lo, T(0), p);
+        p = blend(hi < x, std::numeric_limits<T>::infinity(), p);
+        return blend(x != x, x, p);
+    }
+    
+    /*
+     log(x) = e * ln(2) + log(m) with x = m * 2^e and m in [sqrt(2) / 2, sqrt(2)),
+     where log(m) = 2 * atanh(s) = 2 * (s + s^3 / 3 + s^5 / 5 + ...) with
+     s = (m - 1) / (m + 1), |s| < 0.172; 5 terms are enough for float, 10 for
+     double. Subnormals are scaled into the normal range first.
+    */
+    template <typename T>
+    inline T log_approx(T x) {
+        static_assert(std::is_floating_point_v<T> && (sizeof(T) == 4 || sizeof(T) == 8), "log() is defined for float and double");
+        using Bits = float_bits_t<T>;
+        constexpr int digits = std::numeric_limits<T>::digits;
+        constexpr int bias = std::numeric_limits<T>::max_exponent - 1;
+        constexpr Bits mantissa_mask = (Bits(1) << (digits - 1)) - 1;
+        
+        const bool subnormal = x < std::numeric_limits<T>::min();
+        const Bits bits = bits_as<Bits>(blend(subnormal, x * exp2_int<T>(digits), x));
+        
+        // the exponent field of positive numbers, the others are handled at the end
+        std::int32_t e = static_cast<std::int32_t>((bits >> (digits - 1)) & (2 * bias + 1)) - bias;
+        e -= subnormal ? digits : 0;
+        
+        T m = bits_as<T>(Bits((bits & mantissa_mask) | bits_as<Bits>(T(1))));
+        const bool high = m > T(1.41421356237309504880);
+        m = blend(high, m * T(0.5), m);
+        e += high ? 1 : 0;
+        
+        const T s = (m - 1) / (m + 1);
+        const T s2 = s * s;
+        
+        T series;
+        if constexpr (sizeof(T) == 4)
+            series = horner(s2, T(2), T(2.0 / 3), T(2.0 / 5), T(2.0 / 7), T(2.0 / 9));
+        else
+            series = horner(s2, 2.0, 2.0 / 3, 2.0 / 5, 2.0 / 7, 2.0 / 9, 2.0 / 11, 2.0 / 13, 2.0 / 15, 2.0 / 17, 2.0 / 19);
+        
+        const T k = static_cast<T>(e);
+        T result = k * ln2_high<T> + (s * series + k * ln2_low<T>);
+        
+        result = blend(x == std::numeric_limits<T>::infinity(), x, result);
+        result = blend(x == 0, -std::numeric_limits<T>::infinity(), result);
+        return blend(!(x >= 0), std::numeric_limits<T>::quiet_NaN(), result);
+    }
+    
+    template <typename T>
+    auto as_operand(const T& x, std::size_t size) {
+        if constexpr (is_operand_v<T>)
+            return as_expression(x);
+        else
+            return VectorBroadcast<T>(x, size);
+    }
+    
+    template <typename T>
+    std::size_t size_of_operand(const T& x) {
+        if constexpr (is_operand_v<T>)
+            return as_expression(x).size();
+        else
+            return 0;
+    }
+    
+    
+    template <typename T>
+    struct axpy_op {
+        T alpha;
+        
+        template <typename X, typename Y>
+        auto operator()(const X& x, const Y& y) const { return alpha * x + y; }
+    };
+    
+    struct fma_op {
+        template <typename A, typename B, typename C>
+        auto operator()(const A& a, const B& b, const C& c) const { return a * b + c; }
+    };
+    
+    template <typename T>
+    struct clamp_op {
+        T lo;
+        T hi;
+        
+        T operator()(const T& x) const { return std::min(std::max(x, lo), hi); }
+    };
+    
+    struct select_op {
+        template <typename Mask, typename A, typename B>
+        auto operator()(const Mask& mask, const A& a, const B& b) const {
+            using R = std::common_type_t<A, B>;
+            return blend(static_cast<bool>(mask), static_cast<R>(a), static_cast<R>(b));
+        }
+    };
+    
+    struct abs_op {
+        template <typename T>
+        T operator()(const T& x) const {
+            if constexpr (std::is_unsigned_v<T>)
+                return x;
+            else
+                return static_cast<T>(std::abs(x));
+        }
+    };
+    
+    struct sqrt_op {
+        template <typename T>
+        T operator()(const T& x) const { return static_cast<T>(std::sqrt(x)); }
+    };
+    
+    struct exp_op {
+        template <typename T>
+        T operator()(const T& x) const { return exp_approx(x); }
+    };
+    
+    struct log_op {
+        template <typename T>
+        T operator()(const T& x) const { return log_approx(x); }
+    };
+    
+    template <typename E, typename Op>
+    auto unary(const E& expr, Op op) {
+        return VectorUnaryExpression<expression_t<E>, Op>(as_expression(expr), op);
+    }
+    
+    template <typename A, typename B, typename Op>
+    auto binary(const A& a, const B& b, Op op) {
+        return VectorBinaryExpression<expression_t<A>, expression_t<B>, Op>(as_expression(a), as_expression(b), op);
+    }
+    
+    // op(a[i], b[i]) where a or b may be a scalar
+    template <typename Op, typename A, typename B>
+    auto compare(const A& a, const B& b) {
+        const std::size_t size = is_operand_v<A> ? size_of_operand(a) : size_of_operand(b);
+        return binary(as_operand(a, size), as_operand(b, size), Op());
+    }
+    
+    template <typename A, typename B, typename C, typename Op>
+    auto ternary(const A& a, const B& b, const C& c, Op op) {
+        return VectorTernaryExpression<expression_t<A>, expression_t<B>, expression_t<C>, Op>(as_expression(a), as_expression(b), as_expression(c), op);
+    }
+}
+
+/*
+ @brief     Lazy op(expr[i]), e.g. `Vector<float> y = map(x, [](float v) { return v * v + 1; });`
+ @return    An expression node, evaluated when assigned into a Vector.
+ 
+ The function is called once per element in the fused loop, so it should
+ be cheap and free of branches to be vectorized.
+*/
+template <typename E, typename Op, typename = std::enable_if_t<vector_detail::is_operand_v<E>>>
+auto map(const E& expr, Op op) {
+    return vector_detail::unary(expr, op);
+}
+
+// lazy op(a[i], b[i]), the vectors must have the same size
+template <typename A, typename B, typename Op, typename = std::enable_if_t<vector_detail::is_operand_v<A> && vector_detail::is_operand_v<B>>>
+auto zip_with(const A& a, const B& b, Op op) {
+    return vector_detail::binary(a, b, op);
+}
+
+// lazy a[i] * b[i]
+template <typename A, typename B, typename = std::enable_if_t<vector_detail::is_operand_v<A> && vector_detail::is_operand_v<B>>>
+auto hadamard(const A& a, const B& b) {
+    return vector_detail::binary(a, b, std::multiplies<>());
+}
+
+// lazy a[i] / b[i]
+template <typename A, typename B, typename = std::enable_if_t<vector_detail::is_operand_v<A> && vector_detail::is_operand_v<B>>>
+auto divide(const A& a, const B& b) {
+    return vector_detail::binary(a, b, std::divides<>());
+}
+
+/*
+ @brief     Lazy alpha * x[i] + y[i].
+ 
+ `y = axpy(alpha, x, y)` updates y in place in one pass.
+*/
+template <typename X, typename Y, typename = std::enable_if_t<vector_detail::is_operand_v<X> && vector_detail::is_operand_v<Y>>>
+auto axpy(const typename vector_detail::expression_t<X>::value_type& alpha, const X& x, const Y& y) {
+    using T = typename vector_detail::expression_t<X>::value_type;
+    return vector_detail::binary(x, y, vector_detail::axpy_op<T>{ alpha });
+}
+
+// lazy a[i] * b[i] + c[i], contracted into a fused multiply-add where the compiler does so
+template <typename A, typename B, typename C,
+          typename = std::enable_if_t<vector_detail::is_operand_v<A> && vector_detail::is_operand_v<B> && vector_detail::is_operand_v<C>>>
+auto fma(const A& a, const B& b, const C& c) {
+    return vector_detail::ternary(a, b, c, vector_detail::fma_op());
+}
+
+/*
+ @brief     Lazy min(max(expr[i], lo), hi).
+ @throws    std::invalid_argument if lo > hi.
+*/
+template <typename E, typename = std::enable_if_t<vector_detail::is_operand_v<E>>>
+auto clamp(const E& expr, const typename vector_detail::expression_t<E>::value_type& lo,
+           const typename vector_detail::expression_t<E>::value_type& hi)
+{
+    using T = typename vector_detail::expression_t<E>::value_type;
+    if (hi < lo)
+        throw std::invalid_argument("Lower bound must not exceed upper bound");
+    
+    return vector_detail::unary(expr, vector_detail::clamp_op<T>{ lo, hi });
+}
+
+/*
+ @brief     Lazy mask[i] ? a[i] : b[i].
+ @param a   a vector, a view, an expression or a scalar; so is b.
+ 
+ The mask is typically a comparison: `where(greater(x, 0.f), x, 0.f)`.
+ Both alternatives are computed, only one of them is kept.
+*/
+template <typename M, typename A, typename B, typename = std::enable_if_t<vector_detail::is_operand_v<M>>>
+auto where(const M& mask, const A& a, const B& b) {
+    const std::size_t size = vector_detail::size_of_operand(mask);
+    return vector_detail::ternary(mask, vector_detail::as_operand(a, size), vector_detail::as_operand(b, size), vector_detail::select_op());
+}
+
+/*
+ @brief     Lazy element-wise comparisons into a mask of bool.
+ 
+ Either operand may be a scalar, e.g. `greater(x, 0.f)`. The mask can be
+ used in where() or assigned into a Vector<bool>.
+*/
+template <typename A, typename B, typename = std::enable_if_t<vector_detail::is_operand_v<A> || vector_detail::is_operand_v<B>>>
+auto equal(const A& a, const B& b) {
+    return vector_detail::compare<std::equal_to<>>(a, b);
+}
+
+template <typename A, typename B, typename = std::enable_if_t<vector_detail::is_operand_v<A> || vector_detail::is_operand_v<B>>>
+auto not_equal(const A& a, const B& b) {
+    return vector_detail::compare<std::not_equal_to<>>(a, b);
+}
+
+template <typename A, typename B, typename = std::enable_if_t<vector_detail::is_operand_v<A> || vector_detail::is_operand_v<B>>>
+auto less(const A& a, const B& b) {
+    return vector_detail::compare<std::less<>>(a, b);
+}
+
+template <typename A, typename B, typename = std::enable_if_t<vector_detail::is_operand_v<A> || vector_detail::is_operand_v<B>>>
+auto less_equal(const A& a, const B& b) {
+    return vector_detail::compare<std::less_equal<>>(a, b);
+}
+
+template <typename A, typename B, typename = std::enable_if_t<vector_detail::is_operand_v<A> || vector_detail::is_operand_v<B>>>
+auto greater(const A& a, const B& b) {
+    return vector_detail::compare<std::greater<>>(a, b);
+}
+
+template <typename A, typename B, typename = std::enable_if_t<vector_detail::is_operand_v<A> || vector_detail::is_operand_v<B>>>
+auto greater_equal(const A& a, const B& b) {
+    return vector_detail::compare<std::greater_equal<>>(a, b);
+}
+
+// lazy |expr[i]|
+template <typename E, typename = std::enable_if_t<vector_detail::is_operand_v<E>>>
+auto abs(const E& expr) {
+    return vector_detail::unary(expr, vector_detail::abs_op());
+}
+
+// lazy std::sqrt(expr[i]), correctly rounded
+template <typename E, typename = std::enable_if_t<vector_detail::is_operand_v<E>>>
+auto sqrt(const E& expr) {
+    return vector_detail::unary(expr, vector_detail::sqrt_op());
+}
+
+// lazy e^expr[i] for float and double, within 1 ulp
+template <typename E, typename = std::enable_if_t<vector_detail::is_operand_v<E>>>
+auto exp(const E& expr) {
+    return vector_detail::unary(expr, vector_detail::exp_op());
+}
+
+// lazy natural logarithm for float and double, within 3 ulp: -inf for 0, NaN below
+template <typename E, typename = std::enable_if_t<vector_detail::is_operand_v<E>>>
+auto log(const E& expr) {
+    return vector_detail::unary(expr, vector_detail::log_op());
+}
+
+template <typename T, typename Allocator>
+T dot_product(const Vector<T, Dynamic, Allocator>& u, const Vector<T, Dynamic, Allocator>& v) {
+    VECTOR_OPERATION(reduce);
+    if (u.size() != v.size())
+        throw std::invalid_argument("Vectors must have the same size");
+    
+    return vector_detail::reduce_dot(u.entries, v.entries, u.size());
+}
+
+/*
+ @brief     Distances between two vectors, each in a single SIMD pass.
+ 
+ l2_squared() is |u - v|^2, l1() the sum of |u[i] - v[i]|, cosine() the
+ cosine similarity u.v / (|u| |v|) computed from one pass that
+ accumulates the dot product and both norms, 0 if either vector is 0, and
+ hamming() the number of differing bits of integer vectors. Views and
+ vectors can be mixed. Throws std::invalid_argument if the sizes differ.
+*/
+template <typename T, typename Allocator>
+T l2_squared(const Vector<T, Dynamic, Allocator>& u, const Vector<T, Dynamic, Allocator>& v) {
+    VECTOR_OPERATION(reduce);
+    return l2_squared(u.view(), v.view());
+}
+
+template <typename T, typename Allocator>
+T l1(const Vector<T, Dynamic, Allocator>& u, const Vector<T, Dynamic, Allocator>& v) {
+    VECTOR_OPERATION(reduce);
+    return l1(u.view(), v.view());
+}
+
+template <typename T, typename Allocator>
+T cosine(const Vector<T, Dynamic, Allocator>& u, const Vector<T, Dynamic, Allocator>& v) {
+    VECTOR_OPERATION(reduce);
+    return cosine(u.view(), v.view());
+}
+
+template <typename T, typename Allocator>
+std::size_t hamming(const Vector<T, Dynamic, Allocator>& u, const Vector<T, Dynamic, Allocator>& v) {
+    VECTOR_OPERATION(reduce);
+    return hamming(u.view(), v.view());
+}
+
+// `policy` is an execution or an accumulation policy
+template <typename Policy, typename T>
+T dot_product(const Policy& policy, VectorView<T> u, VectorView<T> v) {
+    if constexpr (accumulation::is_accumulation_policy_v<Policy>)
+        return dot_product(execution::seq, policy, u, v);
+    else
+        return dot_product(policy, accumulation::naive, u, v);
+}
+
+template <typename Policy, typename T, typename Allocator>
+T dot_product(const Policy& policy, const Vector<T, Dynamic, Allocator>& u, const Vector<T, Dynamic, Allocator>& v) {
+    return dot_product(policy, u.view(), v.view());
+}
+
+template <typename Policy, typename Accumulation, typename T, typename = vector_detail::if_accumulation<Accumulation>>
+T dot_product(const Policy& policy, const Accumulation&, VectorView<T> u, VectorView<T> v) {
+    VECTOR_OPERATION(reduce);
+    if (u.size() != v.size())
+        throw std::invalid_argument("Vectors must have the same size");
+    
+    return vector_detail::dot_of<Accumulation>(policy, u.data(), v.data(), u.size());
+}
+
+template <typename Policy, typename Accumulation, typename T, typename Allocator, typename = vector_detail::if_accumulation<Accumulation>>
+T dot_product(const Policy& policy, const Accumulation& accumulation, const Vector<T, Dynamic, Allocator>& u,
+              const Vector<T, Dynamic, Allocator>& v)
+{
+    return dot_product(policy, accumulation, u.view(), v.view());
+}
+
+template <typename T, typename Allocator>
+Vector<T, Dynamic, Allocator> cross_product(const Vector<T, Dynamic, Allocator>& lhs, const Vector<T, Dynamic, Allocator>& rhs) {
+    if (lhs.size() != rhs.size() || lhs.size() < 3)
+        throw std::invalid_argument("Vectors must have at least 3 elements and have the same size");
+    
+    const std::size_t n = lhs.size();
+    const T* u = lhs.data();
+    const T* v = rhs.data();
+    
+    Vector<T, Dynamic, Allocator> w(n, uninitialized, lhs.get_allocator());
+    T* out = w.data();
+    out[0] = u[1] * v[2] - u[2] * v[1];
+    out[1] = u[2] * v[0] - u[0] * v[2];
+    out[2] = u[0] * v[1] - u[1] * v[0];
+    
+    // component i is u[i + 1] * v[i + 2] - u[i + 2] * v[i + 1], the indexes wrap around only for the last two
+    for (std::size_t i = 3; i + 2 < n; i++)
+        out[i] = u[i + 1] * v[i + 2] - u[i + 2] * v[i + 1];
+    if (n > 4)
+        out[n - 2] = u[n - 1] * v[0] - u[0] * v[n - 1];
+    if (n > 3)
+        out[n - 1] = u[0] * v[1] - u[1] * v[0];
+    
+    return w;
+}
+
+template <typename T, typename Allocator>
+T* Vector<T, Dynamic, Allocator>::data() {
+    invalidate_hash();
+    return entries;
+}
+
+template <typename T, typename Allocator>
+const T* Vector<T, Dynamic, Allocator>::data() const {
+    return entries;
+}
+
+template <typename T, typename Allocator>
+T* Vector<T, Dynamic, Allocator>::begin() {
+    invalidate_hash();
+    return entries;
+}
+
+template <typename T, typename Allocator>
+const T* Vector<T, Dynamic, Allocator>::begin() const {
+    return entries;
+}
+
+template <typename T, typename Allocator>
+T* Vector<T, Dynamic, Allocator>::end() {
+    invalidate_hash();
+    return entries + size_;
+}
+
+template <typename T, typename Allocator>
+const T* Vector<T, Dynamic, Allocator>::end() const {
+    return entries + size_;
+}
+
+template <typename T>
+VectorView<T>::VectorView(const T* data, std::size_t size)
+    : data_(data),
+      size_(size)
+{}
+
+template <typename T>
+template <std::size_t N, typename Allocator>
+VectorView<T>::VectorView(const Vector<T, N, Allocator>& vec)
+    : data_(vec.data()),
+      size_(vec.size())
+{}
+
+template <typename T>
+std::size_t VectorView<T>::size() const {
+    return size_;
+}
+
+template <typename T>
+const T* VectorView<T>::data() const {
+    return data_;
+}
+
+template <typename T>
+T VectorView<T>::magnitude() const {
+    return std::sqrt(vector_detail::reduce_dot(data_, data_, size_));
+}
+
+template <typename T>
+T VectorView<T>::mean() const {
+    if (size_ == 0)
+        throw std::logic_error("Vector is empty");
+    
+    return sum() / size_;
+}
+
+template <typename T>
+T VectorView<T>::median() const {
+    return vector_detail::median_of(execution::seq, data_, size_);
+}
+
+template <typename T>
+T VectorView<T>::quantile(double p) const {
+    return vector_detail::quantile_of(execution::seq, data_, size_, p);
+}
+
+template <typename T>
+std::vector<T> VectorView<T>::quantiles(std::initializer_list<double> ps) const {
+    std::vector<T> values;
+    values.reserve(ps.size());
+    vector_detail::quantiles_of(execution::seq, data_, size_, ps.begin(), ps.end(), std::back_inserter(values));
+    
+    return values;
+}
+
+template <typename T>
+std::variant<T, std::vector<std::size_t>> VectorView<T>::max() const {
+    if (size_ == 0)
+        return {};
+    
+    return vector_detail::extremum(execution::seq, data_, size_, argmax());
+}
+
+template <typename T>
+std::variant<T, std::vector<std::size_t>> VectorView<T>::min() const {
+    if (size_ == 0)
+        return {};
+    
+    return vector_detail::extremum(execution::seq, data_, size_, argmin());
+}
+
+template <typename T>
+MinMax<T> VectorView<T>::minmax() const {
+    return vector_detail::extrema<execution::sequenced_policy, T, true, true>(execution::seq, data_, size_);
+}
+
+template <typename T>
+Summary<T> VectorView<T>::describe() const {
+    return vector_detail::summary(execution::seq, data_, size_);
+}
+
+template <typename T>
+IndexedValue<T> VectorView<T>::argmax() const {
+    return vector_detail::extrema<execution::sequenced_policy, T, false, true>(execution::seq, data_, size_).max;
+}
+
+template <typename T>
+IndexedValue<T> VectorView<T>::argmin() const {
+    return vector_detail::extrema<execution::sequenced_policy, T, true, false>(execution::seq, data_, size_).min;
+}
+
+template <typename T>
+std::vector<IndexedValue<T>> VectorView<T>::top_k(std::size_t k) const {
+    return vector_detail::top_k_of(execution::seq, data_, size_, k);
+}
+
+template <typename T>
+std::vector<std::size_t> VectorView<T>::argtop_k(std::size_t k) const {
+    return vector_detail::top_k_indexes(vector_detail::top_k_of(execution::seq, data_, size_, k));
+}
+
+template <typename T>
+T VectorView<T>::sum() const {
+    return vector_detail::reduce_sum(data_, size_);
+}
+
+template <typename T>
+T VectorView<T>::product() const {
+    return vector_detail::reduce_product(data_, size_);
+}
+
+template <typename T>
+std::uint64_t VectorView<T>::hash() const {
+    return vector_detail::hash_elements(data_, size_);
+}
+
+template <typename T>
+template <typename Accumulation>
+T VectorView<T>::magnitude(const Accumulation&) const {
+    return std::sqrt(vector_detail::dot_of<Accumulation>(execution::seq, data_, data_, size_));
+}
+
+template <typename T>
+template <typename Accumulation>
+T VectorView<T>::mean(const Accumulation& accumulation) const {
+    if (size_ == 0)
+        throw std::logic_error("Vector is empty");
+    
+    return sum(accumulation) / size_;
+}
+
+template <typename T>
+template <typename Accumulation>
+T VectorView<T>::sum(const Accumulation&) const {
+    return vector_detail::sum_of<Accumulation>(execution::seq, data_, size_);
+}
+
+template <typename T>
+VectorView<T> VectorView<T>::view(std::size_t start, std::size_t end) const {
+    if (start > end || end > size_)
+        throw std::out_of_range("Invalid range for view");
+    
+    return VectorView(data_ + start, end - start);
+}
+
+/*
+ @brief         Returns a view of `count` elements, `stride` positions apart.
+ @param start   the index of the first element.
+ @param count   the number of elements in the view.
+ @param stride  the distance between consecutive elements, at least 1.
+*/
+template <typename T>
+StridedVectorView<T> VectorView<T>::strided_view(std::size_t start, std::size_t count, std::size_t stride) const {
+    if (stride == 0 || (count && (start >= size_ || (count - 1) > (size_ - 1 - start) / stride)))
+        throw std::out_of_range("Invalid range for view");
+    
+    return StridedVectorView<T>(data_ + start, count, stride);
+}
+
+template <typename T>
+const T& VectorView<T>::operator[](std::size_t i) const {
+    VECTOR_CHECK_INDEX(i, size_);
+    return data_[i];
+}
+
+template <typename T>
+const T& VectorView<T>::at(std::size_t i) const {
+    if (i >= size_)
+        throw std::out_of_range("Index out of range");
+    
+    return data_[i];
+}
+
+template <typename T>
+const T* VectorView<T>::begin() const {
+    return data_;
+}
+
+template <typename T>
+const T* VectorView<T>::end() const {
+    return data_ + size_;
+}
+
+template <typename T>
+StridedVectorView<T>::StridedVectorView(const T* data, std::size_t size, std::size_t stride)
+    : data_(data),
+      size_(size),
+      stride_(stride)
+{}
+
+template <typename T>
+StridedVectorView<T>::StridedVectorView(VectorView<T> view)
+    : data_(view.data()),
+      size_(view.size())
+{}
+
+template <typename T>
+template <std::size_t N, typename Allocator>
+StridedVectorView<T>::StridedVectorView(const Vector<T, N, Allocator>& vec)
+    : data_(vec.data()),
+      size_(vec.size())
+{}
+
+template <typename T>
+std::size_t StridedVectorView<T>::size() const {
+    return size_;
+}
+
+template <typename T>
+std::size_t StridedVectorView<T>::stride() const {
+    return stride_;
+}
+
+template <typename T>
+const T* StridedVectorView<T>::data() const {
+    return data_;
+}
+
+template <typename T>
+T StridedVectorView<T>::magnitude() const {
+    return std::sqrt(vector_detail::reduce_dot_strided(data_, stride_, data_, stride_, size_));
+}
+
+template <typename T>
+T StridedVectorView<T>::mean() const {
+    if (size_ == 0)
+        throw std::logic_error("Vector is empty");
+    
+    return sum() / size_;
+}
+
+template <typename T>
+T StridedVectorView<T>::median() const {
+    return vector_detail::median_of(begin(), end());
+}
+
+template <typename T>
+std::variant<T, std::vector<std::size_t>> StridedVectorView<T>::max() const {
+    return vector_detail::extremum(begin(), end(), std::greater<>());
+}
+
+template <typename T>
+std::variant<T, std::vector<std::size_t>> StridedVectorView<T>::min() const {
+    return vector_detail::extremum(begin(), end(), std::less<>());
+}
+
+template <typename T>
+T StridedVectorView<T>::sum() const {
+    return vector_detail::reduce_sum_strided(data_, stride_, size_);
+}
+
+template <typename T>
+T StridedVectorView<T>::product() const {
+    return vector_detail::reduce_product_strided(data_, stride_, size_);
+}
+
+template <typename T>
+const T& StridedVectorView<T>::operator[](std::size_t i) const {
+    VECTOR_CHECK_INDEX(i, size_);
+    return data_[i * stride_];
+}
+
+template <typename T>
+const T& StridedVectorView<T>::at(std::size_t i) const {
+    if (i >= size_)
+        throw std::out_of_range("Index out of range");
+    
+    return data_[i * stride_];
+}
+
+template <typename T>
+typename StridedVectorView<T>::iterator StridedVectorView<T>::begin() const {
+    return iterator(data_, stride_);
+}
+
+template <typename T>
+typename StridedVectorView<T>::iterator StridedVectorView<T>::end() const {
+    return iterator(data_ + size_ * stride_, stride_);
+}
+
+template <typename T>
+ConcatView<T>::ConcatView(VectorView<T> first, VectorView<T> second)
+    : first_(first),
+      second_(second)
+{}
+
+template <typename T>
+std::size_t ConcatView<T>::size() const {
+    return first_.size() + second_.size();
+}
+
+// unchecked, like every expression node
+template <typename T>
+const T& ConcatView<T>::operator[](std::size_t i) const {
+    return i < first_.size() ? first_.data()[i] : second_.data()[i - first_.size()];
+}
+
+// the second part is read at the positions following the first one
+template <typename T>
+template <typename U>
+bool ConcatView<T>::aliases(const U* out, std::size_t n, std::size_t offset) const {
+    return vector_detail::shifted_alias(first_.data(), first_.size(), out, n, offset) ||
+        vector_detail::shifted_alias(second_.data(), second_.size(), out, n, offset + first_.size());
+}
+
+template <typename T>
+VectorView<T> ConcatView<T>::first() const {
+    return first_;
+}
+
+template <typename T>
+VectorView<T> ConcatView<T>::second() const {
+    return second_;
+}
+
+template <typename T>
+T ConcatView<T>::mean() const {
+    if (size() == 0)
+        throw std::logic_error("Vector is empty");
+    
+    return sum() / size();
+}
+
+template <typename T>
+T ConcatView<T>::sum() const {
+    return first_.sum() + second_.sum();
+}
+
+template <typename T>
+T ConcatView<T>::product() const {
+    return first_.product() * second_.product();
+}
+
+template <typename T>
+typename ConcatView<T>::iterator ConcatView<T>::begin() const {
+    return iterator(this, 0);
+}
+
+template <typename T>
+typename ConcatView<T>::iterator ConcatView<T>::end() const {
+    return iterator(this, size());
+}
+
+/*
+ @brief     Concatenates two vectors or views without copying.
+ @return    A ConcatView referring to both operands.
+ 
+ See concat() for the version that materializes the result.
+*/
+template <typename T>
+ConcatView<T> concat_view(VectorView<T> v1, VectorView<T> v2) {
+    return ConcatView<T>(v1, v2);
+}
+
+template <typename T, typename A1, typename A2>
+ConcatView<T> concat_view(const Vector<T, Dynamic, A1>& v1, const Vector<T, Dynamic, A2>& v2) {
+    return ConcatView<T>(v1, v2);
+}
+
+template <typename T, typename Allocator>
+ConcatView<T> concat_view(const Vector<T, Dynamic, Allocator>& v1, VectorView<T> v2) {
+    return ConcatView<T>(v1, v2);
+}
+
+template <typename T, typename Allocator>
+ConcatView<T> concat_view(VectorView<T> v1, const Vector<T, Dynamic, Allocator>& v2) {
+    return ConcatView<T>(v1, v2);
+}
+
+namespace vector_detail {
+    template <std::size_t N>
+    using if_fixed = std::enable_if_t<N != Dynamic>;
+    
+    template <typename T, std::size_t N, typename A, typename Op, std::size_t... I>
+    constexpr Vector<T, N, A> zip(const Vector<T, N, A>& u, const Vector<T, N, A>& v, Op op, std::index_sequence<I...>) {
+        return Vector<T, N, A>(static_cast<T>(op(u[I], v[I]))...);
+    }
+    
+    template <typename T, std::size_t N, typename A, typename Op, std::size_t... I>
+    constexpr Vector<T, N, A> zip_scalar(const Vector<T, N, A>& u, const T& scalar, Op op, std::index_sequence<I...>) {
+        return Vector<T, N, A>(static_cast<T>(op(u[I], scalar))...);
+    }
+    
+    template <typename T, std::size_t N, typename A, std::size_t... I>
+    constexpr T fold_dot(const Vector<T, N, A>& u, const Vector<T, N, A>& v, std::index_sequence<I...>) {
+        return (T() + ... + (u[I] * v[I]));
+    }
+    
+    // same components as the dynamic cross_product: the first three are the
+    // usual 3D cross product, the others wrap around
+    template <std::size_t N>
+    constexpr std::size_t cross_index(std::size_t i, std::size_t k) {
+        return i < 3 ? (i + k) % 3 : (i + k) % N;
+    }
+    
+    template <typename T, std::size_t N, typename A, std::size_t... I>
+    constexpr Vector<T, N, A> fold_cross(const Vector<T, N, A>& u, const Vector<T, N, A>& v, std::index_sequence<I...>) {
+        return Vector<T, N, A>(static_cast<T>(u[cross_index<N>(I, 1)] * v[cross_index<N>(I, 2)] -
+                                              u[cross_index<N>(I, 2)] * v[cross_index<N>(I, 1)])...);
+    }
+}
+
+template <typename T, std::size_t N, typename Allocator>
+constexpr Vector<T, N, Allocator>::Vector()
+    : entries{}
+{}
+
+template <typename T, std::size_t N, typename Allocator>
+template <typename... Args, typename>
+constexpr Vector<T, N, Allocator>::Vector(Args... args)
+    : entries{ { static_cast<T>(args)... } }
+{}
+
+template <typename T, std::size_t N, typename Allocator>
+constexpr Vector<T, N, Allocator>::Vector(const std::array<T, N>& values)
+    : entries(values)
+{}
+
+/*
+ @brief     Copies the elements of a view.
+ 
+ Throws std::length_error if the view doesn't have exactly N elements.
+*/
+template <typename T, std::size_t N, typename Allocator>
+Vector<T, N, Allocator>::Vector(VectorView<T> view)
+    : entries{}
+{
+    if (view.size() != N)
+        throw std::length_error("View size doesn't match the size of the fixed-size vector");
+    
+    std::copy(view.begin(), view.end(), entries.begin());
+}
+
+template <typename T, std::size_t N, typename Allocator>
+constexpr std::size_t Vector<T, N, Allocator>::size() {
+    return N;
+}
+
+template <typename T, std::size_t N, typename Allocator>
+T Vector<T, N, Allocator>::magnitude() const {
+    return std::sqrt(vector_detail::fold_dot(*this, *this, std::make_index_sequence<N>()));
+}
+
+template <typename T, std::size_t N, typename Allocator>
+constexpr T Vector<T, N, Allocator>::mean() const {
+    return sum() / static_cast<T>(N);
+}
+
+template <typename T, std::size_t N, typename Allocator>
+constexpr T Vector<T, N, Allocator>::sum() const {
+    T total = T();
+    for (std::size_t i = 0; i < N; i++)
+        total += entries[i];
+    
+    return total;
+}
+
+template <typename T, std::size_t N, typename Allocator>
+constexpr T Vector<T, N, Allocator>::product() const {
+    T total = T(1);
+    for (std::size_t i = 0; i < N; i++)
+        total *= entries[i];
+    
+    return total;
+}
+
+template <typename T, std::size_t N, typename Allocator>
+void Vector<T, N, Allocator>::normalize() {
+    static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>, "Vector should consist of double or float types");
+    
+    const T mag = magnitude();
+    if (mag == 0)
+        return;
+    
+    *this /= mag;
+}
+
+template <typename T, std::size_t N, typename Allocator>
+VectorView<T> Vector<T, N, Allocator>::view() const {
+    return VectorView<T>(entries.data(), N);
+}
+
+template <typename T, std::size_t N, typename Allocator>
+constexpr T& Vector<T, N, Allocator>::operator[](std::size_t i) {
+    VECTOR_CHECK_INDEX(i, N);
+    return entries[i];
+}
+
+template <typename T, std::size_t N, typename Allocator>
+constexpr const T& Vector<T, N, Allocator>::operator[](std::size_t i) const {
+    VECTOR_CHECK_INDEX(i, N);
+    return entries[i];
+}
+
+template <typename T, std::size_t N, typename Allocator>
+constexpr T& Vector<T, N, Allocator>::at(std::size_t i) {
+    if (i >= N)
+        throw std::out_of_range("Index out of range");
+    
+    return entries[i];
+}
+
+template <typename T, std::size_t N, typename Allocator>
+constexpr const T& Vector<T, N, Allocator>::at(std::size_t i) const {
+    if (i >= N)
+        throw std::out_of_range("Index out of range");
+    
+    return entries[i];
+}
+
+template <typename T, std::size_t N, typename Allocator>
+constexpr Vector<T, N, Allocator>& Vector<T, N, Allocator>::operator+=(const Vector& other) {
+    for (std::size_t i = 0; i < N; i++)
+        entries[i] += other.entries[i];
+    
+    return *this;
+}
+
+template <typename T, std::size_t N, typename Allocator>
+constexpr Vector<T, N, Allocator>& Vector<T, N, Allocator>::operator-=(const Vector& other) {
+    for (std::size_t i = 0; i < N; i++)
+        entries[i] -= other.entries[i];
+    
+    return *this;
+}
+
+template <typename T, std::size_t N, typename Allocator>
+constexpr Vector<T, N, Allocator>& Vector<T, N, Allocator>::operator*=(T scalar) {
+    for (std::size_t i = 0; i < N; i++)
+        entries[i] *= scalar;
+    
+    return *this;
+}
+
+template <typename T, std::size_t N, typename Allocator>
+constexpr Vector<T, N, Allocator>& Vector<T, N, Allocator>::operator/=(T scalar) {
+    for (std::size_t i = 0; i < N; i++)
+        entries[i] /= scalar;
+    
+    return *this;
+}
+
+template <typename T, std::size_t N, typename Allocator>
+constexpr T* Vector<T, N, Allocator>::data() {
+    return entries.data();
+}
+
+template <typename T, std::size_t N, typename Allocator>
+constexpr const T* Vector<T, N, Allocator>::data() const {
+    return entries.data();
+}
+
+template <typename T, std::size_t N, typename Allocator>
+constexpr T* Vector<T, N, Allocator>::begin() {
+    return entries.data();
+}
+
+template <typename T, std::size_t N, typename Allocator>
+constexpr const T* Vector<T, N, Allocator>::begin() const {
+    return entries.data();
+}
+
+template <typename T, std::size_t N, typename Allocator>
+constexpr T* Vector<T, N, Allocator>::end() {
+    return entries.data() + N;
+}
+
+template <typename T, std::size_t N, typename Allocator>
+constexpr const T* Vector<T, N, Allocator>::end() const {
+    return entries.data() + N;
+}
+
+template <typename T, std::size_t N, typename A, typename = vector_detail::if_fixed<N>>
+constexpr Vector<T, N, A> operator+(const Vector<T, N, A>& u, const Vector<T, N, A>& v) {
+    return vector_detail::zip(u, v, std::plus<>(), std::make_index_sequence<N>());
+}
+
+template <typename T, std::size_t N, typename A, typename = vector_detail::if_fixed<N>>
+constexpr Vector<T, N, A> operator-(const Vector<T, N, A>& u, const Vector<T, N, A>& v) {
+    return vector_detail::zip(u, v, std::minus<>(), std::make_index_sequence<N>());
+}
+
+template <typename T, std::size_t N, typename A, typename = vector_detail::if_fixed<N>>
+constexpr Vector<T, N, A> operator*(const Vector<T, N, A>& u, const T& scalar) {
+    return vector_detail::zip_scalar(u, scalar, std::multiplies<>(), std::make_index_sequence<N>());
+}
+
+template <typename T, std::size_t N, typename A, typename = vector_detail::if_fixed<N>>
+constexpr Vector<T, N, A> operator*(const T& scalar, const Vector<T, N, A>& u) {
+    return vector_detail::zip_scalar(u, scalar, vector_detail::scalar_first<std::multiplies<>>(), std::make_index_sequence<N>());
+}
+
+template <typename T, std::size_t N, typename A, typename = vector_detail::if_fixed<N>>
+constexpr Vector<T, N, A> operator/(const Vector<T, N, A>& u, const T& scalar) {
+    return vector_detail::zip_scalar(u, scalar, std::divides<>(), std::make_index_sequence<N>());
+}
+
+template <typename T, std::size_t N, typename A, typename = vector_detail::if_fixed<N>>
+constexpr T dot_product(const Vector<T, N, A>& u, const Vector<T, N, A>& v) {
+    return vector_detail::fold_dot(u, v, std::make_index_sequence<N>());
+}
+
+/*
+ @brief     Cross product of two fixed-size vectors, N >= 3.
+ 
+ Same components as the cross product of dynamic vectors, computed
+ without any loop or size check.
+*/
+template <typename T, std::size_t N, typename A, typename = vector_detail::if_fixed<N>>
+constexpr Vector<T, N, A> cross_product(const Vector<T, N, A>& u, const Vector<T, N, A>& v) {
+    static_assert(N >= 3, "Vectors must have at least 3 elements");
+    
+    return vector_detail::fold_cross(u, v, std::make_index_sequence<N>());
+}
+
+template <typename T, std::size_t N, typename A, typename = vector_detail::if_fixed<N>>
+constexpr bool operator==(const Vector<T, N, A>& u, const Vector<T, N, A>& v) {
+    for (std::size_t i = 0; i < N; i++)
+        if (!(u[i] == v[i]))
+            return false;
+    
+    return true;
+}
+
+template <typename T, std::size_t N, typename A, typename = vector_detail::if_fixed<N>>
+constexpr bool operator!=(const Vector<T, N, A>& u, const Vector<T, N, A>& v) {
+    return !(u == v);
+}
+
+// lexicographical, as for dynamic vectors
+template <typename T, std::size_t N, typename A, typename = vector_detail::if_fixed<N>>
+constexpr int three_way_compare(const Vector<T, N, A>& u, const Vector<T, N, A>& v) {
+    for (std::size_t i = 0; i < N; i++) {
+        if (u[i] < v[i])
+            return -1;
+        if (v[i] < u[i])
+            return 1;
+    }
+    
+    return 0;
+}
+
+template <typename T, std::size_t N, typename A, typename = vector_detail::if_fixed<N>>
+constexpr bool operator<(const Vector<T, N, A>& u, const Vector<T, N, A>& v) {
+    return three_way_compare(u, v) < 0;
+}
+
+template <typename T, std::size_t N, typename A, typename = vector_detail::if_fixed<N>>
+constexpr bool operator>(const Vector<T, N, A>& u, const Vector<T, N, A>& v) {
+    return three_way_compare(u, v) > 0;
+}
+
+template <typename T, std::size_t N, typename A, typename = vector_detail::if_fixed<N>>
+constexpr bool operator<=(const Vector<T, N, A>& u, const Vector<T, N, A>& v) {
+    return three_way_compare(u, v) <= 0;
+}
+
+template <typename T, std::size_t N, typename A, typename = vector_detail::if_fixed<N>>
+constexpr bool operator>=(const Vector<T, N, A>& u, const Vector<T, N, A>& v) {
+    return three_way_compare(u, v) >= 0;
+}
+
+template <typename T, std::size_t N, typename A, typename = vector_detail::if_fixed<N>>
+std::ostream& operator<<(std::ostream& os, const Vector<T, N, A>& vec) {
+    return vector_detail::print(os, vec.begin(), vec.end());
+}
+
+/*
+ Batches of vectors.
+ 
+ VectorBatch<T> stores `size()` vectors of `dim()` elements in a single
+ aligned allocation, either row by row or as a structure of arrays:
+ 
+     BatchLayout::row_major  element j of vector i at data()[i * stride() + j]
+     BatchLayout::soa        element j of vector i at data()[j * stride() + i]
+ 
+ The stride is rounded up so that every row (column) starts on a
+ vector_alignment boundary. Row-major batches compute several rows per
+ pass over the query; SoA batches compute a block of vectors per SIMD
+ sweep over their columns, which is faster for small dimensions.
+*/
+enum class BatchLayout {
+    row_major,
+    soa
+};
+
+template <typename T, typename Allocator = AlignedAllocator<T>>
+class VectorBatch {
+    static_assert(std::is_arithmetic_v<T>, "VectorBatch should consist of arithmetic types");
+    
+public:
+    using value_type = T;
+    using allocator_type = Allocator;
+    
+    VectorBatch() = default;
+    VectorBatch(std::size_t, std::size_t, BatchLayout = BatchLayout::row_major, const Allocator& = Allocator());
+    VectorBatch(VectorBatch&&) noexcept;
+    VectorBatch& operator=(VectorBatch&&) noexcept;
+    ~VectorBatch();
+    
+    std::size_t size() const;
+    std::size_t dim() const;
+    std::size_t stride() const;
+    BatchLayout layout() const;
+    Allocator get_allocator() const;
+    
+    // operator() is checked by VECTOR_CHECK_INDEX, at() always throws std::out_of_range
+    T& operator()(std::size_t, std::size_t);
+    const T& operator()(std::size_t, std::size_t) const;
+    T& at(std::size_t, std::size_t);
+    const T& at(std::size_t, std::size_t) const;
+    
+    VectorView<T> row(std::size_t) const;
+    StridedVectorView<T> strided_row(std::size_t) const;
+    void assign(std::size_t, VectorView<T>);
+    
+    VectorBatch to_layout(BatchLayout) const;
+    
+    void magnitudes(T*) const;
+    void normalize();
+    
+    template <typename Policy>
+    void magnitudes(const Policy&, T*) const;
+    
+    template <typename Policy>
+    void normalize(const Policy&);
+    
+    // magnitudes kept for cosine() and knn() until the batch is changed
+    void cache_norms();
+    
+    template <typename Policy>
+    void cache_norms(const Policy&);
+    
+    const T* cached_norms() const;
+    
+    T* data();
+    const T* data() const;
+    
+private:
+    using alloc_traits = std::allocator_traits<Allocator>;
+    
+    std::size_t allocated() const;
+    
+    T* entries = nullptr;
+    std::size_t count_ = 0;
+    std::size_t dim_ = 0;
+    std::size_t stride_ = 0;
+    BatchLayout layout_ = BatchLayout::row_major;
+    Allocator allocator_;
+    
+    // magnitude of every vector, empty until cache_norms() and after every change
+    std::vector<T> norms_;
+};
+
+namespace vector_detail {
+    template <typename T>
+    struct type_identity {
+        using type = T;
+    };
+    
+    // keeps a parameter out of template argument deduction
+    template <typename T>
+    using identity_t = typename type_identity<T>::type;
+    
+    // quantity computed between every vector of a batch and a query
+    enum class batch_op {
+        dot,                // dot(x, q)
+        squared_distance,   // |x - q|^2
+        squared_norm,       // |x|^2, q is unused
+        l1                  // sum of |x[j] - q[j]|
+    };
+    
+    // whether the SIMD kernels of Op exist for T
+    template <batch_op Op, typename T>
+    inline constexpr bool batch_simd_v = simd_for<T>::has_mul && (Op != batch_op::l1 || simd_minmax_v<T>);
+    
+    template <batch_op Op, typename T>
+    T batch_term(const T& x, const T& q) {
+        if constexpr (Op == batch_op::dot)
+            return x * q;
+        else if constexpr (Op == batch_op::squared_distance)
+            return (x - q) * (x - q);
+        else if constexpr (Op == batch_op::l1)
+            return absolute_difference(x, q);
+        else
+            return x * x;
+    }
+    
+    template <batch_op Op, typename S>
+    typename S::reg batch_term(typename S::reg acc, typename S::reg x, typename S::reg q) {
+        if constexpr (Op == batch_op::dot)
+            return S::fma(x, q, acc);
+        else if constexpr (Op == batch_op::squared_distance) {
+            const auto d = S::sub(x, q);
+            return S::fma(d, d, acc);
+        }
+        else if constexpr (Op == batch_op::l1)
+            return S::add(acc, S::max(S::sub(x, q), S::sub(q, x)));
+        else
+            return S::fma(x, x, acc);
+    }
+    
+    // rows computed per pass over the query, sharing its loads
+    inline constexpr std::size_t row_tile = 4;
+    
+    // vectors of a SoA batch computed per sweep over the columns: their accumulators stay in L1
+    inline constexpr std::size_t soa_block = 512;
+    
+    // out[i] for the rows [begin, end) of a row-major batch
+    template <batch_op Op, typename T>
+    void rows_against(const T* data, std::size_t stride, std::size_t dim, std::size_t begin, std::size_t end,
+                      const T* q, T* out)
+    {
+        std::size_t i = begin;
+        
+        if constexpr (batch_simd_v<Op, T>) {
+            using S = simd_for<T>;
+            constexpr std::size_t w = S::width;
+            
+            for (; i + row_tile <= end; i += row_tile) {
+                const T* rows[row_tile];
+                typename S::reg acc[row_tile];
+                for (std::size_t r = 0; r < row_tile; r++) {
+                    rows[r] = data + (i + r) * stride;
+                    acc[r] = S::zero();
+                }
+                
+                std::size_t j = 0;
+                for (; j + w <= dim; j += w) {
+                    const auto qv = Op == batch_op::squared_norm ? S::zero() : S::load(q + j);
+                    for (std::size_t r = 0; r < row_tile; r++)
+                        acc[r] = batch_term<Op, S>(acc[r], S::load(rows[r] + j), qv);
+                }
+                
+                for (std::size_t r = 0; r < row_tile; r++) {
+                    T total = horizontal_sum<T, S>(acc[r]);
+                    for (std::size_t k = j; k < dim; k++)
+                        total += batch_term<Op>(rows[r][k], Op == batch_op::squared_norm ? T() : q[k]);
+                    out[i + r] = total;
+                }
+            }
+        }
+        
+        for (; i < end; i++) {
+            const T* x = data + i * stride;
+            if constexpr (Op == batch_op::dot)
+                out[i] = reduce_dot(x, q, dim);
+            else if constexpr (Op == batch_op::squared_distance)
+                out[i] = reduce_squared_distance(x, q, dim);
+            else if constexpr (Op == batch_op::l1)
+                out[i] = reduce_l1(x, q, dim);
+            else
+                out[i] = reduce_dot(x, x, dim);
+        }
+    }
+    
+    // out[i] for the vectors [begin, end) of a SoA batch, accumulated column by column
+    template <batch_op Op, typename T>
+    void columns_against(const T* data, std::size_t stride, std::size_t dim, std::size_t begin, std::size_t end,
+                         const T* q, T* out)
+    {
+        for (std::size_t block = begin; block < end; block += soa_block) {
+            const std::size_t len = std::min(soa_block, end - block);
+            T* acc = out + block;
+            std::fill(acc, acc + len, T());
+            
+            for (std::size_t j = 0; j < dim; j++) {
+                const T* column = data + j * stride + block;
+                const T qj = Op == batch_op::squared_norm ? T() : q[j];
+                std::size_t i = 0;
+                
+                if constexpr (batch_simd_v<Op, T>) {
+                    using S = simd_for<T>;
+                    constexpr std::size_t w = S::width;
+                    
+                    const auto qv = S::set1(static_cast<simd_lane_t<T>>(qj));
+                    for (; i + w <= len; i += w)
+                        S::store(acc + i, batch_term<Op, S>(S::load(acc + i), S::load(column + i), qv));
+                }
+                
+                for (; i < len; i++)
+                    acc[i] += batch_term<Op>(column[i], qj);
+            }
+        }
+    }
+    
+    template <batch_op Op, typename Policy, typename T, typename Allocator>
+    void batch_against(const Policy& policy, const VectorBatch<T, Allocator>& batch, const T* q, T* out) {
+        const T* data = batch.data();
+        const std::size_t stride = batch.stride(), dim = batch.dim();
+        const bool soa = batch.layout() == BatchLayout::soa;
+        
+        for_each_row_chunk(policy, batch.size(), dim, [&](std::size_t begin, std::size_t end) {
+            if (soa)
+                columns_against<Op>(data, stride, dim, begin, end, q, out);
+            else
+                rows_against<Op>(data, stride, dim, begin, end, q, out);
+        });
+    }
+    
+    template <typename T>
+    T square_root(T x) {
+        return static_cast<T>(std::sqrt(x));
+    }
+}
+
+/*
+ @brief             Creates a batch of zero-initialized vectors.
+ @param count       the number of vectors.
+ @param dim         the number of elements of every vector.
+ @param layout      how the elements are laid out in memory.
+*/
+template <typename T, typename Allocator>
+VectorBatch<T, Allocator>::VectorBatch(std::size_t count, std::size_t dim, BatchLayout layout, const Allocator& alloc)
+    : count_(count),
+      dim_(dim),
+      layout_(layout),
+      allocator_(alloc)
+{
+    // rows (columns) start on an alignment boundary
+    constexpr std::size_t lanes = std::max<std::size_t>(1, vector_alignment / sizeof(T));
+    const std::size_t inner = layout == BatchLayout::row_major ? dim : count;
+    stride_ = (inner + lanes - 1) / lanes * lanes;
+    
+    if (allocated() == 0)
+        return;
+    
+    entries = alloc_traits::allocate(allocator_, allocated());
+    std::fill(entries, entries + allocated(), T());
+}
+
+template <typename T, typename Allocator>
+VectorBatch<T, Allocator>::VectorBatch(VectorBatch&& other) noexcept
+    : entries(std::exchange(other.entries, nullptr)),
+      count_(std::exchange(other.count_, 0)),
+      dim_(std::exchange(other.dim_, 0)),
+      stride_(std::exchange(other.stride_, 0)),
+      layout_(other.layout_),
+      allocator_(std::move(other.allocator_)),
+      norms_(std::move(other.norms_))
+{}
+
+template <typename T, typename Allocator>
+VectorBatch<T, Allocator>& VectorBatch<T, Allocator>::operator=(VectorBatch&& other) noexcept {
+    if (this != &other) {
+        if (entries)
+            alloc_traits::deallocate(allocator_, entries, allocated());
+        
+        entries = std::exchange(other.entries, nullptr);
+        count_ = std::exchange(other.count_, 0);
+        dim_ = std::exchange(other.dim_, 0);
+        stride_ = std::exchange(other.stride_, 0);
+        layout_ = other.layout_;
+        allocator_ = std::move(other.allocator_);
+        norms_ = std::move(other.norms_);
+    }
+    
+    return *this;
+}
+
+template <typename T, typename Allocator>
+VectorBatch<T, Allocator>::~VectorBatch() {
+    if (entries)
+        alloc_traits::deallocate(allocator_, entries, allocated());
+}
+
+// number of vectors
+template <typename T, typename Allocator>
+std::size_t VectorBatch<T, Allocator>::size() const {
+    return count_;
+}
+
+// number of elements of every vector
+template <typename T, typename Allocator>
+std::size_t VectorBatch<T, Allocator>::dim() const {
+    return dim_;
+}
+
+// distance between consecutive rows (row_major) or columns (soa), in elements
+template <typename T, typename Allocator>
+std::size_t VectorBatch<T, Allocator>::stride() const {
+    return stride_;
+}
+
+template <typename T, typename Allocator>
+BatchLayout VectorBatch<T, Allocator>::layout() const {
+    return layout_;
+}
+
+template <typename T, typename Allocator>
+Allocator VectorBatch<T, Allocator>::get_allocator() const {
+    return allocator_;
+}
+
+// element j of vector i
+template <typename T, typename Allocator>
+T& VectorBatch<T, Allocator>::operator()(std::size_t i, std::size_t j) {
+    norms_.clear();
+    return const_cast<T&>(std::as_const(*this)(i, j));
+}
+
+template <typename T, typename Allocator>
+const T& VectorBatch<T, Allocator>::operator()(std::size_t i, std::size_t j) const {
+    VECTOR_CHECK_INDEX(i, count_);
+    VECTOR_CHECK_INDEX(j, dim_);
+    
+    return layout_ == BatchLayout::row_major ? entries[i * stride_ + j] : entries[j * stride_ + i];
+}
+
+template <typename T, typename Allocator>
+T& VectorBatch<T, Allocator>::at(std::size_t i, std::size_t j) {
+    norms_.clear();
+    return const_cast<T&>(std::as_const(*this).at(i, j));
+}
+
+template <typename T, typename Allocator>
+const T& VectorBatch<T, Allocator>::at(std::size_t i, std::size_t j) const {
+    if (i >= count_ || j >= dim_)
+        throw std::out_of_range("Index out of range");
+    
+    return (*this)(i, j);
+}
+
+/*
+ @brief     View of vector i, without copying.
+ 
+ Throws std::logic_error for SoA batches, whose vectors aren't contiguous:
+ use strided_row() there.
+*/
+template <typename T, typename Allocator>
+VectorView<T> VectorBatch<T, Allocator>::row(std::size_t i) const {
+    if (layout_ != BatchLayout::row_major)
+        throw std::logic_error("Rows of a SoA batch aren't contiguous");
+    if (i >= count_)
+        throw std::out_of_range("Index out of range");
+    
+    return VectorView<T>(entries + i * stride_, dim_);
+}
+
+// view of vector i in either layout
+template <typename T, typename Allocator>
+StridedVectorView<T> VectorBatch<T, Allocator>::strided_row(std::size_t i) const {
+    if (i >= count_)
+        throw std::out_of_range("Index out of range");
+    
+    if (layout_ == BatchLayout::row_major)
+        return StridedVectorView<T>(entries + i * stride_, dim_, 1);
+    
+    return StridedVectorView<T>(entries + i, dim_, stride_);
+}
+
+// copies the elements of a vector into vector i
+template <typename T, typename Allocator>
+void VectorBatch<T, Allocator>::assign(std::size_t i, VectorView<T> vec) {
+    if (i >= count_)
+        throw std::out_of_range("Index out of range");
+    if (vec.size() != dim_)
+        throw std::invalid_argument("Vectors must have the same size");
+    
+    norms_.clear();
+    if (layout_ == BatchLayout::row_major) {
+        std::copy(vec.begin(), vec.end(), entries + i * stride_);
+        return;
+    }
+    
+    for (std::size_t j = 0; j < dim_; j++)
+        entries[j * stride_ + i] = vec[j];
+}
+
+// copy of the batch in another layout
+template <typename T, typename Allocator>
+VectorBatch<T, Allocator> VectorBatch<T, Allocator>::to_layout(BatchLayout layout) const {
+    VectorBatch result(count_, dim_, layout, allocator_);
+    
+    for (std::size_t i = 0; i < count_; i++)
+        for (std::size_t j = 0; j < dim_; j++)
+            result(i, j) = (*this)(i, j);
+    
+    return result;
+}
+
+/*
+ @brief         Writes the magnitude of every vector.
+ @param out     at least size() elements.
+*/
+template <typename T, typename Allocator>
+void VectorBatch<T, Allocator>::magnitudes(T* out) const {
+    magnitudes(execution::seq, out);
+}
+
+// normalizes every vector, vectors of zero magnitude are left as they are
+template <typename T, typename Allocator>
+void VectorBatch<T, Allocator>::normalize() {
+    normalize(execution::seq);
+}
+
+template <typename T, typename Allocator>
+template <typename Policy>
+void VectorBatch<T, Allocator>::magnitudes(const Policy& policy, T* out) const {
+    if (!norms_.empty()) {
+        std::copy(norms_.begin(), norms_.end(), out);
+        return;
+    }
+    
+    vector_detail::batch_against<vector_detail::batch_op::squared_norm>(policy, *this, static_cast<const T*>(nullptr), out);
+    
+    vector_detail::for_each_chunk(policy, count_, [out](std::size_t begin, std::size_t end) {
+        std::transform(out + begin, out + end, out + begin, vector_detail::square_root<T>);
+    });
+}
+
+template <typename T, typename Allocator>
+template <typename Policy>
+void VectorBatch<T, Allocator>::normalize(const Policy& policy) {
+    static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>, "Vector should consist of double or float types");
+    
+    // stored as 1 / magnitude, or 1 for vectors of magnitude 0
+    std::vector<T> scale(count_);
+    magnitudes(policy, scale.data());
+    for (auto& s : scale)
+        s = s == 0 ? T(1) : 1 / s;
+    
+    norms_.clear();
+    vector_detail::for_each_row_chunk(policy, count_, dim_, [&](std::size_t begin, std::size_t end) {
+        if (layout_ == BatchLayout::row_major) {
+            for (std::size_t i = begin; i < end; i++)
+                for (std::size_t j = 0; j < dim_; j++)
+                    entries[i * stride_ + j] *= scale[i];
+        }
+        else {
+            for (std::size_t j = 0; j < dim_; j++)
+                for (std::size_t i = begin; i < end; i++)
+                    entries[j * stride_ + i] *= scale[i];
+        }
+    });
+}
+
+/*
+ @brief     Computes the magnitudes of the vectors once for cosine() and knn().
+ 
+ They are dropped by every non-const access to the elements: operator(),
+ assign(), normalize() and data(). Call it again after changing the batch.
+*/
+template <typename T, typename Allocator>
+void VectorBatch<T, Allocator>::cache_norms() {
+    cache_norms(execution::seq);
+}
+
+template <typename T, typename Allocator>
+template <typename Policy>
+void VectorBatch<T, Allocator>::cache_norms(const Policy& policy) {
+    std::vector<T> norms(count_);
+    magnitudes(policy, norms.data());
+    norms_ = std::move(norms);
+}
+
+// the magnitudes computed by cache_norms(), or nullptr
+template <typename T, typename Allocator>
+const T* VectorBatch<T, Allocator>::cached_norms() const {
+    return norms_.empty() ? nullptr : norms_.data();
+}
+
+// drops the cached norms, as the elements may be written through the pointer
+template <typename T, typename Allocator>
+T* VectorBatch<T, Allocator>::data() {
+    norms_.clear();
+    return entries;
+}
+
+template <typename T, typename Allocator>
+const T* VectorBatch<T, Allocator>::data() const {
+    return entries;
+}
+
+template <typename T, typename Allocator>
+std::size_t VectorBatch<T, Allocator>::allocated() const {
+    return stride_ * (layout_ == BatchLayout::row_major ? count_ : dim_);
+}
+
+/*
+ @brief         Dot product of every vector of the batch with a query.
+ @param out     at least batch.size() elements, out[i] = dot_product(batch[i], query).
+ 
+ Throws std::invalid_argument if the query doesn't have batch.dim() elements.
+ The summation order differs from the one of dot_product(VectorView, VectorView),
+ so floating point results may differ in the last bits.
+*/
+template <typename T, typename Allocator>
+void dot_product(const VectorBatch<T, Allocator>& batch, VectorView<vector_detail::identity_t<T>> query, T* out) {
+    dot_product(execution::seq, batch, query, out);
+}
+
+template <typename Policy, typename T, typename Allocator>
+void dot_product(const Policy& policy, const VectorBatch<T, Allocator>& batch, VectorView<vector_detail::identity_t<T>> query, T* out) {
+    if (query.size() != batch.dim())
+        throw std::invalid_argument("Vectors must have the same size");
+    
+    vector_detail::batch_against<vector_detail::batch_op::dot>(policy, batch, query.data(), out);
+}
+
+/*
+ @brief         Euclidean distance of every vector of the batch to a query.
+ @param out     at least batch.size() elements.
+*/
+template <typename T, typename Allocator>
+void distances(const VectorBatch<T, Allocator>& batch, VectorView<vector_detail::identity_t<T>> query, T* out) {
+    distances(execution::seq, batch, query, out);
+}
+
+template <typename Policy, typename T, typename Allocator>
+void distances(const Policy& policy, const VectorBatch<T, Allocator>& batch, VectorView<vector_detail::identity_t<T>> query, T* out) {
+    if (query.size() != batch.dim())
+        throw std::invalid_argument("Vectors must have the same size");
+    
+    vector_detail::batch_against<vector_detail::batch_op::squared_distance>(policy, batch, query.data(), out);
+    
+    vector_detail::for_each_chunk(policy, batch.size(), [out](std::size_t begin, std::size_t end) {
+        std::transform(out + begin, out + end, out + begin, vector_detail::square_root<T>);
+    });
+}
+
+/*
+ @brief         Euclidean distances between all the vectors of two batches.
+ @param out     at least a.size() * b.size() elements, out[i * b.size() + j] = |a[i] - b[j]|.
+ 
+ Every vector of `a` is compared with a SIMD sweep over `b`; the work is
+ split between threads by vectors of `a`.
+*/
+template <typename T, typename A1, typename A2>
+void pairwise_distances(const VectorBatch<T, A1>& a, const VectorBatch<T, A2>& b, T* out) {
+    pairwise_distances(execution::seq, a, b, out);
+}
+
+template <typename Policy, typename T, typename A1, typename A2>
+void pairwise_distances(const Policy& policy, const VectorBatch<T, A1>& a, const VectorBatch<T, A2>& b, T* out) {
+    if (a.dim() != b.dim())
+        throw std::invalid_argument("Vectors must have the same size");
+    
+    const std::size_t dim = a.dim(), n = b.size();
+    vector_detail::for_each_row_chunk(policy, a.size(), dim * n, [&](std::size_t begin, std::size_t end) {
+        std::vector<T> query(dim);
+        for (std::size_t i = begin; i < end; i++) {
+            const auto row = a.strided_row(i);
+            std::copy(row.begin(), row.end(), query.begin());
+            
+            T* distances = out + i * n;
+            vector_detail::batch_against<vector_detail::batch_op::squared_distance>(execution::seq, b, query.data(), distances);
+            std::transform(distances, distances + n, distances, vector_detail::square_root<T>);
+        }
+    });
+}
+
+/*
+ @brief         Squared euclidean (L2) distance of every vector of the batch to a query.
+ @param out     at least batch.size() elements, out[i] = l2_squared(batch[i], query).
+ 
+ Cheaper than distances() when only the order matters. Throws
+ std::invalid_argument if the query doesn't have batch.dim() elements.
+*/
+template <typename T, typename Allocator>
+void l2_squared(const VectorBatch<T, Allocator>& batch, VectorView<vector_detail::identity_t<T>> query, T* out) {
+    l2_squared(execution::seq, batch, query, out);
+}
+
+template <typename Policy, typename T, typename Allocator>
+void l2_squared(const Policy& policy, const VectorBatch<T, Allocator>& batch, VectorView<vector_detail::identity_t<T>> query, T* out) {
+    if (query.size() != batch.dim())
+        throw std::invalid_argument("Vectors must have the same size");
+    
+    vector_detail::batch_against<vector_detail::batch_op::squared_distance>(policy, batch, query.data(), out);
+}
+
+// L1 (Manhattan) distance of every vector of the batch to a query, out[i] = l1(batch[i], query)
+template <typename T, typename Allocator>
+void l1(const VectorBatch<T, Allocator>& batch, VectorView<vector_detail::identity_t<T>> query, T* out) {
+    l1(execution::seq, batch, query, out);
+}
+
+template <typename Policy, typename T, typename Allocator>
+void l1(const Policy& policy, const VectorBatch<T, Allocator>& batch, VectorView<vector_detail::identity_t<T>> query, T* out) {
+    if (query.size() != batch.dim())
+        throw std::invalid_argument("Vectors must have the same size");
+    
+    vector_detail::batch_against<vector_detail::batch_op::l1>(policy, batch, query.data(), out);
+}
+
+namespace vector_detail {
+    // vectors scored per step of cosine() and knn(), small enough for their rows to stay in L2
+    inline constexpr std::size_t knn_block = 256;
+    
+    // out[0, end - begin) for the vectors [begin, end) of a batch in either layout
+    template <batch_op Op, typename T, typename Allocator>
+    void block_against(const VectorBatch<T, Allocator>& batch, std::size_t begin, std::size_t end, const T* q, T* out) {
+        const std::size_t stride = batch.stride(), dim = batch.dim();
+        
+        if (batch.layout() == BatchLayout::soa)
+            columns_against<Op>(batch.data() + begin, stride, dim, 0, end - begin, q, out);
+        else
+            rows_against<Op>(batch.data() + begin * stride, stride, dim, 0, end - begin, q, out);
+    }
+    
+    /*
+     Cosine similarities of the vectors [begin, end) with a query of
+     magnitude norm_q. The norms come from the cache of the batch or are
+     computed right after the dot products, while the rows are in cache.
+    */
+    template <typename T, typename Allocator>
+    void block_cosines(const VectorBatch<T, Allocator>& batch, std::size_t begin, std::size_t end, const T* q, T norm_q, T* out) {
+        block_against<batch_op::dot>(batch, begin, end, q, out);
+        
+        const std::size_t len = end - begin;
+        const T* norms = batch.cached_norms();
+        T block_norms[knn_block];
+        if (norms) {
+            norms += begin;
+        } else {
+            block_against<batch_op::squared_norm>(batch, begin, end, static_cast<const T*>(nullptr), block_norms);
+            std::transform(block_norms, block_norms + len, block_norms, square_root<T>);
+            norms = block_norms;
+        }
+        
+        for (std::size_t i = 0; i < len; i++)
+            out[i] = cosine_of(out[i], norms[i], norm_q);
+    }
+}
+
+/*
+ @brief         Cosine similarity of every vector of the batch with a query.
+ @param out     at least batch.size() elements, out[i] = cosine(batch[i], query), 0 for vectors of zero magnitude.
+ 
+ One pass over the batch if cache_norms() was called; otherwise the
+ magnitudes are computed block by block while the rows are in cache.
+ Throws std::invalid_argument if the query doesn't have batch.dim() elements.
+*/
+template <typename T, typename Allocator>
+void cosine(const VectorBatch<T, Allocator>& batch, VectorView<vector_detail::identity_t<T>> query, T* out) {
+    cosine(execution::seq, batch, query, out);
+}
+
+template <typename Policy, typename T, typename Allocator>
+void cosine(const Policy& policy, const VectorBatch<T, Allocator>& batch, VectorView<vector_detail::identity_t<T>> query, T* out) {
+    static_assert(std::is_floating_point_v<T>, "Cosine similarity needs floating point elements");
+    if (query.size() != batch.dim())
+        throw std::invalid_argument("Vectors must have the same size");
+    
+    const T norm_q = query.magnitude();
+    vector_detail::for_each_row_chunk(policy, batch.size(), batch.dim(), [&](std::size_t begin, std::size_t end) {
+        for (std::size_t block = begin; block < end; block += vector_detail::knn_block) {
+            const std::size_t last = std::min(end, block + vector_detail::knn_block);
+            vector_detail::block_cosines(batch, block, last, query.data(), norm_q, out + block);
+        }
+    });
+}
+
+/*
+ @brief         Hamming distance of every vector of an integer batch to a query.
+ @param out     at least batch.size() elements, out[i] = hamming(batch[i], query).
+*/
+template <typename T, typename Allocator>
+void hamming(const VectorBatch<T, Allocator>& batch, VectorView<vector_detail::identity_t<T>> query, std::size_t* out) {
+    hamming(execution::seq, batch, query, out);
+}
+
+template <typename Policy, typename T, typename Allocator>
+void hamming(const Policy& policy, const VectorBatch<T, Allocator>& batch, VectorView<vector_detail::identity_t<T>> query, std::size_t* out) {
+    static_assert(std::is_integral_v<T>, "Hamming distance needs integer elements");
+    if (query.size() != batch.dim())
+        throw std::invalid_argument("Vectors must have the same size");
+    
+    const T* q = query.data();
+    vector_detail::for_each_row_chunk(policy, batch.size(), batch.dim(), [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            if (batch.layout() == BatchLayout::row_major) {
+                out[i] = vector_detail::count_differing_bits(batch.data() + i * batch.stride(), q, batch.dim());
+                continue;
+            }
+            
+            const auto row = batch.strided_row(i);
+            std::size_t bits = 0;
+            for (std::size_t j = 0; j < batch.dim(); j++)
+                bits += vector_detail::count_differing_bits(&row[j], q + j, 1);
+            out[i] = bits;
+        }
+    });
+}
+
+// how knn() compares vectors: distances rank smallest first, similarities largest first
+enum class Metric {
+    l2,             // euclidean distance
+    l1,             // Manhattan distance
+    cosine,         // cosine similarity, floating point batches only
+    inner_product   // dot product
+};
+
+namespace vector_detail {
+    template <typename T>
+    bool nearer(const IndexedValue<T>& a, const IndexedValue<T>& b, bool largest_first) {
+        if (largest_first)
+            return b.value < a.value || (!(a.value < b.value) && a.index < b.index);
+        
+        return a.value < b.value || (!(b.value < a.value) && a.index < b.index);
+    }
+    
+    /*
+     Brute-force k nearest neighbours. Every task scores its candidates a
+     block at a time and keeps the best k in a heap of its own whose top is
+     the worst of them, so most candidates cost one comparison; the heaps
+     are merged at the end. L2 candidates are ranked by squared distance and
+     only the k results take a square root.
+    */
+    template <typename Policy, typename T, typename Allocator>
+    std::vector<IndexedValue<T>> knn_of(const Policy& policy, const VectorBatch<T, Allocator>& batch, const T* q,
+                                        std::size_t k, Metric metric)
+    {
+        k = std::min(k, batch.size());
+        if (k == 0)
+            return {};
+        
+        const bool largest_first = metric == Metric::cosine || metric == Metric::inner_product;
+        const auto before = [largest_first](const IndexedValue<T>& a, const IndexedValue<T>& b) {
+            return nearer(a, b, largest_first);
+        };
+        
+        T norm_q = T();
+        if constexpr (std::is_floating_point_v<T>)
+            norm_q = square_root(reduce_dot(q, q, batch.dim()));
+        
+        std::mutex mutex;
+        std::vector<IndexedValue<T>> best;
+        
+        for_each_row_chunk(policy, batch.size(), batch.dim(), [&](std::size_t begin, std::size_t end) {
+            std::vector<IndexedValue<T>> heap;
+            heap.reserve(k);
+            T scores[knn_block];
+            
+            for (std::size_t block = begin; block < end; block += knn_block) {
+                const std::size_t last = std::min(end, block + knn_block);
+                switch (metric) {
+                    case Metric::l2: block_against<batch_op::squared_distance>(batch, block, last, q, scores); break;
+                    case Metric::l1: block_against<batch_op::l1>(batch, block, last, q, scores); break;
+                    case Metric::inner_product: block_against<batch_op::dot>(batch, block, last, q, scores); break;
+                    case Metric::cosine:
+                        if constexpr (std::is_floating_point_v<T>)
+                            block_cosines(batch, block, last, q, norm_q, scores);
+                        break;
+                }
+                
+                for (std::size_t i = block; i < last; i++) {
+                    const IndexedValue<T> candidate{ scores[i - block], i };
+                    if (heap.size() < k) {
+                        heap.push_back(candidate);
+                        std::push_heap(heap.begin(), heap.end(), before);
+                    } else if (before(candidate, heap.front())) {
+                        std::pop_heap(heap.begin(), heap.end(), before);
+                        heap.back() = candidate;
+                        std::push_heap(heap.begin(), heap.end(), before);
+                    }
+                }
+            }
+            
+            std::lock_guard<std::mutex> lock(mutex);
+            best.insert(best.end(), heap.begin(), heap.end());
+        });
+        
+        // the order of the heaps doesn't matter: the ranking is total
+        std::sort(best.begin(), best.end(), before);
+        best.resize(k);
+        
+        if (metric == Metric::l2)
+            for (auto& neighbour : best)
+                neighbour.value = square_root(neighbour.value);
+        
+        return best;
+    }
+}
+
+/*
+ @brief         The k vectors of the batch nearest to a query, by brute force.
+ @param k       the number of neighbours, at most batch.size() are returned.
+ @param metric  Metric::l2 and Metric::l1 return the distances, Metric::cosine
+                and Metric::inner_product the similarities.
+ @return        The neighbours nearest first, ties in index order.
+ 
+ With execution::par every thread keeps the top k of its part of the batch
+ in a heap of its own. Cosine similarities use the norms of cache_norms()
+ when they are there. Throws std::invalid_argument if the query doesn't
+ have batch.dim() elements, or for Metric::cosine on an integer batch.
+*/
+template <typename T, typename Allocator>
+std::vector<IndexedValue<T>> knn(const VectorBatch<T, Allocator>& batch, VectorView<vector_detail::identity_t<T>> query,
+                                 std::size_t k, Metric metric = Metric::l2)
+{
+    return knn(execution::seq, batch, query, k, metric);
+}
+
+template <typename Policy, typename T, typename Allocator>
+std::vector<IndexedValue<T>> knn(const Policy& policy, const VectorBatch<T, Allocator>& batch, VectorView<vector_detail::identity_t<T>> query,
+                                 std::size_t k, Metric metric = Metric::l2)
+{
+    if (query.size() != batch.dim())
+        throw std::invalid_argument("Vectors must have the same size");
+    if (metric == Metric::cosine && !std::is_floating_point_v<T>)
+        throw std::invalid_argument("Cosine similarity needs floating point elements");
+    
+    return vector_detail::knn_of(policy, batch, query.data(), k, metric);
+}
+
+/*
+ Dot products of many queries with many candidates, as one matrix product.
+ 
+ out[i * n + j] = dot_product(query i, candidate j) is computed like a
+ GEMM: candidates are packed in panels that stay in L2 for the K block
+ and are reused by all the queries, queries are packed in small panels
+ that stay in L1, and a register-tiled micro-kernel computes a tile of
+ gemm_mr x gemm_nr results per pass, every loaded element feeding
+ several FMAs. Work is split between threads by candidates; every task
+ packs its panels in its per-thread scratch arena.
+*/
+namespace vector_detail {
+    // rows of a VectorBatch in either layout
+    template <typename T>
+    struct strided_rows {
+        const T* data;
+        std::size_t count;
+        std::size_t dim;
+        std::size_t row_stride;
+        std::size_t element_stride;
+        
+        const T& operator()(std::size_t i, std::size_t k) const {
+            return data[i * row_stride + k * element_stride];
+        }
+    };
+    
+    // rows that are separate vectors
+    template <typename T>
+    struct indirect_rows {
+        const T* const* rows;
+        std::size_t count;
+        std::size_t dim;
+        
+        const T& operator()(std::size_t i, std::size_t k) const {
+            return rows[i][k];
+        }
+    };
+    
+    template <typename T, typename Allocator>
+    strided_rows<T> rows_of(const VectorBatch<T, Allocator>& batch) {
+        if (batch.layout() == BatchLayout::row_major)
+            return { batch.data(), batch.size(), batch.dim(), batch.stride(), 1 };
+        
+        return { batch.data(), batch.size(), batch.dim(), 1, batch.stride() };
+    }
+    
+    template <typename T>
+    constexpr std::size_t gemm_width() {
+        if constexpr (simd_for<T>::has_mul)
+            return simd_for<T>::width;
+        else
+            return 4;
+    }
+    
+    // register tile, and the blocks of queries (M), candidates (N) and dimensions (K)
+    inline constexpr std::size_t gemm_mr = 4;
+    template <typename T>
+    inline constexpr std::size_t gemm_nr = 2 * gemm_width<T>();
+    inline constexpr std::size_t gemm_mc = 64;
+    inline constexpr std::size_t gemm_nc = 512;
+    inline constexpr std::size_t gemm_kc = 256;
+    
+    // packs rows [first, first + rows) x [k0, k0 + depth) in groups of `Group` rows, k-major, zero padded
+    template <std::size_t Group, typename Rows, typename T>
+    void pack_panel(const Rows& src, std::size_t first, std::size_t rows, std::size_t k0, std::size_t depth, T* dst) {
+        for (std::size_t g = 0; g < rows; g += Group) {
+            const std::size_t len = std::min(Group, rows - g);
+            
+            for (std::size_t k = 0; k < depth; k++) {
+                for (std::size_t r = 0; r < len; r++)
+                    dst[r] = src(first + g + r, k0 + k);
+                std::fill(dst + len, dst + Group, T());
+                dst += Group;
+            }
+        }
+    }
+    
+    // c = (accumulate ? c : 0) + a * b for a tile of rows x cols <= gemm_mr x gemm_nr
+    template <typename T>
+    void gemm_micro(std::size_t depth, const T* a, const T* b, T* c, std::size_t ldc,
+                    std::size_t rows, std::size_t cols, bool accumulate)
+    {
+        constexpr std::size_t mr = gemm_mr, nr = gemm_nr<T>;
+        T tile[mr * nr];
+        
+        if constexpr (simd_for<T>::has_mul) {
+            using S = simd_for<T>;
+            constexpr std::size_t w = S::width;
+            
+            typename S::reg acc[mr][2];
+            for (std::size_t r = 0; r < mr; r++)
+                acc[r][0] = acc[r][1] = S::zero();
+            
+            for (std::size_t k = 0; k < depth; k++, a += mr, b += nr) {
+                const auto b0 = S::load(b), b1 = S::load(b + w);
+                for (std::size_t r = 0; r < mr; r++) {
+                    const auto ar = S::set1(static_cast<simd_lane_t<T>>(a[r]));
+                    acc[r][0] = S::fma(ar, b0, acc[r][0]);
+                    acc[r][1] = S::fma(ar, b1, acc[r][1]);
+                }
+            }
+            
+            for (std::size_t r = 0; r < mr; r++) {
+                S::store(tile + r * nr, acc[r][0]);
+                S::store(tile + r * nr + w, acc[r][1]);
+            }
+        }
+        else {
+            std::fill(tile, tile + mr * nr, T());
+            for (std::size_t k = 0; k < depth; k++, a += mr, b += nr)
+                for (std::size_t r = 0; r < mr; r++)
+                    for (std::size_t j = 0; j < nr; j++)
+                        tile[r * nr + j] += a[r] * b[j];
+        }
+        
+        for (std::size_t r = 0; r < rows; r++)
+            for (std::size_t j = 0; j < cols; j++)
+                c[r * ldc + j] = accumulate ? c[r * ldc + j] + tile[r * nr + j] : tile[r * nr + j];
+    }
+    
+    // out[i * ldc + j] for all queries and the candidates [first, last)
+    template <typename T, typename Queries, typename Candidates>
+    void gemm_nt(const Queries& queries, const Candidates& candidates, std::size_t first, std::size_t last, T* out, std::size_t ldc) {
+        constexpr std::size_t mr = gemm_mr, nr = gemm_nr<T>, mc = gemm_mc, nc = gemm_nc, kc = gemm_kc;
+        const std::size_t m = queries.count, dim = queries.dim;
+        
+        if (dim == 0) {
+            for (std::size_t i = 0; i < m; i++)
+                std::fill(out + i * ldc + first, out + i * ldc + last, T());
+            return;
+        }
+        
+        auto& scratch = scratch_arena<T>();
+        scratch.resize(mc * kc + kc * nc);
+        T* packed_queries = scratch.data();
+        T* packed_candidates = packed_queries + mc * kc;
+        
+        for (std::size_t jc = first; jc < last; jc += nc) {
+            const std::size_t ncols = std::min(nc, last - jc);
+            
+            for (std::size_t pc = 0; pc < dim; pc += kc) {
+                const std::size_t depth = std::min(kc, dim - pc);
+                pack_panel<nr>(candidates, jc, ncols, pc, depth, packed_candidates);
+                
+                for (std::size_t ic = 0; ic < m; ic += mc) {
+                    const std::size_t nrows = std::min(mc, m - ic);
+                    pack_panel<mr>(queries, ic, nrows, pc, depth, packed_queries);
+                    
+                    for (std::size_t jr = 0; jr < ncols; jr += nr)
+                        for (std::size_t ir = 0; ir < nrows; ir += mr)
+                            gemm_micro(depth, packed_queries + ir * depth, packed_candidates + jr * depth,
+                                       out + (ic + ir) * ldc + jc + jr, ldc,
+                                       std::min(mr, nrows - ir), std::min(nr, ncols - jr), pc != 0);
+                }
+            }
+        }
+    }
+    
+    template <typename Policy, typename T, typename Queries, typename Candidates>
+    void dot_products(const Policy& policy, const Queries& queries, const Candidates& candidates, T* out) {
+        const std::size_t n = candidates.count;
+        if (queries.count == 0 || n == 0)
+            return;
+        
+        if (queries.dim != candidates.dim)
+            throw std::invalid_argument("Vectors must have the same size");
+        
+        for_each_row_chunk(policy, n, queries.count * queries.dim, [&](std::size_t begin, std::size_t end) {
+            gemm_nt(queries, candidates, begin, end, out, n);
+        });
+    }
+    
+    template <typename T, typename Allocator>
+    indirect_rows<T> rows_of(const std::vector<Vector<T, Dynamic, Allocator>>& vectors, std::vector<const T*>& rows) {
+        const std::size_t dim = vectors.empty() ? 0 : vectors.front().size();
+        
+        rows.resize(vectors.size());
+        for (std::size_t i = 0; i < vectors.size(); i++) {
+            if (vectors[i].size() != dim)
+                throw std::invalid_argument("Vectors must have the same size");
+            rows[i] = vectors[i].data();
+        }
+        
+        return { rows.data(), vectors.size(), dim };
+    }
+}
+
+/*
+ @brief             Dot products of every query with every candidate.
+ @param queries     M vectors.
+ @param candidates  N vectors of the same dimension.
+ @param out         at least M * N elements, out[i * N + j] = dot_product(queries[i], candidates[j]).
+ 
+ Throws std::invalid_argument if the dimensions differ. Results may differ
+ in the last bits from dot_product() of the single vectors, as the
+ elements are summed in a different order.
+*/
+template <typename T, typename A1, typename A2>
+void dot_products(const VectorBatch<T, A1>& queries, const VectorBatch<T, A2>& candidates, T* out) {
+    dot_products(execution::seq, queries, candidates, out);
+}
+
+template <typename Policy, typename T, typename A1, typename A2>
+void dot_products(const Policy& policy, const VectorBatch<T, A1>& queries, const VectorBatch<T, A2>& candidates, T* out) {
+    vector_detail::dot_products(policy, vector_detail::rows_of(queries), vector_detail::rows_of(candidates), out);
+}
+
+// same, for vectors that aren't in a batch; all of them must have the same size
+template <typename T, typename A1, typename A2>
+void dot_products(const std::vector<Vector<T, Dynamic, A1>>& queries, const std::vector<Vector<T, Dynamic, A2>>& candidates, T* out) {
+    dot_products(execution::seq, queries, candidates, out);
+}
+
+template <typename Policy, typename T, typename A1, typename A2>
+void dot_products(const Policy& policy, const std::vector<Vector<T, Dynamic, A1>>& queries,
+                  const std::vector<Vector<T, Dynamic, A2>>& candidates, T* out)
+{
+    std::vector<const T*> query_rows, candidate_rows;
+    vector_detail::dot_products(policy, vector_detail::rows_of(queries, query_rows),
+                                vector_detail::rows_of(candidates, candidate_rows), out);
+}
+
+namespace vector_detail {
+    struct centroid {
+        double mean;
+        double weight;
+    };
+    
+    /*
+     Merging t-digest (Dunning & Ertl): a sorted list of weighted centroids
+     that are small near the tails and large in the middle, so extreme
+     quantiles stay accurate. New samples are buffered and merged in
+     batches, which makes adding a sample O(1) amortized. The digest keeps
+     at most about `compression` centroids whatever the number of samples.
+    */
+    class tdigest {
+    public:
+        explicit tdigest(double compression = 100) : compression_(compression) {}
+        
+        // a weight above 1 stands for that many samples of the same value
+        void add(double x, double weight = 1) {
+            buffer_.push_back({ x, weight });
+            if (buffer_.size() >= buffer_limit())
+                compress();
+        }
+        
+        void merge(const tdigest& other) {
+            buffer_.insert(buffer_.end(), other.centroids_.begin(), other.centroids_.end());
+            buffer_.insert(buffer_.end(), other.buffer_.begin(), other.buffer_.end());
+            compress();
+        }
+        
+        void clear() {
+            centroids_.clear();
+            buffer_.clear();
+        }
+        
+        // `lo` and `hi` are the smallest and the largest sample, the tails are interpolated up to them
+        double quantile(double q, double lo, double hi) const {
+            if (buffer_.empty())
+                return quantile(centroids_, q, lo, hi);
+            
+            std::vector<centroid> merged(centroids_);
+            merged.insert(merged.end(), buffer_.begin(), buffer_.end());
+            
+            return quantile(merge_all(merged), q, lo, hi);
+        }
+        
+    private:
+        static constexpr double pi = 3.14159265358979323846;
+        
+        std::size_t buffer_limit() const {
+            return static_cast<std::size_t>(5 * compression_);
+        }
+        
+        void compress() {
+            buffer_.insert(buffer_.end(), centroids_.begin(), centroids_.end());
+            centroids_ = merge_all(buffer_);
+            buffer_.clear();
+        }
+        
+        // k1 scale function: the weight a centroid may have shrinks towards q = 0 and q = 1
+        double scale(double q) const {
+            return compression_ / (2 * pi) * std::asin(2 * q - 1);
+        }
+        
+        double inverse_scale(double k) const {
+            if (k >= compression_ / 4)
+                return 1;
+            
+            return (std::sin(k * 2 * pi / compression_) + 1) / 2;
+        }
+        
+        std::vector<centroid> merge_all(std::vector<centroid>& all) const {
+            std::vector<centroid> result;
+            if (all.empty())
+                return result;
+            
+            std::sort(all.begin(), all.end(), [](const centroid& a, const centroid& b) { return a.mean < b.mean; });
+            
+            double total = 0;
+            for (const centroid& c : all)
+                total += c.weight;
+            
+            double before = 0;
+            double limit = total * inverse_scale(scale(0) + 1);
+            centroid current = all.front();
+            
+            for (std::size_t i = 1; i < all.size(); i++) {
+                const centroid& next = all[i];
+                if (before + current.weight + next.weight <= limit) {
+                    current.weight += next.weight;
+                    current.mean += (next.mean - current.mean) * next.weight / current.weight;
+                } else {
+                    before += current.weight;
+                    limit = total * inverse_scale(scale(before / total) + 1);
+                    result.push_back(current);
+                    current = next;
+                }
+            }
+            result.push_back(current);
+            
+            return result;
+        }
+        
+        // interpolates between the centers of the centroids around rank q * total weight
+        static double quantile(const std::vector<centroid>& centroids, double q, double lo, double hi) {
+            double total = 0;
+            for (const centroid& c : centroids)
+                total += c.weight;
+            
+            const double target = q * total;
+            const centroid& first = centroids.front();
+            if (target < first.weight / 2)
+                return lo + (first.mean - lo) * target / (first.weight / 2);
+            
+            double before = 0;
+            for (std::size_t i = 0; i + 1 < centroids.size(); i++) {
+                const centroid& c = centroids[i];
+                const centroid& next = centroids[i + 1];
+                const double center = before + c.weight / 2;
+                const double next_center = before + c.weight + next.weight / 2;
+                
+                if (target <= next_center)
+                    return c.mean + (next.mean - c.mean) * (target - center) / (next_center - center);
+                before += c.weight;
+            }
+            
+            const centroid& last = centroids.back();
+            const double center = total - last.weight / 2;
+            
+            return std::min(hi, last.mean + (hi - last.mean) * (target - center) / (last.weight / 2));
+        }
+        
+        double compression_;
+        std::vector<centroid> centroids_;
+        std::vector<centroid> buffer_;
+    };
+}
+
+/*
+ @brief         Vector whose copies share the elements until one of them is written (copy-on-write).
+ @tparam T      the type of the elements.
+ 
+ Copies cost O(1) whatever the size: they hold a reference-counted Vector
+ and only the first write through a shared copy, with mutable_data() or
+ modify(), copies the elements. It has the whole read-only API of a
+ VectorView and converts to one, so the same large vector can be handed
+ to many read-only consumers, on any threads, without copying it.
+ 
+     SharedVector<float> shared(std::move(embeddings));
+     SharedVector<float> copy = shared;     // no copy of the elements
+     copy.mutable_data()[0] = 1.0f;         // copies them, `shared` is unchanged
+ 
+ Views and pointers into a SharedVector are invalidated by the writes and
+ by assigning to it.
+*/
+template <typename T, typename Allocator = AlignedAllocator<T>>
+class SharedVector : public VectorView<T> {
+public:
+    using vector_type = Vector<T, Dynamic, Allocator>;
+    
+    SharedVector() = default;
+    explicit SharedVector(vector_type&&);
+    explicit SharedVector(VectorView<T>, const Allocator& = Allocator());
+    
+    SharedVector(const SharedVector&) = default;
+    SharedVector(SharedVector&&) noexcept;
+    SharedVector& operator=(const SharedVector&) = default;
+    SharedVector& operator=(SharedVector&&) noexcept;
+    
+    // number of SharedVectors sharing the elements, 0 when empty
+    long use_count() const;
+    
+    std::uint64_t hash() const;
+    
+    T* mutable_data();
+    
+    template <typename F>
+    decltype(auto) modify(F&&);
+    
+    vector_type release();
+
+private:
+    void detach();
+    void rebind();
+    
+    std::shared_ptr<vector_type> buffer_;
+};
+
+template <typename T, typename Allocator>
+SharedVector<T, Allocator>::SharedVector(vector_type&& vec)
+    : buffer_(std::make_shared<vector_type>(std::move(vec)))
+{
+    rebind();
+}
+
+template <typename T, typename Allocator>
+SharedVector<T, Allocator>::SharedVector(VectorView<T> view, const Allocator& allocator)
+    : buffer_(std::make_shared<vector_type>(view, allocator))
+{
+    rebind();
+}
+
+template <typename T, typename Allocator>
+SharedVector<T, Allocator>::SharedVector(SharedVector&& other) noexcept
+    : VectorView<T>(other), buffer_(std::move(other.buffer_))
+{
+    static_cast<VectorView<T>&>(other) = VectorView<T>();
+}
+
+template <typename T, typename Allocator>
+SharedVector<T, Allocator>& SharedVector<T, Allocator>::operator=(SharedVector&& other) noexcept {
+    if (this != &other) {
+        static_cast<VectorView<T>&>(*this) = std::exchange(static_cast<VectorView<T>&>(other), VectorView<T>());
+        buffer_ = std::move(other.buffer_);
+    }
+    
+    return *this;
+}
+
+template <typename T, typename Allocator>
+long SharedVector<T, Allocator>::use_count() const {
+    return buffer_.use_count();
+}
+
+// the cached hash of the shared Vector, computed once for all the copies
+template <typename T, typename Allocator>
+std::uint64_t SharedVector<T, Allocator>::hash() const {
+    return buffer_ ? buffer_->hash() : VectorView<T>::hash();
+}
+
+/*
+ @brief     Pointer to the elements for writing, after copying them if they are shared.
+ 
+ The pointer is valid until this SharedVector is copied or assigned to;
+ writing through it after a copy would change both.
+*/
+template <typename T, typename Allocator>
+T* SharedVector<T, Allocator>::mutable_data() {
+    detach();
+    return buffer_->data();
+}
+
+/*
+ @brief     Calls f(vector) with the elements as a Vector that is not shared with anyone,
+            e.g. to resize it.
+ @return    The result of f.
+*/
+template <typename T, typename Allocator>
+template <typename F>
+decltype(auto) SharedVector<T, Allocator>::modify(F&& f) {
+    detach();
+    
+    struct rebind_on_exit {
+        SharedVector* self;
+        ~rebind_on_exit() { self->rebind(); }
+    } guard{ this };
+    
+    return std::forward<F>(f)(*buffer_);
+}
+
+/*
+ @brief     Moves the elements out as a Vector, or copies them if they are shared.
+ 
+ This SharedVector is left empty.
+*/
+template <typename T, typename Allocator>
+typename SharedVector<T, Allocator>::vector_type SharedVector<T, Allocator>::release() {
+    std::shared_ptr<vector_type> buffer = std::exchange(buffer_, nullptr);
+    static_cast<VectorView<T>&>(*this) = VectorView<T>();
+    
+    if (!buffer)
+        return vector_type();
+    if (buffer.use_count() != 1)
+        return vector_type(*buffer);
+    
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return std::move(*buffer);
+}
+
+/*
+ Makes buffer_ the only reference to its Vector. A use count of 1 can only
+ be observed after every other owner released it, with a release decrement
+ that the fence synchronizes with, so their reads happen before our writes.
+*/
+template <typename T, typename Allocator>
+void SharedVector<T, Allocator>::detach() {
+    if (!buffer_)
+        buffer_ = std::make_shared<vector_type>();
+    else if (buffer_.use_count() != 1)
+        buffer_ = std::make_shared<vector_type>(*buffer_);
+    else
+        std::atomic_thread_fence(std::memory_order_acquire);
+    
+    rebind();
+}
+
+template <typename T, typename Allocator>
+void SharedVector<T, Allocator>::rebind() {
+    static_cast<VectorView<T>&>(*this) = buffer_ ? buffer_->view() : VectorView<T>();
+}
+
+namespace vector_detail {
+    // sum of values[k] * dense[indices[k]], four independent chains to hide the latency of the loads
+    template <typename T, typename I>
+    T sparse_dense_dot(const I* indices, const T* values, std::size_t nnz, const T* dense) {
+        T acc0 = T(), acc1 = T(), acc2 = T(), acc3 = T();
+        
+        std::size_t k = 0;
+        for (; k + 4 <= nnz; k += 4) {
+            acc0 += values[k] * dense[indices[k]];
+            acc1 += values[k + 1] * dense[indices[k + 1]];
+            acc2 += values[k + 2] * dense[indices[k + 2]];
+            acc3 += values[k + 3] * dense[indices[k + 3]];
+        }
+        for (; k < nnz; k++)
+            acc0 += values[k] * dense[indices[k]];
+        
+        return (acc0 + acc1) + (acc2 + acc3);
+    }
+    
+    // first position in [from, n) whose index is not less than `target`, probing 1, 2, 4, ... positions ahead
+    template <typename I>
+    std::size_t gallop(const I* indices, std::size_t from, std::size_t n, I target) {
+        std::size_t lo = from;
+        std::size_t hi = from;
+        std::size_t step = 1;
+        
+        while (hi < n && indices[hi] < target) {
+            lo = hi + 1;
+            hi += step;
+            step *= 2;
+        }
+        
+        return std::lower_bound(indices + lo, indices + std::min(hi, n), target) - indices;
+    }
+    
+    // a vector with this many times fewer non-zeros than the other gallops through it instead of merging
+    inline constexpr std::size_t gallop_ratio = 16;
+    
+    template <typename T, typename I>
+    T sparse_dot(const I* ia, const T* va, std::size_t na, const I* ib, const T* vb, std::size_t nb) {
+        if (na > nb) {
+            std::swap(ia, ib);
+            std::swap(va, vb);
+            std::swap(na, nb);
+        }
+        
+        T result = T();
+        
+        if (na * gallop_ratio < nb) {
+            std::size_t j = 0;
+            for (std::size_t i = 0; i < na && j < nb; i++) {
+                j = gallop(ib, j, nb, ia[i]);
+                if (j < nb && ib[j] == ia[i])
+                    result += va[i] * vb[j++];
+            }
+            
+            return result;
+        }
+        
+        // the advances don't branch, only the rare matches do
+        std::size_t i = 0, j = 0;
+        while (i < na && j < nb) {
+            const I x = ia[i];
+            const I y = ib[j];
+            
+            if (x == y)
+                result += va[i] * vb[j];
+            
+            i += x <= y;
+            j += y <= x;
+        }
+        
+        return result;
+    }
+}
+
+/*
+ @brief         Vector that stores only its non-zero elements.
+ @tparam T      the type of the elements.
+ 
+ The non-zeros are kept in two arrays sorted by index, so memory and the
+ cost of sum(), magnitude() and dot_product() grow with nnz() instead of
+ size(). Indices are 32-bit, so size() is at most 2^32.
+ 
+     SparseVector<float> doc(Vector<float>(...));   // drops the zeros
+     float score = dot_product(doc, weights);        // O(nnz) with a dense vector
+ 
+ set() shifts the non-zeros after the element it writes: build large vectors
+ in index order with push_back(), or from a dense vector.
+*/
+template <typename T, typename Allocator = AlignedAllocator<T>>
+class SparseVector {
+    static_assert(std::is_arithmetic_v<T>, "SparseVector should consist of arithmetic types");
+    
+public:
+    using value_type = T;
+    using index_type = std::uint32_t;
+    using allocator_type = Allocator;
+    using index_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<index_type>;
+    
+    SparseVector() = default;
+    explicit SparseVector(std::size_t, const Allocator& = Allocator());
+    explicit SparseVector(VectorView<T>, const Allocator& = Allocator());
+    SparseVector(std::size_t, Vector<index_type, Dynamic, index_allocator>, Vector<T, Dynamic, Allocator>);
+    
+    std::size_t size() const;
+    std::size_t nnz() const;
+    Allocator get_allocator() const;
+    
+    // sorted indices of the non-zeros and their values
+    VectorView<index_type> indices() const;
+    VectorView<T> values() const;
+    
+    T operator[](std::size_t) const;
+    
+    void set(std::size_t, T);
+    void push_back(std::size_t, T);
+    void reserve(std::size_t);
+    void clear();
+    
+    Vector<T, Dynamic, Allocator> to_dense() const;
+    
+    T sum() const;
+    T magnitude() const;
+    void normalize();
+    
+    SparseVector& operator*=(T);
+    SparseVector& operator+=(const SparseVector&);
+    SparseVector& operator-=(const SparseVector&);
+    
+    friend bool operator==(const SparseVector& u, const SparseVector& v) {
+        return u.size_ == v.size_ && u.indices_ == v.indices_ && u.values_ == v.values_;
+    }
+    
+    friend bool operator!=(const SparseVector& u, const SparseVector& v) {
+        return !(u == v);
+    }
+    
+    friend SparseVector operator+(const SparseVector& u, const SparseVector& v) {
+        return combine(u, v, std::plus<>());
+    }
+    
+    friend SparseVector operator-(const SparseVector& u, const SparseVector& v) {
+        return combine(u, v, std::minus<>());
+    }
+    
+    // merges the indices, or gallops through the vector with more non-zeros
+    friend T dot_product(const SparseVector& u, const SparseVector& v) {
+        if (u.size_ != v.size_)
+            throw std::invalid_argument("Vectors must have the same size");
+        
+        return vector_detail::sparse_dot(u.indices_.data(), u.values_.data(), u.nnz(), v.indices_.data(), v.values_.data(), v.nnz());
+    }
+    
+    // defined inline so that dense vectors are converted to views implicitly
+    friend T dot_product(const SparseVector& u, VectorView<T> v) {
+        if (u.size_ != v.size())
+            throw std::invalid_argument("Vectors must have the same size");
+        
+        return vector_detail::sparse_dense_dot(u.indices_.data(), u.values_.data(), u.nnz(), v.data());
+    }
+    
+    friend T dot_product(VectorView<T> u, const SparseVector& v) {
+        return dot_product(v, u);
+    }
+
+private:
+    template <typename Op>
+    static SparseVector combine(const SparseVector&, const SparseVector&, Op);
+    
+    std::size_t lower_bound(std::size_t) const;
+    
+    Vector<index_type, Dynamic, index_allocator> indices_;
+    Vector<T, Dynamic, Allocator> values_;
+    std::size_t size_ = 0;
+};
+
+// a zero vector of `size` elements
+template <typename T, typename Allocator>
+SparseVector<T, Allocator>::SparseVector(std::size_t size, const Allocator& allocator)
+    : indices_(index_allocator(allocator)), values_(allocator), size_(size)
+{
+    if (size > std::size_t(std::numeric_limits<index_type>::max()) + 1)
+        throw std::length_error("SparseVector size exceeds 2^32");
+}
+
+/*
+ @brief         Constructs a sparse vector from the non-zeros of a dense one.
+*/
+template <typename T, typename Allocator>
+SparseVector<T, Allocator>::SparseVector(VectorView<T> dense, const Allocator& allocator)
+    : SparseVector(dense.size(), allocator)
+{
+    const T* data = dense.data();
+    reserve(dense.size() - std::count(data, data + dense.size(), T()));
+    
+    for (std::size_t i = 0; i < dense.size(); i++) {
+        if (data[i] != T()) {
+            indices_.push_back(static_cast<index_type>(i));
+            values_.push_back(data[i]);
+        }
+    }
+}
+
+/*
+ @brief         Constructs a sparse vector from its non-zeros.
+ @param size    the number of elements.
+ @param indices the indices of the non-zeros, strictly increasing and less than `size`.
+ @param values  the values of the non-zeros, as many as the indices.
+ 
+ Throws std::invalid_argument if the indices are not strictly increasing,
+ out of range or not as many as the values. Zero values are kept.
+*/
+template <typename T, typename Allocator>
+SparseVector<T, Allocator>::SparseVector(std::size_t size, Vector<index_type, Dynamic, index_allocator> indices,
+                                         Vector<T, Dynamic, Allocator> values)
+    : indices_(std::move(indices)), values_(std::move(values)), size_(size)
+{
+    if (size > std::size_t(std::numeric_limits<index_type>::max()) + 1)
+        throw std::length_error("SparseVector size exceeds 2^32");
+    
+    if (indices_.size() != values_.size())
+        throw std::invalid_argument("Indices and values must have the same size");
+    
+    const index_type* idx = indices_.data();
+    const std::size_t n = indices_.size();
+    
+    if (n && (std::adjacent_find(idx, idx + n, std::greater_equal<>()) != idx + n || idx[n - 1] >= size))
+        throw std::invalid_argument("Indices must be strictly increasing and less than the size");
+}
+
+template <typename T, typename Allocator>
+std::size_t SparseVector<T, Allocator>::size() const {
+    return size_;
+}
+
+// number of stored elements
+template <typename T, typename Allocator>
+std::size_t SparseVector<T, Allocator>::nnz() const {
+    return values_.size();
+}
+
+template <typename T, typename Allocator>
+Allocator SparseVector<T, Allocator>::get_allocator() const {
+    return values_.get_allocator();
+}
+
+template <typename T, typename Allocator>
+VectorView<typename SparseVector<T, Allocator>::index_type> SparseVector<T, Allocator>::indices() const {
+    return indices_.view();
+}
+
+template <typename T, typename Allocator>
+VectorView<T> SparseVector<T, Allocator>::values() const {
+    return values_.view();
+}
+
+// position of the first non-zero with an index not less than `i`
+template <typename T, typename Allocator>
+std::size_t SparseVector<T, Allocator>::lower_bound(std::size_t i) const {
+    const index_type* idx = indices_.data();
+    return std::lower_bound(idx, idx + nnz(), i) - idx;
+}
+
+/*
+ @brief         Returns element `i`, in O(log nnz()).
+ 
+ Throws std::out_of_range if `i` is not less than size().
+*/
+template <typename T, typename Allocator>
+T SparseVector<T, Allocator>::operator[](std::size_t i) const {
+    if (i >= size_)
+        throw std::out_of_range("Index out of range");
+    
+    const std::size_t pos = lower_bound(i);
+    return pos < nnz() && indices_.data()[pos] == i ? values_.data()[pos] : T();
+}
+
+/*
+ @brief         Writes element `i`; writing 0 removes it.
+ 
+ O(nnz()) when the element is inserted or removed, since the non-zeros
+ after it are shifted.
+*/
+template <typename T, typename Allocator>
+void SparseVector<T, Allocator>::set(std::size_t i, T value) {
+    if (i >= size_)
+        throw std::out_of_range("Index out of range");
+    
+    const std::size_t pos = lower_bound(i);
+    
+    if (pos < nnz() && indices_.data()[pos] == i) {
+        if (value == T()) {
+            indices_.erase(pos);
+            values_.erase(pos);
+        }
+        else {
+            values_.data()[pos] = value;
+        }
+    }
+    else if (value != T()) {
+        indices_.insert(pos, static_cast<index_type>(i));
+        
+        try {
+            values_.insert(pos, value);
+        }
+        catch (...) {
+            indices_.erase(pos);
+            throw;
+        }
+    }
+}
+
+/*
+ @brief         Appends element `i`, in amortized O(1); zeros are skipped.
+ 
+ Throws std::invalid_argument unless `i` is greater than the indices of
+ all the non-zeros.
+*/
+template <typename T, typename Allocator>
+void SparseVector<T, Allocator>::push_back(std::size_t i, T value) {
+    if (i >= size_)
+        throw std::out_of_range("Index out of range");
+    
+    if (nnz() && i <= indices_.data()[nnz() - 1])
+        throw std::invalid_argument("Indices must be strictly increasing");
+    
+    if (value == T())
+        return;
+    
+    indices_.push_back(static_cast<index_type>(i));
+    
+    try {
+        values_.push_back(value);
+    }
+    catch (...) {
+        indices_.pop_back();
+        throw;
+    }
+}
+
+// reserves storage for `count` non-zeros
+template <typename T, typename Allocator>
+void SparseVector<T, Allocator>::reserve(std::size_t count) {
+    indices_.reserve(count);
+    values_.reserve(count);
+}
+
+// sets all elements to 0, the size is unchanged
+template <typename T, typename Allocator>
+void SparseVector<T, Allocator>::clear() {
+    indices_.clear();
+    values_.clear();
+}
+
+template <typename T, typename Allocator>
+Vector<T, Dynamic, Allocator> SparseVector<T, Allocator>::to_dense() const {
+    Vector<T, Dynamic, Allocator> dense(size_, values_.get_allocator());
+    
+    T* out = dense.data();
+    const index_type* idx = indices_.data();
+    const T* val = values_.data();
+    
+    for (std::size_t k = 0; k < nnz(); k++)
+        out[idx[k]] = val[k];
+    
+    return dense;
+}
+
+template <typename T, typename Allocator>
+T SparseVector<T, Allocator>::sum() const {
+    return values_.sum();
+}
+
+template <typename T, typename Allocator>
+T SparseVector<T, Allocator>::magnitude() const {
+    return values_.magnitude();
+}
+
+// divides the vector by its magnitude, unless the magnitude is 0
+template <typename T, typename Allocator>
+void SparseVector<T, Allocator>::normalize() {
+    values_.normalize();
+}
+
+template <typename T, typename Allocator>
+SparseVector<T, Allocator>& SparseVector<T, Allocator>::operator*=(T scalar) {
+    if (scalar == T())
+        clear();
+    else
+        values_ *= scalar;
+    
+    return *this;
+}
+
+template <typename T, typename Allocator>
+SparseVector<T, Allocator>& SparseVector<T, Allocator>::operator+=(const SparseVector& other) {
+    return *this = *this + other;
+}
+
+template <typename T, typename Allocator>
+SparseVector<T, Allocator>& SparseVector<T, Allocator>::operator-=(const SparseVector& other) {
+    return *this = *this - other;
+}
+
+// op(u[i], v[i]) over the union of the non-zeros, dropping the elements that cancel out
+template <typename T, typename Allocator>
+template <typename Op>
+SparseVector<T, Allocator> SparseVector<T, Allocator>::combine(const SparseVector& u, const SparseVector& v, Op op) {
+    if (u.size_ != v.size_)
+        throw std::invalid_argument("Vectors must have the same size");
+    
+    const std::size_t nu = u.nnz();
+    const std::size_t nv = v.nnz();
+    
+    Vector<index_type, Dynamic, index_allocator> indices(nu + nv, uninitialized, u.indices_.get_allocator());
+    Vector<T, Dynamic, Allocator> values(nu + nv, uninitialized, u.values_.get_allocator());
+    
+    const index_type* iu = u.indices_.data();
+    const index_type* iv = v.indices_.data();
+    const T* vu = u.values_.data();
+    const T* vv = v.values_.data();
+    index_type* io = indices.data();
+    T* vo = values.data();
+    
+    std::size_t i = 0, j = 0, n = 0;
+    while (i < nu || j < nv) {
+        T value;
+        
+        if (j == nv || (i < nu && iu[i] < iv[j])) {
+            io[n] = iu[i];
+            value = op(vu[i++], T());
+        }
+        else if (i == nu || iv[j] < iu[i]) {
+            io[n] = iv[j];
+            value = op(T(), vv[j++]);
+        }
+        else {
+            io[n] = iu[i];
+            value = op(vu[i++], vv[j++]);
+        }
+        
+        vo[n] = value;
+        n += value != T();
+    }
+    
+    indices.resize(n, 0);
+    values.resize(n, T());
+    
+    return SparseVector(u.size_, std::move(indices), std::move(values));
+}
+
+/*
+ @brief         Adds a sparse vector to a dense one, in O(nnz()).
+*/
+template <typename T, typename A, typename B>
+Vector<T, Dynamic, A>& operator+=(Vector<T, Dynamic, A>& u, const SparseVector<T, B>& v) {
+    if (u.size() != v.size())
+        throw std::invalid_argument("Vectors must have the same size");
+    
+    T* out = u.data();
+    const auto* idx = v.indices().data();
+    const T* val = v.values().data();
+    
+    for (std::size_t k = 0; k < v.nnz(); k++)
+        out[idx[k]] += val[k];
+    
+    return u;
+}
+
+template <typename T, typename A, typename B>
+Vector<T, Dynamic, A>& operator-=(Vector<T, Dynamic, A>& u, const SparseVector<T, B>& v) {
+    if (u.size() != v.size())
+        throw std::invalid_argument("Vectors must have the same size");
+    
+    T* out = u.data();
+    const auto* idx = v.indices().data();
+    const T* val = v.values().data();
+    
+    for (std::size_t k = 0; k < v.nnz(); k++)
+        out[idx[k]] -= val[k];
+    
+    return u;
+}
+
+/*
+ @brief             Vector of float stored in a compact format.
+ @tparam Storage    float16, bfloat16 or std::int8_t.
+ 
+ Takes 2 (float16, bfloat16) or 4 (int8) times less memory and bandwidth
+ than a Vector<float>, for corpora of embeddings that should stay in RAM.
+ The elements are read as floats: element i is data()[i] * scale().
+ int8 vectors are quantized symmetrically, scale() = max |x| / 127, and
+ their dot products are computed exactly in integers before scaling; the
+ other results are accumulated in float.
+ 
+     Float16Vector stored(embedding);                  // converts from a view of floats
+     float score = dot_product(stored, query);         // with another CompactVector or a view of floats
+     Vector<float> restored = stored.to_vector();
+ 
+ The elements to quantize must be finite.
+*/
+template <typename Storage, typename Allocator = AlignedAllocator<Storage>>
+class CompactVector {
+    static_assert(std::is_same_v<Storage, float16> || std::is_same_v<Storage, bfloat16> || std::is_same_v<Storage, std::int8_t>,
+                  "CompactVector stores float16, bfloat16 or std::int8_t");
+    
+public:
+    using value_type = float;
+    using storage_type = Storage;
+    using allocator_type = Allocator;
+    
+    CompactVector() = default;
+    explicit CompactVector(VectorView<float>, const Allocator& = Allocator());
+    
+    std::size_t size() const;
+    const Storage* data() const;
+    float scale() const;
+    Allocator get_allocator() const;
+    
+    float operator[](std::size_t) const;
+    float at(std::size_t) const;
+    
+    Vector<float> to_vector() const;
+    
+    float sum() const;
+    float magnitude() const;
+    
+    friend float dot_product(const CompactVector& u, const CompactVector& v) {
+        if (u.size() != v.size())
+            throw std::invalid_argument("Vectors must have the same size");
+        
+        if constexpr (std::is_same_v<Storage, std::int8_t>) {
+            const auto dot = vector_detail::int8_reduce<true>(u.data(), v.data(), u.size());
+            return static_cast<float>(static_cast<double>(dot) * u.scale_ * v.scale_);
+        }
+        else {
+            return vector_detail::widening_dot(u.data(), v.data(), u.size());
+        }
+    }
+    
+    // defined inline so that vectors of floats are converted to views implicitly
+    friend float dot_product(const CompactVector& u, VectorView<float> v) {
+        if (u.size() != v.size())
+            throw std::invalid_argument("Vectors must have the same size");
+        
+        return vector_detail::widening_dot(u.data(), v.data(), u.size()) * u.scale_;
+    }
+    
+    friend float dot_product(VectorView<float> u, const CompactVector& v) {
+        return dot_product(v, u);
+    }
+
+private:
+    Vector<Storage, Dynamic, Allocator> elements_;
+    float scale_ = 1;
+};
+
+using Float16Vector = CompactVector<float16>;
+using BFloat16Vector = CompactVector<bfloat16>;
+using Int8Vector = CompactVector<std::int8_t>;
+
+/*
+ @brief         Converts, or quantizes for int8, a vector of floats.
+*/
+template <typename Storage, typename Allocator>
+CompactVector<Storage, Allocator>::CompactVector(VectorView<float> vec, const Allocator& allocator)
+    : elements_(vec.size(), uninitialized, allocator)
+{
+    Storage* out = elements_.data();
+    
+    if constexpr (std::is_same_v<Storage, std::int8_t>) {
+        float max_abs = 0;
+        if (vec.size()) {
+            const auto extrema = vec.minmax();
+            max_abs = std::max(std::abs(extrema.min.value), std::abs(extrema.max.value));
+        }
+        
+        if (max_abs == 0) {
+            std::fill_n(out, vec.size(), std::int8_t(0));
+            return;
+        }
+        
+        scale_ = max_abs / 127;
+        vector_detail::quantize(vec.data(), vec.size(), 127 / max_abs, out);
+    }
+    else {
+        vector_detail::narrow(vec.data(), vec.size(), out);
+    }
+}
+
+template <typename Storage, typename Allocator>
+std::size_t CompactVector<Storage, Allocator>::size() const {
+    return elements_.size();
+}
+
+template <typename Storage, typename Allocator>
+const Storage* CompactVector<Storage, Allocator>::data() const {
+    return elements_.data();
+}
+
+// 1 for float16 and bfloat16
+template <typename Storage, typename Allocator>
+float CompactVector<Storage, Allocator>::scale() const {
+    return scale_;
+}
+
+template <typename Storage, typename Allocator>
+Allocator CompactVector<Storage, Allocator>::get_allocator() const {
+    return elements_.get_allocator();
+}
+
+template <typename Storage, typename Allocator>
+float CompactVector<Storage, Allocator>::operator[](std::size_t i) const {
+    VECTOR_CHECK_INDEX(i, size());
+    return vector_detail::to_float(elements_.data()[i]) * scale_;
+}
+
+template <typename Storage, typename Allocator>
+float CompactVector<Storage, Allocator>::at(std::size_t i) const {
+    if (i >= size())
+        throw std::out_of_range("Index out of range");
+    
+    return (*this)[i];
+}
+
+template <typename Storage, typename Allocator>
+Vector<float> CompactVector<Storage, Allocator>::to_vector() const {
+    Vector<float> vec(size(), uninitialized);
+    vector_detail::widen_into(elements_.data(), size(), scale_, vec.data());
+    
+    return vec;
+}
+
+template <typename Storage, typename Allocator>
+float CompactVector<Storage, Allocator>::sum() const {
+    if constexpr (std::is_same_v<Storage, std::int8_t>)
+        return static_cast<float>(static_cast<double>(vector_detail::int8_reduce<false>(data(), nullptr, size())) * scale_);
+    else
+        return vector_detail::widening_sum(data(), size());
+}
+
+template <typename Storage, typename Allocator>
+float CompactVector<Storage, Allocator>::magnitude() const {
+    return std::sqrt(dot_product(*this, *this));
+}
+
+/*
+ @brief         Statistics of a stream of samples, updated in O(1) per sample.
+ @tparam T      the type of the samples.
+ 
+ Keeps the count, a compensated (Kahan) sum, the product, the
+ mean and variance (Welford's algorithm), the extremes and a t-digest for
+ approximate quantiles, so the samples themselves are never stored. The
+ results are computed in `result_type`, double for integer samples.
+ 
+ Not thread-safe: give each thread its own RunningStats and merge() them.
+*/
+template <typename T>
+class RunningStats {
+public:
+    using value_type = T;
+    using result_type = std::conditional_t<std::is_floating_point_v<T>, T, double>;
+    
+    // about `compression` centroids are kept for the quantiles, more is more accurate
+    explicit RunningStats(double compression = 100);
+    
+    void push(T);
+    void push(VectorView<T>);
+    
+    template <typename InputIt>
+    void push(InputIt, InputIt);
+    
+    RunningStats& merge(const RunningStats&);
+    void clear();
+    
+    std::size_t count() const;
+    
+    result_type sum() const;
+    result_type product() const;
+    result_type mean() const;
+    
+    result_type variance() const;
+    result_type sample_variance() const;
+    result_type stddev() const;
+    
+    T min() const;
+    T max() const;
+    
+    // approximate, from the t-digest
+    result_type median() const;
+    result_type quantile(double) const;
+
+private:
+    void add_to_sum(result_type);
+    void check_not_empty() const;
+    
+    std::size_t count_ = 0;
+    
+    // Kahan summation: compensation_ is the rounding error sum_ still owes
+    result_type sum_ = 0;
+    result_type compensation_ = 0;
+    result_type product_ = 1;
+    result_type mean_ = 0;
+    result_type m2_ = 0;
+    T min_ = T();
+    T max_ = T();
+    vector_detail::tdigest digest_;
+};
+
+template <typename T>
+RunningStats<T>::RunningStats(double compression) : digest_(compression) {
+    if (!(compression >= 1))
+        throw std::invalid_argument("Compression must be at least 1");
+}
+
+template <typename T>
+void RunningStats<T>::push(T value) {
+    const auto x = static_cast<result_type>(value);
+    
+    if (count_ == 0) {
+        min_ = max_ = value;
+    } else {
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+    count_++;
+    
+    add_to_sum(x);
+    product_ *= x;
+    
+    const result_type delta = x - mean_;
+    mean_ += delta / static_cast<result_type>(count_);
+    m2_ += delta * (x - mean_);
+    
+    digest_.add(static_cast<double>(value));
+}
+
+template <typename T>
+void RunningStats<T>::push(VectorView<T> values) {
+    push(values.begin(), values.end());
+}
+
+template <typename T>
+template <typename InputIt>
+void RunningStats<T>::push(InputIt first, InputIt last) {
+    for (; first != last; ++first)
+        push(static_cast<T>(*first));
+}
+
+/*
+ @brief         Adds the samples of another accumulator, e.g. one filled by another thread.
+ 
+ The result is the same as if all the samples had been pushed into this
+ one, up to rounding and the approximation of the quantiles.
+*/
+template <typename T>
+RunningStats<T>& RunningStats<T>::merge(const RunningStats& other) {
+    if (other.count_ == 0)
+        return *this;
+    if (&other == this)
+        return merge(RunningStats(other));
+    
+    if (count_ == 0) {
+        min_ = other.min_;
+        max_ = other.max_;
+    } else {
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+    
+    add_to_sum(other.sum_);
+    add_to_sum(-other.compensation_);
+    
+    product_ *= other.product_;
+    
+    // Chan et al.: combine the means and the sums of squared deviations
+    const auto n = static_cast<result_type>(count_ + other.count_);
+    const result_type delta = other.mean_ - mean_;
+    mean_ += delta * static_cast<result_type>(other.count_) / n;
+    m2_ += other.m2_ + delta * delta * static_cast<result_type>(count_) * static_cast<result_type>(other.count_) / n;
+    count_ += other.count_;
+    
+    digest_.merge(other.digest_);
+    
+    return *this;
+}
+
+template <typename T>
+void RunningStats<T>::clear() {
+    count_ = 0;
+    sum_ = compensation_ = mean_ = m2_ = 0;
+    product_ = 1;
+    min_ = max_ = T();
+    digest_.clear();
+}
+
+template <typename T>
+std::size_t RunningStats<T>::count() const {
+    return count_;
+}
+
+template <typename T>
+typename RunningStats<T>::result_type RunningStats<T>::sum() const {
+    return sum_ - compensation_;
+}
+
+template <typename T>
+typename RunningStats<T>::result_type RunningStats<T>::product() const {
+    return product_;
+}
+
+template <typename T>
+typename RunningStats<T>::result_type RunningStats<T>::mean() const {
+    check_not_empty();
+    return mean_;
+}
+
+// population variance, divided by the count
+template <typename T>
+typename RunningStats<T>::result_type RunningStats<T>::variance() const {
+    check_not_empty();
+    return m2_ / static_cast<result_type>(count_);
+}
+
+// unbiased estimate, divided by count - 1
+template <typename T>
+typename RunningStats<T>::result_type RunningStats<T>::sample_variance() const {
+    if (count_ < 2)
+        throw std::length_error("Sample variance needs at least 2 samples");
+    
+    return m2_ / static_cast<result_type>(count_ - 1);
+}
+
+template <typename T>
+typename RunningStats<T>::result_type RunningStats<T>::stddev() const {
+    return std::sqrt(variance());
+}
+
+template <typename T>
+T RunningStats<T>::min() const {
+    check_not_empty();
+    return min_;
+}
+
+template <typename T>
+T RunningStats<T>::max() const {
+    check_not_empty();
+    return max_;
+}
+
+template <typename T>
+typename RunningStats<T>::result_type RunningStats<T>::median() const {
+    return quantile(0.5);
+}
+
+/*
+ @brief     Approximate p-quantile of the samples, p in [0, 1].
+ 
+ Exact for p = 0 and p = 1 and while only a few samples were pushed; the
+ error is largest around the median and shrinks towards the tails.
+ Throws std::invalid_argument if p is outside [0, 1].
+*/
+template <typename T>
+typename RunningStats<T>::result_type RunningStats<T>::quantile(double p) const {
+    if (!(p >= 0 && p <= 1))
+        throw std::invalid_argument("Quantile must be in [0, 1]");
+    check_not_empty();
+    
+    if (p == 0)
+        return static_cast<result_type>(min_);
+    if (p == 1)
+        return static_cast<result_type>(max_);
+    
+    return static_cast<result_type>(digest_.quantile(p, static_cast<double>(min_), static_cast<double>(max_)));
+}
+
+template <typename T>
+void RunningStats<T>::add_to_sum(result_type x) {
+    const result_type y = x - compensation_;
+    const result_type sum = sum_ + y;
+    compensation_ = (sum - sum_) - y;
+    sum_ = sum;
+}
+
+template <typename T>
+void RunningStats<T>::check_not_empty() const {
+    if (count_ == 0)
+        throw std::length_error("No samples were pushed");
+}
+
+/*
+ Binary files.
+ 
+ A file is a 64-byte VectorFileHeader followed by the raw elements in the
+ byte order of the machine that wrote it. The payload starts at
+ payload_offset, a multiple of 64, so a mapped file keeps the alignment of
+ a Vector and SIMD loads on it are as fast as on memory.
+*/
+enum class DType : std::uint8_t {
+    int8 = 1, uint8, int16, uint16, int32, uint32, int64, uint64, float32, float64, float16, bfloat16
+};
+
+struct VectorFileHeader {
+    char magic[8];                  // "MVECTOR\0"
+    std::uint32_t version;
+    std::uint32_t payload_offset;   // bytes from the start of the file to the first element
+    std::uint32_t alignment;        // payload_offset is a multiple of it
+    std::uint8_t dtype;             // DType of the elements
+    std::uint8_t element_size;
+    std::uint8_t endianness;        // 1 = little, 2 = big endian
+    std::uint8_t reserved0;
+    std::uint64_t size;             // number of elements
+    unsigned char reserved[32];
+};
+
+static_assert(sizeof(VectorFileHeader) == 64, "VectorFileHeader must be 64 bytes");
+
+namespace vector_detail {
+    inline constexpr char file_magic[8] = { 'M', 'V', 'E', 'C', 'T', 'O', 'R', '\0' };
+    inline constexpr std::uint32_t file_version = 1;
+    inline constexpr std::uint32_t file_alignment = 64;
+    
+    enum : std::uint8_t { little_endian = 1, big_endian = 2 };
+    
+    inline std::uint8_t native_endianness() {
+        const std::uint16_t probe = 1;
+        unsigned char first;
+        std::memcpy(&first, &probe, 1);
+        
+        return first == 1 ? little_endian : big_endian;
+    }
+    
+    template <typename T>
+    constexpr DType dtype_of() {
+        static_assert((std::is_arithmetic_v<T> && !std::is_same_v<T, bool>) || std::is_same_v<T, float16> || std::is_same_v<T, bfloat16>,
+                      "Only numbers can be written to binary files");
+        
+        if constexpr (std::is_same_v<T, float16>) {
+            return DType::float16;
+        } else if constexpr (std::is_same_v<T, bfloat16>) {
+            return DType::bfloat16;
+        } else if constexpr (std::is_floating_point_v<T>) {
+            static_assert(sizeof(T) == 4 || sizeof(T) == 8, "Only 32- and 64-bit floating point numbers are supported");
+            return sizeof(T) == 4 ? DType::float32 : DType::float64;
+        } else {
+            constexpr bool is_signed = std::is_signed_v<T>;
+            switch (sizeof(T)) {
+                case 1: return is_signed ? DType::int8 : DType::uint8;
+                case 2: return is_signed ? DType::int16 : DType::uint16;
+                case 4: return is_signed ? DType::int32 : DType::uint32;
+                default: return is_signed ? DType::int64 : DType::uint64;
+            }
+        }
+    }
+    
+    // reverses the bytes of `count` elements of `size` bytes each
+    inline void byteswap(void* data, std::size_t size, std::size_t count) {
+        auto* bytes = static_cast<unsigned char*>(data);
+        for (std::size_t i = 0; i < count; i++)
+            std::reverse(bytes + i * size, bytes + (i + 1) * size);
+    }
+    
+    template <typename U>
+    void byteswap(U& value) {
+        byteswap(&value, sizeof(U), 1);
+    }
+    
+    template <typename T>
+    VectorFileHeader make_header(std::size_t n) {
+        VectorFileHeader header{};
+        std::memcpy(header.magic, file_magic, sizeof(file_magic));
+        header.version = file_version;
+        header.payload_offset = sizeof(VectorFileHeader);
+        header.alignment = file_alignment;
+        header.dtype = static_cast<std::uint8_t>(dtype_of<T>());
+        header.element_size = sizeof(T);
+        header.endianness = native_endianness();
+        header.size = n;
+        
+        return header;
+    }
+    
+    // validates a header read from a file and converts it to the native byte order,
+    // returns true if the elements have to be byte-swapped as well
+    template <typename T>
+    bool check_header(VectorFileHeader& header) {
+        if (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0)
+            throw std::runtime_error("Not a vector file");
+        if (header.endianness != little_endian && header.endianness != big_endian)
+            throw std::runtime_error("Corrupt vector file");
+        
+        const bool swap = header.endianness != native_endianness();
+        if (swap) {
+            byteswap(header.version);
+            byteswap(header.payload_offset);
+            byteswap(header.alignment);
+            byteswap(header.size);
+        }
+        
+        if (header.version != file_version)
+            throw std::runtime_error("Unsupported vector file version");
+        if (header.dtype != static_cast<std::uint8_t>(dtype_of<T>()) || header.element_size != sizeof(T))
+            throw std::runtime_error("Vector file holds elements of another type");
+        if (header.payload_offset < sizeof(VectorFileHeader) || header.size > std::numeric_limits<std::size_t>::max() / sizeof(T))
+            throw std::runtime_error("Corrupt vector file");
+        
+        return swap;
+    }
+    
+    // writes the header and the payload with as few system calls as possible
+    inline void write_file(const std::string& path, const VectorFileHeader& header, const void* payload, std::size_t bytes) {
+#if defined(VECTOR_HAS_MMAP)
+        const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            throw std::system_error(errno, std::generic_category(), "Cannot open " + path);
+        
+        iovec parts[2] = {
+            { const_cast<VectorFileHeader*>(&header), sizeof(header) },
+            { const_cast<void*>(payload), bytes }
+        };
+        
+        // writev may write less than asked for, e.g. at most 2 GB at once on Linux
+        iovec* first = parts;
+        int count = 2;
+        while (count > 0) {
+            const ssize_t written = ::writev(fd, first, count);
+            if (written < 0) {
+                if (errno == EINTR)
+                    continue;
+                
+                const int error = errno;
+                ::close(fd);
+                throw std::system_error(error, std::generic_category(), "Cannot write " + path);
+            }
+            
+            auto left = static_cast<std::size_t>(written);
+            while (count > 0 && left >= first->iov_len) {
+                left -= first->iov_len;
+                first++;
+                count--;
+            }
+            
+            if (count > 0) {
+                first->iov_base = static_cast<char*>(first->iov_base) + left;
+                first->iov_len -= left;
+            }
+        }
+        
+        if (::close(fd) != 0)
+            throw std::system_error(errno, std::generic_category(), "Cannot write " + path);
+#else
+        std::ofstream os(path, std::ios::binary | std::ios::trunc);
+        if (!os)
+            throw std::runtime_error("Cannot open " + path);
+        
+        os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        os.write(static_cast<const char*>(payload), static_cast<std::streamsize>(bytes));
+        os.close();
+        if (!os)
+            throw std::runtime_error("Cannot write " + path);
+#endif
+    }
+}
+
+#if defined(VECTOR_HAS_MMAP)
+/*
+ @brief         Read-only vector backed by a memory-mapped file, see Vector::map().
+ 
+ Nothing is read until it is first accessed; the pages are loaded by the
+ kernel on demand and shared with the page cache, so mapping a file is
+ O(1) no matter how large it is. It has the whole read-only API of a
+ VectorView and converts to one; views must not outlive the mapping.
+*/
 template <typename T>
-class Vector {
+class MappedVector : public VectorView<T> {
 public:
-    Vector() = default;
-    Vector(std::size_t);
-    Vector(const std::unique_ptr<T[]>&);
-    Vector(Vector&&);
+    MappedVector() = default;
+    MappedVector(MappedVector&&) noexcept;
+    MappedVector& operator=(MappedVector&&) noexcept;
+    ~MappedVector();
+
+private:
+    template <typename, std::size_t, typename>
+    friend class Vector;
     
-    std::size_t size() const;
-    T magnitude() const;
+    MappedVector(void*, std::size_t);
     
-    T mean() const;
-    T median() const;
+    void unmap();
     
-    std::variant<T, std::vector<std::size_t>> max() const;
-    std::variant<T, std::vector<std::size_t>> min() const;
+    void* mapping_ = nullptr;
+    std::size_t mapping_size_ = 0;
+};
+
+template <typename T>
+MappedVector<T>::MappedVector(void* mapping, std::size_t mapping_size) : mapping_(mapping), mapping_size_(mapping_size) {}
+
+template <typename T>
+MappedVector<T>::MappedVector(MappedVector&& other) noexcept
+    : VectorView<T>(other), mapping_(std::exchange(other.mapping_, nullptr)), mapping_size_(std::exchange(other.mapping_size_, 0))
+{
+    static_cast<VectorView<T>&>(other) = VectorView<T>();
+}
+
+template <typename T>
+MappedVector<T>& MappedVector<T>::operator=(MappedVector&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        static_cast<VectorView<T>&>(*this) = std::exchange(static_cast<VectorView<T>&>(other), VectorView<T>());
+        mapping_ = std::exchange(other.mapping_, nullptr);
+        mapping_size_ = std::exchange(other.mapping_size_, 0);
+    }
     
-    T sum() const;
-    T product() const;
+    return *this;
+}
+
+template <typename T>
+MappedVector<T>::~MappedVector() {
+    unmap();
+}
+
+template <typename T>
+void MappedVector<T>::unmap() {
+    if (mapping_)
+        ::munmap(mapping_, mapping_size_);
+}
+#endif
+
+/*
+ @brief         Writes the vector to a binary file or stream.
+ 
+ The file path is written with a single writev() of the header and the
+ elements, without copying them. Throws std::runtime_error (std::system_error
+ with the errno for files) if writing fails.
+*/
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::save(std::ostream& os) const {
+    const auto header = vector_detail::make_header<T>(size());
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    os.write(reinterpret_cast<const char*>(data()), static_cast<std::streamsize>(size() * sizeof(T)));
     
-    void normalize();
-    void clear();
-    void resize(std::size_t, const T&);
+    if (!os)
+        throw std::runtime_error("Cannot write vector");
+}
+
+template <typename T, typename Allocator>
+void Vector<T, Dynamic, Allocator>::save(const std::string& path) const {
+    vector_detail::write_file(path, vector_detail::make_header<T>(size()), data(), size() * sizeof(T));
+}
+
+/*
+ @brief         Reads a vector written by save().
+ 
+ The elements are read straight into the new vector and converted if the
+ file was written on a machine with a different byte order. Throws
+ std::runtime_error if the file is not a vector file, holds elements of
+ another type or is truncated.
+*/
+template <typename T, typename Allocator>
+Vector<T, Dynamic, Allocator> Vector<T, Dynamic, Allocator>::load(std::istream& is, const Allocator& alloc) {
+    VECTOR_OPERATION(construct);
+    VectorFileHeader header;
+    if (!is.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        throw std::runtime_error("Not a vector file");
     
-    Vector subvec(std::size_t, std::size_t) const;
+    const bool swap = vector_detail::check_header<T>(header);
+    is.ignore(header.payload_offset - sizeof(header));
     
-    template <typename A>
-    friend Vector<A> concat(const Vector<A>&, const Vector<A>&);
+    // fail before allocating if a seekable stream is too short
+    const std::size_t bytes = header.size * sizeof(T);
+    const auto position = is.tellg();
+    if (position != std::streampos(-1)) {
+        is.seekg(0, std::ios::end);
+        const auto available = static_cast<std::size_t>(is.tellg() - position);
+        is.seekg(position);
+        
+        if (available < bytes)
+            throw std::runtime_error("Truncated vector file");
+    }
     
-    void insert(std::size_t, const T&); // insert
-    void insert(std::size_t, std::size_t, const T&); // insert specific amount of values
+    Vector result(header.size, uninitialized, alloc);
+    if (!is.read(reinterpret_cast<char*>(result.data()), static_cast<std::streamsize>(bytes)))
+        throw std::runtime_error("Truncated vector file");
     
-    template <typename InputIt>
-    void insert(std::size_t, InputIt, InputIt);
+    if (swap)
+        vector_detail::byteswap(result.data(), sizeof(T), result.size());
     
-    void insert(std::size_t, std::initializer_list<T>);
+    return result;
+}
+
+template <typename T, typename Allocator>
+Vector<T, Dynamic, Allocator> Vector<T, Dynamic, Allocator>::load(const std::string& path, const Allocator& alloc) {
+    std::ifstream is(path, std::ios::binary);
+    if (!is)
+        throw std::runtime_error("Cannot open " + path);
     
-    void erase(std::size_t);
-    void erase(std::size_t first, std::size_t last);
+    return load(is, alloc);
+}
+
+#if defined(VECTOR_HAS_MMAP)
+/*
+ @brief         Maps a file written by save() without copying it.
+ @param path    the file, which must not be modified while it is mapped.
+ 
+ The returned vector is read-only and keeps the mapping alive. Throws
+ std::system_error if the file cannot be mapped and std::runtime_error if
+ it is not a vector file of T or has a different byte order; load() such
+ files instead.
+*/
+template <typename T, typename Allocator>
+MappedVector<T> Vector<T, Dynamic, Allocator>::map(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), "Cannot open " + path);
     
-    T& operator[](std::size_t);
-    const T& operator[](std::size_t) const;
-    bool operator==(const Vector&) const;
-    bool operator!=(const Vector&) const;
+    struct stat status;
+    if (::fstat(fd, &status) != 0) {
+        const int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "Cannot open " + path);
+    }
     
-    template <typename A>
-    friend bool operator<(const Vector<A>&, const Vector<A>&);
+    const auto file_size = static_cast<std::size_t>(status.st_size);
+    if (file_size < sizeof(VectorFileHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Not a vector file");
+    }
     
-    template <typename A>
-    friend bool operator>(const Vector<A>&, const Vector<A>&);
+    void* mapping = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    const int error = errno;
+    ::close(fd); // the mapping keeps the file open
     
-    template <typename A>
-    friend bool operator<=(const Vector<A>&, const Vector<A>&);
+    if (mapping == MAP_FAILED)
+        throw std::system_error(error, std::generic_category(), "Cannot map " + path);
     
-    template <typename A>
-    friend bool operator>=(const Vector<A>&, const Vector<A>&);
+    // owns the mapping from here on, so that it is released if the header is rejected
+    MappedVector<T> result(mapping, file_size);
     
-    Vector& operator*=(T);
-    Vector& operator+(const Vector&);
-    Vector& operator-(const Vector&);
+    VectorFileHeader header;
+    std::memcpy(&header, mapping, sizeof(header));
+    if (vector_detail::check_header<T>(header))
+        throw std::runtime_error("Vector file has a different byte order, load() it instead");
     
-    template <typename A>
-    friend A dot_product(const Vector<A>&, const Vector<A>&);
+    if (header.payload_offset % alignof(T) != 0)
+        throw std::runtime_error("Corrupt vector file");
+    if (header.payload_offset > file_size || (file_size - header.payload_offset) / sizeof(T) < header.size)
+        throw std::runtime_error("Truncated vector file");
     
-    template <typename A>
-    friend Vector<A> cross_product(const Vector<A>&, const Vector<A>&);
+    const auto* elements = reinterpret_cast<const T*>(static_cast<const char*>(mapping) + header.payload_offset);
+    static_cast<VectorView<T>&>(result) = VectorView<T>(elements, header.size);
     
-    template <typename A>
-    friend std::ostream& operator<<(std::ostream&, Vector<A> const&);
+    return result;
+}
+#endif
+
+/*
+ Out-of-core streaming.
+ 
+ A VectorStream reduces a vector file chunk by chunk. A background thread
+ reads the next chunk into a second buffer while the current one is being
+ reduced, so a pass runs at the speed of the slower of the disk and the
+ kernels instead of alternating between reading and computing.
+*/
+namespace vector_detail {
+    inline constexpr std::size_t stream_chunk_bytes = std::size_t(1) << 20;
+    inline constexpr std::size_t stream_buffers = 2;
     
-    // iterators
-    T* begin();
-    const T* begin() const;
+    // elements of every chunk added to the t-digest of VectorStream::median()
+    inline constexpr std::size_t stream_median_samples = 4096;
     
-    T* end();
-    const T* end() const;
+    // adds the result of a chunk, compensated for floating point; the total is sum + compensation
+    template <typename T>
+    void add_chunk(T& sum, T& compensation, T x) {
+        if constexpr (std::is_floating_point_v<T>)
+            compensated_add(sum, compensation, x);
+        else
+            sum += x;
+    }
     
-private:
-    std::size_t size_;
-    std::unique_ptr<T[]> entries;
-};
-
-// overload std::swap
-namespace std {
+    // the elements of a vector file, found by VectorStream's constructor
+    struct stream_source {
+        std::string path;
+        std::uint64_t offset = 0;   // of the first element, in bytes
+        std::size_t size = 0;
+        bool swap = false;
+    };
+    
+    /*
+     Reads the elements of a file into a ring of `stream_buffers` chunks on a
+     thread of its own, starting as soon as it is constructed. next() hands
+     out the chunks in order and gives the previous one back to the thread.
+    */
     template <typename T>
-    void swap(Vector<T>& v1, Vector<T>& v2) noexcept(noexcept(v1.swap(v2))) {
-        v1.swap(v2);
+    class chunk_reader {
+    public:
+        chunk_reader(const stream_source&, std::size_t chunk);
+        ~chunk_reader();
+        
+        chunk_reader(const chunk_reader&) = delete;
+        chunk_reader& operator=(const chunk_reader&) = delete;
+        
+        // the next chunk, an empty view after the last one; rethrows the errors of the thread
+        VectorView<T> next();
+        
+    private:
+        void run();
+        void read(T*, std::size_t first, std::size_t count);
+        
+        const stream_source& source_;
+        std::size_t chunk_;
+        std::size_t chunks_;
+        std::vector<Vector<T>> buffers_;
+        
+#if defined(VECTOR_HAS_MMAP)
+        int fd_ = -1;
+#else
+        std::ifstream is_;
+#endif
+        
+        std::mutex mutex_;
+        std::condition_variable ready_;
+        std::size_t filled_ = 0;    // chunks read so far
+        std::size_t released_ = 0;  // chunks the consumer is done with
+        bool holding_ = false;      // next() handed out chunk `released_`
+        bool stop_ = false;
+        std::exception_ptr error_;
+        std::thread thread_;
+    };
+    
+    template <typename T>
+    chunk_reader<T>::chunk_reader(const stream_source& source, std::size_t chunk)
+        : source_(source), chunk_(chunk), chunks_((source.size + chunk - 1) / chunk)
+    {
+        for (std::size_t i = 0; i < std::min(stream_buffers, chunks_); i++)
+            buffers_.emplace_back(std::min(chunk_, source_.size), uninitialized);
+        
+#if defined(VECTOR_HAS_MMAP)
+        fd_ = ::open(source_.path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0)
+            throw std::system_error(errno, std::generic_category(), "Cannot open " + source_.path);
+    #if defined(POSIX_FADV_SEQUENTIAL)
+        ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+    #endif
+#else
+        is_.open(source_.path, std::ios::binary);
+        if (!is_)
+            throw std::runtime_error("Cannot open " + source_.path);
+#endif
+        
+        try {
+            thread_ = std::thread([this] { run(); });
+        } catch (...) {
+#if defined(VECTOR_HAS_MMAP)
+            ::close(fd_);
+#endif
+            throw;
+        }
+    }
+    
+    template <typename T>
+    chunk_reader<T>::~chunk_reader() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        ready_.notify_all();
+        thread_.join();
+        
+#if defined(VECTOR_HAS_MMAP)
+        ::close(fd_);
+#endif
+    }
+    
+    template <typename T>
+    VectorView<T> chunk_reader<T>::next() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (holding_) {
+            released_++;
+            holding_ = false;
+            ready_.notify_all();
+        }
+        
+        if (released_ == chunks_)
+            return VectorView<T>();
+        
+        ready_.wait(lock, [&] { return filled_ > released_ || error_; });
+        if (filled_ == released_)
+            std::rethrow_exception(error_);
+        
+        holding_ = true;
+        const std::size_t first = released_ * chunk_;
+        
+        return VectorView<T>(buffers_[released_ % stream_buffers].data(), std::min(chunk_, source_.size - first));
+    }
+    
+    template <typename T>
+    void chunk_reader<T>::run() {
+        try {
+            for (std::size_t k = 0; k < chunks_; k++) {
+                {
+                    // wait for the consumer to give back the buffer of chunk k - stream_buffers
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    ready_.wait(lock, [&] { return stop_ || k - released_ < stream_buffers; });
+                    if (stop_)
+                        return;
+                }
+                
+                T* out = buffers_[k % stream_buffers].data();
+                const std::size_t first = k * chunk_;
+                const std::size_t count = std::min(chunk_, source_.size - first);
+                
+                read(out, first, count);
+                if (source_.swap)
+                    byteswap(out, sizeof(T), count);
+                
+                std::lock_guard<std::mutex> lock(mutex_);
+                filled_++;
+                ready_.notify_all();
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = std::current_exception();
+            ready_.notify_all();
+        }
+    }
+    
+    template <typename T>
+    void chunk_reader<T>::read(T* out, std::size_t first, std::size_t count) {
+        char* bytes = reinterpret_cast<char*>(out);
+        std::size_t left = count * sizeof(T);
+        const std::uint64_t position = source_.offset + first * sizeof(T);
+        
+#if defined(VECTOR_HAS_MMAP)
+        auto offset = static_cast<off_t>(position);
+        while (left > 0) {
+            const ssize_t done = ::pread(fd_, bytes, left, offset);
+            if (done < 0) {
+                if (errno == EINTR)
+                    continue;
+                
+                throw std::system_error(errno, std::generic_category(), "Cannot read " + source_.path);
+            }
+            if (done == 0)
+                throw std::runtime_error("Truncated vector file");
+            
+            bytes += done;
+            left -= static_cast<std::size_t>(done);
+            offset += done;
+        }
+#else
+        is_.seekg(static_cast<std::streamoff>(position));
+        if (!is_.read(bytes, static_cast<std::streamsize>(left)))
+            throw std::runtime_error("Truncated vector file");
+#endif
     }
 }
 
-// print vector elements
+/*
+ @brief         A vector file reduced in chunks, for vectors larger than memory.
+ @tparam T      the type of the elements, which must match the file.
+ 
+ Nothing is read by the constructor but the header. Every reduction is one
+ sequential pass over the file with double-buffered reads: a background
+ thread fills one chunk while the other is reduced with the same SIMD
+ kernels as a Vector, and only these two chunks are ever in memory. Files
+ written on a machine with the other byte order are converted as they are
+ read. A stream can be shared by threads, each pass reads the file anew.
+*/
 template <typename T>
-std::ostream& operator<<(std::ostream& os, Vector<T> const& vec) {
-    if (!vec.entries)
-        return os << "nullptr";
+class VectorStream {
+public:
+    using value_type = T;
     
-    os << "[";
-    for (std::size_t i = 0; i < vec.size(); i++) {
-        os << vec.entries[i];
-        if (i < vec.size() - 1)
-            os << ", ";
-    }
-    os << "]";
+    static constexpr std::size_t default_chunk_size = vector_detail::stream_chunk_bytes / sizeof(T);
     
-    return os;
+    explicit VectorStream(const std::string& path, std::size_t chunk_size = default_chunk_size);
+    
+    std::size_t size() const;
+    std::size_t chunk_size() const;
+    
+    // calls f(chunk, offset) for consecutive views of up to chunk_size() elements, offset is the index of chunk[0]
+    template <typename F>
+    void for_each_chunk(F f) const;
+    
+    T sum() const;
+    T mean() const;
+    
+    T min() const;
+    T max() const;
+    MinMax<T> minmax() const;
+    
+    // approximate, from a t-digest of evenly spaced samples of every chunk
+    T median() const;
+    
+    template <typename U>
+    friend U dot_product(const VectorStream<U>&, const VectorStream<U>&);
+
+private:
+    vector_detail::stream_source source_;
+    std::size_t chunk_size_;
+};
+
+/*
+ @brief             Opens a file written by Vector::save() for streaming.
+ @param chunk_size  the number of elements read at once, 1 MB worth by default.
+ 
+ Throws std::invalid_argument if chunk_size is 0 and std::runtime_error if
+ the file cannot be opened, is not a vector file of T or is truncated. A
+ pass throws std::system_error if reading fails.
+*/
+template <typename T>
+VectorStream<T>::VectorStream(const std::string& path, std::size_t chunk_size) : chunk_size_(chunk_size) {
+    if (chunk_size == 0)
+        throw std::invalid_argument("Chunk size must be positive");
+    
+    std::ifstream is(path, std::ios::binary);
+    if (!is)
+        throw std::runtime_error("Cannot open " + path);
+    
+    VectorFileHeader header;
+    if (!is.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        throw std::runtime_error("Not a vector file");
+    
+    source_.swap = vector_detail::check_header<T>(header);
+    
+    is.seekg(0, std::ios::end);
+    const auto file_size = static_cast<std::uint64_t>(is.tellg());
+    if (header.payload_offset > file_size || (file_size - header.payload_offset) / sizeof(T) < header.size)
+        throw std::runtime_error("Truncated vector file");
+    
+    source_.path = path;
+    source_.offset = header.payload_offset;
+    source_.size = header.size;
 }
 
 template <typename T>
-std::ostream& operator<<(std::ostream& os, const std::vector<std::size_t>& indexes) {
-    os << "[";
-    for (std::size_t i = 0; i < indexes.size(); i++) {
-        os << indexes[i];
-        if (i < indexes.size() - 1)
-            os << ", ";
-    }
-    os << "]";
+std::size_t VectorStream<T>::size() const {
+    return source_.size;
+}
+
+template <typename T>
+std::size_t VectorStream<T>::chunk_size() const {
+    return chunk_size_;
+}
+
+/*
+ @brief     Passes the file to f one chunk at a time.
+ 
+ The view is only valid during the call: its buffer is refilled with a
+ later chunk afterwards. While f runs the next chunk is being read, so f
+ should take about as long per byte as the disk does or less. Exceptions
+ thrown by f or by the reads stop the pass and are rethrown.
+*/
+template <typename T>
+template <typename F>
+void VectorStream<T>::for_each_chunk(F f) const {
+    vector_detail::chunk_reader<T> reader(source_, chunk_size_);
     
-    return os;
+    std::size_t offset = 0;
+    for (VectorView<T> chunk = reader.next(); chunk.size() > 0; chunk = reader.next()) {
+        f(chunk, offset);
+        offset += chunk.size();
+    }
 }
 
+/*
+ @brief     Sum of the elements.
+ 
+ Each chunk is summed by the SIMD kernel of VectorView::sum() and the chunk
+ sums of floating point streams are added with Neumaier compensation, so the
+ error doesn't grow with the number of chunks.
+*/
 template <typename T>
-std::ostream& operator<<(std::ostream& os, const std::variant<T, std::vector<std::size_t>>& value) {
-    std::visit([&](auto&& arg) {
-        os << arg;
-    }, value);
+T VectorStream<T>::sum() const {
+    T total = T(), compensation = T();
+    for_each_chunk([&](VectorView<T> chunk, std::size_t) {
+        vector_detail::add_chunk(total, compensation, chunk.sum());
+    });
     
-    return os;
+    return total + compensation;
 }
 
 template <typename T>
-Vector<T>::Vector(std::size_t size)
-    : size_(size),
-      entries(std::make_unique<T[]>(size_))
-{}
+T VectorStream<T>::mean() const {
+    if (size() == 0)
+        throw std::logic_error("Vector is empty");
+    
+    return sum() / static_cast<T>(size());
+}
 
 /*
- @brief         Constructs a Vector object from a unique_ptr to an array.
- @tparam T      the type of elements in the array.
- @param vec     the unique_ptr to the array to construct the vector from.
+ @brief     Smallest and largest element with their indexes in the file, in one pass.
  
- This constructor takes a unique_ptr to an array and constructs a Vector
- object from it. The size of the vector is determined by the size of the array
- pointed to by the unique_ptr. If the unique_ptr is null, the size of the
- vector is 0.
- 
- Note that ownership of the array is transferred to the Vector object, so
- the array should not be accessed or modified after constructing the vector.
+ Ties go to the first index, as in Vector::minmax(). Throws std::length_error if the file is empty.
 */
 template <typename T>
-Vector<T>::Vector(const std::unique_ptr<T[]>& vec)
-    // returns the size of the array pointed to by vec.
-    // If vec is null, then vec.get() returns a null pointer
-    // and the ternary operator evaluates to the second operand, which is 0, resulting in a vector of size 0.
-    : size_(vec.get() ? std::extent<decltype(vec)>::value : 0),
-      entries(std::move(vec))
-{}
+MinMax<T> VectorStream<T>::minmax() const {
+    if (size() == 0)
+        throw std::length_error("Cannot find extrema of an empty vector");
+    
+    MinMax<T> result{};
+    for_each_chunk([&](VectorView<T> chunk, std::size_t offset) {
+        MinMax<T> local = chunk.minmax();
+        local.min.index += offset;
+        local.max.index += offset;
+        
+        if (offset == 0 || local.min.value < result.min.value)
+            result.min = local.min;
+        if (offset == 0 || result.max.value < local.max.value)
+            result.max = local.max;
+    });
+    
+    return result;
+}
 
 template <typename T>
-Vector<T>::Vector(Vector&& other)
-    : size_(other.size_),
-      entries(std::move(other.entries))
-{}
+T VectorStream<T>::min() const {
+    return minmax().min.value;
+}
 
 template <typename T>
-std::size_t Vector<T>::size() const {
-    return size_;
+T VectorStream<T>::max() const {
+    return minmax().max.value;
 }
 
+/*
+ @brief     Approximate median in one pass and constant memory.
+ 
+ Up to stream_median_samples evenly spaced elements of every chunk go into
+ a t-digest, weighted by how many elements each stands for, and the
+ median is interpolated from it between the extremes. Sampling keeps the
+ pass at disk speed; the rank error is a fraction of a percent for large
+ files, and files of a single chunk of up to 4096 elements are sampled
+ completely. Throws std::length_error if the file is empty.
+*/
 template <typename T>
-T Vector<T>::magnitude() const {
-    return std::sqrt(dot_product(*this, *this));
+T VectorStream<T>::median() const {
+    if (size() == 0)
+        throw std::length_error("Cannot calculate median of an empty vector");
+    
+    vector_detail::tdigest digest;
+    T lo = T(), hi = T();
+    
+    for_each_chunk([&](VectorView<T> chunk, std::size_t offset) {
+        const MinMax<T> extremes = chunk.minmax();
+        if (offset == 0 || extremes.min.value < lo)
+            lo = extremes.min.value;
+        if (offset == 0 || hi < extremes.max.value)
+            hi = extremes.max.value;
+        
+        const std::size_t n = chunk.size();
+        const std::size_t count = std::min(n, vector_detail::stream_median_samples);
+        const double weight = static_cast<double>(n) / static_cast<double>(count);
+        
+        // the middle of each of `count` equal slices of the chunk
+        for (std::size_t i = 0; i < count; i++)
+            digest.add(static_cast<double>(chunk[(2 * i + 1) * n / (2 * count)]), weight);
+    });
+    
+    return static_cast<T>(digest.quantile(0.5, static_cast<double>(lo), static_cast<double>(hi)));
 }
 
+/*
+ @brief     Dot product of two vector files, read side by side.
+ 
+ Both files are read ahead by threads of their own in chunks of u's size,
+ and the chunk products are added with compensation. Throws std::invalid_argument if the sizes differ.
+*/
 template <typename T>
-T Vector<T>::mean() const {
-    if (size_ == 0)
-        throw std::logic_error("Vector is empty");
+T dot_product(const VectorStream<T>& u, const VectorStream<T>& v) {
+    if (u.size() != v.size())
+        throw std::invalid_argument("Vectors must have the same size");
+    
+    vector_detail::chunk_reader<T> left(u.source_, u.chunk_size_);
+    vector_detail::chunk_reader<T> right(v.source_, u.chunk_size_);
+    
+    T total = T(), compensation = T();
+    for (VectorView<T> a = left.next(), b = right.next(); a.size() > 0; a = left.next(), b = right.next())
+        vector_detail::add_chunk(total, compensation, dot_product(a, b));
+    
+    return total + compensation;
+}
+
+/*
+ @brief     Dot product of a vector file and a vector in memory, e.g. a query.
+ 
+ Throws std::invalid_argument if the sizes differ.
+*/
+template <typename T>
+T dot_product(const VectorStream<T>& u, VectorView<vector_detail::identity_t<T>> v) {
+    if (u.size() != v.size())
+        throw std::invalid_argument("Vectors must have the same size");
+    
+    T total = T(), compensation = T();
+    u.for_each_chunk([&](VectorView<T> chunk, std::size_t offset) {
+        vector_detail::add_chunk(total, compensation, dot_product(chunk, v.view(offset, offset + chunk.size())));
+    });
     
-    return sum() / size_;
+    return total + compensation;
 }
 
-template <typename T>
-T Vector<T>::median() const {
-    if (size() == 0)
-        throw std::length_error("Cannot calculate median of an empty vector");
+/*
+ Distributed vectors.
+ 
+ A DistributedVector keeps one contiguous shard of a vector on every rank
+ of a group of processes or threads. Its reductions run the kernels of
+ Vector on the local shard, then combine the partial results of all the
+ ranks with an allreduce over a VectorTransport, so that every rank gets
+ the same result, bit for bit.
+*/
+
+/*
+ @brief     Moves bytes between the ranks of a group, for DistributedVector and allreduce().
+ 
+ Implement rank(), size(), send() and receive() to plug in another
+ transport than LocalTransport or MpiTransport. Messages from a rank to
+ another must arrive in the order they were sent, and receive() is given
+ the size of the message it waits for. The default exchange() sends first,
+ which only works if send() returns before the message is received.
+*/
+class VectorTransport {
+public:
+    virtual ~VectorTransport() = default;
     
-    const auto middle_idx = size_ / 2;
-    std::nth_element(entries.get(), entries.get() + middle_idx, entries.get() + size_);
+    virtual std::size_t rank() const = 0;
+    virtual std::size_t size() const = 0;
     
-    if (size_ & 1)
-        return entries[middle_idx];
+    virtual void send(std::size_t to, const void* data, std::size_t bytes) = 0;
+    virtual void receive(std::size_t from, void* data, std::size_t bytes) = 0;
     
-    const auto& lower_middle = entries[middle_idx - 1];
-    const auto& upper_midle = entries[middle_idx];
-    return (lower_middle + upper_midle) / 2;
+    // sends to a rank while receiving from another, without deadlocking when every rank does it at once
+    virtual void exchange(std::size_t to, const void* out, std::size_t out_bytes, std::size_t from, void* in, std::size_t in_bytes);
+};
+
+inline void VectorTransport::exchange(std::size_t to, const void* out, std::size_t out_bytes,
+                                      std::size_t from, void* in, std::size_t in_bytes)
+{
+    send(to, out, out_bytes);
+    receive(from, in, in_bytes);
 }
 
 /*
- @brief     Finds the maximum element(s) in the vector.
- @return    A std::variant object containing either the maximum element or a vector of indexes of the maximum elements.
+ @brief     Transport between the threads of a process, to run a distributed job on one node or to test it.
  
- This function finds the maximum element(s) in the vector and returns them in a std::variant object.
- If there is only one maximum element, the function returns the element itself.
- If there are multiple maximum elements, the function returns a vector of indexes of those elements.
- 
- The function uses the std::max_element function to find the maximum element(s) in the vector.
- 
- If there is only one maximum element, the function counts the number of occurrences of that element in the vector.
- If there is only one occurrence, the function returns the index of that element.
- If there are multiple occurrences, the function creates a vector of indexes of those occurrences and returns it.
+     auto ranks = LocalTransport::group(4);
+     std::vector<std::thread> threads;
+     for (auto& transport : ranks)
+         threads.emplace_back([transport] { DistributedVector<float> v(transport, n); ... });
  
- Note that if the vector is empty, the function returns the default-constructed std::variant object,
- which contains the value of the first alternative (i.e., a default-constructed T object).
+ send() copies the message into a mailbox of the receiver and returns at once.
 */
-template <typename T>
-std::variant<T, std::vector<std::size_t>> Vector<T>::max() const {
-    auto max_it = std::max_element(entries.get(), entries.get() + size_);
+class LocalTransport : public VectorTransport {
+public:
+    // one transport for every rank of a new group, to be used by a thread each
+    static std::vector<std::shared_ptr<LocalTransport>> group(std::size_t ranks);
     
-    if (std::count(entries.get(), entries.get() + size_, *max_it) == 1)
-        return std::distance(entries.get(), max_it);
-    else {
-        std::vector<std::size_t> indexes;
-        for (auto it = entries.get(); it != entries.get() + size_; ++it)
-            if (*it == *max_it)
-                indexes.push_back(std::distance(entries.get(), it));
-        
-        return indexes;
-    }
-}
+    std::size_t rank() const override;
+    std::size_t size() const override;
+    
+    void send(std::size_t to, const void* data, std::size_t bytes) override;
+    void receive(std::size_t from, void* data, std::size_t bytes) override;
 
-template <typename T>
-std::variant<T, std::vector<std::size_t>> Vector<T>::min() const {
-    auto min_it = std::min_element(entries.get(), entries.get() + size_);
+private:
+    struct mailbox {
+        std::mutex mutex;
+        std::condition_variable arrived;
+        std::deque<std::vector<char>> messages;
+    };
     
-    if (std::count(entries.get(), entries.get() + size_, *min_it) == 1)
-        return std::distance(entries.get(), min_it);
-    else {
-        std::vector<std::size_t> indexes;
-        for (auto it = entries.get(); it != entries.get() + size_; ++it)
-            if (*it == *min_it)
-                indexes.push_back(std::distance(entries.get(), it));
+    // the messages from rank i to rank j are in mailboxes[i * ranks + j]
+    struct shared_state {
+        explicit shared_state(std::size_t ranks) : ranks(ranks), mailboxes(ranks * ranks) {}
         
-        return indexes;
-    }
+        std::size_t ranks;
+        std::vector<mailbox> mailboxes;
+    };
+    
+    LocalTransport(std::shared_ptr<shared_state>, std::size_t rank);
+    
+    std::shared_ptr<shared_state> state_;
+    std::size_t rank_;
+};
+
+// throws std::invalid_argument if there are no ranks
+inline std::vector<std::shared_ptr<LocalTransport>> LocalTransport::group(std::size_t ranks) {
+    if (ranks == 0)
+        throw std::invalid_argument("A group needs at least one rank");
+    
+    auto state = std::make_shared<shared_state>(ranks);
+    
+    std::vector<std::shared_ptr<LocalTransport>> result;
+    for (std::size_t rank = 0; rank < ranks; rank++)
+        result.emplace_back(new LocalTransport(state, rank));
+    
+    return result;
 }
 
-template <typename T>
-T Vector<T>::sum() const {
-    return std::accumulate(entries.get(), entries.get() + size(), T());
+inline LocalTransport::LocalTransport(std::shared_ptr<shared_state> state, std::size_t rank)
+    : state_(std::move(state)), rank_(rank) {}
+
+inline std::size_t LocalTransport::rank() const {
+    return rank_;
 }
 
-template <typename T>
-T Vector<T>::product() const {
-    return std::accumulate(entries.get(), entries.get() + size(), T(1), std::multiplies<>());
+inline std::size_t LocalTransport::size() const {
+    return state_->ranks;
 }
 
-template <typename T>
-void Vector<T>::normalize() {
-    static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>, "Vector should consist of double or float types");
-    
-    T mag = magnitude();
-    if (mag == 0)
-        return;
+inline void LocalTransport::send(std::size_t to, const void* data, std::size_t bytes) {
+    if (to >= state_->ranks)
+        throw std::out_of_range("Rank out of range");
     
-    *this *= 1 / mag;
+    const char* begin = static_cast<const char*>(data);
+    mailbox& box = state_->mailboxes[rank_ * state_->ranks + to];
+    {
+        std::lock_guard<std::mutex> lock(box.mutex);
+        box.messages.emplace_back(begin, begin + bytes);
+    }
+    box.arrived.notify_one();
 }
 
-template <typename T>
-void Vector<T>::clear() {
-    size_ = 0;
-    entries.reset();
+// throws std::runtime_error if the message has another size than `bytes`
+inline void LocalTransport::receive(std::size_t from, void* data, std::size_t bytes) {
+    if (from >= state_->ranks)
+        throw std::out_of_range("Rank out of range");
+    
+    mailbox& box = state_->mailboxes[from * state_->ranks + rank_];
+    std::vector<char> message;
+    {
+        std::unique_lock<std::mutex> lock(box.mutex);
+        box.arrived.wait(lock, [&] { return !box.messages.empty(); });
+        message = std::move(box.messages.front());
+        box.messages.pop_front();
+    }
+    
+    if (message.size() != bytes)
+        throw std::runtime_error("Unexpected message size");
+    
+    if (bytes > 0)
+        std::memcpy(data, message.data(), bytes);
 }
 
-template <typename T>
-void Vector<T>::resize(std::size_t size, const T& default_value) {
-    if (size == size_)
-        return;
+#if defined(VECTOR_HAS_MPI)
+/*
+ @brief     Transport between the processes of an MPI communicator.
+ 
+ It works on a duplicate of the communicator, so its messages never match
+ those of the program. MPI must be initialized before the transport is
+ created and finalized after it is destroyed. Failed MPI calls throw
+ std::runtime_error if the communicator returns errors (MPI_ERRORS_RETURN);
+ with the default error handler, MPI aborts.
+*/
+class MpiTransport : public VectorTransport {
+public:
+    explicit MpiTransport(MPI_Comm = MPI_COMM_WORLD);
+    ~MpiTransport() override;
     
-    std::unique_ptr<T[]> new_entries = std::make_unique<T[]>(size);
-    std::size_t copy_size = std::min(size_, size);
+    MpiTransport(const MpiTransport&) = delete;
+    MpiTransport& operator=(const MpiTransport&) = delete;
     
-    std::copy(entries.get(), entries.get() + copy_size, new_entries.get());
-    std::fill(new_entries.get() + copy_size, new_entries.get() + size, default_value);
+    std::size_t rank() const override;
+    std::size_t size() const override;
     
-    entries = std::move(new_entries);
-    size_ = size;
-}
+    void send(std::size_t to, const void* data, std::size_t bytes) override;
+    void receive(std::size_t from, void* data, std::size_t bytes) override;
+    void exchange(std::size_t to, const void* out, std::size_t out_bytes, std::size_t from, void* in, std::size_t in_bytes) override;
 
-template <typename T>
-Vector<T> Vector<T>::subvec(std::size_t start, std::size_t end) const {
-    if (start >= end || end > size())
-        throw std::out_of_range("Invalid range for subvector");
+private:
+    MPI_Comm communicator_ = MPI_COMM_NULL;
+    std::size_t rank_ = 0;
+    std::size_t size_ = 0;
+};
+
+namespace vector_detail {
+    // MPI counts are ints: larger messages go as several pieces of up to this many bytes
+    inline constexpr std::size_t mpi_piece_bytes = std::size_t(1) << 30;
     
-    Vector<T> sub(end - start);
-    std::copy(entries.get() + start, entries.get() + end,sub.entries.get());
+    inline void check_mpi(int error, const char* call) {
+        if (error != MPI_SUCCESS)
+            throw std::runtime_error(std::string(call) + " failed");
+    }
     
-    return sub;
+    inline int mpi_count(std::size_t bytes, std::size_t done) {
+        return static_cast<int>(std::min(mpi_piece_bytes, bytes - done));
+    }
 }
 
-template <typename T>
-Vector<T> concat(const Vector<T>& v1, const Vector<T>& v2) {
-    Vector<T> result(v1.size() + v2.size());
+inline MpiTransport::MpiTransport(MPI_Comm communicator) {
+    vector_detail::check_mpi(MPI_Comm_dup(communicator, &communicator_), "MPI_Comm_dup");
+    
+    int rank = 0, size = 0;
+    MPI_Comm_rank(communicator_, &rank);
+    MPI_Comm_size(communicator_, &size);
+    rank_ = static_cast<std::size_t>(rank);
+    size_ = static_cast<std::size_t>(size);
+}
 
-    std::copy(v1.begin(), v1.end(), result.begin());
-    std::copy(v2.begin(), v2.end(), result.begin() + v1.size());
+inline MpiTransport::~MpiTransport() {
+    MPI_Comm_free(&communicator_);
+}
 
-    return result;
+inline std::size_t MpiTransport::rank() const {
+    return rank_;
 }
 
-template <typename T>
-void Vector<T>::insert(std::size_t pos, const T& value) {
-    if (pos > size())
-        throw std::out_of_range("Index out of range");
-    
-    resize(size_ + 1, T());
-    std::move_backward(entries.get() + pos, entries.get() + size_ - 1, entries.get() + size_);
-    
-    entries[pos] = value;
+inline std::size_t MpiTransport::size() const {
+    return size_;
 }
 
-template <typename T>
-void Vector<T>::insert(std::size_t pos, std::size_t count, const T& value) {
-    if (pos > size())
-        throw std::out_of_range("Index out of range");
-    
-    resize(size_ + count, T());
+inline void MpiTransport::send(std::size_t to, const void* data, std::size_t bytes) {
+    const char* out = static_cast<const char*>(data);
+    for (std::size_t done = 0; done < bytes; done += vector_detail::mpi_piece_bytes)
+        vector_detail::check_mpi(MPI_Send(out + done, vector_detail::mpi_count(bytes, done), MPI_BYTE,
+                                          static_cast<int>(to), 0, communicator_), "MPI_Send");
+}
+
+inline void MpiTransport::receive(std::size_t from, void* data, std::size_t bytes) {
+    char* in = static_cast<char*>(data);
+    for (std::size_t done = 0; done < bytes; done += vector_detail::mpi_piece_bytes)
+        vector_detail::check_mpi(MPI_Recv(in + done, vector_detail::mpi_count(bytes, done), MPI_BYTE,
+                                          static_cast<int>(from), 0, communicator_, MPI_STATUS_IGNORE), "MPI_Recv");
+}
+
+// MPI_Send may wait for the receiver, so all the pieces are posted as nonblocking operations first
+inline void MpiTransport::exchange(std::size_t to, const void* out, std::size_t out_bytes,
+                                   std::size_t from, void* in, std::size_t in_bytes)
+{
+    std::vector<MPI_Request> requests;
+    for (std::size_t done = 0; done < in_bytes; done += vector_detail::mpi_piece_bytes) {
+        requests.emplace_back();
+        vector_detail::check_mpi(MPI_Irecv(static_cast<char*>(in) + done, vector_detail::mpi_count(in_bytes, done), MPI_BYTE,
+                                           static_cast<int>(from), 0, communicator_, &requests.back()), "MPI_Irecv");
+    }
+    for (std::size_t done = 0; done < out_bytes; done += vector_detail::mpi_piece_bytes) {
+        requests.emplace_back();
+        vector_detail::check_mpi(MPI_Isend(static_cast<const char*>(out) + done, vector_detail::mpi_count(out_bytes, done), MPI_BYTE,
+                                           static_cast<int>(to), 0, communicator_, &requests.back()), "MPI_Isend");
+    }
     
-    std::move_backward(entries.get() + pos, entries.get() + size_ - count, entries.get() + size_);
-    std::fill_n(entries.get() + pos, count, value);
+    vector_detail::check_mpi(MPI_Waitall(static_cast<int>(requests.size()), requests.data(), MPI_STATUSES_IGNORE), "MPI_Waitall");
 }
+#endif
 
-template <typename T>
-template <typename InputIt>
-void Vector<T>::insert(std::size_t pos, InputIt first, InputIt last) {
-    if (pos > size())
-        throw std::out_of_range("Index out of range");
+/*
+ Collectives over a VectorTransport. Every rank of the group has to call
+ them, in the same order, with buffers of the same size.
+*/
+namespace vector_detail {
+    // payloads from which allreduce() goes around a ring instead of a tree
+    inline constexpr std::size_t ring_allreduce_bytes = std::size_t(1) << 16;
     
-    const std::size_t count = std::distance(first, last);
-    resize(size_ + count, T());
+    // elements of the shard of every rank sampled by DistributedVector::quantile()
+    inline constexpr std::size_t distributed_quantile_samples = 4096;
+    
+    /*
+     Binomial tree: rank r + 2^k sends its partial result to rank r, for
+     k = 0, 1, ..., until rank 0 holds the result, which then goes back down
+     the same tree. That is 2 log2(p) steps of latency, the least for small
+     payloads. op(a, b) gets in `a` the result of lower ranks than in `b`, so
+     it needs to be associative but not commutative, and every rank ends up
+     with the bits of rank 0.
+    */
+    template <typename T, typename Op>
+    void tree_allreduce(VectorTransport& transport, T* data, std::size_t n, Op op) {
+        static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be sent");
+        
+        const std::size_t rank = transport.rank(), ranks = transport.size();
+        std::vector<T> received(n);
+        
+        std::size_t mask = 1;
+        for (; mask < ranks; mask <<= 1) {
+            if (rank & mask) {
+                transport.send(rank - mask, data, n * sizeof(T));
+                break;
+            }
+            if (rank + mask < ranks) {
+                transport.receive(rank + mask, received.data(), n * sizeof(T));
+                for (std::size_t i = 0; i < n; i++)
+                    data[i] = op(data[i], received[i]);
+            }
+        }
+        
+        // mask is the lowest bit of rank now, or the power of two above the last rank for rank 0
+        if (rank != 0)
+            transport.receive(rank - mask, data, n * sizeof(T));
+        for (mask >>= 1; mask > 0; mask >>= 1)
+            if (rank + mask < ranks)
+                transport.send(rank + mask, data, n * sizeof(T));
+    }
+    
+    /*
+     Ring: in p - 1 steps of reduce-scatter, every rank adds the part it
+     receives from the previous rank to its own and passes it on, which
+     leaves rank r with the result of part (r + 1) mod p. In p - 1 more
+     steps the results go around. Every rank sends about 2n elements
+     whatever p, against n log2(p) through the tree, so large payloads are
+     limited by bandwidth rather than latency. The parts are combined in
+     ring order, so op has to be commutative; the result of every part is
+     computed once, hence it is still the same on every rank.
+    */
+    template <typename T, typename Op>
+    void ring_allreduce(VectorTransport& transport, T* data, std::size_t n, Op op) {
+        static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be sent");
+        
+        const std::size_t rank = transport.rank(), ranks = transport.size();
+        const std::size_t next = (rank + 1) % ranks, previous = (rank + ranks - 1) % ranks;
+        
+        auto first = [&](std::size_t part) { return part * n / ranks; };
+        auto bytes = [&](std::size_t part) { return (first(part + 1) - first(part)) * sizeof(T); };
+        std::vector<T> received(n / ranks + 1);
+        
+        for (std::size_t step = 0; step + 1 < ranks; step++) {
+            const std::size_t out = (rank + ranks - step) % ranks;
+            const std::size_t in = (rank + 2 * ranks - step - 1) % ranks;
+            
+            transport.exchange(next, data + first(out), bytes(out), previous, received.data(), bytes(in));
+            for (std::size_t i = first(in); i < first(in + 1); i++)
+                data[i] = op(received[i - first(in)], data[i]);
+        }
+        
+        for (std::size_t step = 0; step + 1 < ranks; step++) {
+            const std::size_t out = (rank + 1 + ranks - step) % ranks;
+            const std::size_t in = (rank + ranks - step) % ranks;
+            
+            transport.exchange(next, data + first(out), bytes(out), previous, data + first(in), bytes(in));
+        }
+    }
+    
+    // the number of elements of every rank
+    inline std::vector<std::uint64_t> shard_sizes(VectorTransport& transport, std::size_t local) {
+        std::vector<std::uint64_t> sizes(transport.size());
+        sizes[transport.rank()] = local;
+        tree_allreduce(transport, sizes.data(), sizes.size(), std::plus<>());
+        
+        return sizes;
+    }
+    
+    // the elements of all the ranks, concatenated in rank order; each block goes once around the ring
+    template <typename T>
+    std::vector<T> allgather(VectorTransport& transport, const std::vector<T>& local) {
+        static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be sent");
+        
+        const std::size_t rank = transport.rank(), ranks = transport.size();
+        const std::size_t next = (rank + 1) % ranks, previous = (rank + ranks - 1) % ranks;
+        const std::vector<std::uint64_t> sizes = shard_sizes(transport, local.size());
+        
+        std::vector<std::size_t> first(ranks + 1);
+        for (std::size_t r = 0; r < ranks; r++)
+            first[r + 1] = first[r] + static_cast<std::size_t>(sizes[r]);
+        
+        std::vector<T> all(first[ranks]);
+        std::copy(local.begin(), local.end(), all.begin() + first[rank]);
+        
+        for (std::size_t step = 0; step + 1 < ranks; step++) {
+            const std::size_t out = (rank + ranks - step) % ranks;
+            const std::size_t in = (rank + 2 * ranks - step - 1) % ranks;
+            
+            transport.exchange(next, all.data() + first[out], sizes[out] * sizeof(T),
+                               previous, all.data() + first[in], sizes[in] * sizeof(T));
+        }
+        
+        return all;
+    }
+    
+    // a sum and the error of its additions, see add_chunk
+    template <typename T>
+    struct partial_sum {
+        T sum;
+        T compensation;
+    };
+    
+    template <typename T>
+    partial_sum<T> add_partials(partial_sum<T> a, const partial_sum<T>& b) {
+        add_chunk(a.sum, a.compensation, b.sum);
+        a.compensation += b.compensation;
+        
+        return a;
+    }
+    
+    // the partial dot product of a rank, which may have found that the shards don't match
+    template <typename T>
+    struct partial_dot {
+        partial_sum<T> product;
+        bool mismatch;
+    };
+    
+    // the extrema of a rank, with indexes into the whole vector; an empty shard has none
+    template <typename T>
+    struct partial_extrema {
+        MinMax<T> extrema;
+        bool empty;
+    };
+    
+    // b holds higher indexes than a, so ties keep a, as in Vector::minmax()
+    template <typename T>
+    partial_extrema<T> merge_extrema(partial_extrema<T> a, const partial_extrema<T>& b) {
+        if (a.empty)
+            return b;
+        if (b.empty)
+            return a;
+        
+        if (b.extrema.min.value < a.extrema.min.value)
+            a.extrema.min = b.extrema.min;
+        if (a.extrema.max.value < b.extrema.max.value)
+            a.extrema.max = b.extrema.max;
+        
+        return a;
+    }
     
-    std::move_backward(entries.get() + pos, entries.get() + size_ - count, entries.get() + size_);
-    std::copy(first, last, entries.get() + pos);
+    // an element of a shard standing for `weight` elements of the whole vector
+    template <typename T>
+    struct quantile_sample {
+        T value;
+        double weight;
+    };
 }
 
-template <typename T>
-void Vector<T>::insert(std::size_t pos, std::initializer_list<T> ilist) {
-    insert(pos, ilist.begin(), ilist.end());
+/*
+ @brief     Replaces v, on every rank, by the element-wise sum of the vectors of all the ranks.
+ 
+ Collective: every rank of the group calls it with a vector of the same
+ size, e.g. to add up gradients. Vectors smaller than 64 KiB go up and down
+ a binomial tree, larger ones around a ring, which sends about 2 * v.size()
+ elements per rank whatever the number of ranks. Every rank gets the same bits.
+*/
+template <typename T, typename Allocator>
+void allreduce(VectorTransport& transport, Vector<T, Dynamic, Allocator>& v) {
+    const std::size_t n = v.size();
+    
+    if (n * sizeof(T) >= vector_detail::ring_allreduce_bytes && n >= transport.size())
+        vector_detail::ring_allreduce(transport, v.data(), n, std::plus<>());
+    else
+        vector_detail::tree_allreduce(transport, v.data(), n, std::plus<>());
 }
 
+/*
+ @brief         A vector split into contiguous shards over the ranks of a VectorTransport.
+ @tparam T      the type of the elements, which must be trivially copyable.
+ 
+ Rank r holds the elements [offset(), offset() + local().size()) of the
+ whole vector in local(), a Vector that can be filled and transformed like
+ any other, as long as its size doesn't change. The reductions compute the
+ partial result of the shard with the SIMD kernels of Vector and combine
+ the partial results of the ranks in a binomial tree.
+ 
+ Reductions are collective: every rank must call them, in the same order,
+ and they return the same result on every rank. Errors that depend on the
+ whole vector, like an empty one, are thrown by every rank alike.
+ 
+     DistributedVector<double> v(std::make_shared<MpiTransport>(), n);
+     fill(v.local(), v.offset());
+     v.normalize();
+     double median = v.median();
+*/
 template <typename T>
-void Vector<T>::erase(std::size_t pos) {
-    if (pos >= size())
-        throw std::out_of_range("Index out of range");
+class DistributedVector {
+public:
+    using value_type = T;
     
-    std::move(begin() + pos + 1, end(), begin() + pos);
-    resize(size() - 1, T());
-}
+    DistributedVector(std::shared_ptr<VectorTransport>, std::size_t size);
+    DistributedVector(std::shared_ptr<VectorTransport>, Vector<T> local);
+    
+    // of the whole vector
+    std::size_t size() const;
+    
+    // the index of local()[0] in the whole vector
+    std::size_t offset() const;
+    
+    Vector<T>& local();
+    const Vector<T>& local() const;
+    
+    VectorTransport& transport() const;
+    
+    T sum() const;
+    T mean() const;
+    T magnitude() const;
+    void normalize();
+    
+    // with the indexes in the whole vector
+    MinMax<T> minmax() const;
+    T min() const;
+    T max() const;
+    
+    // approximate for shards of more than distributed_quantile_samples elements, see quantile()
+    T median() const;
+    T quantile(double p) const;
 
-template <typename T>
-void Vector<T>::erase(std::size_t first, std::size_t last) {
-    if (first >= size() || last > size() || first >= last)
-        throw std::out_of_range("Invalid range");
+private:
+    static_assert(std::is_trivially_copyable_v<T>, "Elements of a distributed vector must be trivially copyable");
     
-    std::move(entries.get() + last, entries.get() + size(), entries.get() + first);
-    resize(size() - (last - first));
-}
+    std::shared_ptr<VectorTransport> transport_;
+    Vector<T> local_;
+    std::size_t size_ = 0;
+    std::size_t offset_ = 0;
+};
 
+/*
+ @brief         Creates a vector of `size` value-initialized elements, split evenly over the ranks.
+ 
+ The first size % ranks ranks hold one element more than the others. No
+ messages are needed. Throws std::invalid_argument if transport is null.
+*/
 template <typename T>
-T& Vector<T>::operator[](std::size_t i) {
-    if (i > size())
-        throw std::out_of_range("Index out of range");
+DistributedVector<T>::DistributedVector(std::shared_ptr<VectorTransport> transport, std::size_t size)
+    : transport_(std::move(transport)), size_(size)
+{
+    if (!transport_)
+        throw std::invalid_argument("Transport must not be null");
     
-    return entries[i];
+    const std::size_t rank = transport_->rank(), ranks = transport_->size();
+    offset_ = size / ranks * rank + std::min(rank, size % ranks);
+    local_ = Vector<T>(size / ranks + (rank < size % ranks ? 1 : 0));
 }
 
+/*
+ @brief         Makes a distributed vector of the shards the ranks already hold, in rank order.
+ 
+ Collective, the shards can have any sizes, including 0. Throws std::invalid_argument if transport is null.
+*/
 template <typename T>
-const T& Vector<T>::operator[](std::size_t i) const {
-    if (i > size())
-        throw std::out_of_range("Index out of range");
+DistributedVector<T>::DistributedVector(std::shared_ptr<VectorTransport> transport, Vector<T> local)
+    : transport_(std::move(transport)), local_(std::move(local))
+{
+    if (!transport_)
+        throw std::invalid_argument("Transport must not be null");
     
-    return entries[i];
+    const std::vector<std::uint64_t> sizes = vector_detail::shard_sizes(*transport_, local_.size());
+    for (std::size_t r = 0; r < sizes.size(); r++) {
+        if (r < transport_->rank())
+            offset_ += static_cast<std::size_t>(sizes[r]);
+        size_ += static_cast<std::size_t>(sizes[r]);
+    }
 }
 
 template <typename T>
-bool Vector<T>::operator==(const Vector& other) const {
-    return entries == other.entries;
+std::size_t DistributedVector<T>::size() const {
+    return size_;
 }
 
 template <typename T>
-bool Vector<T>::operator!=(const Vector& other) const {
-    return entries != other.entries;
+std::size_t DistributedVector<T>::offset() const {
+    return offset_;
 }
 
 template <typename T>
-bool operator<(const Vector<T>& v1, const Vector<T>& v2) {
-    return std::lexicographical_compare(v1.entries.get(), v1.entries.get() + v1.size(),
-                                        v2.entries.get(), v2.entries.get() + v2.size());
+Vector<T>& DistributedVector<T>::local() {
+    return local_;
 }
 
 template <typename T>
-bool operator>(const Vector<T>& v1, const Vector<T>& v2) {
-    return std::lexicographical_compare(v2.entries.get(), v2.entries.get() + v2.size(),
-                                        v1.entries.get(), v1.entries.get() + v1.size());
+const Vector<T>& DistributedVector<T>::local() const {
+    return local_;
 }
 
 template <typename T>
-bool operator<=(const Vector<T>& v1, const Vector<T>& v2) {
-    return !(v2 < v1);
+VectorTransport& DistributedVector<T>::transport() const {
+    return *transport_;
 }
 
+/*
+ @brief     Sum of the elements.
+ 
+ The shard sums of floating point vectors are added with Neumaier
+ compensation, as the chunks of a VectorStream, so the error doesn't grow
+ with the number of ranks.
+*/
 template <typename T>
-bool operator>=(const Vector<T>& v1, const Vector<T>& v2) {
-    return !(v1 < v2);
+T DistributedVector<T>::sum() const {
+    vector_detail::partial_sum<T> partial{ local_.sum(), T() };
+    vector_detail::tree_allreduce(*transport_, &partial, 1, vector_detail::add_partials<T>);
+    
+    return partial.sum + partial.compensation;
 }
 
 template <typename T>
-Vector<T>& Vector<T>::operator*=(T scalar) {
-    std::transform(entries.get(),
-        entries.get() + size_,
-        entries.get(), [scalar](T x)
-    {
-        return x * scalar;
-    });
+T DistributedVector<T>::mean() const {
+    if (size_ == 0)
+        throw std::logic_error("Vector is empty");
     
-    return *this;
+    return sum() / static_cast<T>(size_);
 }
 
 template <typename T>
-Vector<T>& Vector<T>::operator+(const Vector& other) {
-    if (size() != other.size())
-        throw std::invalid_argument("Vectors must have the same size");
-    
-    Vector<T> result(size());
-    std::transform(entries.get(), entries.get() + size(), other.entries.get(), entries.get(), std::plus<>());
+T DistributedVector<T>::magnitude() const {
+    vector_detail::partial_sum<T> partial{ dot_product(local_, local_), T() };
+    vector_detail::tree_allreduce(*transport_, &partial, 1, vector_detail::add_partials<T>);
     
-    return *this;
+    return static_cast<T>(std::sqrt(partial.sum + partial.compensation));
 }
 
+// divides the vector by its magnitude, unless the magnitude is 0; every rank scales its own shard
 template <typename T>
-Vector<T>& Vector<T>::operator-(const Vector& other) {
-    if (size() != other.size())
-        throw std::invalid_argument("Vectors must have the same size");
+void DistributedVector<T>::normalize() {
+    static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>, "Vector should consist of double or float types");
     
-    Vector<T> result(size());
-    std::transform(entries.get(), entries.get() + size(), other.entries.get(), entries.get(), std::minus<>());
+    const T mag = magnitude();
+    if (mag == 0)
+        return;
     
-    return *this;
+    local_ *= 1 / mag;
 }
 
+/*
+ @brief     Smallest and largest element with their indexes in the whole vector.
+ 
+ One message up and down the tree whatever the size. Ties go to the first
+ index, as in Vector::minmax(). Throws std::length_error if the vector is empty.
+*/
 template <typename T>
-T dot_product(const Vector<T>& u, const Vector<T>& v) {
-    if (u.size() != v.size())
-        throw std::invalid_argument("Vectors must have the same size");
+MinMax<T> DistributedVector<T>::minmax() const {
+    if (size_ == 0)
+        throw std::length_error("Cannot find extrema of an empty vector");
+    
+    vector_detail::partial_extrema<T> partial{ {}, local_.size() == 0 };
+    if (!partial.empty) {
+        partial.extrema = local_.minmax();
+        partial.extrema.min.index += offset_;
+        partial.extrema.max.index += offset_;
+    }
+    vector_detail::tree_allreduce(*transport_, &partial, 1, vector_detail::merge_extrema<T>);
     
-    return std::inner_product(u.entries.get(),
-                              u.entries.get() + u.size(),
-                              v.entries.get(), T());
+    return partial.extrema;
 }
 
 template <typename T>
-Vector<T> cross_product(const Vector<T>& lhs, const Vector<T>& rhs) {
-    if (lhs.size() != rhs.size() || lhs.size() < 3)
-        throw std::invalid_argument("Vectors must have at least 3 elements and have the same size");
-    
-    Vector<T> w(lhs.size());
-    w[0] = lhs[1] * rhs[2] - lhs[2] * rhs[1];
-    w[1] = lhs[2] * rhs[0] - lhs[0] * rhs[2];
-    w[2] = lhs[0] * rhs[1] - lhs[1] * rhs[0];
-
-    for (std::size_t i = 3; i < lhs.size(); i++) {
-        w[i] = lhs[(i + 1) % lhs.size()] * rhs[(i + 2) % rhs.size()] - lhs[(i + 2) % lhs.size()] * rhs[(i + 1) % rhs.size()];
-    }
-    
-    return w;
+T DistributedVector<T>::min() const {
+    return minmax().min.value;
 }
 
 template <typename T>
-T* Vector<T>::begin() {
-    return entries.get();
+T DistributedVector<T>::max() const {
+    return minmax().max.value;
 }
 
 template <typename T>
-const T* Vector<T>::begin() const {
-    return entries.get();
+T DistributedVector<T>::median() const {
+    return quantile(0.5);
 }
 
+/*
+ @brief     Quantile of the whole vector from samples of every shard.
+ @param p   the probability, in [0, 1].
+ 
+ Every rank selects up to distributed_quantile_samples evenly spaced ranks
+ of its shard, each standing for as many elements as lie between them,
+ and all the samples are gathered on every rank, so a rank receives a few
+ KB per rank instead of the vector. The quantile is interpolated between
+ the closest ranks as in Vector::quantile(), which makes it exact when no
+ shard has more than distributed_quantile_samples elements; otherwise the
+ rank of the result is off by about size() / distributed_quantile_samples at most.
+ 
+ Throws std::invalid_argument if p is out of range, std::length_error if the vector is empty.
+*/
 template <typename T>
-T* Vector<T>::end() {
-    return entries.get() + size_;
+T DistributedVector<T>::quantile(double p) const {
+    if (size_ == 0)
+        throw std::length_error("Cannot calculate quantile of an empty vector");
+    
+    const vector_detail::quantile_rank position = vector_detail::rank_of(p, size_);
+    
+    const std::size_t n = local_.size();
+    const std::size_t count = std::min(n, vector_detail::distributed_quantile_samples);
+    
+    // the middle rank of each of `count` equal slices of the sorted shard
+    std::vector<std::size_t> ranks(count);
+    for (std::size_t i = 0; i < count; i++)
+        ranks[i] = (2 * i + 1) * n / (2 * count);
+    
+    std::vector<T> values(count);
+    if (count > 0)
+        vector_detail::select_ranks(execution::seq, local_.data(), n, ranks.data(), count, values.data());
+    
+    std::vector<vector_detail::quantile_sample<T>> samples(count);
+    for (std::size_t i = 0; i < count; i++)
+        samples[i] = { values[i], static_cast<double>(n) / static_cast<double>(count) };
+    
+    std::vector<vector_detail::quantile_sample<T>> all = vector_detail::allgather(*transport_, samples);
+    std::sort(all.begin(), all.end(), [](const auto& a, const auto& b) { return a.value < b.value; });
+    
+    // all[i] stands for the ranks [before[i], before[i] + all[i].weight) of the sorted vector
+    std::vector<double> before(all.size());
+    for (std::size_t i = 1; i < all.size(); i++)
+        before[i] = before[i - 1] + all[i - 1].weight;
+    
+    auto at = [&](std::size_t rank) -> const T& {
+        const auto next = std::upper_bound(before.begin(), before.end(), static_cast<double>(rank));
+        return all[static_cast<std::size_t>(next - before.begin()) - 1].value;
+    };
+    
+    return position.weight == 0 ? at(position.lower) : vector_detail::interpolate(at(position.lower), at(position.upper), position.weight);
 }
 
+/*
+ @brief     Dot product of two distributed vectors split alike, e.g. created with the same size and transport.
+ 
+ Throws std::invalid_argument if the sizes differ, or if the shards of any
+ rank differ: every rank throws then, not only those whose shards differ.
+*/
 template <typename T>
-const T* Vector<T>::end() const {
-    return entries.get() + size_;
+T dot_product(const DistributedVector<T>& u, const DistributedVector<T>& v) {
+    if (u.size() != v.size())
+        throw std::invalid_argument("Vectors must have the same size");
+    
+    const bool mismatch = u.offset() != v.offset() || u.local().size() != v.local().size();
+    vector_detail::partial_dot<T> partial{ { mismatch ? T() : dot_product(u.local(), v.local()), T() }, mismatch };
+    
+    vector_detail::tree_allreduce(u.transport(), &partial, 1, [](vector_detail::partial_dot<T> a, const vector_detail::partial_dot<T>& b) {
+        return vector_detail::partial_dot<T>{ vector_detail::add_partials(a.product, b.product), a.mismatch || b.mismatch };
+    });
+    
+    if (partial.mismatch)
+        throw std::invalid_argument("Vectors must be split alike");
+    
+    return partial.product.sum + partial.product.compensation;
 }
 
 #endif /* vector_hpp */
-